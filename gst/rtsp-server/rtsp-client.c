@@ -54,6 +54,7 @@
 #include "rtsp-sdp.h"
 #include "rtsp-params.h"
 #include "rtsp-server-internal.h"
+#include "rtsp-timer-wheel.h"
 
 typedef enum
 {
@@ -97,6 +98,18 @@ struct _GstRTSPClientPrivate
   gchar *path;
   GstRTSPMedia *media;
 
+  /* the request that waits for the cached media to prepare and the requests
+   * that arrived after it, only used from the watch context */
+  GstRTSPMessage *deferred_request;
+  GQueue pending_requests;
+  gboolean resuming;
+  /* the cached media was described from its idle SDP and is preparing, the
+   * next requests wait for it */
+  gboolean media_preparing;
+  /* the cached media was prepared with other streams than it was described
+   * with, SETUP fails until the next DESCRIBE */
+  gboolean media_changed;
+
   GHashTable *transports;
   GList *sessions;
   guint sessions_cookie;
@@ -107,8 +120,8 @@ struct _GstRTSPClientPrivate
   guint content_length_limit;
 
   gboolean had_session;
-  GSource *rtsp_ctrl_timeout;
-  guint rtsp_ctrl_timeout_cnt;
+  GstRTSPTimerWheel *timer_wheel;
+  guint rtsp_ctrl_timeout_id;
 
   /* The version currently being used */
   GstRTSPVersion version;
@@ -133,8 +146,9 @@ static GHashTable *tunnels;     /* protected by tunnels_lock */
 #define DEFAULT_DROP_BACKLOG            TRUE
 #define DEFAULT_POST_SESSION_TIMEOUT    -1
 
-#define RTSP_CTRL_CB_INTERVAL           1
 #define RTSP_CTRL_TIMEOUT_VALUE         60
+/* requests that are queued while a media prepares, the next ones get a 503 */
+#define MAX_PENDING_REQUESTS            16
 
 enum
 {
@@ -188,6 +202,8 @@ static void gst_rtsp_client_set_property (GObject * object, guint propid,
 static void gst_rtsp_client_finalize (GObject * obj);
 
 static void rtsp_ctrl_timeout_remove (GstRTSPClient * client);
+static void handle_request (GstRTSPClient * client, GstRTSPMessage * request);
+static void clear_pending_requests (GstRTSPClientPrivate * priv);
 
 static GstSDPMessage *create_sdp (GstRTSPClient * client, GstRTSPMedia * media);
 static gboolean handle_sdp (GstRTSPClient * client, GstRTSPContext * ctx,
@@ -618,6 +634,7 @@ gst_rtsp_client_init (GstRTSPClient * client)
       g_str_equal, g_free, g_free);
   priv->tstate = TUNNEL_STATE_UNKNOWN;
   priv->content_length_limit = G_MAXUINT;
+  g_queue_init (&priv->pending_requests);
 }
 
 static GstRTSPFilterResult
@@ -751,6 +768,7 @@ clean_cached_media (GstRTSPClient * client, gboolean unprepare)
     g_object_unref (priv->media);
     priv->media = NULL;
   }
+  priv->media_changed = FALSE;
 }
 
 /* A client is finalized when the connection is broken */
@@ -765,7 +783,12 @@ gst_rtsp_client_finalize (GObject * obj)
   /* the watch and related state should be cleared before finalize
    * as the watch actually holds a strong reference to the client */
   g_assert (priv->watch == NULL);
-  g_assert (priv->rtsp_ctrl_timeout == NULL);
+  g_assert (priv->rtsp_ctrl_timeout_id == 0);
+
+  if (priv->timer_wheel) {
+    gst_rtsp_timer_wheel_unref (priv->timer_wheel);
+    priv->timer_wheel = NULL;
+  }
 
   if (priv->watch_context) {
     g_main_context_unref (priv->watch_context);
@@ -799,6 +822,8 @@ gst_rtsp_client_finalize (GObject * obj)
 
   clean_cached_media (client, TRUE);
 
+  clear_pending_requests (priv);
+
   g_free (priv->server_ip);
   g_mutex_clear (&priv->lock);
   g_mutex_clear (&priv->send_lock);
@@ -967,18 +992,135 @@ paths_are_equal (const gchar * path1, const gchar * path2, gint len2)
   return TRUE;
 }
 
+/* reply to @request outside of handle_request(), for requests that were
+ * deferred or could not be queued */
+static void
+send_request_error (GstRTSPClient * client, GstRTSPMessage * request,
+    GstRTSPStatusCode code)
+{
+  GstRTSPClientPrivate *priv = client->priv;
+  GstRTSPContext sctx = { NULL };
+  GstRTSPMessage response = { 0 };
+
+  sctx.conn = priv->connection;
+  sctx.client = client;
+  sctx.auth = priv->auth;
+  sctx.request = request;
+  sctx.response = &response;
+  gst_rtsp_context_push_current (&sctx);
+  send_generic_response (client, code, &sctx);
+  gst_rtsp_context_pop_current (&sctx);
+}
+
+static void
+clear_pending_requests (GstRTSPClientPrivate * priv)
+{
+  if (priv->deferred_request) {
+    gst_rtsp_message_free (priv->deferred_request);
+    priv->deferred_request = NULL;
+  }
+  g_queue_foreach (&priv->pending_requests, (GFunc) gst_rtsp_message_free,
+      NULL);
+  g_queue_clear (&priv->pending_requests);
+}
+
+/* handle the requests that were received while a request was deferred */
+static void
+handle_pending_requests (GstRTSPClient * client)
+{
+  GstRTSPClientPrivate *priv = client->priv;
+  GstRTSPMessage *request;
+
+  while (priv->deferred_request == NULL && !priv->media_preparing &&
+      (request = g_queue_pop_head (&priv->pending_requests))) {
+    handle_request (client, request);
+    gst_rtsp_message_free (request);
+  }
+}
+
+static void
+media_prepared_notify (gpointer user_data)
+{
+  GWeakRef *client_weak_ref = user_data;
+
+  g_weak_ref_clear (client_weak_ref);
+  g_free (client_weak_ref);
+}
+
+/* called from the watch context when the cached media finished preparing */
+static void
+media_prepared (GstRTSPMedia * media, gboolean success, gpointer user_data)
+{
+  GstRTSPClient *client = g_weak_ref_get ((GWeakRef *) user_data);
+  GstRTSPClientPrivate *priv;
+  GstRTSPMessage *request;
+
+  if (client == NULL)
+    return;
+
+  priv = client->priv;
+  request = priv->deferred_request;
+  priv->deferred_request = NULL;
+
+  if (request == NULL) {
+    if (!priv->media_preparing)
+      goto done;
+
+    priv->media_preparing = FALSE;
+    if (!success && priv->media == media) {
+      GST_ERROR ("client %p: can't prepare described media", client);
+      /* the media is already unprepared, the next SETUP looks it up again */
+      clean_cached_media (client, FALSE);
+    } else if (priv->media == media
+        && gst_rtsp_media_idle_sdp_changed (media)) {
+      GST_WARNING ("client %p: media %p changed since it was described",
+          client, media);
+      priv->media_changed = TRUE;
+    }
+    handle_pending_requests (client);
+    goto done;
+  }
+
+  if (success && priv->media == media) {
+    GST_INFO ("client %p: media %p prepared, resuming request", client, media);
+    /* the cached media is now prepared, handle the request again */
+    priv->resuming = TRUE;
+    handle_request (client, request);
+    priv->resuming = FALSE;
+  } else {
+    GST_ERROR ("client %p: can't prepare media", client);
+    /* the media is already unprepared */
+    if (priv->media == media)
+      clean_cached_media (client, FALSE);
+
+    send_request_error (client, request, GST_RTSP_STS_SERVICE_UNAVAILABLE);
+  }
+  gst_rtsp_message_free (request);
+
+  handle_pending_requests (client);
+
+done:
+  g_object_unref (client);
+}
+
 /* this function is called to initially find the media for the DESCRIBE request
  * but is cached for when the same client (without breaking the connection) is
- * doing a setup for the exact same url. */
+ * doing a setup for the exact same url.
+ *
+ * When the client is attached to a context, the media is prepared without
+ * blocking the context. %NULL is returned and @deferred is set to %TRUE, the
+ * request is handled again when the media is prepared. */
 static GstRTSPMedia *
 find_media (GstRTSPClient * client, GstRTSPContext * ctx, gchar * path,
-    gint * matched)
+    gint * matched, gboolean * deferred)
 {
   GstRTSPClientPrivate *priv = client->priv;
   GstRTSPMediaFactory *factory;
   GstRTSPMedia *media;
   gint path_len;
 
+  *deferred = FALSE;
+
   /* find the longest matching factory for the uri first */
   if (!(factory = gst_rtsp_mount_points_match (priv->mount_points,
               path, matched)))
@@ -1017,9 +1159,33 @@ find_media (GstRTSPClient * client, GstRTSPContext * ctx, gchar * path,
       if (thread == NULL)
         goto no_thread;
 
-      /* prepare the media */
-      if (!gst_rtsp_media_prepare (media, thread))
+      if (priv->watch_context != NULL) {
+        GWeakRef *client_weak_ref = g_new (GWeakRef, 1);
+        gboolean describe_idle;
+
+        /* a media that was unprepared after being idle is described from
+         * its last SDP while it prepares */
+        describe_idle = ctx->method == GST_RTSP_DESCRIBE &&
+            gst_rtsp_media_has_idle_sdp (media);
+
+        /* prepare the media without blocking the other clients in our
+         * context, we handle the request again when it is prepared */
+        g_weak_ref_init (client_weak_ref, client);
+        if (!gst_rtsp_media_prepare_async (media, thread, priv->watch_context,
+                media_prepared, client_weak_ref, media_prepared_notify)) {
+          media_prepared_notify (client_weak_ref);
+          goto no_prepare;
+        }
+        if (!describe_idle)
+          goto prepare_deferred;
+
+        GST_INFO ("client %p: describing idle media %p while it prepares",
+            client, media);
+        priv->media_preparing = TRUE;
+      } else if (!gst_rtsp_media_prepare (media, thread)) {
+        /* prepare the media */
         goto no_prepare;
+      }
     }
 
     /* now keep track of the uri and the media */
@@ -1040,6 +1206,20 @@ find_media (GstRTSPClient * client, GstRTSPContext * ctx, gchar * path,
 
   return media;
 
+prepare_deferred:
+  {
+    GST_INFO ("client %p: deferring request until media %p is prepared",
+        client, media);
+    priv->path = g_strndup (path, path_len);
+    priv->media = media;
+    gst_rtsp_message_copy (ctx->request, &priv->deferred_request);
+    *deferred = TRUE;
+    ctx->media = NULL;
+    g_object_unref (factory);
+    ctx->factory = NULL;
+    return NULL;
+  }
+
   /* ERRORS */
 no_factory:
   {
@@ -1076,6 +1256,8 @@ no_thread:
   {
     GST_ERROR ("client %p: can't create thread", client);
     send_generic_response (client, GST_RTSP_STS_SERVICE_UNAVAILABLE, ctx);
+    /* a pre-warmed media is still prepared */
+    gst_rtsp_media_unprepare_released (media);
     g_object_unref (media);
     ctx->media = NULL;
     g_object_unref (factory);
@@ -1086,6 +1268,7 @@ no_prepare:
   {
     GST_ERROR ("client %p: can't prepare media", client);
     send_generic_response (client, GST_RTSP_STS_SERVICE_UNAVAILABLE, ctx);
+    gst_rtsp_media_unprepare_released (media);
     g_object_unref (media);
     ctx->media = NULL;
     g_object_unref (factory);
@@ -1938,6 +2121,9 @@ setup_play_mode (GstRTSPClient * client, GstRTSPContext * ctx,
   GstRTSPStatusCode rtsp_status_code;
   GstClockTime trickmode_interval = 0;
   gboolean enable_rate_control = TRUE;
+  gboolean timeshifted = FALSE, merged = FALSE;
+  GPtrArray *transports;
+  gboolean playing;
 
   /* parse the range header if we have one */
   res = gst_rtsp_message_get_header (ctx->request, GST_RTSP_HDR_RANGE, &str, 0);
@@ -1999,9 +2185,31 @@ setup_play_mode (GstRTSPClient * client, GstRTSPContext * ctx,
 
   gst_rtsp_media_set_rate_control (ctx->media, enable_rate_control);
 
+  transports = gst_rtsp_session_media_get_transports (ctx->sessmedia);
+
+  /* a live media plays a past range from the time-shift ring buffers of its
+   * streams, without seeking the pipeline that other clients may share */
+  if (range != NULL)
+    timeshifted = gst_rtsp_media_seek_timeshift (ctx->media, transports,
+        range);
+
+  /* a VOD media that was handed out to more clients is not seeked when they
+   * start near its position, the others would jump along */
+  if (!timeshifted) {
+    playing = gst_rtsp_session_media_get_rtsp_state (ctx->sessmedia) ==
+        GST_RTSP_STATE_PLAYING;
+    rtsp_status_code = gst_rtsp_media_merge_seek (ctx->media, playing, range,
+        rate, &merged);
+  }
+  g_ptr_array_unref (transports);
+
+  if (rtsp_status_code != GST_RTSP_STS_OK)
+    goto merge_failed;
+
   /* now do the seek with the seek options */
-  gst_rtsp_media_seek_trickmode (ctx->media, range, flags, rate,
-      trickmode_interval);
+  if (!timeshifted && !merged)
+    gst_rtsp_media_seek_trickmode (ctx->media, range, flags, rate,
+        trickmode_interval);
   if (range != NULL)
     gst_rtsp_range_free (range);
 
@@ -2030,6 +2238,14 @@ adjust_play_mode_failed:
       gst_rtsp_range_free (range);
     return rtsp_status_code;
   }
+merge_failed:
+  {
+    if (range != NULL)
+      gst_rtsp_range_free (range);
+    GST_ERROR ("client %p: can't play along with the other clients (%d)",
+        client, rtsp_status_code);
+    return rtsp_status_code;
+  }
 seek_failed:
   {
     GST_ERROR ("client %p: seek failed", client);
@@ -2600,16 +2816,21 @@ make_server_transport (GstRTSPClient * client, GstRTSPMedia * media,
   return st;
 }
 
+typedef struct
+{
+  GWeakRef client;
+  guint id;
+} RTSPCtrlTimeout;
+
 static void
 rtsp_ctrl_timeout_remove_unlocked (GstRTSPClientPrivate * priv)
 {
-  if (priv->rtsp_ctrl_timeout != NULL) {
-    GST_DEBUG ("rtsp control session removed timeout %p.",
-        priv->rtsp_ctrl_timeout);
-    g_source_destroy (priv->rtsp_ctrl_timeout);
-    g_source_unref (priv->rtsp_ctrl_timeout);
-    priv->rtsp_ctrl_timeout = NULL;
-    priv->rtsp_ctrl_timeout_cnt = 0;
+  if (priv->rtsp_ctrl_timeout_id != 0) {
+    GST_DEBUG ("rtsp control session removed timeout %u.",
+        priv->rtsp_ctrl_timeout_id);
+    gst_rtsp_timer_wheel_remove (priv->timer_wheel,
+        priv->rtsp_ctrl_timeout_id);
+    priv->rtsp_ctrl_timeout_id = 0;
   }
 }
 
@@ -2624,47 +2845,61 @@ rtsp_ctrl_timeout_remove (GstRTSPClient * client)
 static void
 rtsp_ctrl_timeout_destroy_notify (gpointer user_data)
 {
-  GWeakRef *client_weak_ref = (GWeakRef *) user_data;
+  RTSPCtrlTimeout *timeout = user_data;
 
-  g_weak_ref_clear (client_weak_ref);
-  g_free (client_weak_ref);
+  g_weak_ref_clear (&timeout->client);
+  g_slice_free (RTSPCtrlTimeout, timeout);
 }
 
-static gboolean
+static void
 rtsp_ctrl_timeout_cb (gpointer user_data)
 {
-  gboolean res = G_SOURCE_CONTINUE;
+  RTSPCtrlTimeout *timeout = user_data;
   GstRTSPClientPrivate *priv;
-  GWeakRef *client_weak_ref = (GWeakRef *) user_data;
-  GstRTSPClient *client = (GstRTSPClient *) g_weak_ref_get (client_weak_ref);
+  GstRTSPClient *client;
+  gboolean expired;
 
-  if (client == NULL) {
-    return G_SOURCE_REMOVE;
-  }
+  client = (GstRTSPClient *) g_weak_ref_get (&timeout->client);
+  if (client == NULL)
+    return;
 
   priv = client->priv;
   g_mutex_lock (&priv->lock);
-  priv->rtsp_ctrl_timeout_cnt += RTSP_CTRL_CB_INTERVAL;
-
-  if ((priv->rtsp_ctrl_timeout_cnt > RTSP_CTRL_TIMEOUT_VALUE)
-      || (priv->had_session
-          && priv->rtsp_ctrl_timeout_cnt > priv->post_session_timeout)) {
-    GST_DEBUG ("rtsp control session timeout %p expired, closing client.",
-        priv->rtsp_ctrl_timeout);
-    rtsp_ctrl_timeout_remove_unlocked (client->priv);
-
-    res = G_SOURCE_REMOVE;
+  /* the timer could have been replaced or removed while it was expiring */
+  expired = (priv->rtsp_ctrl_timeout_id == timeout->id);
+  if (expired) {
+    GST_DEBUG ("rtsp control session timeout %u expired, closing client.",
+        timeout->id);
+    priv->rtsp_ctrl_timeout_id = 0;
   }
-
   g_mutex_unlock (&priv->lock);
 
-  if (res == G_SOURCE_REMOVE) {
+  if (expired)
     gst_rtsp_client_close (client);
-  }
 
   g_object_unref (client);
+}
 
-  return res;
+/* with priv->lock */
+static void
+rtsp_ctrl_timeout_add_unlocked (GstRTSPClient * client)
+{
+  GstRTSPClientPrivate *priv = client->priv;
+  RTSPCtrlTimeout *timeout;
+  guint seconds;
+
+  /* the control connection is closed after RTSP_CTRL_TIMEOUT_VALUE seconds,
+   * or after post-session-timeout seconds when we had a session before */
+  seconds = RTSP_CTRL_TIMEOUT_VALUE;
+  if (priv->had_session && priv->post_session_timeout >= 0)
+    seconds = MIN (seconds, priv->post_session_timeout);
+
+  timeout = g_slice_new (RTSPCtrlTimeout);
+  g_weak_ref_init (&timeout->client, client);
+  /* the callback takes priv->lock so it always sees the new id */
+  priv->rtsp_ctrl_timeout_id = timeout->id =
+      gst_rtsp_timer_wheel_add (priv->timer_wheel, seconds + 1,
+      rtsp_ctrl_timeout_cb, timeout, rtsp_ctrl_timeout_destroy_notify);
 }
 
 static gchar *
@@ -2756,7 +2991,7 @@ handle_setup_request (GstRTSPClient * client, GstRTSPContext * ctx)
   GstRTSPClientClass *klass;
   gchar *path, *control = NULL;
   gint matched;
-  gboolean new_session = FALSE;
+  gboolean new_session = FALSE, deferred;
   GstRTSPStatusCode sig_result;
   gchar *pipelined_request_id = NULL, *accept_range = NULL;
 
@@ -2799,7 +3034,9 @@ handle_setup_request (GstRTSPClient * client, GstRTSPContext * ctx)
   /* we have no session media, find one and manage it */
   if (sessmedia == NULL) {
     /* get a handle to the configuration of the media in the session */
-    media = find_media (client, ctx, path, &matched);
+    media = find_media (client, ctx, path, &matched, &deferred);
+    if (deferred)
+      goto media_deferred;
     /* need to suspend the media, if the protocol has changed */
     if (media != NULL) {
       gst_rtsp_media_lock (media);
@@ -2817,6 +3054,10 @@ handle_setup_request (GstRTSPClient * client, GstRTSPContext * ctx)
   if (media == NULL)
     goto media_not_found_no_reply;
 
+  /* the client has the wrong streams or payload types */
+  if (priv->media_changed && media == priv->media)
+    goto media_changed;
+
   if (path[matched] == '\0') {
     if (gst_rtsp_media_n_streams (media) == 1) {
       stream = gst_rtsp_media_get_stream (media, 0);
@@ -3069,6 +3310,12 @@ no_pool:
     send_generic_response (client, GST_RTSP_STS_SESSION_NOT_FOUND, ctx);
     goto cleanup_path;
   }
+media_deferred:
+  {
+    GST_DEBUG ("client %p: media '%s' is preparing", client, path);
+    /* reply is sent when the request is handled again */
+    goto cleanup_session;
+  }
 media_not_found_no_reply:
   {
     GST_ERROR ("client %p: media '%s' not found", client, path);
@@ -3081,6 +3328,14 @@ media_not_found:
     send_generic_response (client, GST_RTSP_STS_NOT_FOUND, ctx);
     goto cleanup_session;
   }
+media_changed:
+  {
+    GST_ERROR ("client %p: media changed since it was described", client);
+    send_generic_response (client, GST_RTSP_STS_PRECONDITION_FAILED, ctx);
+    gst_rtsp_media_unlock (media);
+    g_object_unref (media);
+    goto cleanup_session;
+  }
 control_not_found:
   {
     GST_ERROR ("client %p: no control in path '%s'", client, path);
@@ -3243,21 +3498,27 @@ handle_describe_request (GstRTSPClient * client, GstRTSPContext * ctx)
   GstRTSPClientPrivate *priv = client->priv;
   GstRTSPResult res;
   GstSDPMessage *sdp;
-  guint i;
-  gchar *path, *str;
+  GstSDPInfo info;
+  guint i, cookie = 0;
+  gchar *path, *str, *body;
   GstRTSPMedia *media;
   GstRTSPClientClass *klass;
   GstRTSPStatusCode sig_result;
+  gboolean deferred, cacheable;
 
   klass = GST_RTSP_CLIENT_GET_CLASS (client);
 
   if (!ctx->uri)
     goto no_uri;
 
-  g_signal_emit (client, gst_rtsp_client_signals[SIGNAL_PRE_DESCRIBE_REQUEST],
-      0, ctx, &sig_result);
-  if (sig_result != GST_RTSP_STS_OK) {
-    goto sig_failed;
+  /* the signal was already emitted when we deferred the request */
+  if (!priv->resuming) {
+    g_signal_emit (client,
+        gst_rtsp_client_signals[SIGNAL_PRE_DESCRIBE_REQUEST], 0, ctx,
+        &sig_result);
+    if (sig_result != GST_RTSP_STS_OK) {
+      goto sig_failed;
+    }
   }
 
   /* check what kind of format is accepted, we don't really do anything with it
@@ -3282,8 +3543,11 @@ handle_describe_request (GstRTSPClient * client, GstRTSPContext * ctx)
     goto no_path;
 
   /* find the media object for the uri */
-  if (!(media = find_media (client, ctx, path, NULL)))
+  if (!(media = find_media (client, ctx, path, NULL, &deferred))) {
+    if (deferred)
+      goto media_deferred;
     goto no_media;
+  }
 
   gst_rtsp_media_lock (media);
 
@@ -3291,12 +3555,33 @@ handle_describe_request (GstRTSPClient * client, GstRTSPContext * ctx)
           GST_RTSP_TRANSPORT_MODE_PLAY))
     goto unsupported_mode;
 
-  /* create an SDP for the media object on this client */
-  if (!(sdp = klass->create_sdp (client, media)))
-    goto no_sdp;
+  info.is_ipv6 = priv->is_ipv6;
+  info.server_ip = priv->server_ip;
 
-  /* we suspend after the describe */
-  gst_rtsp_media_suspend (media);
+  /* the default SDP of a media that did not change since the last DESCRIBE
+   * is kept by the media */
+  cacheable = klass->create_sdp == create_sdp;
+  if (!cacheable || !(body = gst_rtsp_media_lookup_sdp (media, &info,
+              &cookie))) {
+    /* create an SDP for the media object on this client */
+    if (!(sdp = klass->create_sdp (client, media))) {
+      if (priv->media_preparing)
+        goto sdp_deferred;
+      goto no_sdp;
+    }
+    body = gst_sdp_message_as_text (sdp);
+    gst_sdp_message_free (sdp);
+
+    if (cacheable && cookie != 0)
+      gst_rtsp_media_store_sdp (media, &info, cookie, body);
+  }
+
+  /* we suspend after the describe, unless the media is still preparing */
+  if (!priv->media_preparing)
+    gst_rtsp_media_suspend (media);
+
+  /* the client has the current streams of the media now */
+  priv->media_changed = FALSE;
 
   gst_rtsp_message_init_response (ctx->response, GST_RTSP_STS_OK,
       gst_rtsp_status_as_text (GST_RTSP_STS_OK), ctx->request);
@@ -3312,9 +3597,7 @@ handle_describe_request (GstRTSPClient * client, GstRTSPContext * ctx)
   gst_rtsp_message_take_header (ctx->response, GST_RTSP_HDR_CONTENT_BASE, str);
 
   /* add SDP to the response body */
-  str = gst_sdp_message_as_text (sdp);
-  gst_rtsp_message_take_body (ctx->response, (guint8 *) str, strlen (str));
-  gst_sdp_message_free (sdp);
+  gst_rtsp_message_take_body (ctx->response, (guint8 *) body, strlen (body));
 
   send_message (client, ctx, ctx->response, FALSE);
 
@@ -3352,6 +3635,13 @@ no_path:
     send_generic_response (client, GST_RTSP_STS_NOT_FOUND, ctx);
     return FALSE;
   }
+media_deferred:
+  {
+    GST_DEBUG ("client %p: media is preparing", client);
+    g_free (path);
+    /* reply is sent when the request is handled again */
+    return TRUE;
+  }
 no_media:
   {
     GST_ERROR ("client %p: no media", client);
@@ -3368,6 +3658,18 @@ unsupported_mode:
     g_object_unref (media);
     return FALSE;
   }
+sdp_deferred:
+  {
+    /* the idle SDP was made for another server address, describe the media
+     * when it is prepared */
+    GST_DEBUG ("client %p: waiting for media to describe it", client);
+    priv->media_preparing = FALSE;
+    gst_rtsp_message_copy (ctx->request, &priv->deferred_request);
+    g_free (path);
+    gst_rtsp_media_unlock (media);
+    g_object_unref (media);
+    return TRUE;
+  }
 no_sdp:
   {
     GST_ERROR ("client %p: can't create SDP", client);
@@ -3432,6 +3734,7 @@ handle_announce_request (GstRTSPClient * client, GstRTSPContext * ctx)
   guint size;
   GstRTSPStatusCode sig_result;
   guint i, n_streams;
+  gboolean deferred;
 
   klass = GST_RTSP_CLIENT_GET_CLASS (client);
 
@@ -3466,8 +3769,11 @@ handle_announce_request (GstRTSPClient * client, GstRTSPContext * ctx)
     goto no_path;
 
   /* find the media object for the uri */
-  if (!(media = find_media (client, ctx, path, NULL)))
+  if (!(media = find_media (client, ctx, path, NULL, &deferred))) {
+    if (deferred)
+      goto media_deferred;
     goto no_media;
+  }
 
   ctx->media = media;
   gst_rtsp_media_lock (media);
@@ -3559,6 +3865,14 @@ sdp_parse_failed:
     gst_sdp_message_free (sdp);
     return FALSE;
   }
+media_deferred:
+  {
+    GST_DEBUG ("client %p: media is preparing", client);
+    g_free (path);
+    gst_sdp_message_free (sdp);
+    /* reply is sent when the request is handled again */
+    return TRUE;
+  }
 no_media:
   {
     GST_ERROR ("client %p: no media", client);
@@ -3824,26 +4138,17 @@ client_session_removed (GstRTSPSessionPool * pool, GstRTSPSession * session,
     GstRTSPClient * client)
 {
   GstRTSPClientPrivate *priv = client->priv;
-  GSource *timer_src;
 
   GST_INFO ("client %p: session %p removed", client, session);
 
   g_mutex_lock (&priv->lock);
   client_unwatch_session (client, session, NULL);
 
-  if (!priv->sessions && priv->rtsp_ctrl_timeout == NULL) {
-    if (priv->post_session_timeout > 0) {
-      GWeakRef *client_weak_ref = g_new (GWeakRef, 1);
-      timer_src = g_timeout_source_new_seconds (RTSP_CTRL_CB_INTERVAL);
-
-      g_weak_ref_init (client_weak_ref, client);
-      g_source_set_callback (timer_src, rtsp_ctrl_timeout_cb, client_weak_ref,
-          rtsp_ctrl_timeout_destroy_notify);
-      priv->rtsp_ctrl_timeout_cnt = 0;
-      g_source_attach (timer_src, priv->watch_context);
-      priv->rtsp_ctrl_timeout = timer_src;
-      GST_DEBUG ("rtsp control setting up connection timeout %p.",
-          priv->rtsp_ctrl_timeout);
+  if (!priv->sessions && priv->rtsp_ctrl_timeout_id == 0) {
+    if (priv->post_session_timeout > 0 && priv->timer_wheel) {
+      rtsp_ctrl_timeout_add_unlocked (client);
+      GST_DEBUG ("rtsp control setting up connection timeout %u.",
+          priv->rtsp_ctrl_timeout_id);
       g_mutex_unlock (&priv->lock);
     } else if (priv->post_session_timeout == 0) {
       g_mutex_unlock (&priv->lock);
@@ -4775,7 +5080,25 @@ gst_rtsp_client_handle_message (GstRTSPClient * client,
 
   switch (message->type) {
     case GST_RTSP_MESSAGE_REQUEST:
-      handle_request (client, message);
+      if (client->priv->deferred_request || client->priv->media_preparing) {
+        GstRTSPMessage *request;
+
+        if (g_queue_get_length (&client->priv->pending_requests) >=
+            MAX_PENDING_REQUESTS) {
+          GST_WARNING ("client %p: too many requests while preparing media",
+              client);
+          send_request_error (client, message,
+              GST_RTSP_STS_SERVICE_UNAVAILABLE);
+          break;
+        }
+
+        /* keep the order of the requests, handle this one after the
+         * deferred request */
+        gst_rtsp_message_copy (message, &request);
+        g_queue_push_tail (&client->priv->pending_requests, request);
+      } else {
+        handle_request (client, message);
+      }
       break;
     case GST_RTSP_MESSAGE_RESPONSE:
       handle_response (client, message);
@@ -5237,7 +5560,14 @@ client_watch_notify (GstRTSPClient * client)
   /* remove all sessions if the media says so and so drop the extra client ref */
   gst_rtsp_client_set_send_func (client, NULL, NULL, NULL);
   gst_rtsp_client_set_send_messages_func (client, NULL, NULL, NULL);
-  rtsp_ctrl_timeout_remove (client);
+  g_mutex_lock (&priv->lock);
+  rtsp_ctrl_timeout_remove_unlocked (priv);
+  /* the wheel belongs to the context of the watch, a new one is taken when
+   * the client is attached again */
+  g_clear_pointer (&priv->timer_wheel, gst_rtsp_timer_wheel_unref);
+  g_mutex_unlock (&priv->lock);
+  /* nobody is left to answer the requests that wait for a media */
+  clear_pending_requests (priv);
   gst_rtsp_client_session_filter (client, cleanup_session, &closed);
 
   if (closed)
@@ -5263,17 +5593,18 @@ guint
 gst_rtsp_client_attach (GstRTSPClient * client, GMainContext * context)
 {
   GstRTSPClientPrivate *priv;
-  GSource *timer_src;
   guint res;
-  GWeakRef *client_weak_ref = g_new (GWeakRef, 1);
 
   g_return_val_if_fail (GST_IS_RTSP_CLIENT (client), 0);
   priv = client->priv;
   g_return_val_if_fail (priv->connection != NULL, 0);
   g_return_val_if_fail (priv->watch == NULL, 0);
-  g_return_val_if_fail (priv->watch_context == NULL, 0);
 
-  /* make sure noone will free the context before the watch is destroyed */
+  /* make sure noone will free the context before the watch is destroyed, a
+   * client can be attached again to another context once its previous watch
+   * is gone */
+  if (priv->watch_context)
+    g_main_context_unref (priv->watch_context);
   priv->watch_context = g_main_context_ref (context);
 
   /* create watch for the connection and attach */
@@ -5295,14 +5626,14 @@ gst_rtsp_client_attach (GstRTSPClient * client, GMainContext * context)
   /* remove old timeout if any */
   rtsp_ctrl_timeout_remove_unlocked (client->priv);
 
-  timer_src = g_timeout_source_new_seconds (RTSP_CTRL_CB_INTERVAL);
-  g_weak_ref_init (client_weak_ref, client);
-  g_source_set_callback (timer_src, rtsp_ctrl_timeout_cb, client_weak_ref,
-      rtsp_ctrl_timeout_destroy_notify);
-  g_source_attach (timer_src, priv->watch_context);
-  priv->rtsp_ctrl_timeout = timer_src;
-  GST_DEBUG ("rtsp control setting up session timeout %p.",
-      priv->rtsp_ctrl_timeout);
+  /* all clients of a context share one timer source, drop the wheel of the
+   * context we were attached to before, if any */
+  if (priv->timer_wheel)
+    gst_rtsp_timer_wheel_unref (priv->timer_wheel);
+  priv->timer_wheel = gst_rtsp_timer_wheel_get (priv->watch_context);
+  rtsp_ctrl_timeout_add_unlocked (client);
+  GST_DEBUG ("rtsp control setting up session timeout %u.",
+      priv->rtsp_ctrl_timeout_id);
 
   g_mutex_unlock (&priv->lock);
 
@@ -0,0 +1,462 @@
+/* GStreamer
+ * Copyright (C) 2021 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+/* A keyframe index of a media file, a sorted table of the stream time and,
+ * when it is known, the byte offset of every keyframe. The index is built
+ * while the file plays from start to end and is saved in a small text file
+ * so that later seeks can snap to a keyframe without asking the demuxer to
+ * search for one.
+ *
+ * The file starts with a header line, the duration of the media and, when
+ * it is known, the size and modification time of the indexed file, followed
+ * by one line per keyframe:
+ *
+ *   gst-rtsp-keyframe-index 1
+ *   duration <nanoseconds>
+ *   source <bytes> <seconds since the epoch>
+ *   <nanoseconds> <byte offset or -1>
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "rtsp-keyframe-index.h"
+
+GST_DEBUG_CATEGORY_STATIC (rtsp_keyframe_index_debug);
+#define GST_CAT_DEFAULT rtsp_keyframe_index_debug
+
+#define INDEX_MAGIC "gst-rtsp-keyframe-index 1"
+
+typedef struct
+{
+  GstClockTime time;
+  gint64 offset;
+} GstRTSPKeyframe;
+
+struct _GstRTSPKeyframeIndex
+{
+  GArray *keyframes;            /* of GstRTSPKeyframe, sorted on time */
+  GstClockTime duration;
+  gboolean has_source;
+  guint64 source_size;
+  gint64 source_mtime;
+};
+
+static void
+init_debug (void)
+{
+  static gsize init = 0;
+
+  if (g_once_init_enter (&init)) {
+    GST_DEBUG_CATEGORY_INIT (rtsp_keyframe_index_debug, "rtspkeyframeindex",
+        0, "GstRTSPKeyframeIndex");
+    g_once_init_leave (&init, 1);
+  }
+}
+
+/**
+ * gst_rtsp_keyframe_index_new:
+ *
+ * Create a new, empty keyframe index with an unknown duration.
+ *
+ * Returns: (transfer full): a new #GstRTSPKeyframeIndex, free with
+ * gst_rtsp_keyframe_index_free().
+ */
+GstRTSPKeyframeIndex *
+gst_rtsp_keyframe_index_new (void)
+{
+  GstRTSPKeyframeIndex *index;
+
+  init_debug ();
+
+  index = g_slice_new0 (GstRTSPKeyframeIndex);
+  index->keyframes = g_array_new (FALSE, FALSE, sizeof (GstRTSPKeyframe));
+  index->duration = GST_CLOCK_TIME_NONE;
+
+  return index;
+}
+
+/**
+ * gst_rtsp_keyframe_index_free:
+ * @index: (transfer full): a #GstRTSPKeyframeIndex
+ *
+ * Free @index.
+ */
+void
+gst_rtsp_keyframe_index_free (GstRTSPKeyframeIndex * index)
+{
+  g_return_if_fail (index != NULL);
+
+  g_array_unref (index->keyframes);
+  g_slice_free (GstRTSPKeyframeIndex, index);
+}
+
+/* find the position of the last keyframe at or before @time, -1 when there
+ * is none */
+static gint
+find_keyframe (GstRTSPKeyframeIndex * index, GstClockTime time)
+{
+  gint lo = 0, hi = index->keyframes->len;
+
+  while (lo < hi) {
+    gint mid = (lo + hi) / 2;
+
+    if (g_array_index (index->keyframes, GstRTSPKeyframe, mid).time <= time)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo - 1;
+}
+
+/**
+ * gst_rtsp_keyframe_index_add:
+ * @index: a #GstRTSPKeyframeIndex
+ * @time: the stream time of the keyframe
+ * @offset: the byte offset of the keyframe in the file or -1 when unknown
+ *
+ * Add a keyframe to @index. Keyframes are usually added in order, a keyframe
+ * at a time that is already in @index only updates the byte offset when it
+ * was not known.
+ */
+void
+gst_rtsp_keyframe_index_add (GstRTSPKeyframeIndex * index, GstClockTime time,
+    gint64 offset)
+{
+  GstRTSPKeyframe keyframe;
+  gint pos;
+
+  g_return_if_fail (index != NULL);
+  g_return_if_fail (GST_CLOCK_TIME_IS_VALID (time));
+
+  pos = find_keyframe (index, time);
+  if (pos >= 0) {
+    GstRTSPKeyframe *prev = &g_array_index (index->keyframes,
+        GstRTSPKeyframe, pos);
+
+    if (prev->time == time) {
+      if (prev->offset < 0)
+        prev->offset = offset;
+      return;
+    }
+  }
+
+  keyframe.time = time;
+  keyframe.offset = offset < 0 ? -1 : offset;
+  g_array_insert_val (index->keyframes, pos + 1, keyframe);
+}
+
+/**
+ * gst_rtsp_keyframe_index_set_duration:
+ * @index: a #GstRTSPKeyframeIndex
+ * @duration: the duration of the indexed media
+ *
+ * Set the duration of the media that was indexed. The duration is used to
+ * detect an index of a file that changed.
+ */
+void
+gst_rtsp_keyframe_index_set_duration (GstRTSPKeyframeIndex * index,
+    GstClockTime duration)
+{
+  g_return_if_fail (index != NULL);
+
+  index->duration = duration;
+}
+
+/**
+ * gst_rtsp_keyframe_index_get_duration:
+ * @index: a #GstRTSPKeyframeIndex
+ *
+ * Get the duration of the media that was indexed.
+ *
+ * Returns: the duration or #GST_CLOCK_TIME_NONE when unknown.
+ */
+GstClockTime
+gst_rtsp_keyframe_index_get_duration (GstRTSPKeyframeIndex * index)
+{
+  g_return_val_if_fail (index != NULL, GST_CLOCK_TIME_NONE);
+
+  return index->duration;
+}
+
+/**
+ * gst_rtsp_keyframe_index_set_source:
+ * @index: a #GstRTSPKeyframeIndex
+ * @size: the size of the indexed file
+ * @mtime: the modification time of the indexed file
+ *
+ * Set the size and modification time of the file that was indexed. They are
+ * used to detect an index of a file that was replaced.
+ */
+void
+gst_rtsp_keyframe_index_set_source (GstRTSPKeyframeIndex * index,
+    guint64 size, gint64 mtime)
+{
+  g_return_if_fail (index != NULL);
+
+  index->has_source = TRUE;
+  index->source_size = size;
+  index->source_mtime = mtime;
+}
+
+/**
+ * gst_rtsp_keyframe_index_get_source:
+ * @index: a #GstRTSPKeyframeIndex
+ * @size: (out) (allow-none): the size of the indexed file
+ * @mtime: (out) (allow-none): the modification time of the indexed file
+ *
+ * Get the size and modification time of the file that was indexed.
+ *
+ * Returns: %TRUE when they are known.
+ */
+gboolean
+gst_rtsp_keyframe_index_get_source (GstRTSPKeyframeIndex * index,
+    guint64 * size, gint64 * mtime)
+{
+  g_return_val_if_fail (index != NULL, FALSE);
+
+  if (!index->has_source)
+    return FALSE;
+
+  if (size)
+    *size = index->source_size;
+  if (mtime)
+    *mtime = index->source_mtime;
+
+  return TRUE;
+}
+
+/**
+ * gst_rtsp_keyframe_index_get_size:
+ * @index: a #GstRTSPKeyframeIndex
+ *
+ * Get the number of keyframes in @index.
+ *
+ * Returns: the number of keyframes.
+ */
+guint
+gst_rtsp_keyframe_index_get_size (GstRTSPKeyframeIndex * index)
+{
+  g_return_val_if_fail (index != NULL, 0);
+
+  return index->keyframes->len;
+}
+
+/**
+ * gst_rtsp_keyframe_index_lookup:
+ * @index: a #GstRTSPKeyframeIndex
+ * @time: a stream time
+ * @after: look for the first keyframe after @time instead of the last one
+ *   before it
+ * @keyframe: (out): the time of the keyframe
+ * @offset: (out) (allow-none): the byte offset of the keyframe or -1
+ *
+ * Find the keyframe nearest to @time. A keyframe at exactly @time is always
+ * returned.
+ *
+ * Returns: %TRUE when a keyframe was found.
+ */
+gboolean
+gst_rtsp_keyframe_index_lookup (GstRTSPKeyframeIndex * index,
+    GstClockTime time, gboolean after, GstClockTime * keyframe,
+    gint64 * offset)
+{
+  GstRTSPKeyframe *found;
+  gint pos;
+
+  g_return_val_if_fail (index != NULL, FALSE);
+  g_return_val_if_fail (keyframe != NULL, FALSE);
+
+  if (!GST_CLOCK_TIME_IS_VALID (time))
+    return FALSE;
+
+  pos = find_keyframe (index, time);
+  if (after && (pos < 0 ||
+          g_array_index (index->keyframes, GstRTSPKeyframe, pos).time < time))
+    pos++;
+
+  if (pos < 0 || pos >= (gint) index->keyframes->len)
+    return FALSE;
+
+  found = &g_array_index (index->keyframes, GstRTSPKeyframe, pos);
+  *keyframe = found->time;
+  if (offset)
+    *offset = found->offset;
+
+  return TRUE;
+}
+
+/**
+ * gst_rtsp_keyframe_index_save:
+ * @index: a #GstRTSPKeyframeIndex
+ * @location: the file to save @index in
+ * @error: a #GError
+ *
+ * Save @index in @location. The file is replaced atomically.
+ *
+ * Returns: %TRUE on success.
+ */
+gboolean
+gst_rtsp_keyframe_index_save (GstRTSPKeyframeIndex * index,
+    const gchar * location, GError ** error)
+{
+  GString *str;
+  gboolean res;
+  guint i;
+
+  g_return_val_if_fail (index != NULL, FALSE);
+  g_return_val_if_fail (location != NULL, FALSE);
+
+  str = g_string_new (INDEX_MAGIC "\n");
+  if (GST_CLOCK_TIME_IS_VALID (index->duration))
+    g_string_append_printf (str, "duration %" G_GUINT64_FORMAT "\n",
+        index->duration);
+  else
+    g_string_append (str, "duration -1\n");
+  if (index->has_source)
+    g_string_append_printf (str, "source %" G_GUINT64_FORMAT " %"
+        G_GINT64_FORMAT "\n", index->source_size, index->source_mtime);
+
+  for (i = 0; i < index->keyframes->len; i++) {
+    GstRTSPKeyframe *kf = &g_array_index (index->keyframes, GstRTSPKeyframe, i);
+
+    g_string_append_printf (str, "%" G_GUINT64_FORMAT " %" G_GINT64_FORMAT
+        "\n", kf->time, kf->offset);
+  }
+
+  res = g_file_set_contents (location, str->str, str->len, error);
+  g_string_free (str, TRUE);
+
+  GST_DEBUG ("saved %u keyframes in %s: %d", index->keyframes->len, location,
+      res);
+
+  return res;
+}
+
+/**
+ * gst_rtsp_keyframe_index_load:
+ * @location: the file to load the index from
+ * @error: a #GError
+ *
+ * Load an index that was saved with gst_rtsp_keyframe_index_save().
+ *
+ * Returns: (transfer full) (nullable): a new #GstRTSPKeyframeIndex or %NULL
+ * when @location could not be read or is not a keyframe index.
+ */
+GstRTSPKeyframeIndex *
+gst_rtsp_keyframe_index_load (const gchar * location, GError ** error)
+{
+  GstRTSPKeyframeIndex *index;
+  gchar *contents, **lines;
+  guint i;
+
+  g_return_val_if_fail (location != NULL, NULL);
+
+  if (!g_file_get_contents (location, &contents, NULL, error))
+    return NULL;
+
+  lines = g_strsplit (contents, "\n", -1);
+  g_free (contents);
+
+  if (lines[0] == NULL || strcmp (lines[0], INDEX_MAGIC) != 0 ||
+      lines[1] == NULL || !g_str_has_prefix (lines[1], "duration "))
+    goto invalid;
+
+  index = gst_rtsp_keyframe_index_new ();
+  if (strcmp (lines[1] + 9, "-1") != 0)
+    index->duration = g_ascii_strtoull (lines[1] + 9, NULL, 10);
+
+  i = 2;
+  if (lines[i] && g_str_has_prefix (lines[i], "source ")) {
+    gchar *end;
+
+    index->source_size = g_ascii_strtoull (lines[i] + 7, &end, 10);
+    if (end == lines[i] + 7 || *end != ' ')
+      goto invalid_line;
+    index->source_mtime = g_ascii_strtoll (end + 1, NULL, 10);
+    index->has_source = TRUE;
+    i++;
+  }
+
+  for (; lines[i]; i++) {
+    guint64 time;
+    gint64 offset;
+    gchar *end;
+
+    if (lines[i][0] == '\0')
+      continue;
+
+    time = g_ascii_strtoull (lines[i], &end, 10);
+    if (end == lines[i] || *end != ' ')
+      goto invalid_line;
+    offset = g_ascii_strtoll (end + 1, NULL, 10);
+
+    gst_rtsp_keyframe_index_add (index, time, offset);
+  }
+  g_strfreev (lines);
+
+  GST_DEBUG ("loaded %u keyframes from %s", index->keyframes->len, location);
+
+  return index;
+
+  /* ERRORS */
+invalid:
+  {
+    g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+        "%s is not a keyframe index", location);
+    g_strfreev (lines);
+    return NULL;
+  }
+invalid_line:
+  {
+    g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+        "invalid line %u in keyframe index %s", i + 1, location);
+    gst_rtsp_keyframe_index_free (index);
+    g_strfreev (lines);
+    return NULL;
+  }
+}
+
+/**
+ * gst_rtsp_keyframe_index_make_location:
+ * @dir: a directory
+ * @key: a string that identifies the indexed media, like its URI
+ *
+ * Make the location of the index of the media identified with @key in @dir.
+ *
+ * Returns: (transfer full): the location of the index, free with g_free().
+ */
+gchar *
+gst_rtsp_keyframe_index_make_location (const gchar * dir, const gchar * key)
+{
+  gchar *checksum, *name, *location;
+
+  g_return_val_if_fail (dir != NULL, NULL);
+  g_return_val_if_fail (key != NULL, NULL);
+
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, key, -1);
+  name = g_strconcat (checksum, ".idx", NULL);
+  location = g_build_filename (dir, name, NULL);
+  g_free (name);
+  g_free (checksum);
+
+  return location;
+}
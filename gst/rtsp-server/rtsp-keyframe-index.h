@@ -0,0 +1,70 @@
+/* GStreamer
+ * Copyright (C) 2021 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_RTSP_KEYFRAME_INDEX_H__
+#define __GST_RTSP_KEYFRAME_INDEX_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstRTSPKeyframeIndex GstRTSPKeyframeIndex;
+
+GstRTSPKeyframeIndex * gst_rtsp_keyframe_index_new          (void);
+
+void                   gst_rtsp_keyframe_index_free         (GstRTSPKeyframeIndex *index);
+
+void                   gst_rtsp_keyframe_index_add          (GstRTSPKeyframeIndex *index,
+                                                             GstClockTime time,
+                                                             gint64 offset);
+
+void                   gst_rtsp_keyframe_index_set_duration (GstRTSPKeyframeIndex *index,
+                                                             GstClockTime duration);
+
+GstClockTime           gst_rtsp_keyframe_index_get_duration (GstRTSPKeyframeIndex *index);
+
+void                   gst_rtsp_keyframe_index_set_source   (GstRTSPKeyframeIndex *index,
+                                                             guint64 size,
+                                                             gint64 mtime);
+
+gboolean               gst_rtsp_keyframe_index_get_source   (GstRTSPKeyframeIndex *index,
+                                                             guint64 *size,
+                                                             gint64 *mtime);
+
+guint                  gst_rtsp_keyframe_index_get_size     (GstRTSPKeyframeIndex *index);
+
+gboolean               gst_rtsp_keyframe_index_lookup       (GstRTSPKeyframeIndex *index,
+                                                             GstClockTime time,
+                                                             gboolean after,
+                                                             GstClockTime *keyframe,
+                                                             gint64 *offset);
+
+gboolean               gst_rtsp_keyframe_index_save         (GstRTSPKeyframeIndex *index,
+                                                             const gchar *location,
+                                                             GError **error);
+
+GstRTSPKeyframeIndex * gst_rtsp_keyframe_index_load         (const gchar *location,
+                                                             GError **error);
+
+gchar *                gst_rtsp_keyframe_index_make_location (const gchar *dir,
+                                                             const gchar *key);
+
+G_END_DECLS
+
+#endif /* __GST_RTSP_KEYFRAME_INDEX_H__ */
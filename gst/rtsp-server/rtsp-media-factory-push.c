@@ -0,0 +1,659 @@
+/* GStreamer
+ * Copyright (C) 2021 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+/**
+ * SECTION:rtsp-media-factory-push
+ * @short_description: A factory for the encoded frames of the application
+ * @see_also: #GstRTSPMediaFactory, #GstRTSPMedia
+ *
+ * This specialized #GstRTSPMediaFactory streams frames that the application
+ * already encoded, like H.264 access units or AAC frames. The caps of each
+ * stream are given with gst_rtsp_media_factory_push_add_stream() and the
+ * frames with gst_rtsp_media_factory_push_frame().
+ *
+ * The frames are payloaded in the thread of the caller, without the queue,
+ * the streaming thread and the parser of an appsrc pipeline. The caps of a
+ * stream should therefore be complete enough for a payloader, for example
+ * video/x-h264 with stream-format=byte-stream and alignment=au.
+ *
+ * The media of the factory is live and shared by default. Frames that are
+ * pushed while no media is playing are dropped. A media prepares with the
+ * first frame after it was created, the frames that a media receives while
+ * it waits for its first client are dropped as well. The caller is never
+ * blocked by the media.
+ *
+ * Since: 1.20
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "rtsp-media-factory-push.h"
+#include "rtsp-server-internal.h"
+
+typedef struct
+{
+  GstRTSPMedia *media;          /* no ref */
+  GPtrArray *srcs;              /* the push source of each stream */
+} PushMedia;
+
+struct _GstRTSPMediaFactoryPushPrivate
+{
+  GMutex lock;
+  GPtrArray *caps;              /* protected by lock */
+  GList *medias;                /* PushMedia, protected by lock */
+};
+
+GST_DEBUG_CATEGORY_STATIC (rtsp_media_factory_push_debug);
+#define GST_CAT_DEFAULT rtsp_media_factory_push_debug
+
+static void gst_rtsp_media_factory_push_finalize (GObject * obj);
+
+static GstElement *rtsp_media_factory_push_create_element (GstRTSPMediaFactory
+    * factory, const GstRTSPUrl * url);
+static GstRTSPMedia *rtsp_media_factory_push_construct (GstRTSPMediaFactory *
+    factory, const GstRTSPUrl * url);
+
+G_DEFINE_TYPE_WITH_PRIVATE (GstRTSPMediaFactoryPush,
+    gst_rtsp_media_factory_push, GST_TYPE_RTSP_MEDIA_FACTORY);
+
+/* a live source without a streaming thread, the frames are pushed in the
+ * thread of the application. The stream of the source drops the frames while
+ * it is blocked instead of holding them, so the application never waits. */
+typedef struct
+{
+  GstElement element;
+
+  GstPad *srcpad;
+  GstCaps *caps;
+
+  GMutex lock;
+  gboolean playing;             /* protected by lock */
+
+  gboolean started;             /* protected by the stream lock */
+} GstRTSPPushSrc;
+
+typedef struct
+{
+  GstElementClass parent_class;
+} GstRTSPPushSrcClass;
+
+static GstStaticPadTemplate push_src_template =
+GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+static GType gst_rtsp_push_src_get_type (void);
+
+G_DEFINE_TYPE (GstRTSPPushSrc, gst_rtsp_push_src, GST_TYPE_ELEMENT);
+
+static GstClockTime
+push_src_running_time (GstRTSPPushSrc * src)
+{
+  GstClock *clock;
+  GstClockTime now;
+
+  clock = gst_element_get_clock (GST_ELEMENT_CAST (src));
+  if (clock == NULL)
+    return 0;
+
+  now = gst_clock_get_time (clock);
+  gst_object_unref (clock);
+
+  return now - gst_element_get_base_time (GST_ELEMENT_CAST (src));
+}
+
+static GstFlowReturn
+push_src_do_push (GstRTSPPushSrc * src, GstBuffer * frame)
+{
+  GstFlowReturn ret;
+  GstClockTime now;
+
+  GST_PAD_STREAM_LOCK (src->srcpad);
+  now = push_src_running_time (src);
+
+  if (!src->started) {
+    GstSegment segment;
+    gchar *stream_id;
+
+    stream_id = gst_pad_create_stream_id (src->srcpad,
+        GST_ELEMENT_CAST (src), NULL);
+    gst_pad_push_event (src->srcpad, gst_event_new_stream_start (stream_id));
+    g_free (stream_id);
+    gst_pad_push_event (src->srcpad, gst_event_new_caps (src->caps));
+
+    /* the first frame plays now, the timestamps of the application keep
+     * their distance */
+    gst_segment_init (&segment, GST_FORMAT_TIME);
+    if (GST_BUFFER_PTS_IS_VALID (frame))
+      segment.start = segment.time = GST_BUFFER_PTS (frame);
+    segment.base = now;
+    gst_pad_push_event (src->srcpad, gst_event_new_segment (&segment));
+
+    src->started = TRUE;
+  }
+
+  if (!GST_BUFFER_PTS_IS_VALID (frame)) {
+    GstEvent *event;
+    const GstSegment *segment;
+
+    event = gst_pad_get_sticky_event (src->srcpad, GST_EVENT_SEGMENT, 0);
+    gst_event_parse_segment (event, &segment);
+    frame = gst_buffer_make_writable (frame);
+    GST_BUFFER_PTS (frame) = gst_segment_position_from_running_time (segment,
+        GST_FORMAT_TIME, now);
+    gst_event_unref (event);
+  }
+
+  ret = gst_pad_push (src->srcpad, frame);
+  GST_PAD_STREAM_UNLOCK (src->srcpad);
+
+  return ret;
+}
+
+static GstFlowReturn
+push_src_push (GstRTSPPushSrc * src, GstBuffer * frame)
+{
+  g_mutex_lock (&src->lock);
+  if (!src->playing)
+    goto not_playing;
+  g_mutex_unlock (&src->lock);
+
+  return push_src_do_push (src, frame);
+
+  /* ERRORS */
+not_playing:
+  {
+    g_mutex_unlock (&src->lock);
+    gst_buffer_unref (frame);
+    return GST_FLOW_FLUSHING;
+  }
+}
+
+static GstStateChangeReturn
+gst_rtsp_push_src_change_state (GstElement * element,
+    GstStateChange transition)
+{
+  GstRTSPPushSrc *src = (GstRTSPPushSrc *) element;
+  GstStateChangeReturn ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
+      g_mutex_lock (&src->lock);
+      src->playing = FALSE;
+      g_mutex_unlock (&src->lock);
+      break;
+    default:
+      break;
+  }
+
+  ret =
+      GST_ELEMENT_CLASS (gst_rtsp_push_src_parent_class)->change_state
+      (element, transition);
+  if (ret == GST_STATE_CHANGE_FAILURE)
+    return ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      src->started = FALSE;
+      /* live, we only push in PLAYING */
+      ret = GST_STATE_CHANGE_NO_PREROLL;
+      break;
+    case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
+      g_mutex_lock (&src->lock);
+      src->playing = TRUE;
+      g_mutex_unlock (&src->lock);
+      break;
+    case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
+      ret = GST_STATE_CHANGE_NO_PREROLL;
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
+
+static void
+gst_rtsp_push_src_finalize (GObject * obj)
+{
+  GstRTSPPushSrc *src = (GstRTSPPushSrc *) obj;
+
+  gst_caps_replace (&src->caps, NULL);
+  g_mutex_clear (&src->lock);
+
+  G_OBJECT_CLASS (gst_rtsp_push_src_parent_class)->finalize (obj);
+}
+
+static void
+gst_rtsp_push_src_class_init (GstRTSPPushSrcClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+
+  gobject_class->finalize = gst_rtsp_push_src_finalize;
+  element_class->change_state = gst_rtsp_push_src_change_state;
+
+  gst_element_class_add_static_pad_template (element_class,
+      &push_src_template);
+  gst_element_class_set_static_metadata (element_class,
+      "RTSP push source", "Source",
+      "Pushes the frames of the application", "GStreamer developers");
+}
+
+static void
+gst_rtsp_push_src_init (GstRTSPPushSrc * src)
+{
+  src->srcpad = gst_pad_new_from_static_template (&push_src_template, "src");
+  gst_pad_use_fixed_caps (src->srcpad);
+  gst_element_add_pad (GST_ELEMENT_CAST (src), src->srcpad);
+  g_mutex_init (&src->lock);
+}
+
+static void
+push_media_free (PushMedia * pm)
+{
+  g_ptr_array_unref (pm->srcs);
+  g_slice_free (PushMedia, pm);
+}
+
+static void
+gst_rtsp_media_factory_push_class_init (GstRTSPMediaFactoryPushClass * klass)
+{
+  GObjectClass *gobject_class;
+  GstRTSPMediaFactoryClass *mediafactory_class;
+
+  gobject_class = G_OBJECT_CLASS (klass);
+  mediafactory_class = GST_RTSP_MEDIA_FACTORY_CLASS (klass);
+
+  gobject_class->finalize = gst_rtsp_media_factory_push_finalize;
+
+  mediafactory_class->create_element = rtsp_media_factory_push_create_element;
+  mediafactory_class->construct = rtsp_media_factory_push_construct;
+
+  GST_DEBUG_CATEGORY_INIT (rtsp_media_factory_push_debug,
+      "rtspmediafactorypush", 0, "GstRTSPMediaFactoryPush");
+}
+
+static void
+gst_rtsp_media_factory_push_init (GstRTSPMediaFactoryPush * factory)
+{
+  GstRTSPMediaFactoryPushPrivate *priv =
+      gst_rtsp_media_factory_push_get_instance_private (factory);
+
+  GST_DEBUG_OBJECT (factory, "new");
+
+  factory->priv = priv;
+
+  g_mutex_init (&priv->lock);
+  priv->caps = g_ptr_array_new_with_free_func ((GDestroyNotify) gst_caps_unref);
+
+  /* all the clients receive the same frames */
+  gst_rtsp_media_factory_set_shared (GST_RTSP_MEDIA_FACTORY (factory), TRUE);
+}
+
+static void push_media_gone (GstRTSPMediaFactoryPush * factory,
+    GObject * where_the_object_was);
+
+static void
+gst_rtsp_media_factory_push_finalize (GObject * obj)
+{
+  GstRTSPMediaFactoryPush *factory = GST_RTSP_MEDIA_FACTORY_PUSH (obj);
+  GstRTSPMediaFactoryPushPrivate *priv = factory->priv;
+  GList *walk;
+
+  GST_DEBUG_OBJECT (factory, "finalize");
+
+  for (walk = priv->medias; walk; walk = walk->next) {
+    PushMedia *pm = walk->data;
+
+    g_object_weak_unref (G_OBJECT (pm->media), (GWeakNotify) push_media_gone,
+        factory);
+    push_media_free (pm);
+  }
+  g_list_free (priv->medias);
+  g_ptr_array_unref (priv->caps);
+  g_mutex_clear (&priv->lock);
+
+  G_OBJECT_CLASS (gst_rtsp_media_factory_push_parent_class)->finalize (obj);
+}
+
+/**
+ * gst_rtsp_media_factory_push_new:
+ *
+ * Create a new #GstRTSPMediaFactoryPush instance.
+ *
+ * Returns: (transfer full): a new #GstRTSPMediaFactoryPush object.
+ *
+ * Since: 1.20
+ */
+GstRTSPMediaFactoryPush *
+gst_rtsp_media_factory_push_new (void)
+{
+  GstRTSPMediaFactoryPush *result;
+
+  result = g_object_new (GST_TYPE_RTSP_MEDIA_FACTORY_PUSH, NULL);
+
+  return result;
+}
+
+/**
+ * gst_rtsp_media_factory_push_add_stream:
+ * @factory: a #GstRTSPMediaFactoryPush
+ * @caps: the fixed caps of the frames of the stream
+ *
+ * Add a stream with frames of @caps to the media of @factory. A payloader
+ * for @caps is selected when the media is created. The stream is added to
+ * the media that are created after this call.
+ *
+ * Returns: the index of the stream, to be used with
+ * gst_rtsp_media_factory_push_frame()
+ *
+ * Since: 1.20
+ */
+guint
+gst_rtsp_media_factory_push_add_stream (GstRTSPMediaFactoryPush * factory,
+    GstCaps * caps)
+{
+  GstRTSPMediaFactoryPushPrivate *priv;
+  guint index;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA_FACTORY_PUSH (factory), 0);
+  g_return_val_if_fail (GST_IS_CAPS (caps), 0);
+  g_return_val_if_fail (gst_caps_is_fixed (caps), 0);
+
+  priv = factory->priv;
+
+  g_mutex_lock (&priv->lock);
+  index = priv->caps->len;
+  g_ptr_array_add (priv->caps, gst_caps_ref (caps));
+  g_mutex_unlock (&priv->lock);
+
+  return index;
+}
+
+/**
+ * gst_rtsp_media_factory_push_n_streams:
+ * @factory: a #GstRTSPMediaFactoryPush
+ *
+ * Get the number of streams added to @factory.
+ *
+ * Returns: the number of streams
+ *
+ * Since: 1.20
+ */
+guint
+gst_rtsp_media_factory_push_n_streams (GstRTSPMediaFactoryPush * factory)
+{
+  GstRTSPMediaFactoryPushPrivate *priv;
+  guint result;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA_FACTORY_PUSH (factory), 0);
+
+  priv = factory->priv;
+
+  g_mutex_lock (&priv->lock);
+  result = priv->caps->len;
+  g_mutex_unlock (&priv->lock);
+
+  return result;
+}
+
+/**
+ * gst_rtsp_media_factory_push_frame:
+ * @factory: a #GstRTSPMediaFactoryPush
+ * @stream: the index of a stream
+ * @frame: (transfer full): an encoded frame
+ *
+ * Send @frame on @stream of the media of @factory. The frame is payloaded
+ * and sent to the clients in the thread of the caller. The frames of a
+ * stream should be pushed from one thread at a time.
+ *
+ * The PTS of @frame is relative to the PTS of the first frame of the stream,
+ * which is sent when it is pushed. Frames without PTS are sent when they
+ * are pushed.
+ *
+ * Returns: #GST_FLOW_OK when @frame was sent or dropped by a media that
+ * waits for its first client, #GST_FLOW_FLUSHING when no media is playing
+ * or the error of the payloader.
+ *
+ * Since: 1.20
+ */
+GstFlowReturn
+gst_rtsp_media_factory_push_frame (GstRTSPMediaFactoryPush * factory,
+    guint stream, GstBuffer * frame)
+{
+  GstRTSPMediaFactoryPushPrivate *priv;
+  GstFlowReturn ret = GST_FLOW_FLUSHING, res;
+  GPtrArray *targets;
+  GList *walk;
+  guint i;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA_FACTORY_PUSH (factory),
+      GST_FLOW_ERROR);
+  g_return_val_if_fail (GST_IS_BUFFER (frame), GST_FLOW_ERROR);
+
+  priv = factory->priv;
+
+  targets = g_ptr_array_new_with_free_func (gst_object_unref);
+  g_mutex_lock (&priv->lock);
+  for (walk = priv->medias; walk; walk = walk->next) {
+    PushMedia *pm = walk->data;
+
+    if (stream >= pm->srcs->len)
+      continue;
+
+    g_ptr_array_add (targets, gst_object_ref (g_ptr_array_index (pm->srcs,
+                stream)));
+  }
+  g_mutex_unlock (&priv->lock);
+
+  for (i = 0; i < targets->len; i++) {
+    GstRTSPPushSrc *src = g_ptr_array_index (targets, i);
+
+    res = push_src_push (src, gst_buffer_ref (frame));
+    if (ret != GST_FLOW_OK)
+      ret = res;
+  }
+  g_ptr_array_unref (targets);
+  gst_buffer_unref (frame);
+
+  return ret;
+}
+
+static GstElement *
+make_payloader (GstCaps * caps, guint index)
+{
+  GList *list, *filtered;
+  GstElement *pay = NULL;
+
+  list =
+      gst_element_factory_list_get_elements (GST_ELEMENT_FACTORY_TYPE_PAYLOADER,
+      GST_RANK_MARGINAL);
+  filtered = gst_element_factory_list_filter (list, caps, GST_PAD_SINK, FALSE);
+  gst_plugin_feature_list_free (list);
+
+  filtered = g_list_sort (filtered, gst_plugin_feature_rank_compare_func);
+  if (filtered) {
+    gchar *name;
+
+    name = g_strdup_printf ("pay%u", index);
+    pay = gst_element_factory_create (filtered->data, name);
+    g_free (name);
+  }
+  gst_plugin_feature_list_free (filtered);
+
+  if (pay == NULL)
+    return NULL;
+
+  g_object_set (pay, "pt", 96 + index, NULL);
+  /* clients join at any time, repeat the codec configuration */
+  if (g_object_class_find_property (G_OBJECT_GET_CLASS (pay),
+          "config-interval"))
+    g_object_set (pay, "config-interval", -1, NULL);
+
+  return pay;
+}
+
+static GstElement *
+rtsp_media_factory_push_create_element (GstRTSPMediaFactory * factory,
+    const GstRTSPUrl * url)
+{
+  GstRTSPMediaFactoryPushPrivate *priv;
+  GstElement *topbin;
+  GPtrArray *caps;
+  guint i;
+
+  priv = GST_RTSP_MEDIA_FACTORY_PUSH_CAST (factory)->priv;
+
+  /* add_stream() can grow the array of the factory meanwhile */
+  caps = g_ptr_array_new_with_free_func ((GDestroyNotify) gst_caps_unref);
+  g_mutex_lock (&priv->lock);
+  for (i = 0; i < priv->caps->len; i++)
+    g_ptr_array_add (caps, gst_caps_ref (g_ptr_array_index (priv->caps, i)));
+  g_mutex_unlock (&priv->lock);
+
+  GST_LOG ("creating element");
+
+  topbin = gst_bin_new ("GstRTSPMediaFactoryPush");
+  g_assert (topbin != NULL);
+
+  for (i = 0; i < caps->len; i++) {
+    GstCaps *c = g_ptr_array_index (caps, i);
+    GstRTSPPushSrc *src;
+    GstElement *pay;
+    gchar *name;
+
+    if (!(pay = make_payloader (c, i)))
+      goto no_payloader;
+
+    name = g_strdup_printf ("pushsrc%u", i);
+    src = g_object_new (gst_rtsp_push_src_get_type (), "name", name, NULL);
+    g_free (name);
+    src->caps = gst_caps_ref (c);
+
+    gst_bin_add_many (GST_BIN_CAST (topbin), GST_ELEMENT_CAST (src), pay,
+        NULL);
+    if (!gst_element_link (GST_ELEMENT_CAST (src), pay))
+      goto link_failed;
+  }
+  g_ptr_array_unref (caps);
+
+  if (i == 0)
+    goto no_streams;
+
+  return topbin;
+
+  /* ERRORS */
+no_payloader:
+  {
+    g_critical ("no payloader for %" GST_PTR_FORMAT,
+        g_ptr_array_index (caps, i));
+    g_ptr_array_unref (caps);
+    gst_object_unref (topbin);
+    return NULL;
+  }
+link_failed:
+  {
+    g_critical ("can't link payloader for %" GST_PTR_FORMAT,
+        g_ptr_array_index (caps, i));
+    g_ptr_array_unref (caps);
+    gst_object_unref (topbin);
+    return NULL;
+  }
+no_streams:
+  {
+    g_critical ("no streams added");
+    gst_object_unref (topbin);
+    return NULL;
+  }
+}
+
+static void
+push_media_gone (GstRTSPMediaFactoryPush * factory,
+    GObject * where_the_object_was)
+{
+  GstRTSPMediaFactoryPushPrivate *priv = factory->priv;
+  PushMedia *pm = NULL;
+  GList *walk;
+
+  g_mutex_lock (&priv->lock);
+  for (walk = priv->medias; walk; walk = walk->next) {
+    if (((PushMedia *) walk->data)->media ==
+        (GstRTSPMedia *) where_the_object_was) {
+      pm = walk->data;
+      priv->medias = g_list_delete_link (priv->medias, walk);
+      break;
+    }
+  }
+  g_mutex_unlock (&priv->lock);
+
+  if (pm)
+    push_media_free (pm);
+}
+
+static GstRTSPMedia *
+rtsp_media_factory_push_construct (GstRTSPMediaFactory * factory,
+    const GstRTSPUrl * url)
+{
+  GstRTSPMediaFactoryPushPrivate *priv;
+  GstRTSPMedia *media;
+  GstElement *element, *src;
+  PushMedia *pm;
+  guint i;
+
+  priv = GST_RTSP_MEDIA_FACTORY_PUSH_CAST (factory)->priv;
+
+  media =
+      GST_RTSP_MEDIA_FACTORY_CLASS
+      (gst_rtsp_media_factory_push_parent_class)->construct (factory, url);
+  if (media == NULL)
+    return NULL;
+
+  pm = g_slice_new0 (PushMedia);
+  pm->media = media;
+  pm->srcs = g_ptr_array_new_with_free_func (gst_object_unref);
+
+  /* the frames of the application go to the sources of the new media */
+  element = gst_rtsp_media_get_element (media);
+  for (i = 0;; i++) {
+    gchar *name;
+
+    name = g_strdup_printf ("pushsrc%u", i);
+    src = gst_bin_get_by_name (GST_BIN (element), name);
+    g_free (name);
+    if (src == NULL)
+      break;
+    g_ptr_array_add (pm->srcs, src);
+  }
+  gst_object_unref (element);
+
+  /* a blocked stream must not hold the thread of the application */
+  for (i = 0; i < gst_rtsp_media_n_streams (media); i++)
+    gst_rtsp_stream_set_drop_blocked (gst_rtsp_media_get_stream (media, i),
+        TRUE);
+
+  g_object_weak_ref (G_OBJECT (media), (GWeakNotify) push_media_gone, factory);
+
+  g_mutex_lock (&priv->lock);
+  priv->medias = g_list_prepend (priv->medias, pm);
+  g_mutex_unlock (&priv->lock);
+
+  return media;
+}
@@ -0,0 +1,102 @@
+/* GStreamer
+ * Copyright (C) 2021 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/gst.h>
+
+#include "rtsp-media-factory.h"
+
+#ifndef __GST_RTSP_MEDIA_FACTORY_PUSH_H__
+#define __GST_RTSP_MEDIA_FACTORY_PUSH_H__
+
+G_BEGIN_DECLS
+
+/* types for the media factory */
+#define GST_TYPE_RTSP_MEDIA_FACTORY_PUSH              (gst_rtsp_media_factory_push_get_type ())
+#define GST_IS_RTSP_MEDIA_FACTORY_PUSH(obj)           (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GST_TYPE_RTSP_MEDIA_FACTORY_PUSH))
+#define GST_IS_RTSP_MEDIA_FACTORY_PUSH_CLASS(klass)   (G_TYPE_CHECK_CLASS_TYPE ((klass), GST_TYPE_RTSP_MEDIA_FACTORY_PUSH))
+#define GST_RTSP_MEDIA_FACTORY_PUSH_GET_CLASS(obj)    (G_TYPE_INSTANCE_GET_CLASS ((obj), GST_TYPE_RTSP_MEDIA_FACTORY_PUSH, GstRTSPMediaFactoryPushClass))
+#define GST_RTSP_MEDIA_FACTORY_PUSH(obj)              (G_TYPE_CHECK_INSTANCE_CAST ((obj), GST_TYPE_RTSP_MEDIA_FACTORY_PUSH, GstRTSPMediaFactoryPush))
+#define GST_RTSP_MEDIA_FACTORY_PUSH_CLASS(klass)      (G_TYPE_CHECK_CLASS_CAST ((klass), GST_TYPE_RTSP_MEDIA_FACTORY_PUSH, GstRTSPMediaFactoryPushClass))
+#define GST_RTSP_MEDIA_FACTORY_PUSH_CAST(obj)         ((GstRTSPMediaFactoryPush*)(obj))
+#define GST_RTSP_MEDIA_FACTORY_PUSH_CLASS_CAST(klass) ((GstRTSPMediaFactoryPushClass*)(klass))
+
+typedef struct _GstRTSPMediaFactoryPush GstRTSPMediaFactoryPush;
+typedef struct _GstRTSPMediaFactoryPushClass GstRTSPMediaFactoryPushClass;
+typedef struct _GstRTSPMediaFactoryPushPrivate GstRTSPMediaFactoryPushPrivate;
+
+/**
+ * GstRTSPMediaFactoryPush:
+ *
+ * A media factory for the encoded frames of the application.
+ *
+ * Since: 1.20
+ */
+struct _GstRTSPMediaFactoryPush {
+  GstRTSPMediaFactory   parent;
+
+  /*< private >*/
+  GstRTSPMediaFactoryPushPrivate *priv;
+  gpointer _gst_reserved[GST_PADDING];
+};
+
+/**
+ * GstRTSPMediaFactoryPushClass:
+ *
+ * The #GstRTSPMediaFactoryPush class structure.
+ *
+ * Since: 1.20
+ */
+struct _GstRTSPMediaFactoryPushClass {
+  GstRTSPMediaFactoryClass  parent_class;
+
+  /*< private >*/
+  gpointer _gst_reserved[GST_PADDING];
+};
+
+GST_RTSP_SERVER_API
+GType                 gst_rtsp_media_factory_push_get_type   (void);
+
+/* creating the factory */
+
+GST_RTSP_SERVER_API
+GstRTSPMediaFactoryPush * gst_rtsp_media_factory_push_new    (void);
+
+/* configuring the factory */
+
+GST_RTSP_SERVER_API
+guint                 gst_rtsp_media_factory_push_add_stream (GstRTSPMediaFactoryPush *factory,
+                                                              GstCaps *caps);
+
+GST_RTSP_SERVER_API
+guint                 gst_rtsp_media_factory_push_n_streams  (GstRTSPMediaFactoryPush *factory);
+
+/* pushing frames */
+
+GST_RTSP_SERVER_API
+GstFlowReturn         gst_rtsp_media_factory_push_frame      (GstRTSPMediaFactoryPush *factory,
+                                                              guint stream,
+                                                              GstBuffer *frame);
+
+#ifdef G_DEFINE_AUTOPTR_CLEANUP_FUNC
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(GstRTSPMediaFactoryPush, gst_object_unref)
+#endif
+
+G_END_DECLS
+
+#endif /* __GST_RTSP_MEDIA_FACTORY_PUSH_H__ */
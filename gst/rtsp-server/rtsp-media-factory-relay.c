@@ -0,0 +1,835 @@
+/* GStreamer
+ * Copyright (C) 2021 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+/**
+ * SECTION:rtsp-media-factory-relay
+ * @short_description: A factory for relaying RTSP sources
+ * @see_also: #GstRTSPMediaFactory, #GstRTSPMedia
+ *
+ * This specialized #GstRTSPMediaFactory relays the streams of an upstream
+ * RTSP server, given with gst_rtsp_media_factory_relay_set_location(), to
+ * the clients of the server.
+ *
+ * The RTP packets of the upstream server are not depayloaded, they are sent
+ * to the clients with the SSRC, sequence numbers and timestamps of the
+ * relayed streams but with their original payload. The media of the factory
+ * is shared by default so that all the clients of a mount point share the
+ * connection to the upstream server. Relay factories with the same location,
+ * like the factories of several mount points for the same camera, share the
+ * connection as well. The shared media is configured by the factory that
+ * constructed it, the clients of the other factories with the same location
+ * get a media with the settings of that factory, like its permissions,
+ * protocols and latency.
+ *
+ * When the upstream server goes away after the streams were set up, the
+ * factory reconnects every #GstRTSPMediaFactoryRelay:reconnect-interval
+ * seconds, the clients keep their sessions and receive the packets again
+ * when the connection is restored.
+ *
+ * Since: 1.20
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include "rtsp-media-factory-relay.h"
+#include "rtsp-rtp-forward.h"
+
+struct _GstRTSPMediaFactoryRelayPrivate
+{
+  GMutex lock;
+  gchar *location;              /* protected by lock */
+  guint reconnect_interval;     /* protected by lock */
+};
+
+#define DEFAULT_LOCATION            NULL
+#define DEFAULT_RECONNECT_INTERVAL  5
+
+enum
+{
+  PROP_0,
+  PROP_LOCATION,
+  PROP_RECONNECT_INTERVAL,
+  PROP_LAST
+};
+
+GST_DEBUG_CATEGORY_STATIC (rtsp_media_factory_relay_debug);
+#define GST_CAT_DEFAULT rtsp_media_factory_relay_debug
+
+/* the media of a location, shared with other factories once it was
+ * configured by the factory that constructed it */
+typedef struct
+{
+  GstRTSPMedia *media;          /* no ref, NULL while constructing */
+  gboolean ready;
+} RelayEntry;
+
+/* the media of all relay factories, so that factories with the same location
+ * share the connection to the upstream server */
+static GMutex relays_lock;
+static GCond relays_cond;
+static GHashTable *relays;      /* location -> RelayEntry */
+
+static void gst_rtsp_media_factory_relay_get_property (GObject * object,
+    guint propid, GValue * value, GParamSpec * pspec);
+static void gst_rtsp_media_factory_relay_set_property (GObject * object,
+    guint propid, const GValue * value, GParamSpec * pspec);
+static void gst_rtsp_media_factory_relay_finalize (GObject * obj);
+
+static GstElement *rtsp_media_factory_relay_create_element (GstRTSPMediaFactory
+    * factory, const GstRTSPUrl * url);
+static GstRTSPMedia *rtsp_media_factory_relay_construct (GstRTSPMediaFactory *
+    factory, const GstRTSPUrl * url);
+static void rtsp_media_factory_relay_configure (GstRTSPMediaFactory * factory,
+    GstRTSPMedia * media);
+static void relay_ready (GstRTSPMediaFactory * factory, GstRTSPMedia * media,
+    gpointer user_data);
+
+G_DEFINE_TYPE_WITH_PRIVATE (GstRTSPMediaFactoryRelay,
+    gst_rtsp_media_factory_relay, GST_TYPE_RTSP_MEDIA_FACTORY);
+
+/* the dynamic payloader of a relay media, a bin with rtspsrc that exposes a
+ * forwarding payloader for each stream of the upstream server. The
+ * payloaders and the pads of the bin are kept when rtspsrc reconnects. */
+typedef struct
+{
+  GstBin bin;
+
+  GstElement *rtspsrc;
+  guint reconnect_interval;
+
+  GMutex lock;
+  GCond cond;
+  GHashTable *pays;             /* index -> payloader, protected by lock */
+  gboolean have_pads;
+  gboolean no_more_pads;
+  gboolean reconnecting;
+  gboolean flushing;
+} GstRTSPRelaySrc;
+
+typedef struct
+{
+  GstBinClass parent_class;
+} GstRTSPRelaySrcClass;
+
+static GType gst_rtsp_relay_src_get_type (void);
+
+G_DEFINE_TYPE (GstRTSPRelaySrc, gst_rtsp_relay_src, GST_TYPE_BIN);
+
+static void
+relay_src_do_reconnect (GstElement * element, gpointer user_data)
+{
+  GstRTSPRelaySrc *src = (GstRTSPRelaySrc *) element;
+  gint64 end_time;
+  gboolean flushing;
+
+  end_time = g_get_monotonic_time () +
+      (gint64) src->reconnect_interval * G_TIME_SPAN_SECOND;
+
+  g_mutex_lock (&src->lock);
+  while (!src->flushing && g_cond_wait_until (&src->cond, &src->lock,
+          end_time));
+  flushing = src->flushing;
+  g_mutex_unlock (&src->lock);
+
+  if (!flushing) {
+    GST_INFO_OBJECT (src, "reconnecting");
+    gst_element_set_state (src->rtspsrc, GST_STATE_NULL);
+  }
+
+  g_mutex_lock (&src->lock);
+  src->reconnecting = FALSE;
+  flushing = src->flushing;
+  g_mutex_unlock (&src->lock);
+
+  if (!flushing)
+    gst_element_sync_state_with_parent (src->rtspsrc);
+}
+
+/* schedule a reconnect, returns FALSE when the streams were never set up or
+ * reconnecting is disabled and the caller should fail instead */
+static gboolean
+relay_src_reconnect (GstRTSPRelaySrc * src)
+{
+  g_mutex_lock (&src->lock);
+  if (!src->have_pads || src->reconnect_interval == 0 || src->flushing) {
+    g_mutex_unlock (&src->lock);
+    return FALSE;
+  }
+  if (src->reconnecting) {
+    g_mutex_unlock (&src->lock);
+    return TRUE;
+  }
+  src->reconnecting = TRUE;
+  g_mutex_unlock (&src->lock);
+
+  GST_WARNING_OBJECT (src, "lost the upstream server, reconnecting in %u "
+      "seconds", src->reconnect_interval);
+  gst_element_call_async (GST_ELEMENT_CAST (src), relay_src_do_reconnect,
+      NULL, NULL);
+
+  return TRUE;
+}
+
+/* the upstream server ends the streams when it goes away, the clients of the
+ * relay should not see this */
+static GstPadProbeReturn
+relay_src_eos_probe (GstPad * pad, GstPadProbeInfo * info,
+    GstRTSPRelaySrc * src)
+{
+  GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+
+  if (GST_EVENT_TYPE (event) != GST_EVENT_EOS)
+    return GST_PAD_PROBE_OK;
+
+  if (!relay_src_reconnect (src))
+    return GST_PAD_PROBE_OK;
+
+  return GST_PAD_PROBE_DROP;
+}
+
+/* called from the streaming thread of rtspsrc */
+static void
+relay_src_pad_added (GstElement * rtspsrc, GstPad * pad, GstRTSPRelaySrc * src)
+{
+  GstElement *pay;
+  GstPad *sinkpad, *peer;
+  guint index;
+  gboolean created = FALSE;
+
+  if (sscanf (GST_PAD_NAME (pad), "recv_rtp_src_%u_", &index) != 1)
+    return;
+
+  GST_DEBUG_OBJECT (src, "pad added %s:%s", GST_DEBUG_PAD_NAME (pad));
+
+  g_mutex_lock (&src->lock);
+  pay = g_hash_table_lookup (src->pays, GUINT_TO_POINTER (index));
+  if (pay == NULL) {
+    gchar *name;
+
+    name = g_strdup_printf ("pay_src_%u", index);
+    pay = gst_rtsp_rtp_forward_new (name);
+    g_free (name);
+    g_hash_table_insert (src->pays, GUINT_TO_POINTER (index), pay);
+    created = TRUE;
+  }
+  g_mutex_unlock (&src->lock);
+
+  sinkpad = gst_element_get_static_pad (pay, "sink");
+
+  if (created) {
+    GstPad *srcpad, *ghost;
+    gchar *name;
+
+    gst_bin_add (GST_BIN_CAST (src), pay);
+    gst_element_sync_state_with_parent (pay);
+
+    gst_pad_add_probe (sinkpad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+        (GstPadProbeCallback) relay_src_eos_probe, src, NULL);
+
+    /* expose the payloader before the packets flow */
+    srcpad = gst_element_get_static_pad (pay, "src");
+    name = g_strdup_printf ("src_%u", index);
+    ghost = gst_ghost_pad_new (name, srcpad);
+    g_free (name);
+    gst_object_unref (srcpad);
+
+    gst_pad_set_active (ghost, TRUE);
+    gst_element_add_pad (GST_ELEMENT_CAST (src), ghost);
+
+    g_mutex_lock (&src->lock);
+    src->have_pads = TRUE;
+    g_mutex_unlock (&src->lock);
+  }
+
+  /* a new SSRC of a stream replaces the old one */
+  if ((peer = gst_pad_get_peer (sinkpad))) {
+    gst_pad_unlink (peer, sinkpad);
+    gst_object_unref (peer);
+  }
+  if (gst_pad_link (pad, sinkpad) != GST_PAD_LINK_OK)
+    GST_WARNING_OBJECT (src, "could not link %s:%s", GST_DEBUG_PAD_NAME (pad));
+  gst_object_unref (sinkpad);
+}
+
+static void
+relay_src_no_more_pads (GstElement * rtspsrc, GstRTSPRelaySrc * src)
+{
+  gboolean first;
+
+  g_mutex_lock (&src->lock);
+  first = !src->no_more_pads;
+  src->no_more_pads = TRUE;
+  g_mutex_unlock (&src->lock);
+
+  /* the pads of a reconnect are the ones that we exposed already */
+  if (first)
+    gst_element_no_more_pads (GST_ELEMENT_CAST (src));
+}
+
+static void
+gst_rtsp_relay_src_handle_message (GstBin * bin, GstMessage * message)
+{
+  GstRTSPRelaySrc *src = (GstRTSPRelaySrc *) bin;
+
+  if (GST_MESSAGE_TYPE (message) == GST_MESSAGE_ERROR &&
+      relay_src_reconnect (src)) {
+    GError *err = NULL;
+
+    gst_message_parse_error (message, &err, NULL);
+    GST_WARNING_OBJECT (src, "upstream error: %s", err->message);
+    g_error_free (err);
+    gst_message_unref (message);
+    return;
+  }
+
+  GST_BIN_CLASS (gst_rtsp_relay_src_parent_class)->handle_message (bin,
+      message);
+}
+
+static GstStateChangeReturn
+gst_rtsp_relay_src_change_state (GstElement * element,
+    GstStateChange transition)
+{
+  GstRTSPRelaySrc *src = (GstRTSPRelaySrc *) element;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_NULL_TO_READY:
+      g_mutex_lock (&src->lock);
+      src->flushing = FALSE;
+      g_mutex_unlock (&src->lock);
+      break;
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      /* stop waiting for a reconnect */
+      g_mutex_lock (&src->lock);
+      src->flushing = TRUE;
+      g_cond_signal (&src->cond);
+      g_mutex_unlock (&src->lock);
+      break;
+    default:
+      break;
+  }
+
+  return
+      GST_ELEMENT_CLASS (gst_rtsp_relay_src_parent_class)->change_state
+      (element, transition);
+}
+
+static void
+gst_rtsp_relay_src_finalize (GObject * obj)
+{
+  GstRTSPRelaySrc *src = (GstRTSPRelaySrc *) obj;
+
+  g_hash_table_unref (src->pays);
+  g_mutex_clear (&src->lock);
+  g_cond_clear (&src->cond);
+
+  G_OBJECT_CLASS (gst_rtsp_relay_src_parent_class)->finalize (obj);
+}
+
+static void
+gst_rtsp_relay_src_class_init (GstRTSPRelaySrcClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+  GstBinClass *bin_class = GST_BIN_CLASS (klass);
+
+  gobject_class->finalize = gst_rtsp_relay_src_finalize;
+  element_class->change_state = gst_rtsp_relay_src_change_state;
+  bin_class->handle_message = gst_rtsp_relay_src_handle_message;
+}
+
+static void
+gst_rtsp_relay_src_init (GstRTSPRelaySrc * src)
+{
+  g_mutex_init (&src->lock);
+  g_cond_init (&src->cond);
+  src->pays = g_hash_table_new (NULL, NULL);
+}
+
+static GstElement *
+relay_src_new (const gchar * location, guint reconnect_interval)
+{
+  GstRTSPRelaySrc *src;
+  GstElement *rtspsrc;
+
+  rtspsrc = gst_element_factory_make ("rtspsrc", NULL);
+  if (rtspsrc == NULL)
+    return NULL;
+
+  g_object_set (rtspsrc, "location", location, NULL);
+
+  src = g_object_new (gst_rtsp_relay_src_get_type (), "name", "dynpay0", NULL);
+  src->rtspsrc = rtspsrc;
+  src->reconnect_interval = reconnect_interval;
+
+  g_signal_connect (rtspsrc, "pad-added", (GCallback) relay_src_pad_added, src);
+  g_signal_connect (rtspsrc, "no-more-pads",
+      (GCallback) relay_src_no_more_pads, src);
+  gst_bin_add (GST_BIN_CAST (src), rtspsrc);
+
+  return GST_ELEMENT_CAST (src);
+}
+
+static void
+gst_rtsp_media_factory_relay_class_init (GstRTSPMediaFactoryRelayClass * klass)
+{
+  GObjectClass *gobject_class;
+  GstRTSPMediaFactoryClass *mediafactory_class;
+
+  gobject_class = G_OBJECT_CLASS (klass);
+  mediafactory_class = GST_RTSP_MEDIA_FACTORY_CLASS (klass);
+
+  gobject_class->get_property = gst_rtsp_media_factory_relay_get_property;
+  gobject_class->set_property = gst_rtsp_media_factory_relay_set_property;
+  gobject_class->finalize = gst_rtsp_media_factory_relay_finalize;
+
+  /**
+   * GstRTSPMediaFactoryRelay:location:
+   *
+   * The rtsp:// location of the upstream server.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_LOCATION,
+      g_param_spec_string ("location", "Location",
+          "The location of the upstream RTSP server", DEFAULT_LOCATION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstRTSPMediaFactoryRelay:reconnect-interval:
+   *
+   * The interval in seconds between the attempts to reconnect to the upstream
+   * server, 0 disables reconnecting.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_RECONNECT_INTERVAL,
+      g_param_spec_uint ("reconnect-interval", "Reconnect Interval",
+          "The interval in seconds between the attempts to reconnect to the "
+          "upstream server (0 = disabled)", 0, G_MAXUINT,
+          DEFAULT_RECONNECT_INTERVAL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  mediafactory_class->create_element = rtsp_media_factory_relay_create_element;
+  mediafactory_class->construct = rtsp_media_factory_relay_construct;
+  mediafactory_class->configure = rtsp_media_factory_relay_configure;
+
+  GST_DEBUG_CATEGORY_INIT (rtsp_media_factory_relay_debug,
+      "rtspmediafactoryrelay", 0, "GstRTSPMediaFactoryRelay");
+}
+
+static void
+gst_rtsp_media_factory_relay_init (GstRTSPMediaFactoryRelay * factory)
+{
+  GstRTSPMediaFactoryRelayPrivate *priv =
+      gst_rtsp_media_factory_relay_get_instance_private (factory);
+
+  GST_DEBUG_OBJECT (factory, "new");
+
+  factory->priv = priv;
+
+  priv->location = g_strdup (DEFAULT_LOCATION);
+  priv->reconnect_interval = DEFAULT_RECONNECT_INTERVAL;
+  g_mutex_init (&priv->lock);
+
+  /* all the clients share the connection to the upstream server */
+  gst_rtsp_media_factory_set_shared (GST_RTSP_MEDIA_FACTORY (factory), TRUE);
+
+  /* after the handlers of the application configured the media */
+  g_signal_connect_after (factory, "media-configure",
+      (GCallback) relay_ready, NULL);
+}
+
+static void
+gst_rtsp_media_factory_relay_finalize (GObject * obj)
+{
+  GstRTSPMediaFactoryRelay *factory = GST_RTSP_MEDIA_FACTORY_RELAY (obj);
+  GstRTSPMediaFactoryRelayPrivate *priv = factory->priv;
+
+  GST_DEBUG_OBJECT (factory, "finalize");
+
+  g_free (priv->location);
+  g_mutex_clear (&priv->lock);
+
+  G_OBJECT_CLASS (gst_rtsp_media_factory_relay_parent_class)->finalize (obj);
+}
+
+static void
+gst_rtsp_media_factory_relay_get_property (GObject * object, guint propid,
+    GValue * value, GParamSpec * pspec)
+{
+  GstRTSPMediaFactoryRelay *factory = GST_RTSP_MEDIA_FACTORY_RELAY (object);
+
+  switch (propid) {
+    case PROP_LOCATION:
+      g_value_take_string (value,
+          gst_rtsp_media_factory_relay_get_location (factory));
+      break;
+    case PROP_RECONNECT_INTERVAL:
+      g_value_set_uint (value,
+          gst_rtsp_media_factory_relay_get_reconnect_interval (factory));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, propid, pspec);
+  }
+}
+
+static void
+gst_rtsp_media_factory_relay_set_property (GObject * object, guint propid,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstRTSPMediaFactoryRelay *factory = GST_RTSP_MEDIA_FACTORY_RELAY (object);
+
+  switch (propid) {
+    case PROP_LOCATION:
+      gst_rtsp_media_factory_relay_set_location (factory,
+          g_value_get_string (value));
+      break;
+    case PROP_RECONNECT_INTERVAL:
+      gst_rtsp_media_factory_relay_set_reconnect_interval (factory,
+          g_value_get_uint (value));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, propid, pspec);
+  }
+}
+
+/**
+ * gst_rtsp_media_factory_relay_new:
+ *
+ * Create a new #GstRTSPMediaFactoryRelay instance.
+ *
+ * Returns: (transfer full): a new #GstRTSPMediaFactoryRelay object.
+ *
+ * Since: 1.20
+ */
+GstRTSPMediaFactoryRelay *
+gst_rtsp_media_factory_relay_new (void)
+{
+  GstRTSPMediaFactoryRelay *result;
+
+  result = g_object_new (GST_TYPE_RTSP_MEDIA_FACTORY_RELAY, NULL);
+
+  return result;
+}
+
+/**
+ * gst_rtsp_media_factory_relay_set_location:
+ * @factory: a #GstRTSPMediaFactoryRelay
+ * @location: the rtsp:// location of the upstream server
+ *
+ * Set the location of the upstream RTSP server whose streams are relayed by
+ * @factory.
+ *
+ * Since: 1.20
+ */
+void
+gst_rtsp_media_factory_relay_set_location (GstRTSPMediaFactoryRelay * factory,
+    const gchar * location)
+{
+  GstRTSPMediaFactoryRelayPrivate *priv;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA_FACTORY_RELAY (factory));
+  g_return_if_fail (location != NULL);
+
+  priv = factory->priv;
+
+  g_mutex_lock (&priv->lock);
+  g_free (priv->location);
+  priv->location = g_strdup (location);
+  g_mutex_unlock (&priv->lock);
+}
+
+/**
+ * gst_rtsp_media_factory_relay_get_location:
+ * @factory: a #GstRTSPMediaFactoryRelay
+ *
+ * Get the location of the upstream RTSP server of @factory.
+ *
+ * Returns: (transfer full) (nullable): the configured location. g_free()
+ * after usage.
+ *
+ * Since: 1.20
+ */
+gchar *
+gst_rtsp_media_factory_relay_get_location (GstRTSPMediaFactoryRelay * factory)
+{
+  GstRTSPMediaFactoryRelayPrivate *priv;
+  gchar *result;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA_FACTORY_RELAY (factory), NULL);
+
+  priv = factory->priv;
+
+  g_mutex_lock (&priv->lock);
+  result = g_strdup (priv->location);
+  g_mutex_unlock (&priv->lock);
+
+  return result;
+}
+
+/**
+ * gst_rtsp_media_factory_relay_set_reconnect_interval:
+ * @factory: a #GstRTSPMediaFactoryRelay
+ * @interval: the interval in seconds
+ *
+ * Reconnect to the upstream server every @interval seconds when the
+ * connection is lost after the streams were set up. When @interval is 0,
+ * the media of @factory fails when the connection is lost.
+ *
+ * Since: 1.20
+ */
+void
+gst_rtsp_media_factory_relay_set_reconnect_interval (GstRTSPMediaFactoryRelay
+    * factory, guint interval)
+{
+  GstRTSPMediaFactoryRelayPrivate *priv;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA_FACTORY_RELAY (factory));
+
+  priv = factory->priv;
+
+  g_mutex_lock (&priv->lock);
+  priv->reconnect_interval = interval;
+  g_mutex_unlock (&priv->lock);
+}
+
+/**
+ * gst_rtsp_media_factory_relay_get_reconnect_interval:
+ * @factory: a #GstRTSPMediaFactoryRelay
+ *
+ * Get the interval between the attempts to reconnect to the upstream server.
+ *
+ * Returns: the interval in seconds, 0 when reconnecting is disabled.
+ *
+ * Since: 1.20
+ */
+guint
+gst_rtsp_media_factory_relay_get_reconnect_interval (GstRTSPMediaFactoryRelay
+    * factory)
+{
+  GstRTSPMediaFactoryRelayPrivate *priv;
+  guint result;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA_FACTORY_RELAY (factory), 0);
+
+  priv = factory->priv;
+
+  g_mutex_lock (&priv->lock);
+  result = priv->reconnect_interval;
+  g_mutex_unlock (&priv->lock);
+
+  return result;
+}
+
+static GstElement *
+rtsp_media_factory_relay_create_element (GstRTSPMediaFactory * factory,
+    const GstRTSPUrl * url)
+{
+  GstRTSPMediaFactoryRelayPrivate *priv;
+  GstElement *topbin, *element;
+  gchar *location;
+  guint interval;
+
+  priv = GST_RTSP_MEDIA_FACTORY_RELAY_CAST (factory)->priv;
+
+  g_mutex_lock (&priv->lock);
+  location = g_strdup (priv->location);
+  interval = priv->reconnect_interval;
+  g_mutex_unlock (&priv->lock);
+
+  if (location == NULL)
+    goto no_location;
+
+  GST_LOG ("creating element for %s", location);
+
+  /* our bin will dynamically expose payloaded pads */
+  element = relay_src_new (location, interval);
+  g_free (location);
+  if (element == NULL)
+    goto no_rtspsrc;
+
+  topbin = gst_bin_new ("GstRTSPMediaFactoryRelay");
+  g_assert (topbin != NULL);
+  gst_bin_add (GST_BIN_CAST (topbin), element);
+
+  return topbin;
+
+  /* ERRORS */
+no_location:
+  {
+    g_critical ("no location set");
+    return NULL;
+  }
+no_rtspsrc:
+  {
+    g_critical ("can't create rtspsrc element");
+    return NULL;
+  }
+}
+
+static void
+relay_entry_free (RelayEntry * entry)
+{
+  g_slice_free (RelayEntry, entry);
+}
+
+static gboolean
+relay_is_media (gpointer key, gpointer value, gpointer media)
+{
+  return ((RelayEntry *) value)->media == media;
+}
+
+static void
+relay_forget (GstRTSPMedia * media)
+{
+  g_mutex_lock (&relays_lock);
+  g_hash_table_foreach_remove (relays, relay_is_media, media);
+  /* wake up the factories that wait for it to be configured */
+  g_cond_broadcast (&relays_cond);
+  g_mutex_unlock (&relays_lock);
+}
+
+/* the media was configured, the other factories can share it. This runs
+ * from the media-configure signal, which is emitted also when a subclass
+ * does not chain up its configure vfunc */
+static void
+relay_ready (GstRTSPMediaFactory * factory, GstRTSPMedia * media,
+    gpointer user_data)
+{
+  GHashTableIter iter;
+  RelayEntry *entry;
+
+  if (g_object_get_data (G_OBJECT (media), "gst-rtsp-relay-factory") !=
+      factory)
+    return;
+
+  g_mutex_lock (&relays_lock);
+  g_hash_table_iter_init (&iter, relays);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) & entry)) {
+    if (entry->media == media)
+      entry->ready = TRUE;
+  }
+  g_cond_broadcast (&relays_cond);
+  g_mutex_unlock (&relays_lock);
+}
+
+static void
+relay_media_unprepared (GstRTSPMedia * media, gpointer user_data)
+{
+  relay_forget (media);
+}
+
+static void
+relay_media_gone (gpointer user_data, GObject * where_the_object_was)
+{
+  relay_forget ((GstRTSPMedia *) where_the_object_was);
+}
+
+static GstRTSPMedia *
+rtsp_media_factory_relay_construct (GstRTSPMediaFactory * factory,
+    const GstRTSPUrl * url)
+{
+  GstRTSPMediaFactoryRelay *relay = GST_RTSP_MEDIA_FACTORY_RELAY_CAST (factory);
+  GstRTSPMedia *media;
+  RelayEntry *entry;
+  gchar *location;
+
+  location = gst_rtsp_media_factory_relay_get_location (relay);
+  if (location == NULL || !gst_rtsp_media_factory_is_shared (factory)) {
+    g_free (location);
+    goto construct;
+  }
+
+  g_mutex_lock (&relays_lock);
+  if (G_UNLIKELY (relays == NULL))
+    relays = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+        (GDestroyNotify) relay_entry_free);
+
+  /* another factory relays the same location already, wait until its media
+   * is configured when it is still constructing it */
+  while ((entry = g_hash_table_lookup (relays, location)) && !entry->ready)
+    g_cond_wait (&relays_cond, &relays_lock);
+
+  if (entry) {
+    media = g_object_ref (entry->media);
+    g_mutex_unlock (&relays_lock);
+    GST_INFO ("sharing media %p of %s", media, location);
+    g_free (location);
+    return media;
+  }
+
+  /* let the other factories wait for the media we construct, without
+   * holding the lock that all the relay factories use */
+  entry = g_slice_new0 (RelayEntry);
+  g_hash_table_insert (relays, g_strdup (location), entry);
+  g_mutex_unlock (&relays_lock);
+
+  media =
+      GST_RTSP_MEDIA_FACTORY_CLASS
+      (gst_rtsp_media_factory_relay_parent_class)->construct (factory, url);
+
+  g_mutex_lock (&relays_lock);
+  if (media) {
+    entry->media = media;
+    g_object_set_data (G_OBJECT (media), "gst-rtsp-relay-factory", factory);
+    g_object_weak_ref (G_OBJECT (media), relay_media_gone, NULL);
+    /* an unprepared media does not connect anymore */
+    g_signal_connect (media, "unprepared",
+        (GCallback) relay_media_unprepared, NULL);
+  } else {
+    g_hash_table_remove (relays, location);
+    g_cond_broadcast (&relays_cond);
+  }
+  g_mutex_unlock (&relays_lock);
+  g_free (location);
+
+  return media;
+
+construct:
+  return GST_RTSP_MEDIA_FACTORY_CLASS
+      (gst_rtsp_media_factory_relay_parent_class)->construct (factory, url);
+}
+
+static void
+rtsp_media_factory_relay_configure (GstRTSPMediaFactory * factory,
+    GstRTSPMedia * media)
+{
+  gpointer owner;
+
+  owner = g_object_get_data (G_OBJECT (media), "gst-rtsp-relay-factory");
+  if (owner == NULL) {
+    GST_RTSP_MEDIA_FACTORY_CLASS
+        (gst_rtsp_media_factory_relay_parent_class)->configure (factory, media);
+    return;
+  }
+
+  /* a media shared with other factories is configured once, with the
+   * settings of the factory that constructed it */
+  if (owner != factory ||
+      g_object_get_data (G_OBJECT (media), "gst-rtsp-relay-configured"))
+    return;
+  g_object_set_data (G_OBJECT (media), "gst-rtsp-relay-configured",
+      GINT_TO_POINTER (TRUE));
+
+  GST_RTSP_MEDIA_FACTORY_CLASS
+      (gst_rtsp_media_factory_relay_parent_class)->configure (factory, media);
+}
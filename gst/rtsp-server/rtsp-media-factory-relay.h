@@ -0,0 +1,102 @@
+/* GStreamer
+ * Copyright (C) 2021 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/gst.h>
+
+#include "rtsp-media-factory.h"
+
+#ifndef __GST_RTSP_MEDIA_FACTORY_RELAY_H__
+#define __GST_RTSP_MEDIA_FACTORY_RELAY_H__
+
+G_BEGIN_DECLS
+
+/* types for the media factory */
+#define GST_TYPE_RTSP_MEDIA_FACTORY_RELAY              (gst_rtsp_media_factory_relay_get_type ())
+#define GST_IS_RTSP_MEDIA_FACTORY_RELAY(obj)           (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GST_TYPE_RTSP_MEDIA_FACTORY_RELAY))
+#define GST_IS_RTSP_MEDIA_FACTORY_RELAY_CLASS(klass)   (G_TYPE_CHECK_CLASS_TYPE ((klass), GST_TYPE_RTSP_MEDIA_FACTORY_RELAY))
+#define GST_RTSP_MEDIA_FACTORY_RELAY_GET_CLASS(obj)    (G_TYPE_INSTANCE_GET_CLASS ((obj), GST_TYPE_RTSP_MEDIA_FACTORY_RELAY, GstRTSPMediaFactoryRelayClass))
+#define GST_RTSP_MEDIA_FACTORY_RELAY(obj)              (G_TYPE_CHECK_INSTANCE_CAST ((obj), GST_TYPE_RTSP_MEDIA_FACTORY_RELAY, GstRTSPMediaFactoryRelay))
+#define GST_RTSP_MEDIA_FACTORY_RELAY_CLASS(klass)      (G_TYPE_CHECK_CLASS_CAST ((klass), GST_TYPE_RTSP_MEDIA_FACTORY_RELAY, GstRTSPMediaFactoryRelayClass))
+#define GST_RTSP_MEDIA_FACTORY_RELAY_CAST(obj)         ((GstRTSPMediaFactoryRelay*)(obj))
+#define GST_RTSP_MEDIA_FACTORY_RELAY_CLASS_CAST(klass) ((GstRTSPMediaFactoryRelayClass*)(klass))
+
+typedef struct _GstRTSPMediaFactoryRelay GstRTSPMediaFactoryRelay;
+typedef struct _GstRTSPMediaFactoryRelayClass GstRTSPMediaFactoryRelayClass;
+typedef struct _GstRTSPMediaFactoryRelayPrivate GstRTSPMediaFactoryRelayPrivate;
+
+/**
+ * GstRTSPMediaFactoryRelay:
+ *
+ * A media factory that relays the RTP packets of an upstream RTSP server.
+ *
+ * Since: 1.20
+ */
+struct _GstRTSPMediaFactoryRelay {
+  GstRTSPMediaFactory   parent;
+
+  /*< private >*/
+  GstRTSPMediaFactoryRelayPrivate *priv;
+  gpointer _gst_reserved[GST_PADDING];
+};
+
+/**
+ * GstRTSPMediaFactoryRelayClass:
+ *
+ * The #GstRTSPMediaFactoryRelay class structure.
+ *
+ * Since: 1.20
+ */
+struct _GstRTSPMediaFactoryRelayClass {
+  GstRTSPMediaFactoryClass  parent_class;
+
+  /*< private >*/
+  gpointer _gst_reserved[GST_PADDING];
+};
+
+GST_RTSP_SERVER_API
+GType                 gst_rtsp_media_factory_relay_get_type   (void);
+
+/* creating the factory */
+
+GST_RTSP_SERVER_API
+GstRTSPMediaFactoryRelay * gst_rtsp_media_factory_relay_new   (void);
+
+/* configuring the factory */
+
+GST_RTSP_SERVER_API
+void                  gst_rtsp_media_factory_relay_set_location  (GstRTSPMediaFactoryRelay *factory,
+                                                                  const gchar *location);
+
+GST_RTSP_SERVER_API
+gchar *               gst_rtsp_media_factory_relay_get_location  (GstRTSPMediaFactoryRelay *factory);
+
+GST_RTSP_SERVER_API
+void                  gst_rtsp_media_factory_relay_set_reconnect_interval (GstRTSPMediaFactoryRelay *factory,
+                                                                           guint interval);
+
+GST_RTSP_SERVER_API
+guint                 gst_rtsp_media_factory_relay_get_reconnect_interval (GstRTSPMediaFactoryRelay *factory);
+
+#ifdef G_DEFINE_AUTOPTR_CLEANUP_FUNC
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(GstRTSPMediaFactoryRelay, gst_object_unref)
+#endif
+
+G_END_DECLS
+
+#endif /* __GST_RTSP_MEDIA_FACTORY_RELAY_H__ */
@@ -0,0 +1,198 @@
+/* GStreamer
+ * Copyright (C) 2021 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+/**
+ * SECTION:rtsp-media-factory-replay
+ * @short_description: A factory that loops over a uri
+ * @see_also: #GstRTSPMediaFactoryURI, #GstRTSPMedia
+ *
+ * This specialized #GstRTSPMediaFactoryURI plays its uri
+ * #GstRTSPMediaFactoryReplay:num-loops times, or forever, like a feed of
+ * test pattern that never ends. The media of the factory is shared by
+ * default so that all the clients watch the same loop, and it can't seek.
+ *
+ * A pass starts right after the end of the previous pass, the timestamps of
+ * the packets continue and the elements of the media are not replugged. As
+ * with #GstRTSPMediaFactoryURI, the streams that have a payloader are
+ * payloaded without decoding them.
+ *
+ * When the factory has an RTP cache, see
+ * gst_rtsp_media_factory_uri_set_rtp_cache(), the first pass of the uri is
+ * recorded in the cache. The media created afterwards loop over the packets
+ * of the cache without demuxing the uri.
+ *
+ * Since: 1.20
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "rtsp-media-factory-replay.h"
+#include "rtsp-server-internal.h"
+
+#define DEFAULT_NUM_LOOPS   -1
+
+enum
+{
+  PROP_0,
+  PROP_NUM_LOOPS,
+  PROP_LAST
+};
+
+GST_DEBUG_CATEGORY_STATIC (rtsp_media_factory_replay_debug);
+#define GST_CAT_DEFAULT rtsp_media_factory_replay_debug
+
+static void gst_rtsp_media_factory_replay_get_property (GObject * object,
+    guint propid, GValue * value, GParamSpec * pspec);
+static void gst_rtsp_media_factory_replay_set_property (GObject * object,
+    guint propid, const GValue * value, GParamSpec * pspec);
+
+G_DEFINE_TYPE (GstRTSPMediaFactoryReplay, gst_rtsp_media_factory_replay,
+    GST_TYPE_RTSP_MEDIA_FACTORY_URI);
+
+static void
+gst_rtsp_media_factory_replay_class_init (GstRTSPMediaFactoryReplayClass *
+    klass)
+{
+  GObjectClass *gobject_class;
+
+  gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->get_property = gst_rtsp_media_factory_replay_get_property;
+  gobject_class->set_property = gst_rtsp_media_factory_replay_set_property;
+
+  /**
+   * GstRTSPMediaFactoryReplay:num-loops:
+   *
+   * The number of times to play the uri, -1 to play it forever.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_NUM_LOOPS,
+      g_param_spec_int64 ("num-loops", "Num Loops",
+          "The number of times to play the uri (-1 = infinite)", -1,
+          G_MAXINT64, DEFAULT_NUM_LOOPS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  GST_DEBUG_CATEGORY_INIT (rtsp_media_factory_replay_debug,
+      "rtspmediafactoryreplay", 0, "GstRTSPMediaFactoryReplay");
+}
+
+static void
+gst_rtsp_media_factory_replay_init (GstRTSPMediaFactoryReplay * factory)
+{
+  GST_DEBUG_OBJECT (factory, "new");
+
+  gst_rtsp_media_factory_uri_set_loops (GST_RTSP_MEDIA_FACTORY_URI (factory),
+      DEFAULT_NUM_LOOPS);
+  gst_rtsp_media_factory_set_shared (GST_RTSP_MEDIA_FACTORY (factory), TRUE);
+}
+
+static void
+gst_rtsp_media_factory_replay_get_property (GObject * object, guint propid,
+    GValue * value, GParamSpec * pspec)
+{
+  GstRTSPMediaFactoryReplay *factory = GST_RTSP_MEDIA_FACTORY_REPLAY (object);
+
+  switch (propid) {
+    case PROP_NUM_LOOPS:
+      g_value_set_int64 (value,
+          gst_rtsp_media_factory_replay_get_num_loops (factory));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, propid, pspec);
+  }
+}
+
+static void
+gst_rtsp_media_factory_replay_set_property (GObject * object, guint propid,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstRTSPMediaFactoryReplay *factory = GST_RTSP_MEDIA_FACTORY_REPLAY (object);
+
+  switch (propid) {
+    case PROP_NUM_LOOPS:
+      gst_rtsp_media_factory_replay_set_num_loops (factory,
+          g_value_get_int64 (value));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, propid, pspec);
+  }
+}
+
+/**
+ * gst_rtsp_media_factory_replay_new:
+ *
+ * Create a new #GstRTSPMediaFactoryReplay instance.
+ *
+ * Returns: (transfer full): a new #GstRTSPMediaFactoryReplay object.
+ *
+ * Since: 1.20
+ */
+GstRTSPMediaFactoryReplay *
+gst_rtsp_media_factory_replay_new (void)
+{
+  GstRTSPMediaFactoryReplay *result;
+
+  result = g_object_new (GST_TYPE_RTSP_MEDIA_FACTORY_REPLAY, NULL);
+
+  return result;
+}
+
+/**
+ * gst_rtsp_media_factory_replay_set_num_loops:
+ * @factory: a #GstRTSPMediaFactoryReplay
+ * @num_loops: the number of times to play the uri, -1 for infinite
+ *
+ * Play the uri of @factory @num_loops times. The media that were created
+ * already keep the number of loops they started with.
+ *
+ * Since: 1.20
+ */
+void
+gst_rtsp_media_factory_replay_set_num_loops (GstRTSPMediaFactoryReplay *
+    factory, gint64 num_loops)
+{
+  g_return_if_fail (GST_IS_RTSP_MEDIA_FACTORY_REPLAY (factory));
+  g_return_if_fail (num_loops != 0 && num_loops >= -1);
+
+  gst_rtsp_media_factory_uri_set_loops (GST_RTSP_MEDIA_FACTORY_URI (factory),
+      num_loops);
+}
+
+/**
+ * gst_rtsp_media_factory_replay_get_num_loops:
+ * @factory: a #GstRTSPMediaFactoryReplay
+ *
+ * Get the number of times @factory plays its uri.
+ *
+ * Returns: the number of loops, -1 for infinite.
+ *
+ * Since: 1.20
+ */
+gint64
+gst_rtsp_media_factory_replay_get_num_loops (GstRTSPMediaFactoryReplay *
+    factory)
+{
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA_FACTORY_REPLAY (factory),
+      DEFAULT_NUM_LOOPS);
+
+  return
+      gst_rtsp_media_factory_uri_get_loops (GST_RTSP_MEDIA_FACTORY_URI
+      (factory));
+}
@@ -0,0 +1,93 @@
+/* GStreamer
+ * Copyright (C) 2021 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/gst.h>
+
+#include "rtsp-media-factory-uri.h"
+
+#ifndef __GST_RTSP_MEDIA_FACTORY_REPLAY_H__
+#define __GST_RTSP_MEDIA_FACTORY_REPLAY_H__
+
+G_BEGIN_DECLS
+
+/* types for the media factory */
+#define GST_TYPE_RTSP_MEDIA_FACTORY_REPLAY              (gst_rtsp_media_factory_replay_get_type ())
+#define GST_IS_RTSP_MEDIA_FACTORY_REPLAY(obj)           (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GST_TYPE_RTSP_MEDIA_FACTORY_REPLAY))
+#define GST_IS_RTSP_MEDIA_FACTORY_REPLAY_CLASS(klass)   (G_TYPE_CHECK_CLASS_TYPE ((klass), GST_TYPE_RTSP_MEDIA_FACTORY_REPLAY))
+#define GST_RTSP_MEDIA_FACTORY_REPLAY_GET_CLASS(obj)    (G_TYPE_INSTANCE_GET_CLASS ((obj), GST_TYPE_RTSP_MEDIA_FACTORY_REPLAY, GstRTSPMediaFactoryReplayClass))
+#define GST_RTSP_MEDIA_FACTORY_REPLAY(obj)              (G_TYPE_CHECK_INSTANCE_CAST ((obj), GST_TYPE_RTSP_MEDIA_FACTORY_REPLAY, GstRTSPMediaFactoryReplay))
+#define GST_RTSP_MEDIA_FACTORY_REPLAY_CLASS(klass)      (G_TYPE_CHECK_CLASS_CAST ((klass), GST_TYPE_RTSP_MEDIA_FACTORY_REPLAY, GstRTSPMediaFactoryReplayClass))
+#define GST_RTSP_MEDIA_FACTORY_REPLAY_CAST(obj)         ((GstRTSPMediaFactoryReplay*)(obj))
+#define GST_RTSP_MEDIA_FACTORY_REPLAY_CLASS_CAST(klass) ((GstRTSPMediaFactoryReplayClass*)(klass))
+
+typedef struct _GstRTSPMediaFactoryReplay GstRTSPMediaFactoryReplay;
+typedef struct _GstRTSPMediaFactoryReplayClass GstRTSPMediaFactoryReplayClass;
+
+/**
+ * GstRTSPMediaFactoryReplay:
+ *
+ * A media factory that loops over a uri.
+ *
+ * Since: 1.20
+ */
+struct _GstRTSPMediaFactoryReplay {
+  GstRTSPMediaFactoryURI   parent;
+
+  /*< private >*/
+  gpointer _gst_reserved[GST_PADDING];
+};
+
+/**
+ * GstRTSPMediaFactoryReplayClass:
+ *
+ * The #GstRTSPMediaFactoryReplay class structure.
+ *
+ * Since: 1.20
+ */
+struct _GstRTSPMediaFactoryReplayClass {
+  GstRTSPMediaFactoryURIClass  parent_class;
+
+  /*< private >*/
+  gpointer _gst_reserved[GST_PADDING];
+};
+
+GST_RTSP_SERVER_API
+GType                 gst_rtsp_media_factory_replay_get_type      (void);
+
+/* creating the factory */
+
+GST_RTSP_SERVER_API
+GstRTSPMediaFactoryReplay * gst_rtsp_media_factory_replay_new     (void);
+
+/* configuring the factory */
+
+GST_RTSP_SERVER_API
+void                  gst_rtsp_media_factory_replay_set_num_loops (GstRTSPMediaFactoryReplay *factory,
+                                                                   gint64 num_loops);
+
+GST_RTSP_SERVER_API
+gint64                gst_rtsp_media_factory_replay_get_num_loops (GstRTSPMediaFactoryReplay *factory);
+
+#ifdef G_DEFINE_AUTOPTR_CLEANUP_FUNC
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(GstRTSPMediaFactoryReplay, gst_object_unref)
+#endif
+
+G_END_DECLS
+
+#endif /* __GST_RTSP_MEDIA_FACTORY_REPLAY_H__ */
@@ -36,12 +36,19 @@
 #include <string.h>
 
 #include "rtsp-media-factory-uri.h"
+#include "rtsp-keyframe-index.h"
+#include "rtsp-rtp-cache.h"
+#include "rtsp-server-internal.h"
 
 struct _GstRTSPMediaFactoryURIPrivate
 {
   GMutex lock;
   gchar *uri;                   /* protected by lock */
   gboolean use_gstpay;
+  gchar *rtp_cache_dir;         /* protected by lock */
+  guint64 rtp_cache_size;
+  GstRTSPRtpCache *rtp_cache;
+  gint64 loops;                 /* protected by lock */
 
   GstCaps *raw_vcaps;
   GstCaps *raw_acaps;
@@ -52,12 +59,17 @@ struct _GstRTSPMediaFactoryURIPrivate
 
 #define DEFAULT_URI         NULL
 #define DEFAULT_USE_GSTPAY  FALSE
+#define DEFAULT_RTP_CACHE_DIR NULL
+#define DEFAULT_RTP_CACHE_SIZE (G_GUINT64_CONSTANT (1024) * 1024 * 1024)
+#define DEFAULT_LOOPS       1
 
 enum
 {
   PROP_0,
   PROP_URI,
   PROP_USE_GSTPAY,
+  PROP_RTP_CACHE_DIR,
+  PROP_RTP_CACHE_SIZE,
   PROP_LAST
 };
 
@@ -71,16 +83,50 @@ enum
 static GstStaticCaps raw_video_caps = GST_STATIC_CAPS (RAW_VIDEO_CAPS);
 static GstStaticCaps raw_audio_caps = GST_STATIC_CAPS (RAW_AUDIO_CAPS);
 
+/* loops over the uri with segment seeks, the demuxers and payloaders stay
+ * linked when the next pass starts */
+typedef struct
+{
+  GstElement *element;          /* the dynamic payloader, no ref */
+
+  GMutex lock;
+  gint64 loops;                 /* the passes left after this one */
+  GPtrArray *pads;              /* the sinkpads of the payloaders */
+  GArray *blocks;               /* of gulong, one for each pad */
+  guint n_done;
+  guint32 seqnum;               /* of our seeks */
+} LoopData;
+
 typedef struct
 {
   GstRTSPMediaFactoryURI *factory;
   guint pt;
+  LoopData *loop;               /* NULL when the uri plays once */
 } FactoryData;
 
+static void
+loop_data_free (LoopData * loop)
+{
+  guint i;
+
+  for (i = 0; i < loop->pads->len; i++) {
+    gulong id = g_array_index (loop->blocks, gulong, i);
+
+    if (id)
+      gst_pad_remove_probe (g_ptr_array_index (loop->pads, i), id);
+  }
+  g_ptr_array_unref (loop->pads);
+  g_array_unref (loop->blocks);
+  g_mutex_clear (&loop->lock);
+  g_slice_free (LoopData, loop);
+}
+
 static void
 free_data (FactoryData * data)
 {
   g_object_unref (data->factory);
+  if (data->loop)
+    loop_data_free (data->loop);
   g_free (data);
 }
 
@@ -97,6 +143,8 @@ static void gst_rtsp_media_factory_uri_finalize (GObject * obj);
 
 static GstElement *rtsp_media_factory_uri_create_element (GstRTSPMediaFactory *
     factory, const GstRTSPUrl * url);
+static void rtsp_media_factory_uri_configure (GstRTSPMediaFactory * factory,
+    GstRTSPMedia * media);
 
 G_DEFINE_TYPE_WITH_PRIVATE (GstRTSPMediaFactoryURI, gst_rtsp_media_factory_uri,
     GST_TYPE_RTSP_MEDIA_FACTORY);
@@ -133,8 +181,33 @@ gst_rtsp_media_factory_uri_class_init (GstRTSPMediaFactoryURIClass * klass)
       g_param_spec_boolean ("use-gstpay", "Use gstpay",
           "Use the gstpay payloader to avoid decoding", DEFAULT_USE_GSTPAY,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstRTSPMediaFactoryURI:rtp-cache-dir:
+   *
+   * The directory with the cached RTP packets of the uri, see
+   * gst_rtsp_media_factory_uri_set_rtp_cache().
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_RTP_CACHE_DIR,
+      g_param_spec_string ("rtp-cache-dir", "RTP Cache Directory",
+          "The directory that caches the RTP packets of the uri",
+          DEFAULT_RTP_CACHE_DIR, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstRTSPMediaFactoryURI:rtp-cache-size:
+   *
+   * The maximum size in bytes of the RTP cache directory.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_RTP_CACHE_SIZE,
+      g_param_spec_uint64 ("rtp-cache-size", "RTP Cache Size",
+          "The maximum size in bytes of the RTP cache directory", 0,
+          G_MAXUINT64, DEFAULT_RTP_CACHE_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
   mediafactory_class->create_element = rtsp_media_factory_uri_create_element;
+  mediafactory_class->configure = rtsp_media_factory_uri_configure;
 
   GST_DEBUG_CATEGORY_INIT (rtsp_media_factory_uri_debug, "rtspmediafactoryuri",
       0, "GstRTSPMediaFactoryUri");
@@ -195,6 +268,9 @@ gst_rtsp_media_factory_uri_init (GstRTSPMediaFactoryURI * factory)
 
   priv->uri = g_strdup (DEFAULT_URI);
   priv->use_gstpay = DEFAULT_USE_GSTPAY;
+  priv->rtp_cache_dir = g_strdup (DEFAULT_RTP_CACHE_DIR);
+  priv->rtp_cache_size = DEFAULT_RTP_CACHE_SIZE;
+  priv->loops = DEFAULT_LOOPS;
   g_mutex_init (&priv->lock);
 
   /* get the feature list using the filter */
@@ -221,6 +297,9 @@ gst_rtsp_media_factory_uri_finalize (GObject * obj)
   GST_DEBUG_OBJECT (factory, "finalize");
 
   g_free (priv->uri);
+  g_free (priv->rtp_cache_dir);
+  if (priv->rtp_cache)
+    gst_rtsp_rtp_cache_unref (priv->rtp_cache);
   gst_plugin_feature_list_free (priv->demuxers);
   gst_plugin_feature_list_free (priv->payloaders);
   gst_plugin_feature_list_free (priv->decoders);
@@ -245,6 +324,22 @@ gst_rtsp_media_factory_uri_get_property (GObject * object, guint propid,
     case PROP_USE_GSTPAY:
       g_value_set_boolean (value, priv->use_gstpay);
       break;
+    case PROP_RTP_CACHE_DIR:
+    {
+      gchar *dir;
+
+      gst_rtsp_media_factory_uri_get_rtp_cache (factory, &dir, NULL);
+      g_value_take_string (value, dir);
+      break;
+    }
+    case PROP_RTP_CACHE_SIZE:
+    {
+      guint64 size;
+
+      gst_rtsp_media_factory_uri_get_rtp_cache (factory, NULL, &size);
+      g_value_set_uint64 (value, size);
+      break;
+    }
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, propid, pspec);
   }
@@ -264,6 +359,25 @@ gst_rtsp_media_factory_uri_set_property (GObject * object, guint propid,
     case PROP_USE_GSTPAY:
       priv->use_gstpay = g_value_get_boolean (value);
       break;
+    case PROP_RTP_CACHE_DIR:
+    {
+      guint64 size;
+
+      gst_rtsp_media_factory_uri_get_rtp_cache (factory, NULL, &size);
+      gst_rtsp_media_factory_uri_set_rtp_cache (factory,
+          g_value_get_string (value), size);
+      break;
+    }
+    case PROP_RTP_CACHE_SIZE:
+    {
+      gchar *dir;
+
+      gst_rtsp_media_factory_uri_get_rtp_cache (factory, &dir, NULL);
+      gst_rtsp_media_factory_uri_set_rtp_cache (factory, dir,
+          g_value_get_uint64 (value));
+      g_free (dir);
+      break;
+    }
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, propid, pspec);
   }
@@ -335,6 +449,145 @@ gst_rtsp_media_factory_uri_get_uri (GstRTSPMediaFactoryURI * factory)
   return result;
 }
 
+/**
+ * gst_rtsp_media_factory_uri_set_rtp_cache:
+ * @factory: a #GstRTSPMediaFactoryURI
+ * @dir: (allow-none): a directory or %NULL to disable the cache
+ * @max_size: the maximum size in bytes of the files in @dir
+ *
+ * Cache the RTP packets of the uri in @dir. The packets are recorded the
+ * first time a media of @factory plays the uri from start to end without
+ * seeking. The media created afterwards replay the recorded packets with
+ * their own SSRC, sequence numbers and timestamps instead of demuxing and
+ * payloading the uri again. The packets are cached per uri and
+ * #GstRTSPMediaFactoryURI:use-gstpay setting. They are recorded again when
+ * the size or modification time of the uri changed.
+ *
+ * All the factories with the same @dir share the cache, the least recently
+ * played files are deleted when the cache grows larger than @max_size. The
+ * last @max_size that was set for @dir applies.
+ *
+ * Since: 1.20
+ */
+void
+gst_rtsp_media_factory_uri_set_rtp_cache (GstRTSPMediaFactoryURI * factory,
+    const gchar * dir, guint64 max_size)
+{
+  GstRTSPMediaFactoryURIPrivate *priv;
+  GstRTSPRtpCache *old;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA_FACTORY_URI (factory));
+
+  priv = factory->priv;
+
+  g_mutex_lock (&priv->lock);
+  g_free (priv->rtp_cache_dir);
+  priv->rtp_cache_dir = g_strdup (dir);
+  priv->rtp_cache_size = max_size;
+  old = priv->rtp_cache;
+  priv->rtp_cache = dir ? gst_rtsp_rtp_cache_get (dir) : NULL;
+  if (priv->rtp_cache)
+    gst_rtsp_rtp_cache_set_max_size (priv->rtp_cache, max_size);
+  g_mutex_unlock (&priv->lock);
+
+  if (old)
+    gst_rtsp_rtp_cache_unref (old);
+}
+
+/**
+ * gst_rtsp_media_factory_uri_get_rtp_cache:
+ * @factory: a #GstRTSPMediaFactoryURI
+ * @dir: (out) (allow-none) (transfer full) (nullable): the cache directory
+ * @max_size: (out) (allow-none): the maximum size of the cache
+ *
+ * Get the RTP cache of @factory.
+ *
+ * Since: 1.20
+ */
+void
+gst_rtsp_media_factory_uri_get_rtp_cache (GstRTSPMediaFactoryURI * factory,
+    gchar ** dir, guint64 * max_size)
+{
+  GstRTSPMediaFactoryURIPrivate *priv;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA_FACTORY_URI (factory));
+
+  priv = factory->priv;
+
+  g_mutex_lock (&priv->lock);
+  if (dir)
+    *dir = g_strdup (priv->rtp_cache_dir);
+  if (max_size)
+    *max_size = priv->rtp_cache_size;
+  g_mutex_unlock (&priv->lock);
+}
+
+/* Play the uri @loops times, -1 for an endless loop. The media of a
+ * factory that loops can't seek. */
+void
+gst_rtsp_media_factory_uri_set_loops (GstRTSPMediaFactoryURI * factory,
+    gint64 loops)
+{
+  GstRTSPMediaFactoryURIPrivate *priv;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA_FACTORY_URI (factory));
+  g_return_if_fail (loops != 0 && loops >= -1);
+
+  priv = factory->priv;
+
+  g_mutex_lock (&priv->lock);
+  priv->loops = loops;
+  g_mutex_unlock (&priv->lock);
+}
+
+gint64
+gst_rtsp_media_factory_uri_get_loops (GstRTSPMediaFactoryURI * factory)
+{
+  GstRTSPMediaFactoryURIPrivate *priv;
+  gint64 result;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA_FACTORY_URI (factory),
+      DEFAULT_LOOPS);
+
+  priv = factory->priv;
+
+  g_mutex_lock (&priv->lock);
+  result = priv->loops;
+  g_mutex_unlock (&priv->lock);
+
+  return result;
+}
+
+static GstRTSPRtpCache *
+get_rtp_cache (GstRTSPMediaFactoryURI * urifact)
+{
+  GstRTSPMediaFactoryURIPrivate *priv = urifact->priv;
+  GstRTSPRtpCache *cache = NULL;
+
+  g_mutex_lock (&priv->lock);
+  if (priv->rtp_cache_dir)
+    cache = gst_rtsp_rtp_cache_get (priv->rtp_cache_dir);
+  g_mutex_unlock (&priv->lock);
+
+  return cache;
+}
+
+/* The cached packets depend on the uri and on how it was payloaded, the
+ * first payload type is always 96 */
+static gchar *
+make_rtp_cache_key (GstRTSPMediaFactoryURI * urifact)
+{
+  GstRTSPMediaFactoryURIPrivate *priv = urifact->priv;
+  gchar *key = NULL;
+
+  g_mutex_lock (&priv->lock);
+  if (priv->uri)
+    key = g_strdup_printf ("%s use-gstpay=%d", priv->uri, priv->use_gstpay);
+  g_mutex_unlock (&priv->lock);
+
+  return key;
+}
+
 static GstElementFactory *
 find_payloader (GstRTSPMediaFactoryURI * urifact, GstCaps * caps)
 {
@@ -454,6 +707,139 @@ no_factory:
   }
 }
 
+/* called from a non-streaming thread */
+static void
+loop_seek (GstElement * element, LoopData * loop, gboolean initial)
+{
+  GstSeekFlags flags = GST_SEEK_FLAG_ACCURATE;
+  GstEvent *event;
+  GstPad *pad = NULL;
+  gboolean res = FALSE;
+  gint64 left;
+
+  if (initial)
+    flags |= GST_SEEK_FLAG_FLUSH;
+
+  g_mutex_lock (&loop->lock);
+  if (!initial && loop->loops > 0)
+    loop->loops--;
+  /* the last pass ends with EOS instead of segment-done */
+  left = loop->loops;
+  if (left != 0)
+    flags |= GST_SEEK_FLAG_SEGMENT;
+  event = gst_event_new_seek (1.0, GST_FORMAT_TIME, flags,
+      GST_SEEK_TYPE_SET, 0, GST_SEEK_TYPE_NONE, -1);
+  loop->seqnum = gst_event_get_seqnum (event);
+  loop->n_done = 0;
+  if (loop->pads->len > 0)
+    pad = gst_object_ref (g_ptr_array_index (loop->pads, 0));
+  g_mutex_unlock (&loop->lock);
+
+  GST_DEBUG_OBJECT (element, "start pass, %" G_GINT64_FORMAT " left", left);
+
+  /* upstream of the payloader, the demuxer seeks all the streams */
+  if (pad) {
+    res = gst_pad_push_event (pad, event);
+    gst_object_unref (pad);
+  } else {
+    gst_event_unref (event);
+  }
+
+  if (!res)
+    GST_WARNING_OBJECT (element, "can't seek to loop, playing once");
+}
+
+static void
+loop_start (GstElement * element, gpointer user_data)
+{
+  LoopData *loop = user_data;
+  guint i;
+
+  loop_seek (element, loop, TRUE);
+
+  /* the data before the first seek did not have a loop segment */
+  g_mutex_lock (&loop->lock);
+  for (i = 0; i < loop->pads->len; i++) {
+    gulong *id = &g_array_index (loop->blocks, gulong, i);
+
+    gst_pad_remove_probe (g_ptr_array_index (loop->pads, i), *id);
+    *id = 0;
+  }
+  g_mutex_unlock (&loop->lock);
+}
+
+static void
+loop_next (GstElement * element, gpointer user_data)
+{
+  loop_seek (element, user_data, FALSE);
+}
+
+static GstPadProbeReturn
+loop_block_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  GST_DEBUG_OBJECT (pad, "blocked until the loop starts");
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn
+loop_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  LoopData *loop = user_data;
+  GstPadProbeReturn ret = GST_PAD_PROBE_OK;
+
+  if (info->type & GST_PAD_PROBE_TYPE_QUERY_UPSTREAM) {
+    GstQuery *query = GST_PAD_PROBE_INFO_QUERY (info);
+
+    /* the position of a loop does not map to the uri */
+    if (GST_QUERY_TYPE (query) == GST_QUERY_SEEKING) {
+      gst_query_set_seeking (query, GST_FORMAT_TIME, FALSE, 0,
+          GST_CLOCK_TIME_NONE);
+      ret = GST_PAD_PROBE_HANDLED;
+    }
+  } else {
+    GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+
+    switch (GST_EVENT_TYPE (event)) {
+      case GST_EVENT_SEEK:
+        g_mutex_lock (&loop->lock);
+        if (gst_event_get_seqnum (event) != loop->seqnum) {
+          GST_DEBUG_OBJECT (pad, "drop seek of the media");
+          ret = GST_PAD_PROBE_DROP;
+        }
+        g_mutex_unlock (&loop->lock);
+        break;
+      case GST_EVENT_SEGMENT_DONE:
+        /* start the next pass when all the streams are done */
+        g_mutex_lock (&loop->lock);
+        if (++loop->n_done == loop->pads->len)
+          gst_element_call_async (loop->element, loop_next, loop, NULL);
+        g_mutex_unlock (&loop->lock);
+        ret = GST_PAD_PROBE_DROP;
+        break;
+      default:
+        break;
+    }
+  }
+
+  return ret;
+}
+
+static void
+loop_add_pad (LoopData * loop, GstPad * pad)
+{
+  gulong id;
+
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_EVENT_BOTH |
+      GST_PAD_PROBE_TYPE_QUERY_UPSTREAM, loop_probe, loop, NULL);
+  id = gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BLOCK_DOWNSTREAM,
+      loop_block_probe, NULL, NULL);
+
+  g_mutex_lock (&loop->lock);
+  g_ptr_array_add (loop->pads, gst_object_ref (pad));
+  g_array_append_val (loop->blocks, id);
+  g_mutex_unlock (&loop->lock);
+}
+
 static void
 pad_added_cb (GstElement * uribin, GstPad * pad, GstElement * element)
 {
@@ -541,6 +927,8 @@ pad_added_cb (GstElement * uribin, GstPad * pad, GstElement * element)
 
   /* link the pad to the sinkpad of the payloader */
   sinkpad = gst_element_get_static_pad (payloader, "sink");
+  if (data->loop)
+    loop_add_pad (data->loop, sinkpad);
   gst_pad_link (pad, sinkpad);
   gst_object_unref (sinkpad);
   gst_object_unref (pad);
@@ -586,8 +974,15 @@ no_payloader:
 static void
 no_more_pads_cb (GstElement * uribin, GstElement * element)
 {
+  FactoryData *data;
+
   GST_DEBUG ("no-more-pads");
   gst_element_no_more_pads (element);
+
+  /* flushing from the streaming thread would deadlock */
+  data = g_object_get_data (G_OBJECT (element), factory_key);
+  if (data->loop)
+    gst_element_call_async (element, loop_start, data->loop, NULL);
 }
 
 static GstElement *
@@ -597,16 +992,38 @@ rtsp_media_factory_uri_create_element (GstRTSPMediaFactory * factory,
   GstRTSPMediaFactoryURIPrivate *priv;
   GstElement *topbin, *element, *uribin;
   GstRTSPMediaFactoryURI *urifact;
+  GstRTSPRtpCache *cache;
   FactoryData *data;
+  gchar *key;
+  gint64 loops;
 
   urifact = GST_RTSP_MEDIA_FACTORY_URI_CAST (factory);
   priv = urifact->priv;
 
   GST_LOG ("creating element");
 
+  loops = gst_rtsp_media_factory_uri_get_loops (urifact);
+
   topbin = gst_bin_new ("GstRTSPMediaFactoryURI");
   g_assert (topbin != NULL);
 
+  /* replay the packets of an earlier play when they are cached */
+  if ((cache = get_rtp_cache (urifact))) {
+    gchar *source;
+
+    key = make_rtp_cache_key (urifact);
+    source = key ? gst_rtsp_rtp_cache_get_source_version (priv->uri) : NULL;
+    element = key ? gst_rtsp_rtp_cache_create_replay (cache, key, source,
+        loops) : NULL;
+    g_free (source);
+    g_free (key);
+    gst_rtsp_rtp_cache_unref (cache);
+    if (element) {
+      gst_bin_add (GST_BIN_CAST (topbin), element);
+      return topbin;
+    }
+  }
+
   /* our bin will dynamically expose payloaded pads */
   element = gst_bin_new ("dynpay0");
   g_assert (element != NULL);
@@ -621,6 +1038,14 @@ rtsp_media_factory_uri_create_element (GstRTSPMediaFactory * factory,
   data = g_new0 (FactoryData, 1);
   data->factory = g_object_ref (urifact);
   data->pt = 96;
+  if (loops != 1) {
+    data->loop = g_slice_new0 (LoopData);
+    data->loop->element = element;
+    g_mutex_init (&data->loop->lock);
+    data->loop->loops = loops < 0 ? -1 : loops - 1;
+    data->loop->pads = g_ptr_array_new_with_free_func (gst_object_unref);
+    data->loop->blocks = g_array_new (FALSE, FALSE, sizeof (gulong));
+  }
 
   g_object_set_data_full (G_OBJECT (element), factory_key,
       data, (GDestroyNotify) free_data);
@@ -644,3 +1069,41 @@ no_uridecodebin:
     return NULL;
   }
 }
+
+static void
+rtsp_media_factory_uri_configure (GstRTSPMediaFactory * factory,
+    GstRTSPMedia * media)
+{
+  GstRTSPMediaFactoryURI *urifact = GST_RTSP_MEDIA_FACTORY_URI (factory);
+  GstRTSPRtpCache *cache;
+  gchar *dir, *uri, *key;
+
+  GST_RTSP_MEDIA_FACTORY_CLASS
+      (gst_rtsp_media_factory_uri_parent_class)->configure (factory, media);
+
+  /* the index belongs to the file, whatever pipeline plays it */
+  dir = gst_rtsp_media_factory_get_keyframe_index_dir (factory);
+  uri = gst_rtsp_media_factory_uri_get_uri (urifact);
+  if (dir && uri) {
+    gchar *location;
+
+    location = gst_rtsp_keyframe_index_make_location (dir, uri);
+    gst_rtsp_media_set_keyframe_index_location (media, location);
+    g_free (location);
+  }
+
+  /* record the packets when they are not cached yet */
+  if ((key = make_rtp_cache_key (urifact))) {
+    if ((cache = get_rtp_cache (urifact))) {
+      gchar *source;
+
+      source = uri ? gst_rtsp_rtp_cache_get_source_version (uri) : NULL;
+      gst_rtsp_rtp_cache_record (cache, key, source, media);
+      gst_rtsp_rtp_cache_unref (cache);
+      g_free (source);
+    }
+    g_free (key);
+  }
+  g_free (uri);
+  g_free (dir);
+}
@@ -82,6 +82,16 @@ void                  gst_rtsp_media_factory_uri_set_uri  (GstRTSPMediaFactoryUR
 GST_RTSP_SERVER_API
 gchar *               gst_rtsp_media_factory_uri_get_uri  (GstRTSPMediaFactoryURI *factory);
 
+GST_RTSP_SERVER_API
+void                  gst_rtsp_media_factory_uri_set_rtp_cache (GstRTSPMediaFactoryURI *factory,
+                                                                const gchar *dir,
+                                                                guint64 max_size);
+
+GST_RTSP_SERVER_API
+void                  gst_rtsp_media_factory_uri_get_rtp_cache (GstRTSPMediaFactoryURI *factory,
+                                                                gchar **dir,
+                                                                guint64 *max_size);
+
 #ifdef G_DEFINE_AUTOPTR_CLEANUP_FUNC
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(GstRTSPMediaFactoryURI, gst_object_unref)
 #endif
@@ -43,6 +43,7 @@
 
 #include "rtsp-server-internal.h"
 #include "rtsp-media-factory.h"
+#include "rtsp-keyframe-index.h"
 
 #define GST_RTSP_MEDIA_FACTORY_GET_LOCK(f)       (&(GST_RTSP_MEDIA_FACTORY_CAST(f)->priv->lock))
 #define GST_RTSP_MEDIA_FACTORY_LOCK(f)           (g_mutex_lock(GST_RTSP_MEDIA_FACTORY_GET_LOCK(f)))
@@ -53,6 +54,8 @@ struct _GstRTSPMediaFactoryPrivate
   GMutex lock;                  /* protects everything but medias */
   GstRTSPPermissions *permissions;
   gchar *launch;
+  GstElement *launch_template;  /* parsed launch line, cloned for new media */
+  gboolean launch_template_failed;
   gboolean shared;
   GstRTSPSuspendMode suspend_mode;
   gboolean eos_shutdown;
@@ -63,6 +66,17 @@ struct _GstRTSPMediaFactoryPrivate
   GstRTSPAddressPool *pool;
   GstRTSPTransportMode transport_mode;
   gboolean stop_on_disconnect;
+  guint idle_timeout;
+  gboolean keep_live_sdp;
+  guint gop_cache_size;
+  gboolean force_keyunit_on_join;
+  GstClockTime force_keyunit_interval;
+  gboolean deactivate_unused_streams;
+  gboolean keyframe_trickmode;
+  GstClockTime timeshift_duration;
+  guint64 timeshift_size;
+  gchar *keyframe_index_dir;
+  GstClockTime merge_window;
   gchar *multicast_iface;
   guint max_mcast_ttl;
   gboolean bind_mcast_address;
@@ -73,7 +87,23 @@ struct _GstRTSPMediaFactoryPrivate
   gboolean do_retransmission;
 
   GMutex medias_lock;
+  GCond medias_cond;
   GHashTable *medias;           /* protected by medias_lock */
+  GHashTable *constructing;     /* protected by medias_lock */
+  GHashTable *live_sdps;        /* key -> LiveSDP, protected by medias_lock */
+  GHashTable *merging;          /* key -> GQueue of non-shared media that new
+                                 * clients can join, protected by medias_lock */
+
+  /* pre-warmed media for non-shared factories, protected by medias_lock */
+  guint prewarm_size;
+  gchar *prewarm_key;
+  GstRTSPUrl *prewarm_url;
+  GQueue prewarmed;
+  guint prewarm_pending;
+  guint64 prewarm_hits;
+  guint64 prewarm_misses;
+
+  GstRTSPThreadPool *thread_pool;
 
   GType media_gtype;
 
@@ -98,6 +128,18 @@ struct _GstRTSPMediaFactoryPrivate
 #define DEFAULT_DO_RETRANSMISSION FALSE
 #define DEFAULT_DSCP_QOS        (-1)
 #define DEFAULT_ENABLE_RTCP     TRUE
+#define DEFAULT_PREWARM_SIZE    0
+#define DEFAULT_IDLE_TIMEOUT    0
+#define DEFAULT_KEEP_LIVE_SDP   FALSE
+#define DEFAULT_GOP_CACHE_SIZE  0
+#define DEFAULT_FORCE_KEYUNIT_ON_JOIN FALSE
+#define DEFAULT_FORCE_KEYUNIT_INTERVAL GST_SECOND
+#define DEFAULT_DEACTIVATE_UNUSED_STREAMS FALSE
+#define DEFAULT_KEYFRAME_TRICKMODE FALSE
+#define DEFAULT_TIMESHIFT_DURATION 0
+#define DEFAULT_TIMESHIFT_SIZE  (64 * 1024 * 1024)
+#define DEFAULT_KEYFRAME_INDEX_DIR NULL
+#define DEFAULT_MERGE_WINDOW    0
 
 enum
 {
@@ -117,6 +159,18 @@ enum
   PROP_BIND_MCAST_ADDRESS,
   PROP_DSCP_QOS,
   PROP_ENABLE_RTCP,
+  PROP_PREWARM_SIZE,
+  PROP_IDLE_TIMEOUT,
+  PROP_KEEP_LIVE_SDP,
+  PROP_GOP_CACHE_SIZE,
+  PROP_FORCE_KEYUNIT_ON_JOIN,
+  PROP_FORCE_KEYUNIT_INTERVAL,
+  PROP_DEACTIVATE_UNUSED_STREAMS,
+  PROP_KEYFRAME_TRICKMODE,
+  PROP_TIMESHIFT_DURATION,
+  PROP_TIMESHIFT_SIZE,
+  PROP_KEYFRAME_INDEX_DIR,
+  PROP_MERGE_WINDOW,
   PROP_LAST
 };
 
@@ -149,6 +203,19 @@ static void default_configure (GstRTSPMediaFactory * factory,
 static GstElement *default_create_pipeline (GstRTSPMediaFactory * factory,
     GstRTSPMedia * media);
 
+static void prewarmed_free (GstRTSPMedia * media);
+
+/* the last SDP of a live media, to describe the next media for its key */
+typedef struct
+{
+  GstSDPMessage *sdp;
+  gboolean is_ipv6;
+  gchar *server_ip;
+} LiveSDP;
+
+static void live_sdp_free (LiveSDP * live);
+static void merging_free (GQueue * medias);
+
 G_DEFINE_TYPE_WITH_PRIVATE (GstRTSPMediaFactory, gst_rtsp_media_factory,
     G_TYPE_OBJECT);
 
@@ -268,6 +335,176 @@ gst_rtsp_media_factory_class_init (GstRTSPMediaFactoryClass * klass)
           "The IP DSCP field to use", -1, 63,
           DEFAULT_DSCP_QOS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstRTSPMediaFactory:prewarm-size:
+   *
+   * The number of prepared media that a non-shared factory keeps ready to
+   * hand out. The media are constructed and prepared in the background for
+   * the url of the last request.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_PREWARM_SIZE,
+      g_param_spec_uint ("prewarm-size", "Prewarm Size",
+          "The number of prepared media to keep ready for non-shared media",
+          0, G_MAXUINT, DEFAULT_PREWARM_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstRTSPMediaFactory:idle-timeout:
+   *
+   * The number of seconds shared media stay prepared after the last client
+   * left, 0 unprepares them immediately.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_IDLE_TIMEOUT,
+      g_param_spec_uint ("idle-timeout", "Idle Timeout",
+          "Seconds to keep a shared media prepared after its last client left "
+          "(0 = unprepare immediately)", 0, G_MAXUINT, DEFAULT_IDLE_TIMEOUT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstRTSPMediaFactory:keep-live-sdp:
+   *
+   * Keep the SDP of live shared media after they are unprepared and describe
+   * new media for the same url from it while they prepare.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_KEEP_LIVE_SDP,
+      g_param_spec_boolean ("keep-live-sdp", "Keep Live SDP",
+          "Describe new live shared media from the SDP of the previous one",
+          DEFAULT_KEEP_LIVE_SDP, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstRTSPMediaFactory:gop-cache-size:
+   *
+   * The maximum number of bytes of RTP packets each stream keeps since its
+   * last keyframe to send to new clients, 0 disables the cache.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_GOP_CACHE_SIZE,
+      g_param_spec_uint ("gop-cache-size", "GOP Cache Size",
+          "Bytes of the last GOP of each stream to send to new clients "
+          "(0 = disabled)", 0, G_MAXUINT, DEFAULT_GOP_CACHE_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstRTSPMediaFactory:force-keyunit-on-join:
+   *
+   * Request a keyframe from the encoders of shared live media when a client
+   * starts playing.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_FORCE_KEYUNIT_ON_JOIN,
+      g_param_spec_boolean ("force-keyunit-on-join", "Force Keyunit On Join",
+          "Request a keyframe when a client joins a shared live media",
+          DEFAULT_FORCE_KEYUNIT_ON_JOIN,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstRTSPMediaFactory:force-keyunit-interval:
+   *
+   * The minimum time in nanoseconds between two keyframes requested for the
+   * same stream when clients join.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_FORCE_KEYUNIT_INTERVAL,
+      g_param_spec_uint64 ("force-keyunit-interval", "Force Keyunit Interval",
+          "Minimum time in nanoseconds between requested keyframes", 0,
+          G_MAXUINT64, DEFAULT_FORCE_KEYUNIT_INTERVAL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstRTSPMediaFactory:deactivate-unused-streams:
+   *
+   * Stop feeding the encoders of the streams of live media that no client
+   * receives.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_DEACTIVATE_UNUSED_STREAMS,
+      g_param_spec_boolean ("deactivate-unused-streams",
+          "Deactivate Unused Streams",
+          "Stop encoding the streams of live media that no client receives",
+          DEFAULT_DEACTIVATE_UNUSED_STREAMS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstRTSPMediaFactory:keyframe-trickmode:
+   *
+   * Send only the keyframes of the streams of the media during trick play.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_KEYFRAME_TRICKMODE,
+      g_param_spec_boolean ("keyframe-trickmode", "Keyframe Trickmode",
+          "Send only the keyframes during trick play",
+          DEFAULT_KEYFRAME_TRICKMODE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstRTSPMediaFactory:timeshift-duration:
+   *
+   * How long in nanoseconds the streams of live media keep their RTP
+   * packets for clients that play from the past, 0 disables time-shifting.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_TIMESHIFT_DURATION,
+      g_param_spec_uint64 ("timeshift-duration", "Time-shift Duration",
+          "Nanoseconds of packets kept for clients that play from the past "
+          "(0 = disabled)", 0, G_MAXUINT64, DEFAULT_TIMESHIFT_DURATION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstRTSPMediaFactory:timeshift-size:
+   *
+   * The maximum number of bytes of RTP packets each stream keeps for
+   * clients that play from the past.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_TIMESHIFT_SIZE,
+      g_param_spec_uint64 ("timeshift-size", "Time-shift Size",
+          "Maximum bytes of packets kept by each stream for time-shifting",
+          0, G_MAXUINT64, DEFAULT_TIMESHIFT_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstRTSPMediaFactory:keyframe-index-dir:
+   *
+   * The directory with the keyframe indexes of the VOD media created by the
+   * factory, see gst_rtsp_media_factory_set_keyframe_index_dir().
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_KEYFRAME_INDEX_DIR,
+      g_param_spec_string ("keyframe-index-dir", "Keyframe Index Directory",
+          "The directory with the keyframe indexes used for seeking",
+          DEFAULT_KEYFRAME_INDEX_DIR,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstRTSPMediaFactory:merge-window:
+   *
+   * Hand out the VOD media of a non-shared factory to new clients while its
+   * position is within this window of the start, see
+   * gst_rtsp_media_factory_set_merge_window().
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_MERGE_WINDOW,
+      g_param_spec_uint64 ("merge-window", "Merge Window",
+          "Nanoseconds from the start within which new clients join the "
+          "playback of a VOD media (0 = disabled)", 0, G_MAXUINT64,
+          DEFAULT_MERGE_WINDOW, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gst_rtsp_media_factory_signals[SIGNAL_MEDIA_CONSTRUCTED] =
       g_signal_new ("media-constructed", G_TYPE_FROM_CLASS (klass),
       G_SIGNAL_RUN_LAST, G_STRUCT_OFFSET (GstRTSPMediaFactoryClass,
@@ -316,8 +553,28 @@ gst_rtsp_media_factory_init (GstRTSPMediaFactory * factory)
 
   g_mutex_init (&priv->lock);
   g_mutex_init (&priv->medias_lock);
+  g_cond_init (&priv->medias_cond);
   priv->medias = g_hash_table_new_full (g_str_hash, g_str_equal,
       g_free, g_object_unref);
+  priv->constructing = g_hash_table_new_full (g_str_hash, g_str_equal,
+      g_free, NULL);
+  priv->live_sdps = g_hash_table_new_full (g_str_hash, g_str_equal,
+      g_free, (GDestroyNotify) live_sdp_free);
+  priv->merging = g_hash_table_new_full (g_str_hash, g_str_equal,
+      g_free, (GDestroyNotify) merging_free);
+  priv->prewarm_size = DEFAULT_PREWARM_SIZE;
+  priv->idle_timeout = DEFAULT_IDLE_TIMEOUT;
+  priv->keep_live_sdp = DEFAULT_KEEP_LIVE_SDP;
+  priv->gop_cache_size = DEFAULT_GOP_CACHE_SIZE;
+  priv->force_keyunit_on_join = DEFAULT_FORCE_KEYUNIT_ON_JOIN;
+  priv->force_keyunit_interval = DEFAULT_FORCE_KEYUNIT_INTERVAL;
+  priv->deactivate_unused_streams = DEFAULT_DEACTIVATE_UNUSED_STREAMS;
+  priv->keyframe_trickmode = DEFAULT_KEYFRAME_TRICKMODE;
+  priv->timeshift_duration = DEFAULT_TIMESHIFT_DURATION;
+  priv->timeshift_size = DEFAULT_TIMESHIFT_SIZE;
+  priv->keyframe_index_dir = g_strdup (DEFAULT_KEYFRAME_INDEX_DIR);
+  priv->merge_window = DEFAULT_MERGE_WINDOW;
+  g_queue_init (&priv->prewarmed);
   priv->media_gtype = GST_TYPE_RTSP_MEDIA;
 }
 
@@ -331,13 +588,27 @@ gst_rtsp_media_factory_finalize (GObject * obj)
     gst_object_unref (priv->clock);
   if (priv->permissions)
     gst_rtsp_permissions_unref (priv->permissions);
+  g_queue_foreach (&priv->prewarmed, (GFunc) prewarmed_free, NULL);
+  g_queue_clear (&priv->prewarmed);
+  g_free (priv->prewarm_key);
+  if (priv->prewarm_url)
+    gst_rtsp_url_free (priv->prewarm_url);
+  if (priv->thread_pool)
+    g_object_unref (priv->thread_pool);
   g_hash_table_unref (priv->medias);
+  g_hash_table_unref (priv->constructing);
+  g_hash_table_unref (priv->live_sdps);
+  g_hash_table_unref (priv->merging);
+  g_cond_clear (&priv->medias_cond);
   g_mutex_clear (&priv->medias_lock);
   g_free (priv->launch);
+  if (priv->launch_template)
+    gst_object_unref (priv->launch_template);
   g_mutex_clear (&priv->lock);
   if (priv->pool)
     g_object_unref (priv->pool);
   g_free (priv->multicast_iface);
+  g_free (priv->keyframe_index_dir);
 
   G_OBJECT_CLASS (gst_rtsp_media_factory_parent_class)->finalize (obj);
 }
@@ -402,6 +673,62 @@ gst_rtsp_media_factory_get_property (GObject * object, guint propid,
       g_value_set_boolean (value,
           gst_rtsp_media_factory_is_enable_rtcp (factory));
       break;
+    case PROP_PREWARM_SIZE:
+      g_value_set_uint (value,
+          gst_rtsp_media_factory_get_prewarm_size (factory));
+      break;
+    case PROP_IDLE_TIMEOUT:
+      g_value_set_uint (value,
+          gst_rtsp_media_factory_get_idle_timeout (factory));
+      break;
+    case PROP_KEEP_LIVE_SDP:
+      g_value_set_boolean (value,
+          gst_rtsp_media_factory_is_keep_live_sdp (factory));
+      break;
+    case PROP_GOP_CACHE_SIZE:
+      g_value_set_uint (value,
+          gst_rtsp_media_factory_get_gop_cache_size (factory));
+      break;
+    case PROP_FORCE_KEYUNIT_ON_JOIN:
+      g_value_set_boolean (value,
+          gst_rtsp_media_factory_is_force_keyunit_on_join (factory));
+      break;
+    case PROP_FORCE_KEYUNIT_INTERVAL:
+      g_value_set_uint64 (value,
+          gst_rtsp_media_factory_get_force_keyunit_interval (factory));
+      break;
+    case PROP_DEACTIVATE_UNUSED_STREAMS:
+      g_value_set_boolean (value,
+          gst_rtsp_media_factory_is_deactivate_unused_streams (factory));
+      break;
+    case PROP_KEYFRAME_TRICKMODE:
+      g_value_set_boolean (value,
+          gst_rtsp_media_factory_is_keyframe_trickmode (factory));
+      break;
+    case PROP_TIMESHIFT_DURATION:
+    {
+      GstClockTime duration;
+
+      gst_rtsp_media_factory_get_timeshift (factory, &duration, NULL);
+      g_value_set_uint64 (value, duration);
+      break;
+    }
+    case PROP_TIMESHIFT_SIZE:
+    {
+      guint64 size;
+
+      gst_rtsp_media_factory_get_timeshift (factory, NULL, &size);
+      g_value_set_uint64 (value, size);
+      break;
+    }
+    case PROP_KEYFRAME_INDEX_DIR:
+      g_value_take_string (value,
+          gst_rtsp_media_factory_get_keyframe_index_dir (factory));
+      break;
+    case PROP_MERGE_WINDOW:
+      g_value_set_uint64 (value,
+          gst_rtsp_media_factory_get_merge_window (factory));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, propid, pspec);
   }
@@ -467,6 +794,64 @@ gst_rtsp_media_factory_set_property (GObject * object, guint propid,
       gst_rtsp_media_factory_set_enable_rtcp (factory,
           g_value_get_boolean (value));
       break;
+    case PROP_PREWARM_SIZE:
+      gst_rtsp_media_factory_set_prewarm_size (factory,
+          g_value_get_uint (value));
+      break;
+    case PROP_IDLE_TIMEOUT:
+      gst_rtsp_media_factory_set_idle_timeout (factory,
+          g_value_get_uint (value));
+      break;
+    case PROP_KEEP_LIVE_SDP:
+      gst_rtsp_media_factory_set_keep_live_sdp (factory,
+          g_value_get_boolean (value));
+      break;
+    case PROP_GOP_CACHE_SIZE:
+      gst_rtsp_media_factory_set_gop_cache_size (factory,
+          g_value_get_uint (value));
+      break;
+    case PROP_FORCE_KEYUNIT_ON_JOIN:
+      gst_rtsp_media_factory_set_force_keyunit_on_join (factory,
+          g_value_get_boolean (value));
+      break;
+    case PROP_FORCE_KEYUNIT_INTERVAL:
+      gst_rtsp_media_factory_set_force_keyunit_interval (factory,
+          g_value_get_uint64 (value));
+      break;
+    case PROP_DEACTIVATE_UNUSED_STREAMS:
+      gst_rtsp_media_factory_set_deactivate_unused_streams (factory,
+          g_value_get_boolean (value));
+      break;
+    case PROP_KEYFRAME_TRICKMODE:
+      gst_rtsp_media_factory_set_keyframe_trickmode (factory,
+          g_value_get_boolean (value));
+      break;
+    case PROP_TIMESHIFT_DURATION:
+    {
+      guint64 size;
+
+      gst_rtsp_media_factory_get_timeshift (factory, NULL, &size);
+      gst_rtsp_media_factory_set_timeshift (factory,
+          g_value_get_uint64 (value), size);
+      break;
+    }
+    case PROP_TIMESHIFT_SIZE:
+    {
+      GstClockTime duration;
+
+      gst_rtsp_media_factory_get_timeshift (factory, &duration, NULL);
+      gst_rtsp_media_factory_set_timeshift (factory, duration,
+          g_value_get_uint64 (value));
+      break;
+    }
+    case PROP_KEYFRAME_INDEX_DIR:
+      gst_rtsp_media_factory_set_keyframe_index_dir (factory,
+          g_value_get_string (value));
+      break;
+    case PROP_MERGE_WINDOW:
+      gst_rtsp_media_factory_set_merge_window (factory,
+          g_value_get_uint64 (value));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, propid, pspec);
   }
@@ -632,6 +1017,10 @@ gst_rtsp_media_factory_set_launch (GstRTSPMediaFactory * factory,
   GST_RTSP_MEDIA_FACTORY_LOCK (factory);
   g_free (priv->launch);
   priv->launch = g_strdup (launch);
+  if (priv->launch_template)
+    gst_object_unref (priv->launch_template);
+  priv->launch_template = NULL;
+  priv->launch_template_failed = FALSE;
   GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
 }
 
@@ -1174,15 +1563,23 @@ gst_rtsp_media_factory_is_stop_on_disonnect (GstRTSPMediaFactory * factory)
 }
 
 /**
- * gst_rtsp_media_factory_set_retransmission_time:
+ * gst_rtsp_media_factory_set_idle_timeout:
  * @factory: a #GstRTSPMediaFactory
- * @time: a #GstClockTime
+ * @timeout: the timeout in seconds
  *
- * Configure the time to store for possible retransmission
+ * Keep shared media of @factory prepared for @timeout seconds after the last
+ * client left, so that a new client does not have to wait for the pipeline
+ * to preroll. After @timeout, the media is unprepared and releases its
+ * sockets but it keeps its SDP, the next DESCRIBE is answered from it while
+ * the media prepares again.
+ *
+ * Shared media of @factory are made reusable when @timeout is not 0.
+ *
+ * Since: 1.20
  */
 void
-gst_rtsp_media_factory_set_retransmission_time (GstRTSPMediaFactory * factory,
-    GstClockTime time)
+gst_rtsp_media_factory_set_idle_timeout (GstRTSPMediaFactory * factory,
+    guint timeout)
 {
   GstRTSPMediaFactoryPrivate *priv;
 
@@ -1190,49 +1587,56 @@ gst_rtsp_media_factory_set_retransmission_time (GstRTSPMediaFactory * factory,
 
   priv = factory->priv;
 
-  GST_DEBUG_OBJECT (factory, "retransmission time %" G_GUINT64_FORMAT, time);
-
   GST_RTSP_MEDIA_FACTORY_LOCK (factory);
-  priv->rtx_time = time;
+  priv->idle_timeout = timeout;
   GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
 }
 
 /**
- * gst_rtsp_media_factory_get_retransmission_time:
+ * gst_rtsp_media_factory_get_idle_timeout:
  * @factory: a #GstRTSPMediaFactory
  *
- * Get the time that is stored for retransmission purposes
+ * Get the number of seconds shared media of @factory stay prepared after the
+ * last client left.
  *
- * Returns: a #GstClockTime
+ * Returns: the idle timeout in seconds.
+ *
+ * Since: 1.20
  */
-GstClockTime
-gst_rtsp_media_factory_get_retransmission_time (GstRTSPMediaFactory * factory)
+guint
+gst_rtsp_media_factory_get_idle_timeout (GstRTSPMediaFactory * factory)
 {
   GstRTSPMediaFactoryPrivate *priv;
-  GstClockTime res;
+  guint result;
 
   g_return_val_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory), 0);
 
   priv = factory->priv;
 
   GST_RTSP_MEDIA_FACTORY_LOCK (factory);
-  res = priv->rtx_time;
+  result = priv->idle_timeout;
   GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
 
-  return res;
+  return result;
 }
 
 /**
- * gst_rtsp_media_factory_set_do_retransmission:
+ * gst_rtsp_media_factory_set_keep_live_sdp:
+ * @factory: a #GstRTSPMediaFactory
+ * @keep: the new value
  *
- * Set whether retransmission requests will be sent for
- * receiving media
+ * Keep the SDP of live shared media of @factory after they are unprepared.
+ * The next DESCRIBE for the same url is answered from it right away while
+ * a new media prepares, instead of waiting for the live source to produce
+ * caps. When the prepared media has other streams or payload types than
+ * the SDP, the SETUP requests that follow the DESCRIBE fail with
+ * #GST_RTSP_STS_PRECONDITION_FAILED and the client has to DESCRIBE again.
  *
- * Since: 1.16
+ * Since: 1.20
  */
 void
-gst_rtsp_media_factory_set_do_retransmission (GstRTSPMediaFactory * factory,
-    gboolean do_retransmission)
+gst_rtsp_media_factory_set_keep_live_sdp (GstRTSPMediaFactory * factory,
+    gboolean keep)
 {
   GstRTSPMediaFactoryPrivate *priv;
 
@@ -1240,47 +1644,59 @@ gst_rtsp_media_factory_set_do_retransmission (GstRTSPMediaFactory * factory,
 
   priv = factory->priv;
 
-  GST_DEBUG_OBJECT (factory, "Do retransmission %d", do_retransmission);
-
   GST_RTSP_MEDIA_FACTORY_LOCK (factory);
-  priv->do_retransmission = do_retransmission;
+  priv->keep_live_sdp = keep;
   GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
+
+  if (!keep) {
+    g_mutex_lock (&priv->medias_lock);
+    g_hash_table_remove_all (priv->live_sdps);
+    g_mutex_unlock (&priv->medias_lock);
+  }
 }
 
 /**
- * gst_rtsp_media_factory_get_do_retransmission:
+ * gst_rtsp_media_factory_is_keep_live_sdp:
+ * @factory: a #GstRTSPMediaFactory
  *
- * Returns: Whether retransmission requests will be sent for receiving media
+ * Check if @factory keeps the SDP of its live shared media.
  *
- * Since: 1.16
+ * Returns: %TRUE if the SDP of live shared media is kept.
+ *
+ * Since: 1.20
  */
 gboolean
-gst_rtsp_media_factory_get_do_retransmission (GstRTSPMediaFactory * factory)
+gst_rtsp_media_factory_is_keep_live_sdp (GstRTSPMediaFactory * factory)
 {
   GstRTSPMediaFactoryPrivate *priv;
-  gboolean res;
+  gboolean result;
 
-  g_return_val_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory), 0);
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory), FALSE);
 
   priv = factory->priv;
 
   GST_RTSP_MEDIA_FACTORY_LOCK (factory);
-  res = priv->do_retransmission;
+  result = priv->keep_live_sdp;
   GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
 
-  return res;
+  return result;
 }
 
 /**
- * gst_rtsp_media_factory_set_latency:
+ * gst_rtsp_media_factory_set_gop_cache_size:
  * @factory: a #GstRTSPMediaFactory
- * @latency: latency in milliseconds
+ * @size: the maximum size in bytes, 0 disables the cache
  *
- * Configure the latency used for receiving media
+ * Make the streams of the media created by @factory keep the RTP packets
+ * since their last keyframe, up to @size bytes each, and send them to new
+ * clients before the live packets. Clients of a shared live media can then
+ * start decoding right away instead of waiting for the next keyframe.
+ *
+ * Since: 1.20
  */
 void
-gst_rtsp_media_factory_set_latency (GstRTSPMediaFactory * factory,
-    guint latency)
+gst_rtsp_media_factory_set_gop_cache_size (GstRTSPMediaFactory * factory,
+    guint size)
 {
   GstRTSPMediaFactoryPrivate *priv;
 
@@ -1288,76 +1704,1020 @@ gst_rtsp_media_factory_set_latency (GstRTSPMediaFactory * factory,
 
   priv = factory->priv;
 
-  GST_DEBUG_OBJECT (factory, "latency %ums", latency);
-
   GST_RTSP_MEDIA_FACTORY_LOCK (factory);
-  priv->latency = latency;
+  priv->gop_cache_size = size;
   GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
 }
 
 /**
- * gst_rtsp_media_factory_get_latency:
+ * gst_rtsp_media_factory_get_gop_cache_size:
  * @factory: a #GstRTSPMediaFactory
  *
- * Get the latency that is used for receiving media
+ * Get the maximum size of the GOP cache of the streams of the media created
+ * by @factory.
  *
- * Returns: latency in milliseconds
+ * Returns: the size of the GOP cache in bytes, 0 when it is disabled.
+ *
+ * Since: 1.20
  */
 guint
-gst_rtsp_media_factory_get_latency (GstRTSPMediaFactory * factory)
+gst_rtsp_media_factory_get_gop_cache_size (GstRTSPMediaFactory * factory)
 {
   GstRTSPMediaFactoryPrivate *priv;
-  guint res;
+  guint result;
 
   g_return_val_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory), 0);
 
   priv = factory->priv;
 
   GST_RTSP_MEDIA_FACTORY_LOCK (factory);
-  res = priv->latency;
+  result = priv->gop_cache_size;
   GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
 
-  return res;
+  return result;
 }
 
-static gboolean
-compare_media (gpointer key, GstRTSPMedia * media1, GstRTSPMedia * media2)
+/**
+ * gst_rtsp_media_factory_set_force_keyunit_on_join:
+ * @factory: a #GstRTSPMediaFactory
+ * @force: the new value
+ *
+ * Make the shared live media created by @factory request a keyframe from
+ * their encoders when a client starts playing. See
+ * gst_rtsp_media_set_force_keyunit_on_join().
+ *
+ * Since: 1.20
+ */
+void
+gst_rtsp_media_factory_set_force_keyunit_on_join (GstRTSPMediaFactory *
+    factory, gboolean force)
 {
-  return (media1 == media2);
+  GstRTSPMediaFactoryPrivate *priv;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory));
+
+  priv = factory->priv;
+
+  GST_RTSP_MEDIA_FACTORY_LOCK (factory);
+  priv->force_keyunit_on_join = force;
+  GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
 }
 
-static void
-media_unprepared (GstRTSPMedia * media, GWeakRef * ref)
+/**
+ * gst_rtsp_media_factory_is_force_keyunit_on_join:
+ * @factory: a #GstRTSPMediaFactory
+ *
+ * Check if the media created by @factory request a keyframe when a client
+ * joins.
+ *
+ * Returns: %TRUE if the media request keyframes for new clients.
+ *
+ * Since: 1.20
+ */
+gboolean
+gst_rtsp_media_factory_is_force_keyunit_on_join (GstRTSPMediaFactory *
+    factory)
 {
-  GstRTSPMediaFactory *factory = g_weak_ref_get (ref);
   GstRTSPMediaFactoryPrivate *priv;
+  gboolean result;
 
-  if (!factory)
-    return;
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory), FALSE);
 
   priv = factory->priv;
 
-  g_mutex_lock (&priv->medias_lock);
-  g_hash_table_foreach_remove (priv->medias, (GHRFunc) compare_media, media);
-  g_mutex_unlock (&priv->medias_lock);
+  GST_RTSP_MEDIA_FACTORY_LOCK (factory);
+  result = priv->force_keyunit_on_join;
+  GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
 
-  g_object_unref (factory);
+  return result;
 }
 
-static GWeakRef *
-weak_ref_new (gpointer obj)
+/**
+ * gst_rtsp_media_factory_set_force_keyunit_interval:
+ * @factory: a #GstRTSPMediaFactory
+ * @interval: the minimum time between keyframe requests
+ *
+ * Set the minimum time between two keyframes that the media created by
+ * @factory request for the same stream when clients join.
+ *
+ * Since: 1.20
+ */
+void
+gst_rtsp_media_factory_set_force_keyunit_interval (GstRTSPMediaFactory *
+    factory, GstClockTime interval)
 {
-  GWeakRef *ref = g_slice_new (GWeakRef);
+  GstRTSPMediaFactoryPrivate *priv;
 
-  g_weak_ref_init (ref, obj);
+  g_return_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory));
+  g_return_if_fail (GST_CLOCK_TIME_IS_VALID (interval));
+
+  priv = factory->priv;
+
+  GST_RTSP_MEDIA_FACTORY_LOCK (factory);
+  priv->force_keyunit_interval = interval;
+  GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
+}
+
+/**
+ * gst_rtsp_media_factory_get_force_keyunit_interval:
+ * @factory: a #GstRTSPMediaFactory
+ *
+ * Get the minimum time between two keyframes that the media created by
+ * @factory request for the same stream when clients join.
+ *
+ * Returns: the minimum time between keyframe requests.
+ *
+ * Since: 1.20
+ */
+GstClockTime
+gst_rtsp_media_factory_get_force_keyunit_interval (GstRTSPMediaFactory *
+    factory)
+{
+  GstRTSPMediaFactoryPrivate *priv;
+  GstClockTime result;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory),
+      GST_CLOCK_TIME_NONE);
+
+  priv = factory->priv;
+
+  GST_RTSP_MEDIA_FACTORY_LOCK (factory);
+  result = priv->force_keyunit_interval;
+  GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
+
+  return result;
+}
+
+/**
+ * gst_rtsp_media_factory_set_deactivate_unused_streams:
+ * @factory: a #GstRTSPMediaFactory
+ * @deactivate: the new value
+ *
+ * Make the live media created by @factory stop feeding the encoders of the
+ * streams that no client receives. See
+ * gst_rtsp_media_set_deactivate_unused_streams().
+ *
+ * Since: 1.20
+ */
+void
+gst_rtsp_media_factory_set_deactivate_unused_streams (GstRTSPMediaFactory *
+    factory, gboolean deactivate)
+{
+  GstRTSPMediaFactoryPrivate *priv;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory));
+
+  priv = factory->priv;
+
+  GST_RTSP_MEDIA_FACTORY_LOCK (factory);
+  priv->deactivate_unused_streams = deactivate;
+  GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
+}
+
+/**
+ * gst_rtsp_media_factory_is_deactivate_unused_streams:
+ * @factory: a #GstRTSPMediaFactory
+ *
+ * Check if the live media created by @factory stop encoding the streams
+ * that no client receives.
+ *
+ * Returns: %TRUE if unused streams are deactivated.
+ *
+ * Since: 1.20
+ */
+gboolean
+gst_rtsp_media_factory_is_deactivate_unused_streams (GstRTSPMediaFactory *
+    factory)
+{
+  GstRTSPMediaFactoryPrivate *priv;
+  gboolean result;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory), FALSE);
+
+  priv = factory->priv;
+
+  GST_RTSP_MEDIA_FACTORY_LOCK (factory);
+  result = priv->deactivate_unused_streams;
+  GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
+
+  return result;
+}
+
+/**
+ * gst_rtsp_media_factory_set_keyframe_trickmode:
+ * @factory: a #GstRTSPMediaFactory
+ * @keyframes: the new value
+ *
+ * Make the media created by @factory send only the keyframes of their
+ * streams during trick play. See gst_rtsp_media_set_keyframe_trickmode().
+ *
+ * Since: 1.20
+ */
+void
+gst_rtsp_media_factory_set_keyframe_trickmode (GstRTSPMediaFactory * factory,
+    gboolean keyframes)
+{
+  GstRTSPMediaFactoryPrivate *priv;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory));
+
+  priv = factory->priv;
+
+  GST_RTSP_MEDIA_FACTORY_LOCK (factory);
+  priv->keyframe_trickmode = keyframes;
+  GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
+}
+
+/**
+ * gst_rtsp_media_factory_is_keyframe_trickmode:
+ * @factory: a #GstRTSPMediaFactory
+ *
+ * Check if the media created by @factory send only the keyframes of their
+ * streams during trick play.
+ *
+ * Returns: %TRUE if the other frames are dropped during trick play.
+ *
+ * Since: 1.20
+ */
+gboolean
+gst_rtsp_media_factory_is_keyframe_trickmode (GstRTSPMediaFactory * factory)
+{
+  GstRTSPMediaFactoryPrivate *priv;
+  gboolean result;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory), FALSE);
+
+  priv = factory->priv;
+
+  GST_RTSP_MEDIA_FACTORY_LOCK (factory);
+  result = priv->keyframe_trickmode;
+  GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
+
+  return result;
+}
+
+/**
+ * gst_rtsp_media_factory_set_timeshift:
+ * @factory: a #GstRTSPMediaFactory
+ * @duration: how long the packets are kept, 0 disables time-shifting
+ * @max_size: the maximum size in bytes of the packets of each stream
+ *
+ * Make the streams of the live media created by @factory keep the RTP
+ * packets of the last @duration, up to @max_size bytes each, so that
+ * clients can play from the past. See gst_rtsp_media_set_timeshift().
+ *
+ * Since: 1.20
+ */
+void
+gst_rtsp_media_factory_set_timeshift (GstRTSPMediaFactory * factory,
+    GstClockTime duration, guint64 max_size)
+{
+  GstRTSPMediaFactoryPrivate *priv;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory));
+  g_return_if_fail (GST_CLOCK_TIME_IS_VALID (duration));
+
+  priv = factory->priv;
+
+  GST_RTSP_MEDIA_FACTORY_LOCK (factory);
+  priv->timeshift_duration = duration;
+  priv->timeshift_size = max_size;
+  GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
+}
+
+/**
+ * gst_rtsp_media_factory_get_timeshift:
+ * @factory: a #GstRTSPMediaFactory
+ * @duration: (out) (allow-none): how long the packets are kept
+ * @max_size: (out) (allow-none): the maximum size of the packets of each
+ *   stream
+ *
+ * Get the limits of the time-shift ring buffers of the media created by
+ * @factory.
+ *
+ * Since: 1.20
+ */
+void
+gst_rtsp_media_factory_get_timeshift (GstRTSPMediaFactory * factory,
+    GstClockTime * duration, guint64 * max_size)
+{
+  GstRTSPMediaFactoryPrivate *priv;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory));
+
+  priv = factory->priv;
+
+  GST_RTSP_MEDIA_FACTORY_LOCK (factory);
+  if (duration)
+    *duration = priv->timeshift_duration;
+  if (max_size)
+    *max_size = priv->timeshift_size;
+  GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
+}
+
+/**
+ * gst_rtsp_media_factory_set_keyframe_index_dir:
+ * @factory: a #GstRTSPMediaFactory
+ * @dir: (allow-none): a directory
+ *
+ * Keep the keyframe indexes of the VOD media created by @factory in @dir.
+ * The index of a media is built the first time it plays completely and is
+ * used to seek directly to a keyframe afterwards. The indexes are named
+ * after the launch line of @factory, #GstRTSPMediaFactoryURI names them
+ * after its URI. See gst_rtsp_media_set_keyframe_index_location().
+ *
+ * Since: 1.20
+ */
+void
+gst_rtsp_media_factory_set_keyframe_index_dir (GstRTSPMediaFactory * factory,
+    const gchar * dir)
+{
+  GstRTSPMediaFactoryPrivate *priv;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory));
+
+  priv = factory->priv;
+
+  GST_RTSP_MEDIA_FACTORY_LOCK (factory);
+  g_free (priv->keyframe_index_dir);
+  priv->keyframe_index_dir = g_strdup (dir);
+  GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
+}
+
+/**
+ * gst_rtsp_media_factory_get_keyframe_index_dir:
+ * @factory: a #GstRTSPMediaFactory
+ *
+ * Get the directory with the keyframe indexes of the media created by
+ * @factory.
+ *
+ * Returns: (transfer full) (nullable): the directory, g_free() after usage.
+ *
+ * Since: 1.20
+ */
+gchar *
+gst_rtsp_media_factory_get_keyframe_index_dir (GstRTSPMediaFactory * factory)
+{
+  GstRTSPMediaFactoryPrivate *priv;
+  gchar *result;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory), NULL);
+
+  priv = factory->priv;
+
+  GST_RTSP_MEDIA_FACTORY_LOCK (factory);
+  result = g_strdup (priv->keyframe_index_dir);
+  GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
+
+  return result;
+}
+
+/**
+ * gst_rtsp_media_factory_set_merge_window:
+ * @factory: a #GstRTSPMediaFactory
+ * @window: a #GstClockTime, 0 disables merging
+ *
+ * Let clients of the non-shared @factory that request the same VOD media
+ * shortly after each other share one pipeline. A new client gets a media
+ * of an earlier client while its position is within @window of the start
+ * and the GOP cache, see gst_rtsp_media_factory_set_gop_cache_size(), still
+ * holds the packets from the start. It receives the cached packets and then
+ * the packets from the current position. See
+ * gst_rtsp_media_set_merge_window().
+ *
+ * Since: 1.20
+ */
+void
+gst_rtsp_media_factory_set_merge_window (GstRTSPMediaFactory * factory,
+    GstClockTime window)
+{
+  GstRTSPMediaFactoryPrivate *priv;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory));
+  g_return_if_fail (GST_CLOCK_TIME_IS_VALID (window));
+
+  priv = factory->priv;
+
+  GST_RTSP_MEDIA_FACTORY_LOCK (factory);
+  priv->merge_window = window;
+  GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
+}
+
+/**
+ * gst_rtsp_media_factory_get_merge_window:
+ * @factory: a #GstRTSPMediaFactory
+ *
+ * Get the window from the start within which new clients join the VOD
+ * media of an earlier client.
+ *
+ * Returns: the merge window, 0 when merging is disabled.
+ *
+ * Since: 1.20
+ */
+GstClockTime
+gst_rtsp_media_factory_get_merge_window (GstRTSPMediaFactory * factory)
+{
+  GstRTSPMediaFactoryPrivate *priv;
+  GstClockTime result;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory), 0);
+
+  priv = factory->priv;
+
+  GST_RTSP_MEDIA_FACTORY_LOCK (factory);
+  result = priv->merge_window;
+  GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
+
+  return result;
+}
+
+/**
+ * gst_rtsp_media_factory_set_retransmission_time:
+ * @factory: a #GstRTSPMediaFactory
+ * @time: a #GstClockTime
+ *
+ * Configure the time to store for possible retransmission
+ */
+void
+gst_rtsp_media_factory_set_retransmission_time (GstRTSPMediaFactory * factory,
+    GstClockTime time)
+{
+  GstRTSPMediaFactoryPrivate *priv;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory));
+
+  priv = factory->priv;
+
+  GST_DEBUG_OBJECT (factory, "retransmission time %" G_GUINT64_FORMAT, time);
+
+  GST_RTSP_MEDIA_FACTORY_LOCK (factory);
+  priv->rtx_time = time;
+  GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
+}
+
+/**
+ * gst_rtsp_media_factory_get_retransmission_time:
+ * @factory: a #GstRTSPMediaFactory
+ *
+ * Get the time that is stored for retransmission purposes
+ *
+ * Returns: a #GstClockTime
+ */
+GstClockTime
+gst_rtsp_media_factory_get_retransmission_time (GstRTSPMediaFactory * factory)
+{
+  GstRTSPMediaFactoryPrivate *priv;
+  GstClockTime res;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory), 0);
+
+  priv = factory->priv;
+
+  GST_RTSP_MEDIA_FACTORY_LOCK (factory);
+  res = priv->rtx_time;
+  GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
+
+  return res;
+}
+
+/**
+ * gst_rtsp_media_factory_set_do_retransmission:
+ *
+ * Set whether retransmission requests will be sent for
+ * receiving media
+ *
+ * Since: 1.16
+ */
+void
+gst_rtsp_media_factory_set_do_retransmission (GstRTSPMediaFactory * factory,
+    gboolean do_retransmission)
+{
+  GstRTSPMediaFactoryPrivate *priv;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory));
+
+  priv = factory->priv;
+
+  GST_DEBUG_OBJECT (factory, "Do retransmission %d", do_retransmission);
+
+  GST_RTSP_MEDIA_FACTORY_LOCK (factory);
+  priv->do_retransmission = do_retransmission;
+  GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
+}
+
+/**
+ * gst_rtsp_media_factory_get_do_retransmission:
+ *
+ * Returns: Whether retransmission requests will be sent for receiving media
+ *
+ * Since: 1.16
+ */
+gboolean
+gst_rtsp_media_factory_get_do_retransmission (GstRTSPMediaFactory * factory)
+{
+  GstRTSPMediaFactoryPrivate *priv;
+  gboolean res;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory), 0);
+
+  priv = factory->priv;
+
+  GST_RTSP_MEDIA_FACTORY_LOCK (factory);
+  res = priv->do_retransmission;
+  GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
+
+  return res;
+}
+
+/**
+ * gst_rtsp_media_factory_set_latency:
+ * @factory: a #GstRTSPMediaFactory
+ * @latency: latency in milliseconds
+ *
+ * Configure the latency used for receiving media
+ */
+void
+gst_rtsp_media_factory_set_latency (GstRTSPMediaFactory * factory,
+    guint latency)
+{
+  GstRTSPMediaFactoryPrivate *priv;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory));
+
+  priv = factory->priv;
+
+  GST_DEBUG_OBJECT (factory, "latency %ums", latency);
+
+  GST_RTSP_MEDIA_FACTORY_LOCK (factory);
+  priv->latency = latency;
+  GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
+}
+
+/**
+ * gst_rtsp_media_factory_get_latency:
+ * @factory: a #GstRTSPMediaFactory
+ *
+ * Get the latency that is used for receiving media
+ *
+ * Returns: latency in milliseconds
+ */
+guint
+gst_rtsp_media_factory_get_latency (GstRTSPMediaFactory * factory)
+{
+  GstRTSPMediaFactoryPrivate *priv;
+  guint res;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory), 0);
+
+  priv = factory->priv;
+
+  GST_RTSP_MEDIA_FACTORY_LOCK (factory);
+  res = priv->latency;
+  GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
+
+  return res;
+}
+
+static void
+merging_free (GQueue * medias)
+{
+  g_queue_free_full (medias, g_object_unref);
+}
+
+static gboolean
+compare_media (gpointer key, GstRTSPMedia * media1, GstRTSPMedia * media2)
+{
+  return (media1 == media2);
+}
+
+static void
+live_sdp_free (LiveSDP * live)
+{
+  gst_sdp_message_free (live->sdp);
+  g_free (live->server_ip);
+  g_slice_free (LiveSDP, live);
+}
+
+static void
+media_unprepared (GstRTSPMedia * media, GWeakRef * ref)
+{
+  GstRTSPMediaFactory *factory = g_weak_ref_get (ref);
+  GstRTSPMediaFactoryPrivate *priv;
+  GHashTableIter iter;
+  gpointer key, value;
+  LiveSDP *live;
+
+  if (!factory)
+    return;
+
+  priv = factory->priv;
+
+  /* the media only kept an SDP when it was live and we asked for it */
+  live = g_slice_new0 (LiveSDP);
+  if (!gst_rtsp_media_get_idle_sdp (media, &live->sdp, &live->is_ipv6,
+          &live->server_ip)) {
+    g_slice_free (LiveSDP, live);
+    live = NULL;
+  }
+
+  g_mutex_lock (&priv->medias_lock);
+  g_hash_table_iter_init (&iter, priv->medias);
+  while (g_hash_table_iter_next (&iter, &key, &value)) {
+    if (value != media)
+      continue;
+
+    if (live) {
+      GST_DEBUG ("keeping SDP of live media %p for %s", media,
+          (gchar *) key);
+      g_hash_table_insert (priv->live_sdps, g_strdup (key), live);
+      live = NULL;
+    }
+    g_hash_table_iter_remove (&iter);
+  }
+  g_mutex_unlock (&priv->medias_lock);
+
+  if (live)
+    live_sdp_free (live);
+
+  g_object_unref (factory);
+}
+
+static GWeakRef *
+weak_ref_new (gpointer obj)
+{
+  GWeakRef *ref = g_slice_new (GWeakRef);
+
+  g_weak_ref_init (ref, obj);
   return ref;
 }
 
-static void
-weak_ref_free (GWeakRef * ref)
+static void
+weak_ref_free (GWeakRef * ref)
+{
+  g_weak_ref_clear (ref);
+  g_slice_free (GWeakRef, ref);
+}
+
+static void
+merging_unprepared (GstRTSPMedia * media, GWeakRef * ref)
+{
+  GstRTSPMediaFactory *factory = g_weak_ref_get (ref);
+  GstRTSPMediaFactoryPrivate *priv;
+  GHashTableIter iter;
+  gpointer value;
+
+  if (!factory)
+    return;
+
+  priv = factory->priv;
+
+  g_mutex_lock (&priv->medias_lock);
+  g_hash_table_iter_init (&iter, priv->merging);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    GQueue *medias = value;
+
+    if (!g_queue_remove (medias, media))
+      continue;
+
+    g_object_unref (media);
+    if (g_queue_is_empty (medias))
+      g_hash_table_iter_remove (&iter);
+    break;
+  }
+  g_mutex_unlock (&priv->medias_lock);
+
+  g_object_unref (factory);
+}
+
+/* remember the non-shared @media so that new clients for @key can join it */
+static void
+merging_add (GstRTSPMediaFactory * factory, const gchar * key,
+    GstRTSPMedia * media)
+{
+  GstRTSPMediaFactoryPrivate *priv = factory->priv;
+  GQueue *medias;
+
+  g_signal_connect_data (media, "unprepared",
+      (GCallback) merging_unprepared, weak_ref_new (factory),
+      (GClosureNotify) weak_ref_free, 0);
+
+  g_mutex_lock (&priv->medias_lock);
+  medias = g_hash_table_lookup (priv->merging, key);
+  if (medias == NULL) {
+    medias = g_queue_new ();
+    g_hash_table_insert (priv->merging, g_strdup (key), medias);
+  }
+  g_queue_push_tail (medias, g_object_ref (media));
+  g_mutex_unlock (&priv->medias_lock);
+}
+
+/* find a media for @key that a new client can join, which makes it a shared
+ * media from now on */
+static GstRTSPMedia *
+merging_take (GstRTSPMediaFactory * factory, const gchar * key)
+{
+  GstRTSPMediaFactoryPrivate *priv = factory->priv;
+  GstRTSPMedia *media = NULL;
+  GQueue *medias;
+  GList *candidates = NULL, *walk;
+
+  /* the media take their state lock to check their position, which they
+   * hold while they emit unprepared, so check them without our lock */
+  g_mutex_lock (&priv->medias_lock);
+  if ((medias = g_hash_table_lookup (priv->merging, key))) {
+    for (walk = medias->head; walk; walk = walk->next)
+      candidates = g_list_prepend (candidates, g_object_ref (walk->data));
+  }
+  g_mutex_unlock (&priv->medias_lock);
+
+  for (walk = candidates; walk; walk = walk->next) {
+    if (gst_rtsp_media_can_merge (walk->data)) {
+      media = g_object_ref (walk->data);
+      break;
+    }
+  }
+  g_list_free_full (candidates, g_object_unref);
+
+  if (media) {
+    GST_INFO ("new client for %s joins media %p", key, media);
+    gst_rtsp_media_set_shared (media, TRUE);
+  }
+
+  return media;
+}
+
+/* a media that is being constructed for a key, other requests for the same
+ * key wait for it instead of constructing their own media */
+typedef struct
+{
+  gint refcount;                /* protected by medias_lock */
+  gboolean done;
+  gboolean failed;
+} MediaConstruct;
+
+static void
+media_construct_unref (MediaConstruct * construct)
+{
+  if (--construct->refcount == 0)
+    g_slice_free (MediaConstruct, construct);
+}
+
+static GstRTSPMedia *
+construct_media (GstRTSPMediaFactory * factory, const GstRTSPUrl * url)
+{
+  GstRTSPMediaFactoryClass *klass = GST_RTSP_MEDIA_FACTORY_GET_CLASS (factory);
+  GstRTSPMedia *media;
+
+  if (!klass->construct)
+    return NULL;
+
+  media = klass->construct (factory, url);
+  if (media == NULL)
+    return NULL;
+
+  g_signal_emit (factory,
+      gst_rtsp_media_factory_signals[SIGNAL_MEDIA_CONSTRUCTED], 0, media, NULL);
+
+  /* configure the media */
+  if (klass->configure)
+    klass->configure (factory, media);
+
+  g_signal_emit (factory,
+      gst_rtsp_media_factory_signals[SIGNAL_MEDIA_CONFIGURE], 0, media, NULL);
+
+  if (!gst_rtsp_media_is_reusable (media)) {
+    /* when not reusable, connect to the unprepare signal to remove the item
+     * from our cache when it gets unprepared */
+    g_signal_connect_data (media, "unprepared",
+        (GCallback) media_unprepared, weak_ref_new (factory),
+        (GClosureNotify) weak_ref_free, 0);
+  }
+  return media;
+}
+
+typedef struct
+{
+  GstRTSPMediaFactory *factory;
+  GstRTSPUrl *url;
+  gchar *key;
+  GstRTSPThread *thread;
+} PrewarmData;
+
+static void
+prewarm_data_free (PrewarmData * data)
+{
+  g_object_unref (data->factory);
+  gst_rtsp_url_free (data->url);
+  g_free (data->key);
+  g_slice_free (PrewarmData, data);
+}
+
+static void
+prewarmed_free (GstRTSPMedia * media)
+{
+  gst_rtsp_media_unprepare (media);
+  g_object_unref (media);
+}
+
+/* called from the media thread when a pre-warmed media is prepared */
+static void
+prewarm_prepared (GstRTSPMedia * media, gboolean success, gpointer user_data)
+{
+  PrewarmData *data = user_data;
+  GstRTSPMediaFactoryPrivate *priv = data->factory->priv;
+  gboolean keep = FALSE;
+
+  g_mutex_lock (&priv->medias_lock);
+  priv->prewarm_pending--;
+  if (success && g_strcmp0 (priv->prewarm_key, data->key) == 0 &&
+      priv->prewarmed.length < priv->prewarm_size) {
+    g_queue_push_tail (&priv->prewarmed, g_object_ref (media));
+    keep = TRUE;
+  }
+  g_mutex_unlock (&priv->medias_lock);
+
+  GST_DEBUG ("pre-warmed media %p for %s, success %d, kept %d", media,
+      data->key, success, keep);
+
+  /* a failed media is already unprepared */
+  if (success && !keep)
+    gst_rtsp_media_unprepare (media);
+}
+
+/* called from the context of the media thread */
+static gboolean
+prewarm_construct (PrewarmData * data)
+{
+  GstRTSPMediaFactoryPrivate *priv = data->factory->priv;
+  GstRTSPThread *thread = data->thread;
+  GstRTSPMedia *media;
+
+  data->thread = NULL;
+
+  media = construct_media (data->factory, data->url);
+  if (media == NULL)
+    goto no_media;
+
+  if (!(gst_rtsp_media_get_transport_mode (media) &
+          GST_RTSP_TRANSPORT_MODE_PLAY))
+    goto not_play;
+
+  if (!gst_rtsp_media_prepare_async (media, thread, thread->context,
+          prewarm_prepared, data, (GDestroyNotify) prewarm_data_free))
+    goto no_prepare;
+
+  g_object_unref (media);
+
+  return G_SOURCE_REMOVE;
+
+  /* ERRORS */
+no_media:
+  {
+    GST_WARNING ("could not construct media for %s", data->key);
+    gst_rtsp_thread_stop (thread);
+    goto failed;
+  }
+not_play:
+  {
+    GST_WARNING ("only media for PLAY can be pre-warmed");
+    gst_rtsp_thread_stop (thread);
+    g_object_unref (media);
+    goto failed;
+  }
+no_prepare:
+  {
+    GST_WARNING ("could not prepare media for %s", data->key);
+    g_object_unref (media);
+    goto failed;
+  }
+failed:
+  {
+    g_mutex_lock (&priv->medias_lock);
+    priv->prewarm_pending--;
+    g_mutex_unlock (&priv->medias_lock);
+    prewarm_data_free (data);
+    return G_SOURCE_REMOVE;
+  }
+}
+
+/* start constructing and preparing @n_media in the background */
+static void
+prewarm_refill (GstRTSPMediaFactory * factory, const GstRTSPUrl * url,
+    const gchar * key, guint n_media)
+{
+  GstRTSPThreadPool *pool;
+  guint i;
+
+  if (n_media == 0)
+    return;
+
+  pool = gst_rtsp_media_factory_get_thread_pool (factory);
+
+  GST_DEBUG ("pre-warming %u media for %s", n_media, key);
+
+  for (i = 0; i < n_media; i++) {
+    PrewarmData *data;
+    GstRTSPThread *thread;
+    GSource *source;
+
+    thread = gst_rtsp_thread_pool_get_thread (pool,
+        GST_RTSP_THREAD_TYPE_MEDIA, NULL);
+    if (thread == NULL) {
+      GstRTSPMediaFactoryPrivate *priv = factory->priv;
+
+      GST_WARNING ("can't get a thread for pre-warming");
+      g_mutex_lock (&priv->medias_lock);
+      priv->prewarm_pending -= n_media - i;
+      g_mutex_unlock (&priv->medias_lock);
+      break;
+    }
+
+    data = g_slice_new (PrewarmData);
+    data->factory = g_object_ref (factory);
+    data->url = gst_rtsp_url_copy (url);
+    data->key = g_strdup (key);
+    data->thread = thread;
+
+    source = g_idle_source_new ();
+    g_source_set_callback (source, (GSourceFunc) prewarm_construct, data,
+        NULL);
+    g_source_attach (source, thread->context);
+    g_source_unref (source);
+  }
+  g_object_unref (pool);
+}
+
+/* with medias_lock, returns the number of media to construct */
+static guint
+prewarm_missing_unlocked (GstRTSPMediaFactory * factory)
+{
+  GstRTSPMediaFactoryPrivate *priv = factory->priv;
+  guint have, missing;
+
+  if (priv->prewarm_key == NULL)
+    return 0;
+
+  have = priv->prewarmed.length + priv->prewarm_pending;
+  missing = have < priv->prewarm_size ? priv->prewarm_size - have : 0;
+  priv->prewarm_pending += missing;
+
+  return missing;
+}
+
+/* take a pre-warmed media for @key, returns %NULL when the pool is empty */
+static GstRTSPMedia *
+prewarm_take (GstRTSPMediaFactory * factory, const GstRTSPUrl * url,
+    const gchar * key)
 {
-  g_weak_ref_clear (ref);
-  g_slice_free (GWeakRef, ref);
+  GstRTSPMediaFactoryPrivate *priv = factory->priv;
+  GstRTSPMedia *media = NULL;
+  GQueue old = G_QUEUE_INIT;
+  GstRTSPUrl *refill_url = NULL;
+  guint missing;
+
+  g_mutex_lock (&priv->medias_lock);
+  if (priv->prewarm_size == 0) {
+    g_mutex_unlock (&priv->medias_lock);
+    return NULL;
+  }
+
+  if (g_strcmp0 (priv->prewarm_key, key) != 0) {
+    /* the pool is for another url now */
+    old = priv->prewarmed;
+    g_queue_init (&priv->prewarmed);
+    g_free (priv->prewarm_key);
+    priv->prewarm_key = g_strdup (key);
+    if (priv->prewarm_url)
+      gst_rtsp_url_free (priv->prewarm_url);
+    priv->prewarm_url = gst_rtsp_url_copy (url);
+  }
+
+  media = g_queue_pop_head (&priv->prewarmed);
+  if (media)
+    priv->prewarm_hits++;
+  else
+    priv->prewarm_misses++;
+
+  missing = prewarm_missing_unlocked (factory);
+  if (missing)
+    refill_url = gst_rtsp_url_copy (priv->prewarm_url);
+  g_mutex_unlock (&priv->medias_lock);
+
+  g_queue_foreach (&old, (GFunc) prewarmed_free, NULL);
+  g_queue_clear (&old);
+
+  if (refill_url) {
+    prewarm_refill (factory, refill_url, key, missing);
+    gst_rtsp_url_free (refill_url);
+  }
+
+  if (media) {
+    GST_INFO ("using pre-warmed media %p for %s", media, key);
+    /* the next prepare takes over the prepared pipeline */
+    gst_rtsp_media_release_prepare (media);
+  }
+
+  return media;
 }
 
 /**
@@ -1385,6 +2745,11 @@ gst_rtsp_media_factory_construct (GstRTSPMediaFactory * factory,
   gchar *key;
   GstRTSPMedia *media;
   GstRTSPMediaFactoryClass *klass;
+  MediaConstruct *construct = NULL;
+  gboolean shared, merge, failed, is_ipv6 = FALSE;
+  LiveSDP *live;
+  GstSDPMessage *sdp = NULL;
+  gchar *server_ip = NULL;
 
   g_return_val_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory), NULL);
   g_return_val_if_fail (url != NULL, NULL);
@@ -1399,55 +2764,99 @@ gst_rtsp_media_factory_construct (GstRTSPMediaFactory * factory,
   else
     key = NULL;
 
+  if (key == NULL) {
+    /* nothing can be cached, no need to lock */
+    media = construct_media (factory, url);
+    goto done;
+  }
+
+  shared = gst_rtsp_media_factory_is_shared (factory);
+  merge = !shared && gst_rtsp_media_factory_get_merge_window (factory) > 0;
+
+  /* new clients of a non-shared VOD media can join one that just started */
+  if (merge && (media = merging_take (factory, key)))
+    goto done;
+
+  /* non-shared media can come from the pre-warmed pool */
+  if (!shared && (media = prewarm_take (factory, url, key)))
+    goto merging;
+
   g_mutex_lock (&priv->medias_lock);
-  if (key) {
+  while (TRUE) {
     /* we have a key, see if we find a cached media */
     media = g_hash_table_lookup (priv->medias, key);
-    if (media)
+    if (media) {
       g_object_ref (media);
-  } else
-    media = NULL;
-
-  if (media == NULL) {
-    /* nothing cached found, try to create one */
-    if (klass->construct) {
-      media = klass->construct (factory, url);
-      if (media)
-        g_signal_emit (factory,
-            gst_rtsp_media_factory_signals[SIGNAL_MEDIA_CONSTRUCTED], 0, media,
-            NULL);
-    } else
-      media = NULL;
+      g_mutex_unlock (&priv->medias_lock);
+      goto done;
+    }
 
-    if (media) {
-      /* configure the media */
-      if (klass->configure)
-        klass->configure (factory, media);
-
-      g_signal_emit (factory,
-          gst_rtsp_media_factory_signals[SIGNAL_MEDIA_CONFIGURE], 0, media,
-          NULL);
-
-      /* check if we can cache this media */
-      if (gst_rtsp_media_is_shared (media) && key) {
-        /* insert in the hashtable, takes ownership of the key */
-        g_object_ref (media);
-        g_hash_table_insert (priv->medias, key, media);
-        key = NULL;
-      }
-      if (!gst_rtsp_media_is_reusable (media)) {
-        /* when not reusable, connect to the unprepare signal to remove the item
-         * from our cache when it gets unprepared */
-        g_signal_connect_data (media, "unprepared",
-            (GCallback) media_unprepared, weak_ref_new (factory),
-            (GClosureNotify) weak_ref_free, 0);
-      }
+    construct = g_hash_table_lookup (priv->constructing, key);
+    if (construct == NULL)
+      break;
+
+    /* someone else is constructing a shared media for this key, wait for it
+     * and share its result, also when it failed */
+    GST_DEBUG ("waiting for media for url %s", url->abspath);
+    construct->refcount++;
+    while (!construct->done)
+      g_cond_wait (&priv->medias_cond, &priv->medias_lock);
+
+    failed = construct->failed;
+    media_construct_unref (construct);
+    if (failed) {
+      g_mutex_unlock (&priv->medias_lock);
+      goto done;
     }
+    /* the media is cached now or was not shared after all, try again */
+  }
+
+  /* nothing cached found, when the media will be shared we let others wait
+   * for the one we construct */
+  if (shared) {
+    construct = g_slice_new0 (MediaConstruct);
+    construct->refcount = 1;
+    g_hash_table_insert (priv->constructing, g_strdup (key), construct);
   }
   g_mutex_unlock (&priv->medias_lock);
 
-  if (key)
-    g_free (key);
+  media = construct_media (factory, url);
+
+  g_mutex_lock (&priv->medias_lock);
+  if (construct) {
+    g_hash_table_remove (priv->constructing, key);
+    construct->failed = (media == NULL);
+    construct->done = TRUE;
+    g_cond_broadcast (&priv->medias_cond);
+    media_construct_unref (construct);
+  }
+  /* check if we can cache this media */
+  if (media && gst_rtsp_media_is_shared (media)) {
+    /* a live media is described like the one before it while it prepares */
+    if ((live = g_hash_table_lookup (priv->live_sdps, key))) {
+      gst_sdp_message_copy (live->sdp, &sdp);
+      is_ipv6 = live->is_ipv6;
+      server_ip = g_strdup (live->server_ip);
+    }
+    /* insert in the hashtable, takes ownership of the key */
+    g_hash_table_insert (priv->medias, key, g_object_ref (media));
+    key = NULL;
+  }
+  g_mutex_unlock (&priv->medias_lock);
+
+  if (sdp) {
+    GST_DEBUG ("describe media %p from the SDP of the last one", media);
+    gst_rtsp_media_set_idle_sdp (media, sdp, is_ipv6, server_ip);
+    gst_sdp_message_free (sdp);
+    g_free (server_ip);
+  }
+
+merging:
+  if (merge && media && !gst_rtsp_media_is_shared (media))
+    merging_add (factory, key, media);
+
+done:
+  g_free (key);
 
   GST_INFO ("constructed media %p for url %s", media, url->abspath);
 
@@ -1762,6 +3171,181 @@ gst_rtsp_media_factory_is_enable_rtcp (GstRTSPMediaFactory * factory)
   return result;
 }
 
+/**
+ * gst_rtsp_media_factory_set_thread_pool:
+ * @factory: a #GstRTSPMediaFactory
+ * @pool: (transfer none) (nullable): a #GstRTSPThreadPool
+ *
+ * Configure @pool to be used as the thread pool for the media that @factory
+ * constructs in the background, such as pre-warmed media. When no pool is
+ * configured, a default #GstRTSPThreadPool is used.
+ *
+ * Since: 1.20
+ */
+void
+gst_rtsp_media_factory_set_thread_pool (GstRTSPMediaFactory * factory,
+    GstRTSPThreadPool * pool)
+{
+  GstRTSPMediaFactoryPrivate *priv;
+  GstRTSPThreadPool *old;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory));
+
+  priv = factory->priv;
+
+  if (pool)
+    g_object_ref (pool);
+
+  GST_RTSP_MEDIA_FACTORY_LOCK (factory);
+  old = priv->thread_pool;
+  priv->thread_pool = pool;
+  GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
+
+  if (old)
+    g_object_unref (old);
+}
+
+/**
+ * gst_rtsp_media_factory_get_thread_pool:
+ * @factory: a #GstRTSPMediaFactory
+ *
+ * Get the #GstRTSPThreadPool used for the media that @factory constructs in
+ * the background.
+ *
+ * Returns: (transfer full): the #GstRTSPThreadPool of @factory.
+ * g_object_unref() after usage.
+ *
+ * Since: 1.20
+ */
+GstRTSPThreadPool *
+gst_rtsp_media_factory_get_thread_pool (GstRTSPMediaFactory * factory)
+{
+  GstRTSPMediaFactoryPrivate *priv;
+  GstRTSPThreadPool *result;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory), NULL);
+
+  priv = factory->priv;
+
+  GST_RTSP_MEDIA_FACTORY_LOCK (factory);
+  if (priv->thread_pool == NULL)
+    priv->thread_pool = gst_rtsp_thread_pool_new ();
+  result = g_object_ref (priv->thread_pool);
+  GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
+
+  return result;
+}
+
+/**
+ * gst_rtsp_media_factory_set_prewarm_size:
+ * @factory: a #GstRTSPMediaFactory
+ * @size: the number of media to keep prepared
+ *
+ * Keep @size prepared media ready to be handed out by
+ * gst_rtsp_media_factory_construct(). This only applies to non-shared
+ * factories, the media are constructed and prepared in the background for
+ * the url of the last request, on threads of the thread pool of @factory.
+ *
+ * Since: 1.20
+ */
+void
+gst_rtsp_media_factory_set_prewarm_size (GstRTSPMediaFactory * factory,
+    guint size)
+{
+  GstRTSPMediaFactoryPrivate *priv;
+  GQueue old = G_QUEUE_INIT;
+  GstRTSPUrl *url = NULL;
+  gchar *key = NULL;
+  guint missing;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory));
+
+  priv = factory->priv;
+
+  g_mutex_lock (&priv->medias_lock);
+  priv->prewarm_size = size;
+  while (priv->prewarmed.length > size)
+    g_queue_push_tail (&old, g_queue_pop_tail (&priv->prewarmed));
+  missing = prewarm_missing_unlocked (factory);
+  if (missing) {
+    url = gst_rtsp_url_copy (priv->prewarm_url);
+    key = g_strdup (priv->prewarm_key);
+  }
+  g_mutex_unlock (&priv->medias_lock);
+
+  g_queue_foreach (&old, (GFunc) prewarmed_free, NULL);
+  g_queue_clear (&old);
+
+  if (url) {
+    prewarm_refill (factory, url, key, missing);
+    gst_rtsp_url_free (url);
+    g_free (key);
+  }
+}
+
+/**
+ * gst_rtsp_media_factory_get_prewarm_size:
+ * @factory: a #GstRTSPMediaFactory
+ *
+ * Get the number of prepared media @factory keeps ready.
+ *
+ * Returns: the prewarm size of @factory.
+ *
+ * Since: 1.20
+ */
+guint
+gst_rtsp_media_factory_get_prewarm_size (GstRTSPMediaFactory * factory)
+{
+  GstRTSPMediaFactoryPrivate *priv;
+  guint result;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory), 0);
+
+  priv = factory->priv;
+
+  g_mutex_lock (&priv->medias_lock);
+  result = priv->prewarm_size;
+  g_mutex_unlock (&priv->medias_lock);
+
+  return result;
+}
+
+/**
+ * gst_rtsp_media_factory_get_prewarm_stats:
+ * @factory: a #GstRTSPMediaFactory
+ *
+ * Get statistics about the pre-warmed media of @factory. The structure is
+ * named "application/x-rtsp-media-factory-prewarm-stats" and contains the
+ * fields "size", "available" and "pending" (guint) and "hits" and "misses"
+ * (guint64).
+ *
+ * Returns: (transfer full): a #GstStructure, free with
+ * gst_structure_free() after usage.
+ *
+ * Since: 1.20
+ */
+GstStructure *
+gst_rtsp_media_factory_get_prewarm_stats (GstRTSPMediaFactory * factory)
+{
+  GstRTSPMediaFactoryPrivate *priv;
+  GstStructure *result;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory), NULL);
+
+  priv = factory->priv;
+
+  g_mutex_lock (&priv->medias_lock);
+  result = gst_structure_new ("application/x-rtsp-media-factory-prewarm-stats",
+      "size", G_TYPE_UINT, priv->prewarm_size,
+      "available", G_TYPE_UINT, priv->prewarmed.length,
+      "pending", G_TYPE_UINT, priv->prewarm_pending,
+      "hits", G_TYPE_UINT64, priv->prewarm_hits,
+      "misses", G_TYPE_UINT64, priv->prewarm_misses, NULL);
+  g_mutex_unlock (&priv->medias_lock);
+
+  return result;
+}
+
 static gchar *
 default_gen_key (GstRTSPMediaFactory * factory, const GstRTSPUrl * url)
 {
@@ -1780,11 +3364,281 @@ default_gen_key (GstRTSPMediaFactory * factory, const GstRTSPUrl * url)
   return result;
 }
 
+/* Parsing the launch line is the most expensive part of constructing a media
+ * for short pipelines, so the first parse is kept as a template. New elements
+ * are cloned from the template by creating the same element factories with
+ * the same names and non-default properties and linking the same pads. The
+ * names of the payloaders are preserved so gst_rtsp_media_collect_streams()
+ * finds them like in a parsed pipeline.
+ *
+ * Launch lines that gst_parse_launch() can only handle with state it keeps in
+ * the pipeline, such as delayed links on sometimes pads or nested bins, or
+ * that set properties the clone can't get, are not cloned and are parsed for
+ * every media like before. */
+static gboolean
+copy_property_is_safe (GParamSpec * pspec)
+{
+  if (pspec->flags & (G_PARAM_CONSTRUCT_ONLY | G_PARAM_DEPRECATED))
+    return FALSE;
+  return TRUE;
+}
+
+/* copy the non-default properties of @src to @dest or, when @dest is NULL,
+ * check if they can be copied */
+static gboolean
+copy_properties (GstElement * src, GstElement * dest)
+{
+  GParamSpec **pspecs;
+  guint i, n_pspecs;
+  gboolean res = TRUE;
+
+  pspecs = g_object_class_list_properties (G_OBJECT_GET_CLASS (src),
+      &n_pspecs);
+  for (i = 0; i < n_pspecs && res; i++) {
+    GParamSpec *pspec = pspecs[i];
+    GValue value = G_VALUE_INIT;
+
+    /* a launch line can't set the others */
+    if (!(pspec->flags & G_PARAM_WRITABLE) ||
+        g_str_equal (pspec->name, "name") || g_str_equal (pspec->name, "parent"))
+      continue;
+
+    if (!(pspec->flags & G_PARAM_READABLE)) {
+      /* we can't know if the launch line set it */
+      GST_DEBUG_OBJECT (src, "property %s can't be read", pspec->name);
+      res = FALSE;
+      continue;
+    }
+
+    g_value_init (&value, pspec->value_type);
+    g_object_get_property (G_OBJECT (src), pspec->name, &value);
+    if (!g_param_value_defaults (pspec, &value)) {
+      if (!copy_property_is_safe (pspec)) {
+        GST_DEBUG_OBJECT (src, "property %s can't be set on a clone",
+            pspec->name);
+        res = FALSE;
+      } else if (G_VALUE_HOLDS_OBJECT (&value)) {
+        /* objects can't be shared between pipelines */
+        GST_DEBUG_OBJECT (src, "property %s holds an object", pspec->name);
+        res = FALSE;
+      } else if (dest) {
+        g_object_set_property (G_OBJECT (dest), pspec->name, &value);
+      }
+    }
+    g_value_unset (&value);
+  }
+  g_free (pspecs);
+
+  return res;
+}
+
+static gboolean
+has_pending_handler (GstElement * element, const gchar * signal)
+{
+  guint signal_id;
+
+  signal_id = g_signal_lookup (signal, G_OBJECT_TYPE (element));
+  if (signal_id == 0)
+    return FALSE;
+
+  return g_signal_handler_find (element, G_SIGNAL_MATCH_ID, signal_id, 0,
+      NULL, NULL, NULL) != 0;
+}
+
+static gboolean
+is_parse_bin (GstElement * element)
+{
+  GstElementFactory *factory = gst_element_get_factory (element);
+  const gchar *name;
+
+  if (factory == NULL)
+    return FALSE;
+
+  name = GST_OBJECT_NAME (factory);
+  return g_str_equal (name, "bin") || g_str_equal (name, "pipeline");
+}
+
+static gboolean
+pad_is_clonable (GstPad * pad, GstElement * bin)
+{
+  GstPad *peer;
+  GstElement *parent;
+  gboolean res = TRUE;
+
+  if (GST_IS_GHOST_PAD (pad) || GST_IS_PROXY_PAD (pad))
+    return FALSE;
+
+  peer = gst_pad_get_peer (pad);
+  if (peer == NULL)
+    return TRUE;
+
+  /* only links between children of the bin are cloned */
+  parent = gst_pad_get_parent_element (peer);
+  if (parent == NULL || GST_OBJECT_PARENT (parent) != GST_OBJECT_CAST (bin) ||
+      GST_IS_GHOST_PAD (peer))
+    res = FALSE;
+  if (parent)
+    gst_object_unref (parent);
+  gst_object_unref (peer);
+
+  return res;
+}
+
+static gboolean
+template_is_clonable (GstElement * bin)
+{
+  GList *walk, *pads;
+  gboolean res = TRUE;
+
+  if (!GST_IS_BIN (bin) || !is_parse_bin (bin) || GST_ELEMENT_PADS (bin))
+    return FALSE;
+  if (!copy_properties (bin, NULL))
+    return FALSE;
+
+  /* the template is never used in a pipeline, so nothing changes it while
+   * we look at it without the object locks */
+  for (walk = GST_BIN_CHILDREN (bin); walk && res; walk = walk->next) {
+    GstElement *child = walk->data;
+
+    if (gst_element_get_factory (child) == NULL || is_parse_bin (child)) {
+      GST_DEBUG_OBJECT (child, "element can't be recreated");
+      res = FALSE;
+    } else if (has_pending_handler (child, "pad-added") ||
+        has_pending_handler (child, "child-added")) {
+      GST_DEBUG_OBJECT (child, "element has delayed links or properties");
+      res = FALSE;
+    } else if (!copy_properties (child, NULL)) {
+      res = FALSE;
+    }
+
+    for (pads = GST_ELEMENT_PADS (child); pads && res; pads = pads->next) {
+      if (!pad_is_clonable (pads->data, bin)) {
+        GST_DEBUG_OBJECT (pads->data, "pad can't be cloned");
+        res = FALSE;
+      }
+    }
+  }
+
+  return res;
+}
+
+static GstPad *
+clone_pad (GstElement * element, GstPad * pad)
+{
+  GstPad *res;
+  GstPadTemplate *templ, *request_templ = NULL;
+
+  res = gst_element_get_static_pad (element, GST_PAD_NAME (pad));
+  if (res)
+    return res;
+
+  templ = gst_pad_get_pad_template (pad);
+  if (templ == NULL)
+    return NULL;
+
+  if (GST_PAD_TEMPLATE_PRESENCE (templ) == GST_PAD_REQUEST)
+    request_templ = gst_element_get_pad_template (element,
+        GST_PAD_TEMPLATE_NAME_TEMPLATE (templ));
+  if (request_templ)
+    res = gst_element_request_pad (element, request_templ, GST_PAD_NAME (pad),
+        NULL);
+  gst_object_unref (templ);
+
+  return res;
+}
+
+static gboolean
+clone_links (GstElement * src, GstElement * dest, GstBin * bin)
+{
+  GList *walk;
+
+  for (walk = GST_ELEMENT_PADS (src); walk; walk = walk->next) {
+    GstPad *pad = walk->data, *peer;
+    GstElement *peer_element, *peer_clone;
+    GstPad *srcpad, *sinkpad;
+    GstPadLinkReturn ret = GST_PAD_LINK_REFUSED;
+
+    if (GST_PAD_IS_SINK (pad) || (peer = gst_pad_get_peer (pad)) == NULL)
+      continue;
+
+    peer_element = gst_pad_get_parent_element (peer);
+    peer_clone = gst_bin_get_by_name (bin, GST_ELEMENT_NAME (peer_element));
+
+    srcpad = clone_pad (dest, pad);
+    sinkpad = peer_clone ? clone_pad (peer_clone, peer) : NULL;
+    if (srcpad && sinkpad)
+      ret = gst_pad_link (srcpad, sinkpad);
+
+    if (ret != GST_PAD_LINK_OK)
+      GST_WARNING ("could not link %s:%s to %s:%s: %s", GST_DEBUG_PAD_NAME (pad),
+          GST_DEBUG_PAD_NAME (peer), gst_pad_link_get_name (ret));
+
+    if (srcpad)
+      gst_object_unref (srcpad);
+    if (sinkpad)
+      gst_object_unref (sinkpad);
+    if (peer_clone)
+      gst_object_unref (peer_clone);
+    gst_object_unref (peer_element);
+    gst_object_unref (peer);
+
+    if (ret != GST_PAD_LINK_OK)
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+static GstElement *
+clone_template (GstElement * tmpl)
+{
+  GstElement *bin;
+  GList *walk;
+
+  bin = gst_element_factory_create (gst_element_get_factory (tmpl),
+      GST_ELEMENT_NAME (tmpl));
+  if (bin == NULL)
+    return NULL;
+  copy_properties (tmpl, bin);
+
+  /* add in the order the elements were parsed */
+  for (walk = g_list_last (GST_BIN_CHILDREN (tmpl)); walk;
+      walk = walk->prev) {
+    GstElement *child = walk->data, *clone;
+
+    clone = gst_element_factory_create (gst_element_get_factory (child),
+        GST_ELEMENT_NAME (child));
+    if (clone == NULL)
+      goto failed;
+    copy_properties (child, clone);
+    gst_bin_add (GST_BIN (bin), clone);
+  }
+
+  for (walk = GST_BIN_CHILDREN (tmpl); walk; walk = walk->next) {
+    GstElement *child = walk->data, *clone;
+    gboolean linked;
+
+    clone = gst_bin_get_by_name (GST_BIN (bin), GST_ELEMENT_NAME (child));
+    linked = clone_links (child, clone, GST_BIN (bin));
+    gst_object_unref (clone);
+    if (!linked)
+      goto failed;
+  }
+
+  return bin;
+
+failed:
+  {
+    gst_object_unref (gst_object_ref_sink (bin));
+    return NULL;
+  }
+}
+
 static GstElement *
 default_create_element (GstRTSPMediaFactory * factory, const GstRTSPUrl * url)
 {
   GstRTSPMediaFactoryPrivate *priv = factory->priv;
-  GstElement *element;
+  GstElement *element, *tmpl;
   GError *error = NULL;
 
   GST_RTSP_MEDIA_FACTORY_LOCK (factory);
@@ -1792,6 +3646,29 @@ default_create_element (GstRTSPMediaFactory * factory, const GstRTSPUrl * url)
   if (priv->launch == NULL)
     goto no_launch;
 
+  if (priv->launch_template) {
+    tmpl = gst_object_ref (priv->launch_template);
+    GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
+
+    element = clone_template (tmpl);
+    if (element) {
+      gst_object_unref (tmpl);
+      return element;
+    }
+
+    GST_RTSP_MEDIA_FACTORY_LOCK (factory);
+    GST_WARNING ("could not clone launch template, parsing launch line");
+    if (priv->launch_template == tmpl) {
+      gst_object_unref (priv->launch_template);
+      priv->launch_template = NULL;
+      priv->launch_template_failed = TRUE;
+    }
+    gst_object_unref (tmpl);
+
+    if (priv->launch == NULL)
+      goto no_launch;
+  }
+
   /* parse the user provided launch line */
   element =
       gst_parse_launch_full (priv->launch, NULL, GST_PARSE_FLAG_PLACE_IN_BIN,
@@ -1799,6 +3676,22 @@ default_create_element (GstRTSPMediaFactory * factory, const GstRTSPUrl * url)
   if (element == NULL)
     goto parse_error;
 
+  if (!priv->launch_template && !priv->launch_template_failed) {
+    /* the first parse becomes the template, give a clone to the caller so
+     * that the template never ends up in a pipeline */
+    tmpl = gst_object_ref_sink (element);
+    if (template_is_clonable (tmpl) && (element = clone_template (tmpl))) {
+      GST_DEBUG ("using launch template for %s", priv->launch);
+      priv->launch_template = tmpl;
+    } else {
+      GST_DEBUG ("launch line can't be cloned, parsing for each media");
+      priv->launch_template_failed = TRUE;
+      element = tmpl;
+      /* give back the floating ref the caller expects */
+      g_object_force_floating (G_OBJECT (element));
+    }
+  }
+
   GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
 
   if (error != NULL) {
@@ -1904,8 +3797,11 @@ static void
 default_configure (GstRTSPMediaFactory * factory, GstRTSPMedia * media)
 {
   GstRTSPMediaFactoryPrivate *priv = factory->priv;
-  gboolean shared, eos_shutdown, stop_on_disconnect;
-  guint size;
+  gboolean shared, eos_shutdown, stop_on_disconnect, keep_live_sdp;
+  gboolean force_keyunit, deactivate_unused, keyframe_trickmode;
+  GstClockTime keyunit_interval, timeshift_duration, merge_window;
+  guint64 timeshift_size;
+  guint size, idle_timeout, gop_cache_size;
   gint dscp_qos;
   GstRTSPSuspendMode suspend_mode;
   GstRTSPProfile profiles;
@@ -1917,6 +3813,7 @@ default_configure (GstRTSPMediaFactory * factory, GstRTSPMedia * media)
   GstRTSPTransportMode transport_mode;
   GstClock *clock;
   gchar *multicast_iface;
+  gchar *index_location = NULL;
   GstRTSPPublishClockMode publish_clock_mode;
   guint ttl;
   gboolean bind_mcast;
@@ -1934,6 +3831,20 @@ default_configure (GstRTSPMediaFactory * factory, GstRTSPMedia * media)
   latency = priv->latency;
   transport_mode = priv->transport_mode;
   stop_on_disconnect = priv->stop_on_disconnect;
+  idle_timeout = priv->idle_timeout;
+  keep_live_sdp = priv->keep_live_sdp;
+  gop_cache_size = priv->gop_cache_size;
+  force_keyunit = priv->force_keyunit_on_join;
+  keyunit_interval = priv->force_keyunit_interval;
+  deactivate_unused = priv->deactivate_unused_streams;
+  keyframe_trickmode = priv->keyframe_trickmode;
+  timeshift_duration = priv->timeshift_duration;
+  timeshift_size = priv->timeshift_size;
+  merge_window = priv->merge_window;
+  if (priv->keyframe_index_dir && priv->launch)
+    index_location =
+        gst_rtsp_keyframe_index_make_location (priv->keyframe_index_dir,
+        priv->launch);
   clock = priv->clock ? gst_object_ref (priv->clock) : NULL;
   publish_clock_mode = priv->publish_clock_mode;
   ttl = priv->max_mcast_ttl;
@@ -1944,6 +3855,16 @@ default_configure (GstRTSPMediaFactory * factory, GstRTSPMedia * media)
   gst_rtsp_media_set_shared (media, shared);
   gst_rtsp_media_set_eos_shutdown (media, eos_shutdown);
   gst_rtsp_media_set_buffer_size (media, size);
+  gst_rtsp_media_set_gop_cache_size (media, gop_cache_size);
+  gst_rtsp_media_set_force_keyunit_on_join (media, force_keyunit);
+  gst_rtsp_media_set_force_keyunit_interval (media, keyunit_interval);
+  gst_rtsp_media_set_deactivate_unused_streams (media, deactivate_unused);
+  gst_rtsp_media_set_keyframe_trickmode (media, keyframe_trickmode);
+  gst_rtsp_media_set_timeshift (media, timeshift_duration, timeshift_size);
+  gst_rtsp_media_set_keyframe_index_location (media, index_location);
+  g_free (index_location);
+  if (!shared)
+    gst_rtsp_media_set_merge_window (media, merge_window);
   gst_rtsp_media_set_dscp_qos (media, dscp_qos);
   gst_rtsp_media_set_profiles (media, profiles);
   gst_rtsp_media_set_protocols (media, protocols);
@@ -1952,6 +3873,13 @@ default_configure (GstRTSPMediaFactory * factory, GstRTSPMedia * media)
   gst_rtsp_media_set_latency (media, latency);
   gst_rtsp_media_set_transport_mode (media, transport_mode);
   gst_rtsp_media_set_stop_on_disconnect (media, stop_on_disconnect);
+  if (shared && idle_timeout > 0) {
+    /* an idle media is prepared again when a new client comes */
+    gst_rtsp_media_set_reusable (media, TRUE);
+    gst_rtsp_media_set_idle_timeout (media, idle_timeout);
+  }
+  if (shared && keep_live_sdp)
+    gst_rtsp_media_set_keep_live_sdp (media, TRUE);
   gst_rtsp_media_set_publish_clock_mode (media, publish_clock_mode);
   gst_rtsp_media_set_max_mcast_ttl (media, ttl);
   gst_rtsp_media_set_bind_mcast_address (media, bind_mcast);
@@ -143,6 +143,79 @@ void                  gst_rtsp_media_factory_set_stop_on_disconnect       (GstRT
 GST_RTSP_SERVER_API
 gboolean              gst_rtsp_media_factory_is_stop_on_disonnect        (GstRTSPMediaFactory *factory);
 
+GST_RTSP_SERVER_API
+void                  gst_rtsp_media_factory_set_idle_timeout (GstRTSPMediaFactory *factory,
+                                                               guint timeout);
+
+GST_RTSP_SERVER_API
+guint                 gst_rtsp_media_factory_get_idle_timeout (GstRTSPMediaFactory *factory);
+
+GST_RTSP_SERVER_API
+void                  gst_rtsp_media_factory_set_keep_live_sdp (GstRTSPMediaFactory *factory,
+                                                                gboolean keep);
+
+GST_RTSP_SERVER_API
+gboolean              gst_rtsp_media_factory_is_keep_live_sdp (GstRTSPMediaFactory *factory);
+
+GST_RTSP_SERVER_API
+void                  gst_rtsp_media_factory_set_gop_cache_size (GstRTSPMediaFactory *factory,
+                                                                 guint size);
+
+GST_RTSP_SERVER_API
+guint                 gst_rtsp_media_factory_get_gop_cache_size (GstRTSPMediaFactory *factory);
+
+GST_RTSP_SERVER_API
+void                  gst_rtsp_media_factory_set_force_keyunit_on_join (GstRTSPMediaFactory *factory,
+                                                                        gboolean force);
+
+GST_RTSP_SERVER_API
+gboolean              gst_rtsp_media_factory_is_force_keyunit_on_join (GstRTSPMediaFactory *factory);
+
+GST_RTSP_SERVER_API
+void                  gst_rtsp_media_factory_set_force_keyunit_interval (GstRTSPMediaFactory *factory,
+                                                                         GstClockTime interval);
+
+GST_RTSP_SERVER_API
+GstClockTime          gst_rtsp_media_factory_get_force_keyunit_interval (GstRTSPMediaFactory *factory);
+
+GST_RTSP_SERVER_API
+void                  gst_rtsp_media_factory_set_deactivate_unused_streams (GstRTSPMediaFactory *factory,
+                                                                            gboolean deactivate);
+
+GST_RTSP_SERVER_API
+gboolean              gst_rtsp_media_factory_is_deactivate_unused_streams (GstRTSPMediaFactory *factory);
+
+GST_RTSP_SERVER_API
+void                  gst_rtsp_media_factory_set_keyframe_trickmode (GstRTSPMediaFactory *factory,
+                                                                     gboolean keyframes);
+
+GST_RTSP_SERVER_API
+gboolean              gst_rtsp_media_factory_is_keyframe_trickmode (GstRTSPMediaFactory *factory);
+
+GST_RTSP_SERVER_API
+void                  gst_rtsp_media_factory_set_timeshift (GstRTSPMediaFactory *factory,
+                                                            GstClockTime duration,
+                                                            guint64 max_size);
+
+GST_RTSP_SERVER_API
+void                  gst_rtsp_media_factory_get_timeshift (GstRTSPMediaFactory *factory,
+                                                            GstClockTime *duration,
+                                                            guint64 *max_size);
+
+GST_RTSP_SERVER_API
+void                  gst_rtsp_media_factory_set_keyframe_index_dir (GstRTSPMediaFactory *factory,
+                                                                     const gchar *dir);
+
+GST_RTSP_SERVER_API
+gchar *               gst_rtsp_media_factory_get_keyframe_index_dir (GstRTSPMediaFactory *factory);
+
+GST_RTSP_SERVER_API
+void                  gst_rtsp_media_factory_set_merge_window (GstRTSPMediaFactory *factory,
+                                                               GstClockTime window);
+
+GST_RTSP_SERVER_API
+GstClockTime          gst_rtsp_media_factory_get_merge_window (GstRTSPMediaFactory *factory);
+
 GST_RTSP_SERVER_API
 void                  gst_rtsp_media_factory_set_suspend_mode (GstRTSPMediaFactory *factory,
                                                                GstRTSPSuspendMode mode);
@@ -265,6 +338,23 @@ void                  gst_rtsp_media_factory_set_enable_rtcp (GstRTSPMediaFactor
 GST_RTSP_SERVER_API
 gboolean              gst_rtsp_media_factory_is_enable_rtcp (GstRTSPMediaFactory * factory);
 
+GST_RTSP_SERVER_API
+void                  gst_rtsp_media_factory_set_thread_pool (GstRTSPMediaFactory * factory,
+                                                              GstRTSPThreadPool * pool);
+
+GST_RTSP_SERVER_API
+GstRTSPThreadPool *   gst_rtsp_media_factory_get_thread_pool (GstRTSPMediaFactory * factory);
+
+GST_RTSP_SERVER_API
+void                  gst_rtsp_media_factory_set_prewarm_size (GstRTSPMediaFactory * factory,
+                                                               guint size);
+
+GST_RTSP_SERVER_API
+guint                 gst_rtsp_media_factory_get_prewarm_size (GstRTSPMediaFactory * factory);
+
+GST_RTSP_SERVER_API
+GstStructure *        gst_rtsp_media_factory_get_prewarm_stats (GstRTSPMediaFactory * factory);
+
 /* creating the media from the factory and a url */
 
 GST_RTSP_SERVER_API
@@ -71,6 +71,8 @@
 #include <string.h>
 #include <stdlib.h>
 
+#include <glib/gstdio.h>
+
 #include <gst/app/gstappsrc.h>
 #include <gst/app/gstappsink.h>
 
@@ -85,6 +87,26 @@
 
 #include "rtsp-media.h"
 #include "rtsp-server-internal.h"
+#include "rtsp-keyframe-index.h"
+
+typedef struct
+{
+  guint cookie;
+  gchar *sdp;
+} SDPCacheEntry;
+
+static void
+sdp_cache_entry_free (SDPCacheEntry * entry)
+{
+  g_free (entry->sdp);
+  g_slice_free (SDPCacheEntry, entry);
+}
+
+typedef struct
+{
+  GstPad *pad;
+  gulong id;
+} IndexProbe;
 
 struct _GstRTSPMediaPrivate
 {
@@ -116,18 +138,58 @@ struct _GstRTSPMediaPrivate
   gboolean blocked;
   GstRTSPTransportMode transport_mode;
   gboolean stop_on_disconnect;
+  guint idle_timeout;
+  guint gop_cache_size;
+  gboolean force_keyunit_on_join;
+  GstClockTime force_keyunit_interval;
+  gboolean deactivate_unused_streams;
+  gboolean keyframe_trickmode;
+  GstClockTime timeshift_duration;
+  guint64 timeshift_size;
+  GstClockTime merge_window;
   guint blocking_msg_received;
 
+  /* keyframe index of a VOD media, protected by index_lock because it is
+   * updated from the streaming threads */
+  GMutex index_lock;
+  gchar *index_location;
+  GstRTSPKeyframeIndex *index;  /* loaded or completely recorded index */
+  GstRTSPKeyframeIndex *index_recording;
+  GstPad *index_pad;            /* the pad whose keyframes are recorded */
+  GArray *index_probes;         /* of IndexProbe, protected by state_lock */
+
   GstElement *element;
   GRecMutex state_lock;         /* locking order: state lock, lock */
   GPtrArray *streams;           /* protected by lock */
   GList *dynamic;               /* protected by lock */
   GstRTSPMediaStatus status;    /* protected by lock */
+  GList *prepare_waiters;       /* protected by lock */
   gint prepare_count;
   gint n_active;
   gboolean complete;
   gboolean finishing_unprepare;
 
+  /* keeps an unused shared media prepared, protected by state_lock */
+  GSource *idle_source;
+  /* the part of the SDP that was added by the last setup_sdp, used to
+   * describe the media while it prepares again after it was idle, protected
+   * by state_lock */
+  GstSDPMessage *idle_sdp;
+  gboolean idle_sdp_ipv6;
+  gchar *idle_sdp_server_ip;
+  /* also keep the SDP of a live media after it was unprepared */
+  gboolean keep_live_sdp;
+  /* the media was prepared after it was described from idle_sdp and the
+   * SDP of the prepared streams was not compared with it yet */
+  gboolean idle_sdp_unchecked;
+  gboolean idle_sdp_changed;
+
+  /* serialized SDPs of the prepared media, protected by lock */
+  guint sdp_cookie;
+  GHashTable *sdp_cache;        /* info key -> SDPCacheEntry */
+  guint64 sdp_cache_hits;
+  guint64 sdp_cache_misses;
+
   /* the pipeline for the media */
   GstElement *pipeline;
   GSource *source;
@@ -177,6 +239,16 @@ struct _GstRTSPMediaPrivate
 #define DEFAULT_LATENCY         200
 #define DEFAULT_TRANSPORT_MODE  GST_RTSP_TRANSPORT_MODE_PLAY
 #define DEFAULT_STOP_ON_DISCONNECT TRUE
+#define DEFAULT_IDLE_TIMEOUT    0
+#define DEFAULT_GOP_CACHE_SIZE  0
+#define DEFAULT_FORCE_KEYUNIT_ON_JOIN FALSE
+#define DEFAULT_FORCE_KEYUNIT_INTERVAL GST_SECOND
+#define DEFAULT_DEACTIVATE_UNUSED_STREAMS FALSE
+#define DEFAULT_KEYFRAME_TRICKMODE FALSE
+#define DEFAULT_TIMESHIFT_DURATION 0
+#define DEFAULT_TIMESHIFT_SIZE  (64 * 1024 * 1024)
+#define DEFAULT_KEYFRAME_INDEX_LOCATION NULL
+#define DEFAULT_MERGE_WINDOW    0
 #define DEFAULT_MAX_MCAST_TTL   255
 #define DEFAULT_BIND_MCAST_ADDRESS FALSE
 #define DEFAULT_DO_RATE_CONTROL TRUE
@@ -206,6 +278,16 @@ enum
   PROP_MAX_MCAST_TTL,
   PROP_BIND_MCAST_ADDRESS,
   PROP_DSCP_QOS,
+  PROP_IDLE_TIMEOUT,
+  PROP_GOP_CACHE_SIZE,
+  PROP_FORCE_KEYUNIT_ON_JOIN,
+  PROP_FORCE_KEYUNIT_INTERVAL,
+  PROP_DEACTIVATE_UNUSED_STREAMS,
+  PROP_KEYFRAME_TRICKMODE,
+  PROP_TIMESHIFT_DURATION,
+  PROP_TIMESHIFT_SIZE,
+  PROP_KEYFRAME_INDEX_LOCATION,
+  PROP_MERGE_WINDOW,
   PROP_LAST
 };
 
@@ -268,6 +350,8 @@ gst_rtsp_suspend_mode_get_type (void)
         "pause"},
     {C_ENUM (GST_RTSP_SUSPEND_MODE_RESET), "GST_RTSP_SUSPEND_MODE_RESET",
         "reset"},
+    {C_ENUM (GST_RTSP_SUSPEND_MODE_GATE), "GST_RTSP_SUSPEND_MODE_GATE",
+        "gate"},
     {0, NULL, NULL}
   };
 
@@ -421,6 +505,151 @@ gst_rtsp_media_class_init (GstRTSPMediaClass * klass)
           "The IP DSCP field to use for each related stream", -1, 63,
           DEFAULT_DSCP_QOS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstRTSPMedia:idle-timeout:
+   *
+   * The number of seconds a shared and reusable media stays prepared after
+   * it was unprepared by its last user, 0 unprepares it immediately.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_IDLE_TIMEOUT,
+      g_param_spec_uint ("idle-timeout", "Idle Timeout",
+          "Seconds to keep a shared media prepared after its last user left "
+          "(0 = unprepare immediately)", 0, G_MAXUINT, DEFAULT_IDLE_TIMEOUT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstRTSPMedia:gop-cache-size:
+   *
+   * The maximum number of bytes of RTP packets each stream keeps since its
+   * last keyframe to send to new clients, 0 disables the cache.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_GOP_CACHE_SIZE,
+      g_param_spec_uint ("gop-cache-size", "GOP Cache Size",
+          "Bytes of the last GOP of each stream to send to new clients "
+          "(0 = disabled)", 0, G_MAXUINT, DEFAULT_GOP_CACHE_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstRTSPMedia:force-keyunit-on-join:
+   *
+   * Request a keyframe from the encoders of a shared live media when a
+   * client starts playing.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_FORCE_KEYUNIT_ON_JOIN,
+      g_param_spec_boolean ("force-keyunit-on-join", "Force Keyunit On Join",
+          "Request a keyframe when a client joins a shared live media",
+          DEFAULT_FORCE_KEYUNIT_ON_JOIN,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstRTSPMedia:force-keyunit-interval:
+   *
+   * The minimum time in nanoseconds between two keyframes requested by
+   * #GstRTSPMedia:force-keyunit-on-join for the same stream.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_FORCE_KEYUNIT_INTERVAL,
+      g_param_spec_uint64 ("force-keyunit-interval", "Force Keyunit Interval",
+          "Minimum time in nanoseconds between requested keyframes", 0,
+          G_MAXUINT64, DEFAULT_FORCE_KEYUNIT_INTERVAL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstRTSPMedia:deactivate-unused-streams:
+   *
+   * Stop feeding the encoders of the streams of a live media that no client
+   * receives.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_DEACTIVATE_UNUSED_STREAMS,
+      g_param_spec_boolean ("deactivate-unused-streams",
+          "Deactivate Unused Streams",
+          "Stop encoding the streams of a live media that no client receives",
+          DEFAULT_DEACTIVATE_UNUSED_STREAMS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstRTSPMedia:keyframe-trickmode:
+   *
+   * Send only the keyframes of the streams during trick play, see
+   * gst_rtsp_media_set_keyframe_trickmode().
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_KEYFRAME_TRICKMODE,
+      g_param_spec_boolean ("keyframe-trickmode", "Keyframe Trickmode",
+          "Send only the keyframes during trick play",
+          DEFAULT_KEYFRAME_TRICKMODE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstRTSPMedia:timeshift-duration:
+   *
+   * How long in nanoseconds the streams of a live media keep their RTP
+   * packets for clients that play from the past, 0 disables time-shifting.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_TIMESHIFT_DURATION,
+      g_param_spec_uint64 ("timeshift-duration", "Time-shift Duration",
+          "Nanoseconds of packets kept for clients that play from the past "
+          "(0 = disabled)", 0, G_MAXUINT64, DEFAULT_TIMESHIFT_DURATION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstRTSPMedia:timeshift-size:
+   *
+   * The maximum number of bytes of RTP packets each stream keeps for
+   * clients that play from the past.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_TIMESHIFT_SIZE,
+      g_param_spec_uint64 ("timeshift-size", "Time-shift Size",
+          "Maximum bytes of packets kept by each stream for time-shifting",
+          0, G_MAXUINT64, DEFAULT_TIMESHIFT_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstRTSPMedia:keyframe-index-location:
+   *
+   * The file with the keyframe index of a VOD media, see
+   * gst_rtsp_media_set_keyframe_index_location().
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_KEYFRAME_INDEX_LOCATION,
+      g_param_spec_string ("keyframe-index-location", "Keyframe Index Location",
+          "The file with the keyframe index used for seeking",
+          DEFAULT_KEYFRAME_INDEX_LOCATION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstRTSPMedia:merge-window:
+   *
+   * How far from its current position new clients of a VOD media can start
+   * to play it together with the clients that already play it, see
+   * gst_rtsp_media_set_merge_window().
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_MERGE_WINDOW,
+      g_param_spec_uint64 ("merge-window", "Merge Window",
+          "Nanoseconds from the current position within which new clients "
+          "join the playback of the VOD media (0 = disabled)", 0,
+          G_MAXUINT64, DEFAULT_MERGE_WINDOW,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gst_rtsp_media_signals[SIGNAL_NEW_STREAM] =
       g_signal_new ("new-stream", G_TYPE_FROM_CLASS (klass), G_SIGNAL_RUN_LAST,
       G_STRUCT_OFFSET (GstRTSPMediaClass, new_stream), NULL, NULL, NULL,
@@ -478,6 +707,7 @@ gst_rtsp_media_init (GstRTSPMedia * media)
   g_mutex_init (&priv->global_lock);
   g_cond_init (&priv->cond);
   g_rec_mutex_init (&priv->state_lock);
+  g_mutex_init (&priv->index_lock);
 
   priv->shared = DEFAULT_SHARED;
   priv->suspend_mode = DEFAULT_SUSPEND_MODE;
@@ -489,6 +719,19 @@ gst_rtsp_media_init (GstRTSPMedia * media)
   priv->time_provider = DEFAULT_TIME_PROVIDER;
   priv->transport_mode = DEFAULT_TRANSPORT_MODE;
   priv->stop_on_disconnect = DEFAULT_STOP_ON_DISCONNECT;
+  priv->idle_timeout = DEFAULT_IDLE_TIMEOUT;
+  priv->gop_cache_size = DEFAULT_GOP_CACHE_SIZE;
+  priv->force_keyunit_on_join = DEFAULT_FORCE_KEYUNIT_ON_JOIN;
+  priv->force_keyunit_interval = DEFAULT_FORCE_KEYUNIT_INTERVAL;
+  priv->deactivate_unused_streams = DEFAULT_DEACTIVATE_UNUSED_STREAMS;
+  priv->keyframe_trickmode = DEFAULT_KEYFRAME_TRICKMODE;
+  priv->timeshift_duration = DEFAULT_TIMESHIFT_DURATION;
+  priv->timeshift_size = DEFAULT_TIMESHIFT_SIZE;
+  priv->index_location = g_strdup (DEFAULT_KEYFRAME_INDEX_LOCATION);
+  priv->merge_window = DEFAULT_MERGE_WINDOW;
+  priv->index_probes = g_array_new (FALSE, FALSE, sizeof (IndexProbe));
+  priv->sdp_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      (GDestroyNotify) sdp_cache_entry_free);
   priv->publish_clock_mode = GST_RTSP_PUBLISH_CLOCK_MODE_CLOCK;
   priv->do_retransmission = DEFAULT_DO_RETRANSMISSION;
   priv->max_mcast_ttl = DEFAULT_MAX_MCAST_TTL;
@@ -523,6 +766,10 @@ gst_rtsp_media_finalize (GObject * obj)
     gst_object_unref (priv->pipeline);
   if (priv->nettime)
     gst_object_unref (priv->nettime);
+  if (priv->idle_sdp)
+    gst_sdp_message_free (priv->idle_sdp);
+  g_free (priv->idle_sdp_server_ip);
+  g_hash_table_unref (priv->sdp_cache);
   gst_object_unref (priv->element);
   if (priv->pool)
     g_object_unref (priv->pool);
@@ -531,6 +778,13 @@ gst_rtsp_media_finalize (GObject * obj)
   if (priv->clock)
     gst_object_unref (priv->clock);
   g_free (priv->multicast_iface);
+  g_free (priv->index_location);
+  if (priv->index)
+    gst_rtsp_keyframe_index_free (priv->index);
+  if (priv->index_recording)
+    gst_rtsp_keyframe_index_free (priv->index_recording);
+  g_array_unref (priv->index_probes);
+  g_mutex_clear (&priv->index_lock);
   g_mutex_clear (&priv->lock);
   g_mutex_clear (&priv->global_lock);
   g_cond_clear (&priv->cond);
@@ -594,6 +848,50 @@ gst_rtsp_media_get_property (GObject * object, guint propid,
     case PROP_DSCP_QOS:
       g_value_set_int (value, gst_rtsp_media_get_dscp_qos (media));
       break;
+    case PROP_IDLE_TIMEOUT:
+      g_value_set_uint (value, gst_rtsp_media_get_idle_timeout (media));
+      break;
+    case PROP_GOP_CACHE_SIZE:
+      g_value_set_uint (value, gst_rtsp_media_get_gop_cache_size (media));
+      break;
+    case PROP_FORCE_KEYUNIT_ON_JOIN:
+      g_value_set_boolean (value,
+          gst_rtsp_media_is_force_keyunit_on_join (media));
+      break;
+    case PROP_FORCE_KEYUNIT_INTERVAL:
+      g_value_set_uint64 (value,
+          gst_rtsp_media_get_force_keyunit_interval (media));
+      break;
+    case PROP_DEACTIVATE_UNUSED_STREAMS:
+      g_value_set_boolean (value,
+          gst_rtsp_media_is_deactivate_unused_streams (media));
+      break;
+    case PROP_KEYFRAME_TRICKMODE:
+      g_value_set_boolean (value, gst_rtsp_media_is_keyframe_trickmode (media));
+      break;
+    case PROP_TIMESHIFT_DURATION:
+    {
+      GstClockTime duration;
+
+      gst_rtsp_media_get_timeshift (media, &duration, NULL);
+      g_value_set_uint64 (value, duration);
+      break;
+    }
+    case PROP_TIMESHIFT_SIZE:
+    {
+      guint64 size;
+
+      gst_rtsp_media_get_timeshift (media, NULL, &size);
+      g_value_set_uint64 (value, size);
+      break;
+    }
+    case PROP_KEYFRAME_INDEX_LOCATION:
+      g_value_take_string (value,
+          gst_rtsp_media_get_keyframe_index_location (media));
+      break;
+    case PROP_MERGE_WINDOW:
+      g_value_set_uint64 (value, gst_rtsp_media_get_merge_window (media));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, propid, pspec);
   }
@@ -657,6 +955,52 @@ gst_rtsp_media_set_property (GObject * object, guint propid,
     case PROP_DSCP_QOS:
       gst_rtsp_media_set_dscp_qos (media, g_value_get_int (value));
       break;
+    case PROP_IDLE_TIMEOUT:
+      gst_rtsp_media_set_idle_timeout (media, g_value_get_uint (value));
+      break;
+    case PROP_GOP_CACHE_SIZE:
+      gst_rtsp_media_set_gop_cache_size (media, g_value_get_uint (value));
+      break;
+    case PROP_FORCE_KEYUNIT_ON_JOIN:
+      gst_rtsp_media_set_force_keyunit_on_join (media,
+          g_value_get_boolean (value));
+      break;
+    case PROP_FORCE_KEYUNIT_INTERVAL:
+      gst_rtsp_media_set_force_keyunit_interval (media,
+          g_value_get_uint64 (value));
+      break;
+    case PROP_DEACTIVATE_UNUSED_STREAMS:
+      gst_rtsp_media_set_deactivate_unused_streams (media,
+          g_value_get_boolean (value));
+      break;
+    case PROP_KEYFRAME_TRICKMODE:
+      gst_rtsp_media_set_keyframe_trickmode (media,
+          g_value_get_boolean (value));
+      break;
+    case PROP_TIMESHIFT_DURATION:
+    {
+      guint64 size;
+
+      gst_rtsp_media_get_timeshift (media, NULL, &size);
+      gst_rtsp_media_set_timeshift (media, g_value_get_uint64 (value), size);
+      break;
+    }
+    case PROP_TIMESHIFT_SIZE:
+    {
+      GstClockTime duration;
+
+      gst_rtsp_media_get_timeshift (media, &duration, NULL);
+      gst_rtsp_media_set_timeshift (media, duration,
+          g_value_get_uint64 (value));
+      break;
+    }
+    case PROP_KEYFRAME_INDEX_LOCATION:
+      gst_rtsp_media_set_keyframe_index_location (media,
+          g_value_get_string (value));
+      break;
+    case PROP_MERGE_WINDOW:
+      gst_rtsp_media_set_merge_window (media, g_value_get_uint64 (value));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, propid, pspec);
   }
@@ -1127,6 +1471,39 @@ gst_rtsp_media_get_suspend_mode (GstRTSPMedia * media)
   return res;
 }
 
+/* Configure the settings of @stream that only apply to live media.
+ * Must be called with priv->lock */
+static void
+update_live_stream_unlocked (GstRTSPMedia * media, GstRTSPStream * stream)
+{
+  GstRTSPMediaPrivate *priv = media->priv;
+  GstClockTime interval = GST_CLOCK_TIME_NONE;
+
+  /* only request keyframes for new clients of shared live media, other media
+   * start a new stream with a keyframe for each client */
+  if (priv->shared && priv->is_live && priv->force_keyunit_on_join)
+    interval = priv->force_keyunit_interval;
+  gst_rtsp_stream_set_force_keyunit_interval (stream, interval);
+
+  /* media that are not live need the data of all streams to preroll */
+  gst_rtsp_stream_set_idle_unused (stream, priv->is_live &&
+      priv->deactivate_unused_streams);
+}
+
+/* Must be called with priv->lock */
+static void
+update_live_streams_unlocked (GstRTSPMedia * media)
+{
+  GstRTSPMediaPrivate *priv = media->priv;
+  guint i;
+
+  for (i = 0; i < priv->streams->len; i++) {
+    GstRTSPStream *stream = g_ptr_array_index (priv->streams, i);
+
+    update_live_stream_unlocked (media, stream);
+  }
+}
+
 /**
  * gst_rtsp_media_set_shared:
  * @media: a #GstRTSPMedia
@@ -1147,6 +1524,7 @@ gst_rtsp_media_set_shared (GstRTSPMedia * media, gboolean shared)
 
   g_mutex_lock (&priv->lock);
   priv->shared = shared;
+  update_live_streams_unlocked (media);
   g_mutex_unlock (&priv->lock);
 }
 
@@ -1546,302 +1924,1073 @@ gst_rtsp_media_is_stop_on_disconnect (GstRTSPMedia * media)
 }
 
 /**
- * gst_rtsp_media_set_retransmission_time:
+ * gst_rtsp_media_set_idle_timeout:
  * @media: a #GstRTSPMedia
- * @time: the new value
+ * @timeout: the timeout in seconds
  *
- * Set the amount of time to store retransmission packets.
+ * Keep a shared and reusable @media prepared for @timeout seconds after the
+ * last user unprepared it. When nobody prepares @media again within
+ * @timeout, it is unprepared and its sockets are released. The SDP of the
+ * last DESCRIBE is kept so that @media can be described again while it is
+ * preparing.
+ *
+ * A @timeout of 0 unprepares @media as soon as its last user unprepares it.
+ *
+ * Since: 1.20
  */
 void
-gst_rtsp_media_set_retransmission_time (GstRTSPMedia * media, GstClockTime time)
+gst_rtsp_media_set_idle_timeout (GstRTSPMedia * media, guint timeout)
 {
   GstRTSPMediaPrivate *priv;
-  guint i;
 
   g_return_if_fail (GST_IS_RTSP_MEDIA (media));
 
-  GST_LOG_OBJECT (media, "set retransmission time %" G_GUINT64_FORMAT, time);
-
   priv = media->priv;
 
   g_mutex_lock (&priv->lock);
-  priv->rtx_time = time;
-  for (i = 0; i < priv->streams->len; i++) {
-    GstRTSPStream *stream = g_ptr_array_index (priv->streams, i);
-
-    gst_rtsp_stream_set_retransmission_time (stream, time);
-  }
+  priv->idle_timeout = timeout;
   g_mutex_unlock (&priv->lock);
 }
 
 /**
- * gst_rtsp_media_get_retransmission_time:
+ * gst_rtsp_media_get_idle_timeout:
  * @media: a #GstRTSPMedia
  *
- * Get the amount of time to store retransmission data.
+ * Get the number of seconds @media stays prepared after its last user
+ * unprepared it.
  *
- * Returns: the amount of time to store retransmission data.
+ * Returns: the idle timeout of @media in seconds.
+ *
+ * Since: 1.20
  */
-GstClockTime
-gst_rtsp_media_get_retransmission_time (GstRTSPMedia * media)
+guint
+gst_rtsp_media_get_idle_timeout (GstRTSPMedia * media)
 {
   GstRTSPMediaPrivate *priv;
-  GstClockTime res;
+  guint res;
 
-  g_return_val_if_fail (GST_IS_RTSP_MEDIA (media), FALSE);
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA (media), 0);
 
   priv = media->priv;
 
   g_mutex_lock (&priv->lock);
-  res = priv->rtx_time;
+  res = priv->idle_timeout;
   g_mutex_unlock (&priv->lock);
 
   return res;
 }
 
 /**
- * gst_rtsp_media_set_do_retransmission:
+ * gst_rtsp_media_set_gop_cache_size:
+ * @media: a #GstRTSPMedia
+ * @size: the maximum size in bytes, 0 disables the cache
  *
- * Set whether retransmission requests will be sent
+ * Make the streams of @media keep the RTP packets since their last
+ * keyframe, up to @size bytes each, and send them to new clients before the
+ * live packets. See gst_rtsp_stream_set_gop_cache_size().
  *
- * Since: 1.16
+ * Since: 1.20
  */
 void
-gst_rtsp_media_set_do_retransmission (GstRTSPMedia * media,
-    gboolean do_retransmission)
+gst_rtsp_media_set_gop_cache_size (GstRTSPMedia * media, guint size)
 {
   GstRTSPMediaPrivate *priv;
+  guint i;
 
   g_return_if_fail (GST_IS_RTSP_MEDIA (media));
 
+  GST_LOG_OBJECT (media, "set GOP cache size %u", size);
+
   priv = media->priv;
 
   g_mutex_lock (&priv->lock);
-  priv->do_retransmission = do_retransmission;
+  priv->gop_cache_size = size;
 
-  if (priv->rtpbin)
-    g_object_set (priv->rtpbin, "do-retransmission", do_retransmission, NULL);
+  for (i = 0; i < priv->streams->len; i++) {
+    GstRTSPStream *stream = g_ptr_array_index (priv->streams, i);
+    gst_rtsp_stream_set_gop_cache_size (stream, size);
+  }
   g_mutex_unlock (&priv->lock);
 }
 
 /**
- * gst_rtsp_media_get_do_retransmission:
+ * gst_rtsp_media_get_gop_cache_size:
+ * @media: a #GstRTSPMedia
  *
- * Returns: Whether retransmission requests will be sent
+ * Get the maximum size of the GOP cache of the streams of @media.
  *
- * Since: 1.16
+ * Returns: the size of the GOP cache in bytes, 0 when it is disabled.
+ *
+ * Since: 1.20
  */
-gboolean
-gst_rtsp_media_get_do_retransmission (GstRTSPMedia * media)
+guint
+gst_rtsp_media_get_gop_cache_size (GstRTSPMedia * media)
 {
   GstRTSPMediaPrivate *priv;
-  gboolean res;
+  guint res;
 
   g_return_val_if_fail (GST_IS_RTSP_MEDIA (media), 0);
 
   priv = media->priv;
 
   g_mutex_lock (&priv->lock);
-  res = priv->do_retransmission;
+  res = priv->gop_cache_size;
   g_mutex_unlock (&priv->lock);
 
   return res;
 }
 
-static void
-update_stream_storage_size (GstRTSPMedia * media, GstRTSPStream * stream,
-    guint sessid)
-{
-  GObject *storage = NULL;
-
-  g_signal_emit_by_name (G_OBJECT (media->priv->rtpbin), "get-storage",
-      sessid, &storage);
-
-  if (storage) {
-    guint64 size_time = 0;
-
-    if (!gst_rtsp_stream_is_tcp_receiver (stream))
-      size_time = (media->priv->latency + 50) * GST_MSECOND;
-
-    g_object_set (storage, "size-time", size_time, NULL);
-
-    g_object_unref (storage);
-  }
-}
-
 /**
- * gst_rtsp_media_set_latency:
+ * gst_rtsp_media_set_force_keyunit_on_join:
  * @media: a #GstRTSPMedia
- * @latency: latency in milliseconds
+ * @force: the new value
  *
- * Configure the latency used for receiving media.
+ * Request a keyframe from the encoders of @media when a client starts
+ * playing it, so that the client does not have to wait for the next
+ * keyframe. This is only done for shared live media, other media start
+ * with a keyframe anyway. Keyframes are requested at most once per
+ * #GstRTSPMedia:force-keyunit-interval for each stream, so that many
+ * clients joining at the same time do not make the encoders produce only
+ * keyframes.
+ *
+ * This is an alternative to gst_rtsp_media_set_gop_cache_size() that does
+ * not need memory, at the cost of a larger bitrate when clients join.
+ *
+ * Since: 1.20
  */
 void
-gst_rtsp_media_set_latency (GstRTSPMedia * media, guint latency)
+gst_rtsp_media_set_force_keyunit_on_join (GstRTSPMedia * media,
+    gboolean force)
 {
   GstRTSPMediaPrivate *priv;
-  guint i;
 
   g_return_if_fail (GST_IS_RTSP_MEDIA (media));
 
-  GST_LOG_OBJECT (media, "set latency %ums", latency);
-
   priv = media->priv;
 
   g_mutex_lock (&priv->lock);
-  priv->latency = latency;
-  if (priv->rtpbin) {
-    g_object_set (priv->rtpbin, "latency", latency, NULL);
-
-    for (i = 0; i < media->priv->streams->len; i++) {
-      GstRTSPStream *stream = g_ptr_array_index (media->priv->streams, i);
-      update_stream_storage_size (media, stream, i);
-    }
-  }
-
+  priv->force_keyunit_on_join = force;
+  update_live_streams_unlocked (media);
   g_mutex_unlock (&priv->lock);
 }
 
 /**
- * gst_rtsp_media_get_latency:
+ * gst_rtsp_media_is_force_keyunit_on_join:
  * @media: a #GstRTSPMedia
  *
- * Get the latency that is used for receiving media.
+ * Check if @media requests a keyframe when a client joins.
  *
- * Returns: latency in milliseconds
+ * Returns: %TRUE if @media requests keyframes for new clients.
+ *
+ * Since: 1.20
  */
-guint
-gst_rtsp_media_get_latency (GstRTSPMedia * media)
+gboolean
+gst_rtsp_media_is_force_keyunit_on_join (GstRTSPMedia * media)
 {
   GstRTSPMediaPrivate *priv;
-  guint res;
+  gboolean res;
 
   g_return_val_if_fail (GST_IS_RTSP_MEDIA (media), FALSE);
 
   priv = media->priv;
 
   g_mutex_lock (&priv->lock);
-  res = priv->latency;
+  res = priv->force_keyunit_on_join;
   g_mutex_unlock (&priv->lock);
 
   return res;
 }
 
 /**
- * gst_rtsp_media_use_time_provider:
+ * gst_rtsp_media_set_force_keyunit_interval:
  * @media: a #GstRTSPMedia
- * @time_provider: if a #GstNetTimeProvider should be used
+ * @interval: the minimum time between keyframe requests
  *
- * Set @media to provide a #GstNetTimeProvider.
+ * Set the minimum time between two keyframes that are requested for the
+ * same stream of @media when clients join.
+ *
+ * Since: 1.20
  */
 void
-gst_rtsp_media_use_time_provider (GstRTSPMedia * media, gboolean time_provider)
+gst_rtsp_media_set_force_keyunit_interval (GstRTSPMedia * media,
+    GstClockTime interval)
 {
   GstRTSPMediaPrivate *priv;
 
   g_return_if_fail (GST_IS_RTSP_MEDIA (media));
+  g_return_if_fail (GST_CLOCK_TIME_IS_VALID (interval));
 
   priv = media->priv;
 
   g_mutex_lock (&priv->lock);
-  priv->time_provider = time_provider;
+  priv->force_keyunit_interval = interval;
+  update_live_streams_unlocked (media);
   g_mutex_unlock (&priv->lock);
 }
 
 /**
- * gst_rtsp_media_is_time_provider:
+ * gst_rtsp_media_get_force_keyunit_interval:
  * @media: a #GstRTSPMedia
  *
- * Check if @media can provide a #GstNetTimeProvider for its pipeline clock.
+ * Get the minimum time between two keyframes that are requested for the
+ * same stream of @media when clients join.
  *
- * Use gst_rtsp_media_get_time_provider() to get the network clock.
+ * Returns: the minimum time between keyframe requests.
  *
- * Returns: %TRUE if @media can provide a #GstNetTimeProvider.
+ * Since: 1.20
  */
-gboolean
-gst_rtsp_media_is_time_provider (GstRTSPMedia * media)
+GstClockTime
+gst_rtsp_media_get_force_keyunit_interval (GstRTSPMedia * media)
 {
   GstRTSPMediaPrivate *priv;
-  gboolean res;
+  GstClockTime res;
 
-  g_return_val_if_fail (GST_IS_RTSP_MEDIA (media), FALSE);
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA (media), GST_CLOCK_TIME_NONE);
 
   priv = media->priv;
 
   g_mutex_lock (&priv->lock);
-  res = priv->time_provider;
+  res = priv->force_keyunit_interval;
   g_mutex_unlock (&priv->lock);
 
   return res;
 }
 
 /**
- * gst_rtsp_media_set_clock:
+ * gst_rtsp_media_get_force_keyunit_stats:
  * @media: a #GstRTSPMedia
- * @clock: (nullable): #GstClock to be used
  *
- * Configure the clock used for the media.
+ * Get statistics about the keyframes that @media requested for joining
+ * clients. The returned structure is called
+ * "application/x-rtsp-media-force-keyunit-stats" and has the following
+ * fields:
+ *
+ * - "honored" (G_TYPE_UINT64): the number of keyframes that were requested
+ * - "suppressed" (G_TYPE_UINT64): the number of joining clients for which no
+ *   keyframe was requested because one was requested less than
+ *   #GstRTSPMedia:force-keyunit-interval before
+ *
+ * Returns: (transfer full): a #GstStructure with the statistics, free with
+ * gst_structure_free().
+ *
+ * Since: 1.20
  */
-void
-gst_rtsp_media_set_clock (GstRTSPMedia * media, GstClock * clock)
+GstStructure *
+gst_rtsp_media_get_force_keyunit_stats (GstRTSPMedia * media)
 {
   GstRTSPMediaPrivate *priv;
+  guint64 honored = 0, suppressed = 0;
+  guint i;
 
-  g_return_if_fail (GST_IS_RTSP_MEDIA (media));
-  g_return_if_fail (GST_IS_CLOCK (clock) || clock == NULL);
-
-  GST_LOG_OBJECT (media, "setting clock %" GST_PTR_FORMAT, clock);
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA (media), NULL);
 
   priv = media->priv;
 
   g_mutex_lock (&priv->lock);
-  if (priv->clock)
-    gst_object_unref (priv->clock);
-  priv->clock = clock ? gst_object_ref (clock) : NULL;
-  if (priv->pipeline) {
-    if (clock)
-      gst_pipeline_use_clock (GST_PIPELINE_CAST (priv->pipeline), clock);
-    else
-      gst_pipeline_auto_clock (GST_PIPELINE_CAST (priv->pipeline));
-  }
+  for (i = 0; i < priv->streams->len; i++) {
+    GstRTSPStream *stream = g_ptr_array_index (priv->streams, i);
+    guint64 h, s;
 
+    gst_rtsp_stream_get_force_keyunit_stats (stream, &h, &s);
+    honored += h;
+    suppressed += s;
+  }
   g_mutex_unlock (&priv->lock);
+
+  return gst_structure_new ("application/x-rtsp-media-force-keyunit-stats",
+      "honored", G_TYPE_UINT64, honored,
+      "suppressed", G_TYPE_UINT64, suppressed, NULL);
 }
 
 /**
- * gst_rtsp_media_set_publish_clock_mode:
+ * gst_rtsp_media_set_deactivate_unused_streams:
  * @media: a #GstRTSPMedia
- * @mode: the clock publish mode
+ * @deactivate: the new value
  *
- * Sets if and how the media clock should be published according to RFC7273.
+ * Drop the data of the streams of a live @media that have no active
+ * transports before it reaches their encoder, so that streams that no
+ * client set up, like the audio of a client that only receives video, do
+ * not use CPU for encoding and payloading. When a transport is added to
+ * such a stream again, a keyframe is requested from the encoder and the
+ * stream resumes at the first keyframe.
  *
- * Since: 1.8
+ * Media that are not live need the data of all streams to preroll and are
+ * not affected.
+ *
+ * Since: 1.20
  */
 void
-gst_rtsp_media_set_publish_clock_mode (GstRTSPMedia * media,
-    GstRTSPPublishClockMode mode)
+gst_rtsp_media_set_deactivate_unused_streams (GstRTSPMedia * media,
+    gboolean deactivate)
 {
   GstRTSPMediaPrivate *priv;
-  guint i, n;
 
-  priv = media->priv;
-  g_mutex_lock (&priv->lock);
-  priv->publish_clock_mode = mode;
+  g_return_if_fail (GST_IS_RTSP_MEDIA (media));
 
-  n = priv->streams->len;
-  for (i = 0; i < n; i++) {
-    GstRTSPStream *stream = g_ptr_array_index (priv->streams, i);
+  priv = media->priv;
 
-    gst_rtsp_stream_set_publish_clock_mode (stream, mode);
-  }
+  g_mutex_lock (&priv->lock);
+  priv->deactivate_unused_streams = deactivate;
+  update_live_streams_unlocked (media);
   g_mutex_unlock (&priv->lock);
 }
 
 /**
- * gst_rtsp_media_get_publish_clock_mode:
+ * gst_rtsp_media_is_deactivate_unused_streams:
  * @media: a #GstRTSPMedia
  *
- * Gets if and how the media clock should be published according to RFC7273.
+ * Check if @media stops encoding the streams that no client receives.
+ *
+ * Returns: %TRUE if unused streams are deactivated.
+ *
+ * Since: 1.20
+ */
+gboolean
+gst_rtsp_media_is_deactivate_unused_streams (GstRTSPMedia * media)
+{
+  GstRTSPMediaPrivate *priv;
+  gboolean res;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA (media), FALSE);
+
+  priv = media->priv;
+
+  g_mutex_lock (&priv->lock);
+  res = priv->deactivate_unused_streams;
+  g_mutex_unlock (&priv->lock);
+
+  return res;
+}
+
+/**
+ * gst_rtsp_media_set_keyframe_trickmode:
+ * @media: a #GstRTSPMedia
+ * @keyframes: the new value
+ *
+ * Send only the keyframes of the streams of @media during trick play, when
+ * a PLAY request with a Scale seeks @media with #GST_SEEK_FLAG_TRICKMODE
+ * and the demuxer and decoders push all frames anyway. This cuts the
+ * bandwidth and the payloading work for fast-forward and rewind. See
+ * gst_rtsp_stream_set_keyframe_trickmode().
+ *
+ * Needs to be set before @media is prepared.
+ *
+ * Since: 1.20
+ */
+void
+gst_rtsp_media_set_keyframe_trickmode (GstRTSPMedia * media,
+    gboolean keyframes)
+{
+  GstRTSPMediaPrivate *priv;
+  guint i;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA (media));
+
+  priv = media->priv;
+
+  g_mutex_lock (&priv->lock);
+  priv->keyframe_trickmode = keyframes;
+
+  for (i = 0; i < priv->streams->len; i++) {
+    GstRTSPStream *stream = g_ptr_array_index (priv->streams, i);
+    gst_rtsp_stream_set_keyframe_trickmode (stream, keyframes);
+  }
+  g_mutex_unlock (&priv->lock);
+}
+
+/**
+ * gst_rtsp_media_is_keyframe_trickmode:
+ * @media: a #GstRTSPMedia
+ *
+ * Check if @media sends only the keyframes of its streams during trick
+ * play.
+ *
+ * Returns: %TRUE if the other frames are dropped during trick play.
+ *
+ * Since: 1.20
+ */
+gboolean
+gst_rtsp_media_is_keyframe_trickmode (GstRTSPMedia * media)
+{
+  GstRTSPMediaPrivate *priv;
+  gboolean res;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA (media), FALSE);
+
+  priv = media->priv;
+
+  g_mutex_lock (&priv->lock);
+  res = priv->keyframe_trickmode;
+  g_mutex_unlock (&priv->lock);
+
+  return res;
+}
+
+/**
+ * gst_rtsp_media_set_timeshift:
+ * @media: a #GstRTSPMedia
+ * @duration: how long the packets are kept, 0 disables time-shifting
+ * @max_size: the maximum size in bytes of the packets of each stream
+ *
+ * Make the streams of the live @media keep the RTP packets of the last
+ * @duration, up to @max_size bytes each, in ring buffers in temporary files.
+ * Clients can then play from the past with a PLAY request with a past
+ * Range, see gst_rtsp_media_seek_timeshift(). See
+ * gst_rtsp_stream_set_timeshift().
+ *
+ * Needs to be set before @media is prepared.
+ *
+ * Since: 1.20
+ */
+void
+gst_rtsp_media_set_timeshift (GstRTSPMedia * media, GstClockTime duration,
+    guint64 max_size)
+{
+  GstRTSPMediaPrivate *priv;
+  guint i;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA (media));
+  g_return_if_fail (GST_CLOCK_TIME_IS_VALID (duration));
+
+  GST_LOG_OBJECT (media, "set time-shift %" GST_TIME_FORMAT ", %"
+      G_GUINT64_FORMAT " bytes", GST_TIME_ARGS (duration), max_size);
+
+  priv = media->priv;
+
+  g_mutex_lock (&priv->lock);
+  priv->timeshift_duration = duration;
+  priv->timeshift_size = max_size;
+
+  for (i = 0; i < priv->streams->len; i++) {
+    GstRTSPStream *stream = g_ptr_array_index (priv->streams, i);
+    gst_rtsp_stream_set_timeshift (stream, duration, max_size);
+  }
+  g_mutex_unlock (&priv->lock);
+}
+
+/**
+ * gst_rtsp_media_get_timeshift:
+ * @media: a #GstRTSPMedia
+ * @duration: (out) (allow-none): how long the packets are kept
+ * @max_size: (out) (allow-none): the maximum size of the packets of each
+ *   stream
+ *
+ * Get the limits of the time-shift ring buffers of the streams of @media.
+ *
+ * Since: 1.20
+ */
+void
+gst_rtsp_media_get_timeshift (GstRTSPMedia * media, GstClockTime * duration,
+    guint64 * max_size)
+{
+  GstRTSPMediaPrivate *priv;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA (media));
+
+  priv = media->priv;
+
+  g_mutex_lock (&priv->lock);
+  if (duration)
+    *duration = priv->timeshift_duration;
+  if (max_size)
+    *max_size = priv->timeshift_size;
+  g_mutex_unlock (&priv->lock);
+}
+
+/**
+ * gst_rtsp_media_set_keyframe_index_location:
+ * @media: a #GstRTSPMedia
+ * @location: (allow-none): a file name
+ *
+ * Use the keyframe index in @location for seeking in the VOD @media. When
+ * the file does not exist yet, the keyframes of the first video stream are
+ * recorded while @media plays from start to end and the index is saved in
+ * @location on EOS. Seeks with #GST_SEEK_FLAG_KEY_UNIT then start at the
+ * keyframe from the index and the demuxer no longer needs to search for it.
+ *
+ * An index is recorded again when the size or modification time of the file
+ * that @media plays, from a file:// uri or a filesrc, changed. An index is
+ * also ignored when its duration does not match the duration of @media.
+ *
+ * Needs to be set before @media is prepared.
+ *
+ * Since: 1.20
+ */
+void
+gst_rtsp_media_set_keyframe_index_location (GstRTSPMedia * media,
+    const gchar * location)
+{
+  GstRTSPMediaPrivate *priv;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA (media));
+
+  GST_LOG_OBJECT (media, "set keyframe index location %s",
+      GST_STR_NULL (location));
+
+  priv = media->priv;
+
+  g_mutex_lock (&priv->index_lock);
+  g_free (priv->index_location);
+  priv->index_location = g_strdup (location);
+  g_mutex_unlock (&priv->index_lock);
+}
+
+/**
+ * gst_rtsp_media_get_keyframe_index_location:
+ * @media: a #GstRTSPMedia
+ *
+ * Get the file with the keyframe index of @media.
+ *
+ * Returns: (transfer full) (nullable): the location of the keyframe index,
+ * g_free() after usage.
+ *
+ * Since: 1.20
+ */
+gchar *
+gst_rtsp_media_get_keyframe_index_location (GstRTSPMedia * media)
+{
+  GstRTSPMediaPrivate *priv;
+  gchar *result;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA (media), NULL);
+
+  priv = media->priv;
+
+  g_mutex_lock (&priv->index_lock);
+  result = g_strdup (priv->index_location);
+  g_mutex_unlock (&priv->index_lock);
+
+  return result;
+}
+
+/**
+ * gst_rtsp_media_set_merge_window:
+ * @media: a #GstRTSPMedia
+ * @window: a #GstClockTime, 0 disables merging
+ *
+ * Let new clients of the VOD @media play it together with the clients
+ * that already play it when they start within @window of its current
+ * position. Instead of seeking the pipeline for them, which would move the
+ * other clients too, they receive the packets of the GOP cache of the
+ * streams and then the live packets, see gst_rtsp_media_set_gop_cache_size().
+ * The GOP caches keep all the packets of the first @window, so that clients
+ * can join from the start, and the last GOP afterwards. A new client is only
+ * merged when the GOP caches hold the packets from its start on, the GOP
+ * cache size must be large enough for @window.
+ *
+ * While other clients play @media or have it paused, PLAY requests for a
+ * position outside of @window, or with another rate, are refused.
+ *
+ * #GstRTSPMediaFactory hands out such a media to more than one client with
+ * gst_rtsp_media_factory_set_merge_window().
+ *
+ * Since: 1.20
+ */
+void
+gst_rtsp_media_set_merge_window (GstRTSPMedia * media, GstClockTime window)
+{
+  GstRTSPMediaPrivate *priv;
+  guint i;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA (media));
+  g_return_if_fail (GST_CLOCK_TIME_IS_VALID (window));
+
+  GST_LOG_OBJECT (media, "set merge window %" GST_TIME_FORMAT,
+      GST_TIME_ARGS (window));
+
+  priv = media->priv;
+
+  g_mutex_lock (&priv->lock);
+  priv->merge_window = window;
+
+  for (i = 0; i < priv->streams->len; i++) {
+    GstRTSPStream *stream = g_ptr_array_index (priv->streams, i);
+    gst_rtsp_stream_set_gop_keep_start (stream, window);
+  }
+  g_mutex_unlock (&priv->lock);
+}
+
+/**
+ * gst_rtsp_media_get_merge_window:
+ * @media: a #GstRTSPMedia
+ *
+ * Get how far from the current position of @media new clients can start to
+ * play it together with its current clients.
+ *
+ * Returns: the merge window of @media, 0 when merging is disabled.
+ *
+ * Since: 1.20
+ */
+GstClockTime
+gst_rtsp_media_get_merge_window (GstRTSPMedia * media)
+{
+  GstRTSPMediaPrivate *priv;
+  GstClockTime result;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA (media), 0);
+
+  priv = media->priv;
+
+  g_mutex_lock (&priv->lock);
+  result = priv->merge_window;
+  g_mutex_unlock (&priv->lock);
+
+  return result;
+}
+
+/* with state_lock, the position of a prepared VOD @media that merges new
+ * clients or GST_CLOCK_TIME_NONE. @cached is set to the stream time from
+ * which the GOP caches of all the streams hold the packets, or
+ * GST_CLOCK_TIME_NONE */
+static GstClockTime
+merge_position (GstRTSPMedia * media, GstClockTime * cached)
+{
+  GstRTSPMediaPrivate *priv = media->priv;
+  GstClockTime position = GST_CLOCK_TIME_NONE;
+  guint i;
+
+  *cached = GST_CLOCK_TIME_NONE;
+
+  g_mutex_lock (&priv->lock);
+  if (priv->merge_window > 0 && !priv->is_live &&
+      priv->status == GST_RTSP_MEDIA_STATUS_PREPARED) {
+    collect_media_stats (media);
+    if (priv->range_start != -1)
+      position = priv->range_start;
+
+    for (i = 0; i < priv->streams->len; i++) {
+      GstRTSPStream *stream = g_ptr_array_index (priv->streams, i);
+      GstClockTime time = gst_rtsp_stream_get_gop_start_time (stream);
+
+      if (!GST_CLOCK_TIME_IS_VALID (time)) {
+        *cached = GST_CLOCK_TIME_NONE;
+        break;
+      }
+      if (i == 0 || time > *cached)
+        *cached = time;
+    }
+  }
+  g_mutex_unlock (&priv->lock);
+
+  return position;
+}
+
+/* Check if a new client of @media that starts to play from the beginning
+ * can play it together with the current clients, which is the case when
+ * @media is a prepared VOD media whose position is within its merge
+ * window and whose GOP caches still hold the packets from the start. */
+gboolean
+gst_rtsp_media_can_merge (GstRTSPMedia * media)
+{
+  GstRTSPMediaPrivate *priv;
+  GstClockTime position, cached;
+  gboolean res;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA (media), FALSE);
+
+  priv = media->priv;
+
+  g_rec_mutex_lock (&priv->state_lock);
+  position = merge_position (media, &cached);
+  res = GST_CLOCK_TIME_IS_VALID (position) && position <= priv->merge_window &&
+      cached == 0;
+  g_rec_mutex_unlock (&priv->state_lock);
+
+  GST_DEBUG_OBJECT (media, "position %" GST_TIME_FORMAT ", cached from %"
+      GST_TIME_FORMAT ", can merge %d", GST_TIME_ARGS (position),
+      GST_TIME_ARGS (cached), res);
+
+  return res;
+}
+
+/* Called before @media is seeked for a PLAY request of a client, which is
+ * @active when it plays already. When other clients have the VOD @media
+ * prepared and its merge window is set, @merged is set and the seek is
+ * skipped when @range starts within the window of the current position and,
+ * for a new client, the GOP caches hold the packets from its start. Returns
+ * the status of the response otherwise, when the request would move the
+ * other clients. */
+GstRTSPStatusCode
+gst_rtsp_media_merge_seek (GstRTSPMedia * media, gboolean active,
+    const GstRTSPTimeRange * range, gdouble rate, gboolean * merged)
+{
+  GstRTSPMediaClass *klass;
+  GstRTSPMediaPrivate *priv;
+  GstRTSPStatusCode res = GST_RTSP_STS_OK;
+  GstClockTime position, cached, start = GST_CLOCK_TIME_NONE, stop;
+  GstRTSPTimeRange conv;
+  gint others;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA (media), GST_RTSP_STS_OK);
+  g_return_val_if_fail (merged != NULL, GST_RTSP_STS_OK);
+
+  klass = GST_RTSP_MEDIA_GET_CLASS (media);
+  priv = media->priv;
+
+  *merged = FALSE;
+
+  g_rec_mutex_lock (&priv->state_lock);
+  position = merge_position (media, &cached);
+  if (!GST_CLOCK_TIME_IS_VALID (position))
+    goto done;
+
+  /* every client prepared the media, also the paused ones move along */
+  others = priv->prepare_count - 1;
+  if (others <= 0)
+    goto done;
+
+  if (rate != 1.0)
+    goto wrong_rate;
+
+  if (range != NULL) {
+    conv = *range;
+    if (!klass->convert_range || !klass->convert_range (media, &conv,
+            GST_RTSP_RANGE_NPT))
+      goto wrong_range;
+    gst_rtsp_range_get_times (&conv, &start, &stop);
+  }
+
+  /* a range from now or without a start plays along */
+  if (GST_CLOCK_TIME_IS_VALID (start) && (start + priv->merge_window <
+          position || start > position + priv->merge_window))
+    goto wrong_range;
+
+  /* a new client receives the GOP caches, they must not start after it */
+  if (!active && GST_CLOCK_TIME_IS_VALID (start) &&
+      (!GST_CLOCK_TIME_IS_VALID (cached) || cached > start))
+    goto not_cached;
+
+  GST_INFO_OBJECT (media, "merging client at %" GST_TIME_FORMAT " with %d "
+      "other clients", GST_TIME_ARGS (position), others);
+  *merged = TRUE;
+
+done:
+  g_rec_mutex_unlock (&priv->state_lock);
+
+  return res;
+
+  /* ERRORS */
+wrong_rate:
+  {
+    GST_WARNING_OBJECT (media, "can't change the rate of a merged media");
+    res = GST_RTSP_STS_METHOD_NOT_VALID_IN_THIS_STATE;
+    goto done;
+  }
+wrong_range:
+  {
+    GST_WARNING_OBJECT (media, "range %" GST_TIME_FORMAT " is outside of "
+        "the merge window at %" GST_TIME_FORMAT, GST_TIME_ARGS (start),
+        GST_TIME_ARGS (position));
+    res = GST_RTSP_STS_INVALID_RANGE;
+    goto done;
+  }
+not_cached:
+  {
+    GST_WARNING_OBJECT (media, "range %" GST_TIME_FORMAT " starts before the "
+        "cached packets at %" GST_TIME_FORMAT, GST_TIME_ARGS (start),
+        GST_TIME_ARGS (cached));
+    res = GST_RTSP_STS_INVALID_RANGE;
+    goto done;
+  }
+}
+
+/**
+ * gst_rtsp_media_set_retransmission_time:
+ * @media: a #GstRTSPMedia
+ * @time: the new value
+ *
+ * Set the amount of time to store retransmission packets.
+ */
+void
+gst_rtsp_media_set_retransmission_time (GstRTSPMedia * media, GstClockTime time)
+{
+  GstRTSPMediaPrivate *priv;
+  guint i;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA (media));
+
+  GST_LOG_OBJECT (media, "set retransmission time %" G_GUINT64_FORMAT, time);
+
+  priv = media->priv;
+
+  g_mutex_lock (&priv->lock);
+  priv->rtx_time = time;
+  for (i = 0; i < priv->streams->len; i++) {
+    GstRTSPStream *stream = g_ptr_array_index (priv->streams, i);
+
+    gst_rtsp_stream_set_retransmission_time (stream, time);
+  }
+  g_mutex_unlock (&priv->lock);
+}
+
+/**
+ * gst_rtsp_media_get_retransmission_time:
+ * @media: a #GstRTSPMedia
+ *
+ * Get the amount of time to store retransmission data.
+ *
+ * Returns: the amount of time to store retransmission data.
+ */
+GstClockTime
+gst_rtsp_media_get_retransmission_time (GstRTSPMedia * media)
+{
+  GstRTSPMediaPrivate *priv;
+  GstClockTime res;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA (media), FALSE);
+
+  priv = media->priv;
+
+  g_mutex_lock (&priv->lock);
+  res = priv->rtx_time;
+  g_mutex_unlock (&priv->lock);
+
+  return res;
+}
+
+/**
+ * gst_rtsp_media_set_do_retransmission:
+ *
+ * Set whether retransmission requests will be sent
+ *
+ * Since: 1.16
+ */
+void
+gst_rtsp_media_set_do_retransmission (GstRTSPMedia * media,
+    gboolean do_retransmission)
+{
+  GstRTSPMediaPrivate *priv;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA (media));
+
+  priv = media->priv;
+
+  g_mutex_lock (&priv->lock);
+  priv->do_retransmission = do_retransmission;
+
+  if (priv->rtpbin)
+    g_object_set (priv->rtpbin, "do-retransmission", do_retransmission, NULL);
+  g_mutex_unlock (&priv->lock);
+}
+
+/**
+ * gst_rtsp_media_get_do_retransmission:
+ *
+ * Returns: Whether retransmission requests will be sent
+ *
+ * Since: 1.16
+ */
+gboolean
+gst_rtsp_media_get_do_retransmission (GstRTSPMedia * media)
+{
+  GstRTSPMediaPrivate *priv;
+  gboolean res;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA (media), 0);
+
+  priv = media->priv;
+
+  g_mutex_lock (&priv->lock);
+  res = priv->do_retransmission;
+  g_mutex_unlock (&priv->lock);
+
+  return res;
+}
+
+static void
+update_stream_storage_size (GstRTSPMedia * media, GstRTSPStream * stream,
+    guint sessid)
+{
+  GObject *storage = NULL;
+
+  g_signal_emit_by_name (G_OBJECT (media->priv->rtpbin), "get-storage",
+      sessid, &storage);
+
+  if (storage) {
+    guint64 size_time = 0;
+
+    if (!gst_rtsp_stream_is_tcp_receiver (stream))
+      size_time = (media->priv->latency + 50) * GST_MSECOND;
+
+    g_object_set (storage, "size-time", size_time, NULL);
+
+    g_object_unref (storage);
+  }
+}
+
+/**
+ * gst_rtsp_media_set_latency:
+ * @media: a #GstRTSPMedia
+ * @latency: latency in milliseconds
+ *
+ * Configure the latency used for receiving media.
+ */
+void
+gst_rtsp_media_set_latency (GstRTSPMedia * media, guint latency)
+{
+  GstRTSPMediaPrivate *priv;
+  guint i;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA (media));
+
+  GST_LOG_OBJECT (media, "set latency %ums", latency);
+
+  priv = media->priv;
+
+  g_mutex_lock (&priv->lock);
+  priv->latency = latency;
+  if (priv->rtpbin) {
+    g_object_set (priv->rtpbin, "latency", latency, NULL);
+
+    for (i = 0; i < media->priv->streams->len; i++) {
+      GstRTSPStream *stream = g_ptr_array_index (media->priv->streams, i);
+      update_stream_storage_size (media, stream, i);
+    }
+  }
+
+  g_mutex_unlock (&priv->lock);
+}
+
+/**
+ * gst_rtsp_media_get_latency:
+ * @media: a #GstRTSPMedia
+ *
+ * Get the latency that is used for receiving media.
+ *
+ * Returns: latency in milliseconds
+ */
+guint
+gst_rtsp_media_get_latency (GstRTSPMedia * media)
+{
+  GstRTSPMediaPrivate *priv;
+  guint res;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA (media), FALSE);
+
+  priv = media->priv;
+
+  g_mutex_lock (&priv->lock);
+  res = priv->latency;
+  g_mutex_unlock (&priv->lock);
+
+  return res;
+}
+
+/**
+ * gst_rtsp_media_use_time_provider:
+ * @media: a #GstRTSPMedia
+ * @time_provider: if a #GstNetTimeProvider should be used
+ *
+ * Set @media to provide a #GstNetTimeProvider.
+ */
+void
+gst_rtsp_media_use_time_provider (GstRTSPMedia * media, gboolean time_provider)
+{
+  GstRTSPMediaPrivate *priv;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA (media));
+
+  priv = media->priv;
+
+  g_mutex_lock (&priv->lock);
+  priv->time_provider = time_provider;
+  g_mutex_unlock (&priv->lock);
+}
+
+/**
+ * gst_rtsp_media_is_time_provider:
+ * @media: a #GstRTSPMedia
+ *
+ * Check if @media can provide a #GstNetTimeProvider for its pipeline clock.
+ *
+ * Use gst_rtsp_media_get_time_provider() to get the network clock.
+ *
+ * Returns: %TRUE if @media can provide a #GstNetTimeProvider.
+ */
+gboolean
+gst_rtsp_media_is_time_provider (GstRTSPMedia * media)
+{
+  GstRTSPMediaPrivate *priv;
+  gboolean res;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA (media), FALSE);
+
+  priv = media->priv;
+
+  g_mutex_lock (&priv->lock);
+  res = priv->time_provider;
+  g_mutex_unlock (&priv->lock);
+
+  return res;
+}
+
+/**
+ * gst_rtsp_media_set_clock:
+ * @media: a #GstRTSPMedia
+ * @clock: (nullable): #GstClock to be used
+ *
+ * Configure the clock used for the media.
+ */
+void
+gst_rtsp_media_set_clock (GstRTSPMedia * media, GstClock * clock)
+{
+  GstRTSPMediaPrivate *priv;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA (media));
+  g_return_if_fail (GST_IS_CLOCK (clock) || clock == NULL);
+
+  GST_LOG_OBJECT (media, "setting clock %" GST_PTR_FORMAT, clock);
+
+  priv = media->priv;
+
+  g_mutex_lock (&priv->lock);
+  if (priv->clock)
+    gst_object_unref (priv->clock);
+  priv->clock = clock ? gst_object_ref (clock) : NULL;
+  if (priv->pipeline) {
+    if (clock)
+      gst_pipeline_use_clock (GST_PIPELINE_CAST (priv->pipeline), clock);
+    else
+      gst_pipeline_auto_clock (GST_PIPELINE_CAST (priv->pipeline));
+  }
+
+  g_mutex_unlock (&priv->lock);
+}
+
+/**
+ * gst_rtsp_media_set_publish_clock_mode:
+ * @media: a #GstRTSPMedia
+ * @mode: the clock publish mode
+ *
+ * Sets if and how the media clock should be published according to RFC7273.
+ *
+ * Since: 1.8
+ */
+void
+gst_rtsp_media_set_publish_clock_mode (GstRTSPMedia * media,
+    GstRTSPPublishClockMode mode)
+{
+  GstRTSPMediaPrivate *priv;
+  guint i, n;
+
+  priv = media->priv;
+  g_mutex_lock (&priv->lock);
+  priv->publish_clock_mode = mode;
+
+  n = priv->streams->len;
+  for (i = 0; i < n; i++) {
+    GstRTSPStream *stream = g_ptr_array_index (priv->streams, i);
+
+    gst_rtsp_stream_set_publish_clock_mode (stream, mode);
+  }
+  g_mutex_unlock (&priv->lock);
+}
+
+/**
+ * gst_rtsp_media_get_publish_clock_mode:
+ * @media: a #GstRTSPMedia
+ *
+ * Gets if and how the media clock should be published according to RFC7273.
  *
  * Returns: The GstRTSPPublishClockMode
  *
@@ -2120,6 +3269,23 @@ gst_rtsp_media_set_enable_rtcp (GstRTSPMedia * media, gboolean enable)
   g_mutex_unlock (&priv->lock);
 }
 
+/* Drop one prepare count of a prepared @media without unpreparing it. The
+ * next gst_rtsp_media_prepare() takes over the prepared pipeline. */
+void
+gst_rtsp_media_release_prepare (GstRTSPMedia * media)
+{
+  GstRTSPMediaPrivate *priv;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA (media));
+
+  priv = media->priv;
+
+  g_rec_mutex_lock (&priv->state_lock);
+  if (priv->prepare_count > 0)
+    priv->prepare_count--;
+  g_rec_mutex_unlock (&priv->state_lock);
+}
+
 static GList *
 _find_payload_types (GstRTSPMedia * media)
 {
@@ -2446,10 +3612,17 @@ gst_rtsp_media_create_stream (GstRTSPMedia * media, GstElement * payloader,
   gst_rtsp_stream_set_protocols (stream, priv->protocols);
   gst_rtsp_stream_set_retransmission_time (stream, priv->rtx_time);
   gst_rtsp_stream_set_buffer_size (stream, priv->buffer_size);
+  gst_rtsp_stream_set_gop_cache_size (stream, priv->gop_cache_size);
+  gst_rtsp_stream_set_gop_keep_start (stream, priv->merge_window);
+  gst_rtsp_stream_set_keyframe_trickmode (stream, priv->keyframe_trickmode);
+  gst_rtsp_stream_set_timeshift (stream, priv->timeshift_duration,
+      priv->timeshift_size);
+  update_live_stream_unlocked (media, stream);
   gst_rtsp_stream_set_publish_clock_mode (stream, priv->publish_clock_mode);
   gst_rtsp_stream_set_rate_control (stream, priv->do_rate_control);
 
   g_ptr_array_add (priv->streams, stream);
+  priv->sdp_cookie = gst_rtsp_sdp_next_cookie ();
 
   if (GST_PAD_IS_SRC (pad)) {
     gint i, n;
@@ -2513,6 +3686,7 @@ gst_rtsp_media_remove_stream (GstRTSPMedia * media, GstRTSPStream * stream)
   /* now remove the stream */
   g_object_ref (stream);
   g_ptr_array_remove (priv->streams, stream);
+  priv->sdp_cookie = gst_rtsp_sdp_next_cookie ();
   g_mutex_unlock (&priv->lock);
 
   g_signal_emit (media, gst_rtsp_media_signals[SIGNAL_REMOVED_STREAM], 0,
@@ -2785,12 +3959,28 @@ static void
 gst_rtsp_media_set_status (GstRTSPMedia * media, GstRTSPMediaStatus status)
 {
   GstRTSPMediaPrivate *priv = media->priv;
+  GList *waiters = NULL, *walk;
 
   g_mutex_lock (&priv->lock);
   priv->status = status;
+  /* the SDP is the same while prepared and suspended */
+  if (status != GST_RTSP_MEDIA_STATUS_PREPARED &&
+      status != GST_RTSP_MEDIA_STATUS_SUSPENDED)
+    priv->sdp_cookie = gst_rtsp_sdp_next_cookie ();
   GST_DEBUG ("setting new status to %d", status);
   g_cond_broadcast (&priv->cond);
+  if (status != GST_RTSP_MEDIA_STATUS_PREPARING) {
+    waiters = priv->prepare_waiters;
+    priv->prepare_waiters = NULL;
+  }
   g_mutex_unlock (&priv->lock);
+
+  /* wake up the asynchronous waiters in their own context */
+  for (walk = waiters; walk; walk = walk->next) {
+    g_source_set_ready_time (walk->data, 0);
+    g_source_unref (walk->data);
+  }
+  g_list_free (waiters);
 }
 
 /**
@@ -2943,6 +4133,12 @@ gst_rtsp_media_seek_trickmode (GstRTSPMedia * media,
         start = current_position;
         start_type = GST_SEEK_TYPE_SET;
       }
+    } else if ((flags & GST_SEEK_FLAG_KEY_UNIT) && rate > 0.0 &&
+        start != GST_CLOCK_TIME_NONE && index_snap (media, &start, flags)) {
+      /* the demuxer does not need to look for the keyframe anymore */
+      GST_DEBUG ("keyframe index moved start to %" GST_TIME_FORMAT,
+          GST_TIME_ARGS (start));
+      flags &= ~(GST_SEEK_FLAG_KEY_UNIT | GST_SEEK_FLAG_SNAP_NEAREST);
     }
 
     if (!force_seek &&
@@ -2979,6 +4175,7 @@ gst_rtsp_media_seek_trickmode (GstRTSPMedia * media,
       }
 
       gst_rtsp_media_set_status (media, GST_RTSP_MEDIA_STATUS_PREPARING);
+      index_abort (media);
 
       if (rate < 0.0) {
         GstClockTime temp_time = start;
@@ -3112,6 +4309,118 @@ gst_rtsp_media_seek (GstRTSPMedia * media, GstRTSPTimeRange * range)
       1.0, 0);
 }
 
+/* Get the running time of the pipeline where @range starts,
+ * GST_CLOCK_TIME_NONE when it starts now.
+ * call with state_lock */
+static GstClockTime
+get_timeshift_start (GstRTSPMedia * media, GstRTSPTimeRange * range)
+{
+  GstRTSPMediaPrivate *priv = media->priv;
+  GstClockTime start = GST_CLOCK_TIME_NONE;
+  GstClock *clock;
+  GDateTime *datetime;
+  GstClockTime now;
+  gint64 utc, ago;
+
+  if (!(clock = gst_element_get_clock (priv->pipeline)))
+    return GST_CLOCK_TIME_NONE;
+  now = gst_clock_get_time (clock) -
+      gst_element_get_base_time (priv->pipeline);
+  gst_object_unref (clock);
+
+  if (range->min.type != GST_RTSP_TIME_UTC) {
+    /* the position of a live pipeline is its running time. Clients play
+     * from npt=0 or npt=now to get the live packets, only a position
+     * before the current one is in the past */
+    if (range->min.type == GST_RTSP_TIME_NOW ||
+        range->min.type == GST_RTSP_TIME_END)
+      return GST_CLOCK_TIME_NONE;
+    gst_rtsp_range_get_times (range, &start, NULL);
+    if (!GST_CLOCK_TIME_IS_VALID (start) || start == 0 || start >= now)
+      return GST_CLOCK_TIME_NONE;
+    return start;
+  }
+
+  datetime = g_date_time_new_utc (range->min2.year, range->min2.month,
+      range->min2.day, 0, 0, 0);
+  if (datetime == NULL)
+    return GST_CLOCK_TIME_NONE;
+  utc = g_date_time_to_unix (datetime) * GST_SECOND +
+      range->min.seconds * GST_SECOND;
+  g_date_time_unref (datetime);
+
+  ago = g_get_real_time () * GST_USECOND - utc;
+  if (ago <= 0)
+    return GST_CLOCK_TIME_NONE;
+
+  return ago < now ? now - ago : 0;
+}
+
+/**
+ * gst_rtsp_media_seek_timeshift:
+ * @media: a #GstRTSPMedia
+ * @transports: (element-type GstRTSPStreamTransport): the transports of a
+ *   client, can contain %NULL for the streams that were not set up
+ * @range: (transfer none): a #GstRTSPTimeRange
+ *
+ * Make @transports receive the packets of the live @media from the start
+ * of @range in the past, from the time-shift ring buffers of the streams,
+ * see gst_rtsp_media_set_timeshift(). The packets start at the last
+ * keyframe before the start of @range, like with gst_rtsp_media_seek_full()
+ * and #GST_SEEK_FLAG_KEY_UNIT, and are sent at the pace of the live
+ * packets. The pipeline is not seeked, so that the other clients of a
+ * shared @media keep receiving the live packets.
+ *
+ * @range is either an absolute time with the clock unit, or a position of
+ * @media before the current one, which is the running time of its live
+ * pipeline. A @range that starts now, at 0 or at the current position
+ * returns @transports to the live packets.
+ *
+ * Returns: %TRUE when @transports receive packets from the past.
+ *
+ * Since: 1.20
+ */
+gboolean
+gst_rtsp_media_seek_timeshift (GstRTSPMedia * media, GPtrArray * transports,
+    GstRTSPTimeRange * range)
+{
+  GstRTSPMediaPrivate *priv;
+  GstClockTime start;
+  gboolean res = FALSE;
+  guint i;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA (media), FALSE);
+  g_return_val_if_fail (transports != NULL, FALSE);
+  g_return_val_if_fail (range != NULL, FALSE);
+
+  priv = media->priv;
+
+  g_rec_mutex_lock (&priv->state_lock);
+  if (priv->status != GST_RTSP_MEDIA_STATUS_PREPARED || !priv->is_live ||
+      priv->timeshift_duration == 0)
+    goto done;
+
+  start = get_timeshift_start (media, range);
+  GST_INFO_OBJECT (media, "time-shift to %" GST_TIME_FORMAT,
+      GST_TIME_ARGS (start));
+
+  for (i = 0; i < transports->len; i++) {
+    GstRTSPStreamTransport *trans = g_ptr_array_index (transports, i);
+
+    if (trans == NULL)
+      continue;
+
+    if (gst_rtsp_stream_timeshift_transport (gst_rtsp_stream_transport_get_stream
+            (trans), trans, start))
+      res = TRUE;
+  }
+
+done:
+  g_rec_mutex_unlock (&priv->state_lock);
+
+  return res;
+}
+
 static void
 stream_collect_blocking (GstRTSPStream * stream, gboolean * blocked)
 {
@@ -3346,6 +4655,8 @@ default_handle_message (GstRTSPMedia * media, GstMessage * message)
       if (priv->status == GST_RTSP_MEDIA_STATUS_UNPREPARING) {
         GST_DEBUG ("shutting down after EOS");
         finish_unprepare (media);
+      } else {
+        index_finish (media);
       }
       break;
     default:
@@ -3382,69 +4693,400 @@ watch_destroyed (GstRTSPMedia * media)
   g_object_unref (media);
 }
 
-static gboolean
-is_payloader (GstElement * element)
-{
-  GstElementClass *eclass = GST_ELEMENT_GET_CLASS (element);
-  const gchar *klass;
+static gboolean
+is_payloader (GstElement * element)
+{
+  GstElementClass *eclass = GST_ELEMENT_GET_CLASS (element);
+  const gchar *klass;
+
+  klass = gst_element_class_get_metadata (eclass, GST_ELEMENT_METADATA_KLASS);
+  if (klass == NULL)
+    return FALSE;
+
+  if (strstr (klass, "Payloader") && strstr (klass, "RTP")) {
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+static GstElement *
+find_payload_element (GstElement * payloader, GstPad * pad)
+{
+  GstElement *pay = NULL;
+
+  if (GST_IS_BIN (payloader)) {
+    GstIterator *iter;
+    GValue item = { 0 };
+    gchar *pad_name, *payloader_name;
+    GstElement *element;
+
+    if ((element = gst_bin_get_by_name (GST_BIN (payloader), "pay"))) {
+      if (is_payloader (element))
+        return element;
+      gst_object_unref (element);
+    }
+
+    pad_name = gst_object_get_name (GST_OBJECT (pad));
+    payloader_name = g_strdup_printf ("pay_%s", pad_name);
+    g_free (pad_name);
+    if ((element = gst_bin_get_by_name (GST_BIN (payloader), payloader_name))) {
+      g_free (payloader_name);
+      if (is_payloader (element))
+        return element;
+      gst_object_unref (element);
+    } else {
+      g_free (payloader_name);
+    }
+
+    iter = gst_bin_iterate_recurse (GST_BIN (payloader));
+    while (gst_iterator_next (iter, &item) == GST_ITERATOR_OK) {
+      element = (GstElement *) g_value_get_object (&item);
+
+      if (is_payloader (element)) {
+        pay = gst_object_ref (element);
+        g_value_unset (&item);
+        break;
+      }
+      g_value_unset (&item);
+    }
+    gst_iterator_free (iter);
+  } else {
+    pay = g_object_ref (payloader);
+  }
+
+  return pay;
+}
+
+/* called from streaming threads */
+static GstPadProbeReturn
+index_probe (GstPad * pad, GstPadProbeInfo * info, GstRTSPMedia * media)
+{
+  GstRTSPMediaPrivate *priv = media->priv;
+  GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+  GstClockTime time = GST_CLOCK_TIME_NONE;
+  gint64 offset;
+  GstEvent *event;
+
+  if (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT) ||
+      !GST_BUFFER_PTS_IS_VALID (buffer))
+    return GST_PAD_PROBE_OK;
+
+  g_mutex_lock (&priv->index_lock);
+  if (priv->index_recording == NULL)
+    goto done;
+
+  /* only the keyframes of the first video stream are recorded, the buffers
+   * of the other streams are all keyframes */
+  if (priv->index_pad == NULL) {
+    GstCaps *caps;
+    const gchar *media_type = NULL;
+
+    caps = gst_pad_get_current_caps (pad);
+    if (caps)
+      media_type = gst_structure_get_string (gst_caps_get_structure (caps, 0),
+          "media");
+    if (g_strcmp0 (media_type, "video") == 0)
+      priv->index_pad = pad;
+    if (caps)
+      gst_caps_unref (caps);
+  }
+  if (priv->index_pad != pad)
+    goto done;
+  g_mutex_unlock (&priv->index_lock);
+
+  event = gst_pad_get_sticky_event (pad, GST_EVENT_SEGMENT, 0);
+  if (event) {
+    const GstSegment *segment;
+
+    gst_event_parse_segment (event, &segment);
+    if (segment->format == GST_FORMAT_TIME)
+      time = gst_segment_to_stream_time (segment, GST_FORMAT_TIME,
+          GST_BUFFER_PTS (buffer));
+    gst_event_unref (event);
+  }
+  if (!GST_CLOCK_TIME_IS_VALID (time))
+    return GST_PAD_PROBE_OK;
+
+  /* the demuxer answers this when it knows where it is in the file */
+  if (!gst_pad_query_position (pad, GST_FORMAT_BYTES, &offset))
+    offset = -1;
+
+  GST_LOG_OBJECT (media, "keyframe at %" GST_TIME_FORMAT ", offset %"
+      G_GINT64_FORMAT, GST_TIME_ARGS (time), offset);
+
+  g_mutex_lock (&priv->index_lock);
+  if (priv->index_recording)
+    gst_rtsp_keyframe_index_add (priv->index_recording, time, offset);
+done:
+  g_mutex_unlock (&priv->index_lock);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static gint
+find_file_uri (const GValue * value, gchar ** uri)
+{
+  GstElement *element = g_value_get_object (value);
+  GParamSpec *pspec;
+  gchar *str = NULL;
+
+  if (GST_IS_URI_HANDLER (element)) {
+    if (gst_uri_handler_get_uri_type (GST_URI_HANDLER (element)) == GST_URI_SRC)
+      str = gst_uri_handler_get_uri (GST_URI_HANDLER (element));
+  } else if ((pspec = g_object_class_find_property (G_OBJECT_GET_CLASS
+              (element), "uri")) && pspec->value_type == G_TYPE_STRING &&
+      (pspec->flags & G_PARAM_READABLE)) {
+    /* like uridecodebin, which makes its source later */
+    g_object_get (element, "uri", &str, NULL);
+  }
+
+  if (str && gst_uri_has_protocol (str, "file")) {
+    *uri = str;
+    return 0;
+  }
+  g_free (str);
+
+  return 1;
+}
+
+/* get the size and modification time of the file that the pipeline plays,
+ * called with state_lock */
+static gboolean
+index_get_source (GstRTSPMedia * media, guint64 * size, gint64 * mtime)
+{
+  GstRTSPMediaPrivate *priv = media->priv;
+  GstIterator *iter;
+  GValue item = G_VALUE_INIT;
+  gchar *uri = NULL, *filename;
+  GStatBuf st;
+  gboolean res = FALSE;
+
+  if (!GST_IS_BIN (priv->element))
+    return FALSE;
+
+  iter = gst_bin_iterate_recurse (GST_BIN (priv->element));
+  if (gst_iterator_find_custom (iter, (GCompareFunc) find_file_uri,
+          &item, &uri))
+    g_value_unset (&item);
+  gst_iterator_free (iter);
+
+  if (uri == NULL)
+    return FALSE;
+
+  filename = g_filename_from_uri (uri, NULL, NULL);
+  if (filename && g_stat (filename, &st) == 0) {
+    *size = st.st_size;
+    *mtime = st.st_mtime;
+    res = TRUE;
+  }
+  g_free (filename);
+  g_free (uri);
+
+  return res;
+}
+
+/* load the keyframe index or start recording one, called with state_lock */
+static void
+index_start (GstRTSPMedia * media)
+{
+  GstRTSPMediaPrivate *priv = media->priv;
+  GError *error = NULL;
+  guint64 size = 0, index_size;
+  gint64 mtime = 0, index_mtime;
+  gboolean has_source;
+
+  has_source = index_get_source (media, &size, &mtime);
+
+  g_mutex_lock (&priv->index_lock);
+  if (priv->index_location && priv->index == NULL &&
+      priv->index_recording == NULL) {
+    priv->index = gst_rtsp_keyframe_index_load (priv->index_location, &error);
+    if (priv->index == NULL) {
+      GST_INFO_OBJECT (media, "recording keyframe index: %s", error->message);
+      g_clear_error (&error);
+    } else if (has_source && (!gst_rtsp_keyframe_index_get_source (priv->index,
+                &index_size, &index_mtime) || index_size != size
+            || index_mtime != mtime)) {
+      GST_INFO_OBJECT (media, "indexed file changed, recording keyframe index");
+      gst_rtsp_keyframe_index_free (priv->index);
+      priv->index = NULL;
+    }
+    if (priv->index == NULL) {
+      priv->index_recording = gst_rtsp_keyframe_index_new ();
+      if (has_source)
+        gst_rtsp_keyframe_index_set_source (priv->index_recording, size,
+            mtime);
+    }
+  }
+  g_mutex_unlock (&priv->index_lock);
+}
+
+/* called with state_lock */
+static void
+index_add_stream (GstRTSPMedia * media, GstRTSPStream * stream)
+{
+  GstRTSPMediaPrivate *priv = media->priv;
+  gboolean recording;
+  IndexProbe probe;
+
+  g_mutex_lock (&priv->index_lock);
+  recording = priv->index_recording != NULL;
+  g_mutex_unlock (&priv->index_lock);
+
+  if (!recording)
+    return;
+
+  probe.pad = gst_rtsp_stream_get_srcpad (stream);
+  if (probe.pad == NULL)
+    return;
+
+  probe.id = gst_pad_add_probe (probe.pad, GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) index_probe, media, NULL);
+  g_array_append_val (priv->index_probes, probe);
+}
+
+/* the recorded index only covers the file when it played from start to end
+ * without seeking */
+static void
+index_abort (GstRTSPMedia * media)
+{
+  GstRTSPMediaPrivate *priv = media->priv;
+
+  g_mutex_lock (&priv->index_lock);
+  if (priv->index_recording) {
+    GST_DEBUG_OBJECT (media, "seeking, stop recording keyframe index");
+    gst_rtsp_keyframe_index_free (priv->index_recording);
+    priv->index_recording = NULL;
+  }
+  g_mutex_unlock (&priv->index_lock);
+}
+
+/* save the recorded index on EOS, called with state_lock */
+static void
+index_finish (GstRTSPMedia * media)
+{
+  GstRTSPMediaPrivate *priv = media->priv;
+  GstRTSPKeyframeIndex *index;
+  gchar *location;
+  gint64 duration;
+  gboolean is_live;
+  GError *error = NULL;
+
+  g_mutex_lock (&priv->index_lock);
+  index = priv->index_recording;
+  priv->index_recording = NULL;
+  location = g_strdup (priv->index_location);
+  g_mutex_unlock (&priv->index_lock);
+
+  if (index == NULL)
+    goto done;
+
+  g_mutex_lock (&priv->lock);
+  is_live = priv->is_live;
+  g_mutex_unlock (&priv->lock);
+
+  if (is_live || location == NULL ||
+      gst_rtsp_keyframe_index_get_size (index) == 0)
+    goto done;
 
-  klass = gst_element_class_get_metadata (eclass, GST_ELEMENT_METADATA_KLASS);
-  if (klass == NULL)
-    return FALSE;
+  if (!gst_element_query_duration (priv->pipeline, GST_FORMAT_TIME, &duration))
+    duration = -1;
+  gst_rtsp_keyframe_index_set_duration (index, duration);
 
-  if (strstr (klass, "Payloader") && strstr (klass, "RTP")) {
-    return TRUE;
+  if (!gst_rtsp_keyframe_index_save (index, location, &error)) {
+    GST_WARNING_OBJECT (media, "failed to save keyframe index: %s",
+        error->message);
+    g_clear_error (&error);
+    goto done;
   }
 
-  return FALSE;
+  GST_INFO_OBJECT (media, "saved keyframe index of %u keyframes in %s",
+      gst_rtsp_keyframe_index_get_size (index), location);
+
+  g_mutex_lock (&priv->index_lock);
+  if (priv->index == NULL) {
+    priv->index = index;
+    index = NULL;
+  }
+  g_mutex_unlock (&priv->index_lock);
+
+done:
+  if (index)
+    gst_rtsp_keyframe_index_free (index);
+  g_free (location);
 }
 
-static GstElement *
-find_payload_element (GstElement * payloader, GstPad * pad)
+/* called with state_lock */
+static void
+index_stop (GstRTSPMedia * media)
 {
-  GstElement *pay = NULL;
+  GstRTSPMediaPrivate *priv = media->priv;
+  guint i;
 
-  if (GST_IS_BIN (payloader)) {
-    GstIterator *iter;
-    GValue item = { 0 };
-    gchar *pad_name, *payloader_name;
-    GstElement *element;
+  for (i = 0; i < priv->index_probes->len; i++) {
+    IndexProbe *probe = &g_array_index (priv->index_probes, IndexProbe, i);
 
-    if ((element = gst_bin_get_by_name (GST_BIN (payloader), "pay"))) {
-      if (is_payloader (element))
-        return element;
-      gst_object_unref (element);
-    }
+    gst_pad_remove_probe (probe->pad, probe->id);
+    gst_object_unref (probe->pad);
+  }
+  g_array_set_size (priv->index_probes, 0);
+
+  /* the index is loaded again when the media is prepared again, the file
+   * might have been updated in the meantime */
+  g_mutex_lock (&priv->index_lock);
+  if (priv->index_recording)
+    gst_rtsp_keyframe_index_free (priv->index_recording);
+  priv->index_recording = NULL;
+  if (priv->index)
+    gst_rtsp_keyframe_index_free (priv->index);
+  priv->index = NULL;
+  priv->index_pad = NULL;
+  g_mutex_unlock (&priv->index_lock);
+}
+
+/* move @start to a keyframe from the index, called with state_lock */
+static gboolean
+index_snap (GstRTSPMedia * media, GstClockTime * start, GstSeekFlags flags)
+{
+  GstRTSPMediaPrivate *priv = media->priv;
+  GstClockTime before = GST_CLOCK_TIME_NONE, after = GST_CLOCK_TIME_NONE;
+  GstClockTime index_duration;
+  gint64 duration;
+  gboolean res = FALSE;
 
-    pad_name = gst_object_get_name (GST_OBJECT (pad));
-    payloader_name = g_strdup_printf ("pay_%s", pad_name);
-    g_free (pad_name);
-    if ((element = gst_bin_get_by_name (GST_BIN (payloader), payloader_name))) {
-      g_free (payloader_name);
-      if (is_payloader (element))
-        return element;
-      gst_object_unref (element);
-    } else {
-      g_free (payloader_name);
-    }
+  g_mutex_lock (&priv->index_lock);
+  if (priv->index == NULL)
+    goto done;
 
-    iter = gst_bin_iterate_recurse (GST_BIN (payloader));
-    while (gst_iterator_next (iter, &item) == GST_ITERATOR_OK) {
-      element = (GstElement *) g_value_get_object (&item);
+  index_duration = gst_rtsp_keyframe_index_get_duration (priv->index);
+  if (GST_CLOCK_TIME_IS_VALID (index_duration) &&
+      gst_element_query_duration (priv->pipeline, GST_FORMAT_TIME, &duration)
+      && duration != -1 && duration != index_duration) {
+    GST_WARNING_OBJECT (media, "keyframe index is for a duration of %"
+        GST_TIME_FORMAT " instead of %" GST_TIME_FORMAT ", ignoring",
+        GST_TIME_ARGS (index_duration), GST_TIME_ARGS (duration));
+    goto done;
+  }
 
-      if (is_payloader (element)) {
-        pay = gst_object_ref (element);
-        g_value_unset (&item);
-        break;
-      }
-      g_value_unset (&item);
-    }
-    gst_iterator_free (iter);
-  } else {
-    pay = g_object_ref (payloader);
+  if (flags & GST_SEEK_FLAG_SNAP_AFTER)
+    gst_rtsp_keyframe_index_lookup (priv->index, *start, TRUE, &after, NULL);
+  if (flags & GST_SEEK_FLAG_SNAP_BEFORE || !(flags & GST_SEEK_FLAG_SNAP_AFTER))
+    gst_rtsp_keyframe_index_lookup (priv->index, *start, FALSE, &before, NULL);
+
+  if (GST_CLOCK_TIME_IS_VALID (before) && (!GST_CLOCK_TIME_IS_VALID (after) ||
+          *start - before <= after - *start)) {
+    *start = before;
+    res = TRUE;
+  } else if (GST_CLOCK_TIME_IS_VALID (after)) {
+    *start = after;
+    res = TRUE;
   }
 
-  return pay;
+done:
+  g_mutex_unlock (&priv->index_lock);
+
+  return res;
 }
 
 /* called from streaming threads */
@@ -3474,6 +5116,7 @@ pad_added_cb (GstElement * element, GstPad * pad, GstRTSPMedia * media)
           priv->rtpbin, GST_STATE_PAUSED)) {
     GST_WARNING ("failed to join bin element");
   }
+  index_add_stream (media, stream);
 
   if (priv->blocked)
     gst_rtsp_stream_set_blocked (stream, TRUE);
@@ -3556,7 +5199,10 @@ start_preroll (GstRTSPMedia * media)
       /* FIXME we disable seeking for live streams for now. We should perform a
        * seeking query in preroll instead */
       priv->seekable = -1;
+      g_mutex_lock (&priv->lock);
       priv->is_live = TRUE;
+      update_live_streams_unlocked (media);
+      g_mutex_unlock (&priv->lock);
 
       ret = set_state (media, GST_STATE_PLAYING);
       if (ret == GST_STATE_CHANGE_FAILURE)
@@ -3686,6 +5332,8 @@ start_prepare (GstRTSPMedia * media)
   g_signal_connect (priv->rtpbin, "request-fec-decoder",
       G_CALLBACK (request_fec_decoder), media);
 
+  index_start (media);
+
   /* link streams we already have, other streams might appear when we have
    * dynamic elements */
   for (i = 0; i < priv->streams->len; i++) {
@@ -3708,6 +5356,7 @@ start_prepare (GstRTSPMedia * media)
             priv->rtpbin, GST_STATE_NULL)) {
       goto join_bin_failed;
     }
+    index_add_stream (media, stream);
   }
 
   if (priv->rtpbin)
@@ -3839,34 +5488,36 @@ no_rtpbin:
   }
 }
 
-/**
- * gst_rtsp_media_prepare:
- * @media: a #GstRTSPMedia
- * @thread: (transfer full) (allow-none): a #GstRTSPThread to run the
- *   bus handler or %NULL
- *
- * Prepare @media for streaming. This function will create the objects
- * to manage the streaming. A pipeline must have been set on @media with
- * gst_rtsp_media_take_pipeline().
- *
- * It will preroll the pipeline and collect vital information about the streams
- * such as the duration.
- *
- * Returns: %TRUE on success.
- */
-gboolean
-gst_rtsp_media_prepare (GstRTSPMedia * media, GstRTSPThread * thread)
+/* must be called with state-lock */
+static void
+clear_idle_source (GstRTSPMedia * media)
 {
-  GstRTSPMediaPrivate *priv;
-  GstRTSPMediaClass *klass;
+  GstRTSPMediaPrivate *priv = media->priv;
 
-  g_return_val_if_fail (GST_IS_RTSP_MEDIA (media), FALSE);
+  g_source_destroy (priv->idle_source);
+  g_source_unref (priv->idle_source);
+  priv->idle_source = NULL;
+}
 
-  priv = media->priv;
+/* start preparing @media. Returns %FALSE on error, @prepared is set to %TRUE
+ * when @media was already prepared and we don't need to wait for it. */
+static gboolean
+begin_prepare (GstRTSPMedia * media, GstRTSPThread * thread,
+    gboolean * prepared)
+{
+  GstRTSPMediaPrivate *priv = media->priv;
+  GstRTSPMediaClass *klass;
+
+  *prepared = FALSE;
 
   g_rec_mutex_lock (&priv->state_lock);
   priv->prepare_count++;
 
+  if (priv->idle_source) {
+    GST_INFO ("media %p is used again", media);
+    clear_idle_source (media);
+  }
+
   if (priv->status == GST_RTSP_MEDIA_STATUS_PREPARED ||
       priv->status == GST_RTSP_MEDIA_STATUS_SUSPENDED)
     goto was_prepared;
@@ -3883,10 +5534,15 @@ gst_rtsp_media_prepare (GstRTSPMedia * media, GstRTSPThread * thread)
   GST_INFO ("preparing media %p", media);
 
   /* reset some variables */
+  g_mutex_lock (&priv->lock);
   priv->is_live = FALSE;
+  update_live_streams_unlocked (media);
+  g_mutex_unlock (&priv->lock);
   priv->seekable = -1;
   priv->buffering = FALSE;
   priv->no_more_pads_pending = priv->nb_dynamic_elements;
+  priv->idle_sdp_unchecked = priv->idle_sdp != NULL;
+  priv->idle_sdp_changed = FALSE;
 
   /* we're preparing now */
   gst_rtsp_media_set_status (media, GST_RTSP_MEDIA_STATUS_PREPARING);
@@ -3896,19 +5552,8 @@ gst_rtsp_media_prepare (GstRTSPMedia * media, GstRTSPThread * thread)
     if (!klass->prepare (media, thread))
       goto prepare_failed;
   }
-
-wait_status:
   g_rec_mutex_unlock (&priv->state_lock);
 
-  /* now wait for all pads to be prerolled, FIXME, we should somehow be
-   * able to do this async so that we don't block the server thread. */
-  if (!wait_preroll (media))
-    goto preroll_failed;
-
-  g_signal_emit (media, gst_rtsp_media_signals[SIGNAL_PREPARED], 0, NULL);
-
-  GST_INFO ("object %p is prerolled", media);
-
   return TRUE;
 
   /* OK */
@@ -3917,7 +5562,8 @@ is_preparing:
     /* we are not going to use the giving thread, so stop it. */
     if (thread)
       gst_rtsp_thread_stop (thread);
-    goto wait_status;
+    g_rec_mutex_unlock (&priv->state_lock);
+    return TRUE;
   }
 was_prepared:
   {
@@ -3926,6 +5572,7 @@ was_prepared:
     if (thread)
       gst_rtsp_thread_stop (thread);
     g_rec_mutex_unlock (&priv->state_lock);
+    *prepared = TRUE;
     return TRUE;
   }
   /* ERRORS */
@@ -3959,6 +5606,50 @@ prepare_failed:
     GST_ERROR ("failed to prepare media");
     return FALSE;
   }
+}
+
+/**
+ * gst_rtsp_media_prepare:
+ * @media: a #GstRTSPMedia
+ * @thread: (transfer full) (allow-none): a #GstRTSPThread to run the
+ *   bus handler or %NULL
+ *
+ * Prepare @media for streaming. This function will create the objects
+ * to manage the streaming. A pipeline must have been set on @media with
+ * gst_rtsp_media_take_pipeline().
+ *
+ * It will preroll the pipeline and collect vital information about the streams
+ * such as the duration.
+ *
+ * This function blocks until the pipeline is prerolled, use
+ * gst_rtsp_media_prepare_async() to prepare without blocking.
+ *
+ * Returns: %TRUE on success.
+ */
+gboolean
+gst_rtsp_media_prepare (GstRTSPMedia * media, GstRTSPThread * thread)
+{
+  gboolean prepared;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA (media), FALSE);
+
+  if (!begin_prepare (media, thread, &prepared))
+    return FALSE;
+
+  if (prepared)
+    return TRUE;
+
+  /* now wait for all pads to be prerolled */
+  if (!wait_preroll (media))
+    goto preroll_failed;
+
+  g_signal_emit (media, gst_rtsp_media_signals[SIGNAL_PREPARED], 0, NULL);
+
+  GST_INFO ("object %p is prerolled", media);
+
+  return TRUE;
+
+  /* ERRORS */
 preroll_failed:
   {
     GST_WARNING ("failed to preroll pipeline");
@@ -3967,6 +5658,150 @@ preroll_failed:
   }
 }
 
+typedef struct
+{
+  GSource source;
+  GstRTSPMedia *media;
+  gboolean prepared;
+  GstRTSPMediaPreparedFunc func;
+  gpointer user_data;
+  GDestroyNotify notify;
+} PrepareWaiter;
+
+static gboolean
+prepare_waiter_dispatch (GSource * source, GSourceFunc callback,
+    gpointer user_data)
+{
+  PrepareWaiter *waiter = (PrepareWaiter *) source;
+  GstRTSPMedia *media = waiter->media;
+  GstRTSPMediaPrivate *priv = media->priv;
+  GList *link;
+  GstRTSPMediaStatus status;
+  gboolean timeout, success;
+
+  g_mutex_lock (&priv->lock);
+  /* still in the list when we timed out */
+  link = g_list_find (priv->prepare_waiters, waiter);
+  if (link) {
+    priv->prepare_waiters = g_list_delete_link (priv->prepare_waiters, link);
+    g_source_unref (source);
+  }
+  timeout = (priv->status == GST_RTSP_MEDIA_STATUS_PREPARING);
+  g_mutex_unlock (&priv->lock);
+
+  if (timeout) {
+    GST_DEBUG ("timeout, assuming error status");
+    gst_rtsp_media_set_status (media, GST_RTSP_MEDIA_STATUS_ERROR);
+  }
+
+  g_mutex_lock (&priv->lock);
+  status = priv->status;
+  g_mutex_unlock (&priv->lock);
+
+  success = (status == GST_RTSP_MEDIA_STATUS_PREPARED ||
+      status == GST_RTSP_MEDIA_STATUS_SUSPENDED);
+
+  if (waiter->prepared) {
+    /* nothing to finish */
+  } else if (success) {
+    g_signal_emit (media, gst_rtsp_media_signals[SIGNAL_PREPARED], 0, NULL);
+    GST_INFO ("object %p is prerolled", media);
+  } else if (status == GST_RTSP_MEDIA_STATUS_ERROR) {
+    GST_WARNING ("failed to preroll pipeline");
+    gst_rtsp_media_unprepare (media);
+  } else {
+    GST_INFO ("media %p was unprepared while preparing", media);
+  }
+
+  waiter->func (media, success, waiter->user_data);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+prepare_waiter_finalize (GSource * source)
+{
+  PrepareWaiter *waiter = (PrepareWaiter *) source;
+
+  if (waiter->notify)
+    waiter->notify (waiter->user_data);
+  g_object_unref (waiter->media);
+}
+
+static GSourceFuncs prepare_waiter_funcs = {
+  NULL, NULL, prepare_waiter_dispatch, prepare_waiter_finalize,
+};
+
+/**
+ * gst_rtsp_media_prepare_async:
+ * @media: a #GstRTSPMedia
+ * @thread: (transfer full) (allow-none): a #GstRTSPThread to run the
+ *   bus handler or %NULL
+ * @context: (allow-none): the #GMainContext to call @func from
+ * @func: (scope notified): called when @media is prepared or failed
+ * @user_data: user data passed to @func
+ * @notify: (allow-none): called with @user_data when it is no longer needed
+ *
+ * Prepare @media for streaming like gst_rtsp_media_prepare() but without
+ * waiting for the pipeline to preroll. @func is called from @context when
+ * @media is prepared or when preparing failed. @func is also called, from
+ * the next iteration of @context, when @media was already prepared.
+ *
+ * When preparing fails, @media is unprepared again before @func is called,
+ * like gst_rtsp_media_prepare() does. @func is also called with %FALSE when
+ * @media was unprepared before it finished preparing.
+ *
+ * Returns: %FALSE when preparing could not be started, @func will not be
+ * called in that case.
+ *
+ * Since: 1.20
+ */
+gboolean
+gst_rtsp_media_prepare_async (GstRTSPMedia * media, GstRTSPThread * thread,
+    GMainContext * context, GstRTSPMediaPreparedFunc func, gpointer user_data,
+    GDestroyNotify notify)
+{
+  GstRTSPMediaPrivate *priv;
+  PrepareWaiter *waiter;
+  gboolean prepared;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA (media), FALSE);
+  g_return_val_if_fail (func != NULL, FALSE);
+
+  priv = media->priv;
+
+  if (!begin_prepare (media, thread, &prepared))
+    return FALSE;
+
+  waiter = (PrepareWaiter *) g_source_new (&prepare_waiter_funcs,
+      sizeof (PrepareWaiter));
+  g_source_set_name ((GSource *) waiter, "GstRTSPMedia prepare");
+  waiter->media = g_object_ref (media);
+  waiter->prepared = prepared;
+  waiter->func = func;
+  waiter->user_data = user_data;
+  waiter->notify = notify;
+
+  g_mutex_lock (&priv->lock);
+  if (prepared || priv->status != GST_RTSP_MEDIA_STATUS_PREPARING) {
+    g_source_set_ready_time ((GSource *) waiter, 0);
+  } else {
+    /* same timeout as gst_rtsp_media_get_status() */
+    g_source_set_ready_time ((GSource *) waiter,
+        g_get_monotonic_time () + 20 * G_TIME_SPAN_SECOND);
+    priv->prepare_waiters = g_list_prepend (priv->prepare_waiters,
+        g_source_ref ((GSource *) waiter));
+  }
+  g_mutex_unlock (&priv->lock);
+
+  GST_DEBUG ("media %p waiting for prepare in context %p", media, context);
+
+  g_source_attach ((GSource *) waiter, context);
+  g_source_unref ((GSource *) waiter);
+
+  return TRUE;
+}
+
 /* must be called with state-lock */
 static void
 finish_unprepare (GstRTSPMedia * media)
@@ -3988,6 +5823,7 @@ finish_unprepare (GstRTSPMedia * media)
   g_rec_mutex_lock (&priv->state_lock);
 
   media_streams_set_blocked (media, FALSE);
+  index_stop (media);
 
   for (i = 0; i < priv->streams->len; i++) {
     GstRTSPStream *stream;
@@ -4074,6 +5910,59 @@ default_unprepare (GstRTSPMedia * media)
   return TRUE;
 }
 
+/* must be called with state-lock */
+static gboolean
+unprepare_unlocked (GstRTSPMedia * media, gboolean idle)
+{
+  GstRTSPMediaPrivate *priv = media->priv;
+  gboolean success = TRUE;
+
+  /* whoever prepared the media before has to prepare it again */
+  priv->prepare_count = 0;
+
+  if (priv->idle_source)
+    clear_idle_source (media);
+
+  /* the SDP is only kept to describe a media that was idle or live */
+  if (!idle && !priv->keep_live_sdp && priv->idle_sdp) {
+    gst_sdp_message_free (priv->idle_sdp);
+    priv->idle_sdp = NULL;
+  }
+
+  GST_INFO ("unprepare media %p", media);
+  set_target_state (media, GST_STATE_NULL, FALSE);
+
+  if (priv->status == GST_RTSP_MEDIA_STATUS_PREPARED) {
+    GstRTSPMediaClass *klass;
+
+    klass = GST_RTSP_MEDIA_GET_CLASS (media);
+    if (klass->unprepare)
+      success = klass->unprepare (media);
+  } else {
+    gst_rtsp_media_set_status (media, GST_RTSP_MEDIA_STATUS_UNPREPARING);
+    finish_unprepare (media);
+  }
+  return success;
+}
+
+/* called from the context of the media thread */
+static gboolean
+idle_timeout_cb (GstRTSPMedia * media)
+{
+  GstRTSPMediaPrivate *priv = media->priv;
+
+  g_rec_mutex_lock (&priv->state_lock);
+  /* the source is removed when the media is prepared again */
+  if (priv->idle_source == g_main_current_source () &&
+      priv->prepare_count <= 0) {
+    GST_INFO ("media %p was idle for %u seconds", media, priv->idle_timeout);
+    unprepare_unlocked (media, TRUE);
+  }
+  g_rec_mutex_unlock (&priv->state_lock);
+
+  return G_SOURCE_REMOVE;
+}
+
 /**
  * gst_rtsp_media_unprepare:
  * @media: a #GstRTSPMedia
@@ -4089,6 +5978,7 @@ gst_rtsp_media_unprepare (GstRTSPMedia * media)
 {
   GstRTSPMediaPrivate *priv;
   gboolean success;
+  guint idle_timeout;
 
   g_return_val_if_fail (GST_IS_RTSP_MEDIA (media), FALSE);
 
@@ -4098,28 +5988,38 @@ gst_rtsp_media_unprepare (GstRTSPMedia * media)
   if (priv->status == GST_RTSP_MEDIA_STATUS_UNPREPARED)
     goto was_unprepared;
 
-  priv->prepare_count--;
+  /* an idle media has no users left to release */
+  if (priv->idle_source == NULL && priv->prepare_count > 0)
+    priv->prepare_count--;
   if (priv->prepare_count > 0)
     goto is_busy;
 
-  GST_INFO ("unprepare media %p", media);
-  set_target_state (media, GST_STATE_NULL, FALSE);
-  success = TRUE;
+  g_mutex_lock (&priv->lock);
+  idle_timeout = priv->shared && priv->reusable ? priv->idle_timeout : 0;
+  g_mutex_unlock (&priv->lock);
 
-  if (priv->status == GST_RTSP_MEDIA_STATUS_PREPARED) {
-    GstRTSPMediaClass *klass;
+  if (idle_timeout > 0 && priv->idle_source == NULL &&
+      (priv->status == GST_RTSP_MEDIA_STATUS_PREPARED ||
+          priv->status == GST_RTSP_MEDIA_STATUS_SUSPENDED))
+    goto is_idle;
 
-    klass = GST_RTSP_MEDIA_GET_CLASS (media);
-    if (klass->unprepare)
-      success = klass->unprepare (media);
-  } else {
-    gst_rtsp_media_set_status (media, GST_RTSP_MEDIA_STATUS_UNPREPARING);
-    finish_unprepare (media);
-  }
+  success = unprepare_unlocked (media, FALSE);
   g_rec_mutex_unlock (&priv->state_lock);
 
   return success;
 
+is_idle:
+  {
+    GST_INFO ("media %p is idle, unprepare in %u seconds", media,
+        idle_timeout);
+    priv->idle_source = g_timeout_source_new_seconds (idle_timeout);
+    g_source_set_callback (priv->idle_source, (GSourceFunc) idle_timeout_cb,
+        g_object_ref (media), g_object_unref);
+    g_source_attach (priv->idle_source,
+        priv->thread ? priv->thread->context : NULL);
+    g_rec_mutex_unlock (&priv->state_lock);
+    return TRUE;
+  }
 was_unprepared:
   {
     g_rec_mutex_unlock (&priv->state_lock);
@@ -4134,6 +6034,29 @@ is_busy:
   }
 }
 
+/* Unprepare @media when it is still prepared but nobody holds a prepare count
+ * on it anymore, like a pre-warmed media that was released with
+ * gst_rtsp_media_release_prepare() but then not prepared again. Media that
+ * are prepared by someone else or that wait for their idle timeout are left
+ * alone. */
+void
+gst_rtsp_media_unprepare_released (GstRTSPMedia * media)
+{
+  GstRTSPMediaPrivate *priv;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA (media));
+
+  priv = media->priv;
+
+  g_rec_mutex_lock (&priv->state_lock);
+  if (priv->prepare_count <= 0 && priv->idle_source == NULL &&
+      priv->status != GST_RTSP_MEDIA_STATUS_UNPREPARED) {
+    GST_INFO ("unprepare released media %p", media);
+    unprepare_unlocked (media, FALSE);
+  }
+  g_rec_mutex_unlock (&priv->state_lock);
+}
+
 /* should be called with state-lock */
 static GstClock *
 get_clock_unlocked (GstRTSPMedia * media)
@@ -4307,6 +6230,403 @@ default_setup_sdp (GstRTSPMedia * media, GstSDPMessage * sdp, GstSDPInfo * info)
   return gst_rtsp_sdp_from_media (sdp, info, media);
 }
 
+/* must be called with state-lock */
+static gboolean
+idle_sdp_matches (GstRTSPMedia * media, GstSDPInfo * info)
+{
+  GstRTSPMediaPrivate *priv = media->priv;
+
+  return priv->idle_sdp != NULL && priv->idle_sdp_ipv6 == info->is_ipv6 &&
+      g_strcmp0 (priv->idle_sdp_server_ip, info->server_ip) == 0;
+}
+
+/* Check if a client that was given @described can receive the streams in
+ * @prepared: the medias, their controls and their payload types must be the
+ * same. Other attributes, like the codec parameters, can change in-band. */
+static gboolean
+sdp_medias_compatible (const GstSDPMessage * described,
+    const GstSDPMessage * prepared)
+{
+  guint i, j, len;
+
+  len = gst_sdp_message_medias_len (described);
+  if (len != gst_sdp_message_medias_len (prepared))
+    return FALSE;
+
+  for (i = 0; i < len; i++) {
+    const GstSDPMedia *m1 = gst_sdp_message_get_media (described, i);
+    const GstSDPMedia *m2 = gst_sdp_message_get_media (prepared, i);
+    guint n_formats = gst_sdp_media_formats_len (m1);
+
+    if (g_strcmp0 (gst_sdp_media_get_media (m1),
+            gst_sdp_media_get_media (m2)) != 0 ||
+        g_strcmp0 (gst_sdp_media_get_attribute_val (m1, "control"),
+            gst_sdp_media_get_attribute_val (m2, "control")) != 0 ||
+        n_formats != gst_sdp_media_formats_len (m2))
+      return FALSE;
+
+    for (j = 0; j < n_formats; j++) {
+      if (g_strcmp0 (gst_sdp_media_get_format (m1, j),
+              gst_sdp_media_get_format (m2, j)) != 0 ||
+          g_strcmp0 (gst_sdp_media_get_attribute_val_n (m1, "rtpmap", j),
+              gst_sdp_media_get_attribute_val_n (m2, "rtpmap", j)) != 0)
+        return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+/* Keep the attributes and medias that setup_sdp added to @sdp, starting at
+ * @n_attributes and @n_medias. Nothing is kept when the SDP refers to the
+ * clock of the running pipeline because that changes when the media is
+ * prepared again. Must be called with state-lock */
+static void
+keep_idle_sdp (GstRTSPMedia * media, const GstSDPMessage * sdp,
+    GstSDPInfo * info, guint n_attributes, guint n_medias)
+{
+  GstRTSPMediaPrivate *priv = media->priv;
+  GstSDPMessage *idle_sdp;
+  guint i;
+
+  gst_sdp_message_new (&idle_sdp);
+  for (i = n_attributes; i < gst_sdp_message_attributes_len (sdp); i++) {
+    const GstSDPAttribute *attr = gst_sdp_message_get_attribute (sdp, i);
+
+    if (g_str_equal (attr->key, "x-gst-clock"))
+      goto uses_clock;
+    gst_sdp_message_add_attribute (idle_sdp, attr->key, attr->value);
+  }
+  for (i = n_medias; i < gst_sdp_message_medias_len (sdp); i++) {
+    const GstSDPMedia *smedia = gst_sdp_message_get_media (sdp, i);
+    const gchar *mediaclk = gst_sdp_media_get_attribute_val (smedia,
+        "mediaclk");
+
+    if (mediaclk && g_str_has_prefix (mediaclk, "direct="))
+      goto uses_clock;
+    gst_sdp_message_add_media (idle_sdp, (GstSDPMedia *) smedia);
+  }
+
+  if (priv->idle_sdp_unchecked && priv->idle_sdp) {
+    priv->idle_sdp_changed = !sdp_medias_compatible (priv->idle_sdp, idle_sdp);
+    priv->idle_sdp_unchecked = FALSE;
+    if (priv->idle_sdp_changed)
+      GST_WARNING ("media %p was described with other streams", media);
+  }
+
+  if (priv->idle_sdp)
+    gst_sdp_message_free (priv->idle_sdp);
+  priv->idle_sdp = idle_sdp;
+  priv->idle_sdp_ipv6 = info->is_ipv6;
+  g_free (priv->idle_sdp_server_ip);
+  priv->idle_sdp_server_ip = g_strdup (info->server_ip);
+  return;
+
+uses_clock:
+  {
+    GST_DEBUG ("not keeping SDP of media %p, it refers to the clock", media);
+    gst_sdp_message_free (idle_sdp);
+    if (priv->idle_sdp) {
+      gst_sdp_message_free (priv->idle_sdp);
+      priv->idle_sdp = NULL;
+    }
+  }
+}
+
+/* Check if @media was unprepared after being idle and can be described from
+ * the SDP it had before while it prepares again. */
+gboolean
+gst_rtsp_media_has_idle_sdp (GstRTSPMedia * media)
+{
+  GstRTSPMediaPrivate *priv;
+  gboolean res;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA (media), FALSE);
+
+  priv = media->priv;
+
+  g_rec_mutex_lock (&priv->state_lock);
+  res = priv->idle_sdp != NULL &&
+      (priv->status == GST_RTSP_MEDIA_STATUS_UNPREPARED ||
+      priv->status == GST_RTSP_MEDIA_STATUS_PREPARING);
+  g_rec_mutex_unlock (&priv->state_lock);
+
+  return res;
+}
+
+/* Keep the SDP of @media when it is live, also after it is unprepared, so
+ * that it can be used to describe the next media of the factory. */
+void
+gst_rtsp_media_set_keep_live_sdp (GstRTSPMedia * media, gboolean keep)
+{
+  GstRTSPMediaPrivate *priv;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA (media));
+
+  priv = media->priv;
+
+  g_mutex_lock (&priv->lock);
+  priv->keep_live_sdp = keep;
+  g_mutex_unlock (&priv->lock);
+}
+
+/* Get a copy of the SDP that describes @media while it is not prepared and
+ * the address it was made for. */
+gboolean
+gst_rtsp_media_get_idle_sdp (GstRTSPMedia * media, GstSDPMessage ** sdp,
+    gboolean * is_ipv6, gchar ** server_ip)
+{
+  GstRTSPMediaPrivate *priv;
+  gboolean res = FALSE;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA (media), FALSE);
+  g_return_val_if_fail (sdp != NULL, FALSE);
+  g_return_val_if_fail (is_ipv6 != NULL, FALSE);
+  g_return_val_if_fail (server_ip != NULL, FALSE);
+
+  priv = media->priv;
+
+  g_rec_mutex_lock (&priv->state_lock);
+  if (priv->idle_sdp) {
+    gst_sdp_message_copy (priv->idle_sdp, sdp);
+    *is_ipv6 = priv->idle_sdp_ipv6;
+    *server_ip = g_strdup (priv->idle_sdp_server_ip);
+    res = TRUE;
+  }
+  g_rec_mutex_unlock (&priv->state_lock);
+
+  return res;
+}
+
+/* Describe the unprepared @media with @sdp, which was made for another
+ * media of the same factory, until it is prepared. */
+void
+gst_rtsp_media_set_idle_sdp (GstRTSPMedia * media, const GstSDPMessage * sdp,
+    gboolean is_ipv6, const gchar * server_ip)
+{
+  GstRTSPMediaPrivate *priv;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA (media));
+  g_return_if_fail (sdp != NULL);
+
+  priv = media->priv;
+
+  g_rec_mutex_lock (&priv->state_lock);
+  if (priv->status == GST_RTSP_MEDIA_STATUS_UNPREPARED) {
+    if (priv->idle_sdp)
+      gst_sdp_message_free (priv->idle_sdp);
+    gst_sdp_message_copy (sdp, &priv->idle_sdp);
+    priv->idle_sdp_ipv6 = is_ipv6;
+    g_free (priv->idle_sdp_server_ip);
+    priv->idle_sdp_server_ip = g_strdup (server_ip);
+  }
+  g_rec_mutex_unlock (&priv->state_lock);
+}
+
+/* Check if the streams of the prepared @media are different from the streams
+ * in the SDP that described it while it was preparing. */
+gboolean
+gst_rtsp_media_idle_sdp_changed (GstRTSPMedia * media)
+{
+  GstRTSPMediaPrivate *priv;
+  gboolean res;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA (media), FALSE);
+
+  priv = media->priv;
+
+  g_rec_mutex_lock (&priv->state_lock);
+  if (priv->idle_sdp_unchecked &&
+      (priv->status == GST_RTSP_MEDIA_STATUS_PREPARED ||
+          priv->status == GST_RTSP_MEDIA_STATUS_SUSPENDED)) {
+    GstSDPMessage *sdp;
+    GstSDPInfo info;
+    gchar *server_ip;
+
+    /* making the SDP of the prepared media does the check, the idle SDP is
+     * replaced so keep our own copy of its address */
+    server_ip = g_strdup (priv->idle_sdp_server_ip);
+    info.is_ipv6 = priv->idle_sdp_ipv6;
+    info.server_ip = server_ip;
+    gst_sdp_message_new (&sdp);
+    gst_rtsp_media_setup_sdp (media, sdp, &info);
+    gst_sdp_message_free (sdp);
+    g_free (server_ip);
+    /* nothing to compare with when the SDP could not be kept */
+    priv->idle_sdp_unchecked = FALSE;
+  }
+  res = priv->idle_sdp_changed;
+  g_rec_mutex_unlock (&priv->state_lock);
+
+  return res;
+}
+
+/* must be called with lock */
+static guint
+get_sdp_cookie_unlocked (GstRTSPMedia * media)
+{
+  GstRTSPMediaPrivate *priv = media->priv;
+  guint i, cookie = priv->sdp_cookie;
+
+  /* every change takes a larger cookie than all before */
+  for (i = 0; i < priv->streams->len; i++)
+    cookie = MAX (cookie,
+        gst_rtsp_stream_get_sdp_cookie (g_ptr_array_index (priv->streams, i)));
+
+  return cookie;
+}
+
+/* the range in the SDP depends on the position and the duration of the media
+ * and on whether it is playing, and is not covered by the cookies, so an
+ * entry is only used for the range it was made with */
+static gchar *
+make_sdp_cache_key (GstSDPInfo * info, const gchar * range)
+{
+  return g_strdup_printf ("%s %s %s", info->is_ipv6 ? "IP6" : "IP4",
+      GST_STR_NULL (info->server_ip), range);
+}
+
+/* get the value of the range attribute of @sdp */
+static gchar *
+get_sdp_range (const gchar * sdp)
+{
+  const gchar *start, *end;
+
+  if (!(start = strstr (sdp, "a=range:")))
+    return NULL;
+
+  start += strlen ("a=range:");
+  end = strpbrk (start, "\r\n");
+
+  return g_strndup (start, end ? end - start : strlen (start));
+}
+
+/* Get a copy of the SDP that was stored for @info when nothing in the SDP of
+ * @media changed since. When there is none, @cookie is set to the cookie to
+ * store the new SDP with. */
+gchar *
+gst_rtsp_media_lookup_sdp (GstRTSPMedia * media, GstSDPInfo * info,
+    guint * cookie)
+{
+  GstRTSPMediaPrivate *priv;
+  SDPCacheEntry *entry;
+  gchar *range, *key, *result = NULL;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA (media), NULL);
+  g_return_val_if_fail (info != NULL, NULL);
+  g_return_val_if_fail (cookie != NULL, NULL);
+
+  priv = media->priv;
+
+  /* subclasses can put anything in the SDP */
+  if (GST_RTSP_MEDIA_GET_CLASS (media)->setup_sdp != default_setup_sdp)
+    return NULL;
+
+  /* the range that a new SDP would get, this also fails when the media is not
+   * prepared */
+  range = gst_rtsp_media_get_range_string (media, FALSE, GST_RTSP_RANGE_NPT);
+  if (range == NULL)
+    return NULL;
+
+  g_mutex_lock (&priv->lock);
+  if (priv->status != GST_RTSP_MEDIA_STATUS_PREPARED &&
+      priv->status != GST_RTSP_MEDIA_STATUS_SUSPENDED) {
+    g_mutex_unlock (&priv->lock);
+    g_free (range);
+    return NULL;
+  }
+
+  *cookie = get_sdp_cookie_unlocked (media);
+  key = make_sdp_cache_key (info, range);
+  g_free (range);
+  entry = g_hash_table_lookup (priv->sdp_cache, key);
+  if (entry && entry->cookie == *cookie) {
+    result = g_strdup (entry->sdp);
+    priv->sdp_cache_hits++;
+  } else {
+    priv->sdp_cache_misses++;
+  }
+  g_mutex_unlock (&priv->lock);
+
+  GST_LOG ("SDP for %s of media %p: %s", key, media, result ? "hit" : "miss");
+  g_free (key);
+
+  return result;
+}
+
+/* Store @sdp for @info when nothing in the SDP of @media changed since
+ * gst_rtsp_media_lookup_sdp() returned @cookie. SDPs that depend on the time
+ * they are made are not stored. */
+void
+gst_rtsp_media_store_sdp (GstRTSPMedia * media, GstSDPInfo * info,
+    guint cookie, const gchar * sdp)
+{
+  GstRTSPMediaPrivate *priv;
+  SDPCacheEntry *entry;
+  gchar *range;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA (media));
+  g_return_if_fail (info != NULL);
+  g_return_if_fail (sdp != NULL);
+
+  priv = media->priv;
+
+  if (strstr (sdp, "a=x-gst-clock:") || strstr (sdp, "a=mediaclk:direct="))
+    return;
+
+  /* store the SDP for the range it contains, which is the one that lookups
+   * see as long as the position and duration of the media don't change */
+  if (!(range = get_sdp_range (sdp)))
+    return;
+
+  g_mutex_lock (&priv->lock);
+  if (cookie == get_sdp_cookie_unlocked (media)) {
+    entry = g_slice_new (SDPCacheEntry);
+    entry->cookie = cookie;
+    entry->sdp = g_strdup (sdp);
+    g_hash_table_insert (priv->sdp_cache, make_sdp_cache_key (info, range),
+        entry);
+  }
+  g_mutex_unlock (&priv->lock);
+  g_free (range);
+}
+
+/**
+ * gst_rtsp_media_get_sdp_cache_stats:
+ * @media: a #GstRTSPMedia
+ *
+ * Get statistics about the SDPs that @media keeps for DESCRIBE requests.
+ * The returned structure is called "application/x-rtsp-media-sdp-cache-stats"
+ * and has the following fields:
+ *
+ * - "hits" (G_TYPE_UINT64): the number of SDPs taken from the cache
+ * - "misses" (G_TYPE_UINT64): the number of SDPs that had to be made
+ * - "size" (G_TYPE_UINT): the number of SDPs in the cache
+ *
+ * Returns: (transfer full): a #GstStructure with the statistics, free with
+ * gst_structure_free().
+ *
+ * Since: 1.20
+ */
+GstStructure *
+gst_rtsp_media_get_sdp_cache_stats (GstRTSPMedia * media)
+{
+  GstRTSPMediaPrivate *priv;
+  GstStructure *s;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA (media), NULL);
+
+  priv = media->priv;
+
+  g_mutex_lock (&priv->lock);
+  s = gst_structure_new ("application/x-rtsp-media-sdp-cache-stats",
+      "hits", G_TYPE_UINT64, priv->sdp_cache_hits,
+      "misses", G_TYPE_UINT64, priv->sdp_cache_misses,
+      "size", G_TYPE_UINT, g_hash_table_size (priv->sdp_cache), NULL);
+  g_mutex_unlock (&priv->lock);
+
+  return s;
+}
+
 /**
  * gst_rtsp_media_setup_sdp:
  * @media: a #GstRTSPMedia
@@ -4324,7 +6644,8 @@ gst_rtsp_media_setup_sdp (GstRTSPMedia * media, GstSDPMessage * sdp,
 {
   GstRTSPMediaPrivate *priv;
   GstRTSPMediaClass *klass;
-  gboolean res;
+  gboolean res, keep;
+  guint i, n_attributes, n_medias;
 
   g_return_val_if_fail (GST_IS_RTSP_MEDIA (media), FALSE);
   g_return_val_if_fail (sdp != NULL, FALSE);
@@ -4334,17 +6655,49 @@ gst_rtsp_media_setup_sdp (GstRTSPMedia * media, GstSDPMessage * sdp,
 
   g_rec_mutex_lock (&priv->state_lock);
 
+  if (priv->status != GST_RTSP_MEDIA_STATUS_PREPARED &&
+      priv->status != GST_RTSP_MEDIA_STATUS_SUSPENDED &&
+      idle_sdp_matches (media, info))
+    goto use_idle_sdp;
+
   klass = GST_RTSP_MEDIA_GET_CLASS (media);
 
   if (!klass->setup_sdp)
     goto no_setup_sdp;
 
+  n_attributes = gst_sdp_message_attributes_len (sdp);
+  n_medias = gst_sdp_message_medias_len (sdp);
+
   res = klass->setup_sdp (media, sdp, info);
 
+  g_mutex_lock (&priv->lock);
+  keep = priv->shared && ((priv->reusable && priv->idle_timeout > 0) ||
+      (priv->keep_live_sdp && priv->is_live));
+  g_mutex_unlock (&priv->lock);
+
+  if (res && keep)
+    keep_idle_sdp (media, sdp, info, n_attributes, n_medias);
+
   g_rec_mutex_unlock (&priv->state_lock);
 
   return res;
 
+use_idle_sdp:
+  {
+    GST_DEBUG ("describe idle media %p from its last SDP", media);
+    for (i = 0; i < gst_sdp_message_attributes_len (priv->idle_sdp); i++) {
+      const GstSDPAttribute *attr =
+          gst_sdp_message_get_attribute (priv->idle_sdp, i);
+
+      gst_sdp_message_add_attribute (sdp, attr->key, attr->value);
+    }
+    for (i = 0; i < gst_sdp_message_medias_len (priv->idle_sdp); i++)
+      gst_sdp_message_add_media (sdp,
+          (GstSDPMedia *) gst_sdp_message_get_media (priv->idle_sdp, i));
+    g_rec_mutex_unlock (&priv->state_lock);
+    return TRUE;
+  }
+
   /* ERRORS */
 no_setup_sdp:
   {
@@ -4503,6 +6856,23 @@ do_set_seqnum (GstRTSPStream * stream)
   }
 }
 
+static void
+media_streams_set_gated (GstRTSPMedia * media, gboolean gated)
+{
+  GstRTSPMediaPrivate *priv = media->priv;
+  guint i;
+
+  GST_DEBUG ("media %p set gated %d", media, gated);
+
+  g_mutex_lock (&priv->lock);
+  for (i = 0; i < priv->streams->len; i++) {
+    GstRTSPStream *stream = g_ptr_array_index (priv->streams, i);
+
+    gst_rtsp_stream_set_gated (stream, gated);
+  }
+  g_mutex_unlock (&priv->lock);
+}
+
 /* call with state_lock */
 static gboolean
 default_suspend (GstRTSPMedia * media)
@@ -4514,6 +6884,15 @@ default_suspend (GstRTSPMedia * media)
     case GST_RTSP_SUSPEND_MODE_NONE:
       GST_DEBUG ("media %p no suspend", media);
       break;
+    case GST_RTSP_SUSPEND_MODE_GATE:
+      if (priv->is_live) {
+        /* keep capturing, the data is dropped before the encoders */
+        GST_DEBUG ("media %p suspend by gating the streams", media);
+        media_streams_set_gated (media, TRUE);
+        break;
+      }
+      /* the data of media that are not live can't be dropped, pause them */
+      /* fallthrough */
     case GST_RTSP_SUSPEND_MODE_PAUSE:
       GST_DEBUG ("media %p suspend to PAUSED", media);
       ret = set_target_state (media, GST_STATE_PAUSED, TRUE);
@@ -4644,6 +7023,12 @@ default_unsuspend (GstRTSPMedia * media)
       }
       gst_rtsp_media_set_status (media, GST_RTSP_MEDIA_STATUS_PREPARED);
       break;
+    case GST_RTSP_SUSPEND_MODE_GATE:
+      /* a keyframe is requested, the streams resume with it */
+      if (priv->is_live)
+        media_streams_set_gated (media, FALSE);
+      gst_rtsp_media_set_status (media, GST_RTSP_MEDIA_STATUS_PREPARED);
+      break;
     case GST_RTSP_SUSPEND_MODE_PAUSE:
       gst_rtsp_media_set_status (media, GST_RTSP_MEDIA_STATUS_PREPARED);
       break;
@@ -4766,9 +7151,13 @@ media_set_pipeline_state_locked (GstRTSPMedia * media, GstState state)
       GST_INFO ("Buffering busy, delay state change");
     } else {
       if (state == GST_STATE_PAUSED) {
-        set_state_ret = set_state (media, state);
-        if (set_state_ret == GST_STATE_CHANGE_ASYNC)
-          priv->expected_async_done = TRUE;
+        /* gated live media keep capturing while paused */
+        if (priv->suspend_mode != GST_RTSP_SUSPEND_MODE_GATE ||
+            !priv->is_live) {
+          set_state_ret = set_state (media, state);
+          if (set_state_ret == GST_STATE_CHANGE_ASYNC)
+            priv->expected_async_done = TRUE;
+        }
         /* and suspend after pause */
         gst_rtsp_media_suspend (media);
       } else {
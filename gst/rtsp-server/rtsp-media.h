@@ -68,6 +68,9 @@ typedef enum {
  * @GST_RTSP_SUSPEND_MODE_NONE: Media is not suspended
  * @GST_RTSP_SUSPEND_MODE_PAUSE: Media is PAUSED in suspend
  * @GST_RTSP_SUSPEND_MODE_RESET: The media is set to NULL when suspended
+ * @GST_RTSP_SUSPEND_MODE_GATE: A live media keeps capturing when suspended
+ *   but the data is dropped before the encoders, other media are PAUSED.
+ *   Since: 1.20
  *
  * The suspend mode of the media pipeline. A media pipeline is suspended right
  * after creating the SDP and when the client performs a PAUSED request.
@@ -75,7 +78,8 @@ typedef enum {
 typedef enum {
   GST_RTSP_SUSPEND_MODE_NONE   = 0,
   GST_RTSP_SUSPEND_MODE_PAUSE  = 1,
-  GST_RTSP_SUSPEND_MODE_RESET  = 2
+  GST_RTSP_SUSPEND_MODE_RESET  = 2,
+  GST_RTSP_SUSPEND_MODE_GATE   = 3
 } GstRTSPSuspendMode;
 
 /**
@@ -227,6 +231,75 @@ void                  gst_rtsp_media_set_stop_on_disconnect (GstRTSPMedia *media
 GST_RTSP_SERVER_API
 gboolean              gst_rtsp_media_is_stop_on_disconnect  (GstRTSPMedia *media);
 
+GST_RTSP_SERVER_API
+void                  gst_rtsp_media_set_idle_timeout (GstRTSPMedia *media, guint timeout);
+
+GST_RTSP_SERVER_API
+guint                 gst_rtsp_media_get_idle_timeout (GstRTSPMedia *media);
+
+GST_RTSP_SERVER_API
+void                  gst_rtsp_media_set_gop_cache_size (GstRTSPMedia *media, guint size);
+
+GST_RTSP_SERVER_API
+guint                 gst_rtsp_media_get_gop_cache_size (GstRTSPMedia *media);
+
+GST_RTSP_SERVER_API
+void                  gst_rtsp_media_set_force_keyunit_on_join (GstRTSPMedia *media, gboolean force);
+
+GST_RTSP_SERVER_API
+gboolean              gst_rtsp_media_is_force_keyunit_on_join (GstRTSPMedia *media);
+
+GST_RTSP_SERVER_API
+void                  gst_rtsp_media_set_force_keyunit_interval (GstRTSPMedia *media,
+                                                                 GstClockTime interval);
+
+GST_RTSP_SERVER_API
+GstClockTime          gst_rtsp_media_get_force_keyunit_interval (GstRTSPMedia *media);
+
+GST_RTSP_SERVER_API
+GstStructure *        gst_rtsp_media_get_force_keyunit_stats (GstRTSPMedia *media);
+
+GST_RTSP_SERVER_API
+void                  gst_rtsp_media_set_deactivate_unused_streams (GstRTSPMedia *media,
+                                                                    gboolean deactivate);
+
+GST_RTSP_SERVER_API
+gboolean              gst_rtsp_media_is_deactivate_unused_streams (GstRTSPMedia *media);
+
+GST_RTSP_SERVER_API
+void                  gst_rtsp_media_set_keyframe_trickmode (GstRTSPMedia *media,
+                                                             gboolean keyframes);
+
+GST_RTSP_SERVER_API
+gboolean              gst_rtsp_media_is_keyframe_trickmode (GstRTSPMedia *media);
+
+GST_RTSP_SERVER_API
+void                  gst_rtsp_media_set_timeshift (GstRTSPMedia *media,
+                                                    GstClockTime duration,
+                                                    guint64 max_size);
+
+GST_RTSP_SERVER_API
+void                  gst_rtsp_media_get_timeshift (GstRTSPMedia *media,
+                                                    GstClockTime *duration,
+                                                    guint64 *max_size);
+
+GST_RTSP_SERVER_API
+void                  gst_rtsp_media_set_keyframe_index_location (GstRTSPMedia *media,
+                                                                  const gchar *location);
+
+GST_RTSP_SERVER_API
+gchar *               gst_rtsp_media_get_keyframe_index_location (GstRTSPMedia *media);
+
+GST_RTSP_SERVER_API
+void                  gst_rtsp_media_set_merge_window (GstRTSPMedia *media,
+                                                       GstClockTime window);
+
+GST_RTSP_SERVER_API
+GstClockTime          gst_rtsp_media_get_merge_window (GstRTSPMedia *media);
+
+GST_RTSP_SERVER_API
+GstStructure *        gst_rtsp_media_get_sdp_cache_stats (GstRTSPMedia *media);
+
 GST_RTSP_SERVER_API
 void                  gst_rtsp_media_set_transport_mode  (GstRTSPMedia *media, GstRTSPTransportMode mode);
 
@@ -331,9 +404,30 @@ gint                  gst_rtsp_media_get_dscp_qos (GstRTSPMedia * media);
 
 /* prepare the media for playback */
 
+/**
+ * GstRTSPMediaPreparedFunc:
+ * @media: a #GstRTSPMedia
+ * @success: %TRUE when @media was prepared
+ * @user_data: user data passed to gst_rtsp_media_prepare_async()
+ *
+ * Called when an asynchronous prepare of @media finished.
+ *
+ * Since: 1.20
+ */
+typedef void (*GstRTSPMediaPreparedFunc) (GstRTSPMedia *media, gboolean success,
+                                          gpointer user_data);
+
 GST_RTSP_SERVER_API
 gboolean              gst_rtsp_media_prepare          (GstRTSPMedia *media, GstRTSPThread *thread);
 
+GST_RTSP_SERVER_API
+gboolean              gst_rtsp_media_prepare_async    (GstRTSPMedia *media,
+                                                       GstRTSPThread *thread,
+                                                       GMainContext *context,
+                                                       GstRTSPMediaPreparedFunc func,
+                                                       gpointer user_data,
+                                                       GDestroyNotify notify);
+
 GST_RTSP_SERVER_API
 gboolean              gst_rtsp_media_unprepare        (GstRTSPMedia *media);
 
@@ -404,6 +498,11 @@ gboolean              gst_rtsp_media_seek_trickmode   (GstRTSPMedia *media,
                                                        gdouble rate,
                                                        GstClockTime trickmode_interval);
 
+GST_RTSP_SERVER_API
+gboolean              gst_rtsp_media_seek_timeshift   (GstRTSPMedia *media,
+                                                       GPtrArray *transports,
+                                                       GstRTSPTimeRange *range);
+
 GST_RTSP_SERVER_API
 GstClockTimeDiff      gst_rtsp_media_seekable         (GstRTSPMedia *media);
 
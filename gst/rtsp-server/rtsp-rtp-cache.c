@@ -0,0 +1,1306 @@
+/* GStreamer
+ * Copyright (C) 2021 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+/* A cache of the RTP packets of VOD media. The packets that the payloaders
+ * produce while a media plays from start to end are recorded in a file,
+ * later media of the same asset replay the file instead of demuxing, parsing
+ * and payloading it again. The replayed packets pass through a payloader
+ * that gives them their own SSRC, sequence numbers and timestamps.
+ *
+ * A cache file starts with the magic "GSTRTPC1" and contains records of a
+ * 16 bytes header followed by the data of the record:
+ *
+ *   type (1 byte): 'S' for the version of the source, 'C' for the caps of a
+ *                  stream, 'P' for an RTP packet and 'E' for the end of the
+ *                  file
+ *   stream (1 byte): the index of the stream of the record
+ *   flags (1 byte): RECORD_FLAG_KEYFRAME for the packets of keyframes
+ *   padding (1 byte)
+ *   size (4 bytes, big endian): the size of the data
+ *   time (8 bytes, big endian): the stream time of the packet
+ *
+ * The source record comes first, it describes the asset the packets were
+ * recorded from, like its size and modification time. A file whose source
+ * version differs from the asset is dropped and recorded again.
+ *
+ * The files are memory mapped when they are replayed and the payload of the
+ * packets is never copied. A replay can loop over the file: the streams
+ * start over without a gap after the end record, with timestamps that
+ * continue from the previous pass. All the media with the same cache directory
+ * share the cache, which deletes the least recently used files when it grows
+ * over its maximum size.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <gst/app/gstappsrc.h>
+
+#include "rtsp-rtp-cache.h"
+#include "rtsp-rtp-forward.h"
+
+GST_DEBUG_CATEGORY_STATIC (rtsp_rtp_cache_debug);
+#define GST_CAT_DEFAULT rtsp_rtp_cache_debug
+
+#define CACHE_MAGIC "GSTRTPC1"
+#define CACHE_MAGIC_LEN 8
+#define RECORD_HEADER_LEN 16
+
+#define RECORD_SOURCE 'S'
+#define RECORD_CAPS 'C'
+#define RECORD_PACKET 'P'
+#define RECORD_END 'E'
+
+#define RECORD_FLAG_KEYFRAME (1 << 0)
+
+#define DEFAULT_MAX_SIZE (G_GUINT64_CONSTANT (1024) * 1024 * 1024)
+
+/* packets pushed for each need-data of a replay */
+#define REPLAY_CHUNK 64
+
+typedef struct
+{
+  guint8 type;
+  guint8 stream;
+  guint8 flags;
+  GstClockTime time;
+  gsize data;                   /* offset of the data in the file */
+  gsize size;
+  gsize next;                   /* offset of the next record */
+} CacheRecord;
+
+/* a mapped cache file */
+typedef struct
+{
+  GstClockTime time;
+  gsize pos;
+} CacheKeyframe;
+
+typedef struct
+{
+  GstCaps *caps;
+  GArray *keyframes;            /* of CacheKeyframe */
+  gsize first;                  /* offset of the first packet, 0 if none */
+  GstClockTime last;            /* the time of the last packet */
+  GstClockTime gap;             /* the time between the last two packets */
+} CacheStream;
+
+typedef struct
+{
+  gint ref_count;
+  GMappedFile *file;
+  const guint8 *data;
+  gsize size;
+  GArray *streams;              /* of CacheStream */
+  gchar *source;                /* the version of the source or NULL */
+  GstClockTime duration;
+  GstClockTime period;          /* the time between two passes of a loop */
+} CacheEntry;
+
+static gboolean
+read_record (const guint8 * data, gsize size, gsize pos, CacheRecord * rec)
+{
+  if (pos > size || size - pos < RECORD_HEADER_LEN)
+    return FALSE;
+
+  rec->type = data[pos];
+  rec->stream = data[pos + 1];
+  rec->flags = data[pos + 2];
+  rec->size = GST_READ_UINT32_BE (data + pos + 4);
+  rec->time = GST_READ_UINT64_BE (data + pos + 8);
+  rec->data = pos + RECORD_HEADER_LEN;
+  if (rec->size > size - rec->data)
+    return FALSE;
+  rec->next = rec->data + rec->size;
+
+  return TRUE;
+}
+
+static CacheEntry *
+cache_entry_ref (CacheEntry * entry)
+{
+  g_atomic_int_inc (&entry->ref_count);
+  return entry;
+}
+
+static void
+cache_entry_unref (CacheEntry * entry)
+{
+  guint i;
+
+  if (!g_atomic_int_dec_and_test (&entry->ref_count))
+    return;
+
+  for (i = 0; i < entry->streams->len; i++) {
+    CacheStream *stream = &g_array_index (entry->streams, CacheStream, i);
+
+    if (stream->caps)
+      gst_caps_unref (stream->caps);
+    if (stream->keyframes)
+      g_array_unref (stream->keyframes);
+  }
+  g_array_unref (entry->streams);
+  g_free (entry->source);
+  g_mapped_file_unref (entry->file);
+  g_slice_free (CacheEntry, entry);
+}
+
+static CacheEntry *
+cache_entry_load (const gchar * location, GError ** error)
+{
+  CacheEntry *entry;
+  GMappedFile *file;
+  CacheRecord rec;
+  gsize pos;
+  guint i;
+
+  /* mapped privately, so that nothing can ever write to the file */
+  file = g_mapped_file_new (location, TRUE, error);
+  if (file == NULL)
+    return NULL;
+
+  entry = g_slice_new0 (CacheEntry);
+  entry->ref_count = 1;
+  entry->file = file;
+  entry->data = (const guint8 *) g_mapped_file_get_contents (file);
+  entry->size = g_mapped_file_get_length (file);
+  entry->streams = g_array_new (FALSE, TRUE, sizeof (CacheStream));
+  entry->duration = 0;
+
+  if (entry->size < CACHE_MAGIC_LEN ||
+      memcmp (entry->data, CACHE_MAGIC, CACHE_MAGIC_LEN) != 0)
+    goto invalid;
+
+  for (pos = CACHE_MAGIC_LEN;; pos = rec.next) {
+    CacheStream *stream;
+
+    if (!read_record (entry->data, entry->size, pos, &rec))
+      goto invalid;
+
+    if (rec.type == RECORD_END)
+      break;
+
+    if (rec.type == RECORD_SOURCE) {
+      if (pos != CACHE_MAGIC_LEN)
+        goto invalid;
+      entry->source = g_strndup ((const gchar *) entry->data + rec.data,
+          rec.size);
+      continue;
+    }
+
+    if (rec.stream >= entry->streams->len)
+      g_array_set_size (entry->streams, rec.stream + 1);
+    stream = &g_array_index (entry->streams, CacheStream, rec.stream);
+
+    if (rec.type == RECORD_CAPS) {
+      /* the stream keeps the caps it started with */
+      if (stream->caps == NULL) {
+        gchar *str = g_strndup ((const gchar *) entry->data + rec.data,
+            rec.size);
+
+        stream->caps = gst_caps_from_string (str);
+        g_free (str);
+        if (stream->caps == NULL)
+          goto invalid;
+        stream->keyframes = g_array_new (FALSE, FALSE, sizeof (CacheKeyframe));
+        stream->last = GST_CLOCK_TIME_NONE;
+      }
+    } else if (rec.type == RECORD_PACKET) {
+      if (stream->caps == NULL)
+        goto invalid;
+      if (stream->first == 0)
+        stream->first = pos;
+      if (rec.flags & RECORD_FLAG_KEYFRAME) {
+        CacheKeyframe keyframe = { rec.time, pos };
+
+        g_array_append_val (stream->keyframes, keyframe);
+      }
+      if (GST_CLOCK_TIME_IS_VALID (rec.time)) {
+        /* the packets of a frame all have the time of the frame */
+        if (GST_CLOCK_TIME_IS_VALID (stream->last) && rec.time > stream->last)
+          stream->gap = rec.time - stream->last;
+        stream->last = rec.time;
+        entry->duration = MAX (entry->duration, rec.time);
+      }
+    }
+  }
+
+  /* a file that was not completely written has no end record */
+  if (rec.next != entry->size || entry->streams->len == 0)
+    goto invalid;
+
+  /* the next pass starts one frame after the last frame of the streams */
+  entry->period = entry->duration;
+  for (i = 0; i < entry->streams->len; i++) {
+    CacheStream *stream = &g_array_index (entry->streams, CacheStream, i);
+
+    if (stream->caps == NULL)
+      goto invalid;
+    if (GST_CLOCK_TIME_IS_VALID (stream->last))
+      entry->period = MAX (entry->period, stream->last + stream->gap);
+  }
+
+  return entry;
+
+  /* ERRORS */
+invalid:
+  {
+    g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+        "%s is not a valid RTP cache file", location);
+    cache_entry_unref (entry);
+    return NULL;
+  }
+}
+
+/* the cache */
+typedef struct
+{
+  gchar *name;
+  guint64 size;
+  gint64 mtime;
+  GList link;                   /* in the LRU queue, data points to the file */
+  CacheEntry *entry;            /* mapped when it was first replayed */
+} CacheFile;
+
+struct _GstRTSPRtpCache
+{
+  gint ref_count;               /* protected by caches_lock */
+  gchar *dir;
+
+  GMutex lock;                  /* protects everything below */
+  guint64 max_size;
+  guint64 size;
+  GQueue lru;                   /* of CacheFile, most recently used first */
+  GHashTable *files;            /* name -> CacheFile */
+  GHashTable *recording;        /* names of the files being recorded */
+};
+
+static GMutex caches_lock;
+static GHashTable *caches;      /* dir -> GstRTSPRtpCache */
+
+static CacheFile *
+cache_file_new (const gchar * name, guint64 size, gint64 mtime)
+{
+  CacheFile *file;
+
+  file = g_slice_new0 (CacheFile);
+  file->name = g_strdup (name);
+  file->size = size;
+  file->mtime = mtime;
+  file->link.data = file;
+
+  return file;
+}
+
+static void
+cache_file_free (CacheFile * file)
+{
+  if (file->entry)
+    cache_entry_unref (file->entry);
+  g_free (file->name);
+  g_slice_free (CacheFile, file);
+}
+
+static gint
+cache_file_compare (CacheFile * a, CacheFile * b)
+{
+  /* most recently used first */
+  return a->mtime < b->mtime ? 1 : (a->mtime > b->mtime ? -1 : 0);
+}
+
+static gchar *
+cache_make_name (const gchar * key)
+{
+  gchar *checksum, *name;
+
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, key, -1);
+  name = g_strconcat (checksum, ".rtp", NULL);
+  g_free (checksum);
+
+  return name;
+}
+
+/* called with the cache lock */
+static void
+cache_remove_file (GstRTSPRtpCache * cache, CacheFile * file)
+{
+  gchar *path;
+
+  path = g_build_filename (cache->dir, file->name, NULL);
+  g_unlink (path);
+  g_free (path);
+
+  /* replays of the file keep their mapping */
+  cache->size -= file->size;
+  g_queue_unlink (&cache->lru, &file->link);
+  g_hash_table_remove (cache->files, file->name);
+}
+
+/* called with the cache lock */
+static void
+cache_evict (GstRTSPRtpCache * cache)
+{
+  while (cache->size > cache->max_size && cache->lru.tail) {
+    CacheFile *file = cache->lru.tail->data;
+
+    GST_INFO ("evicting %s of %" G_GUINT64_FORMAT " bytes from %s",
+        file->name, file->size, cache->dir);
+    cache_remove_file (cache, file);
+  }
+}
+
+static void
+cache_scan (GstRTSPRtpCache * cache)
+{
+  GDir *dir;
+  const gchar *name;
+  GList *files = NULL, *walk;
+
+  dir = g_dir_open (cache->dir, 0, NULL);
+  if (dir == NULL)
+    return;
+
+  while ((name = g_dir_read_name (dir))) {
+    GStatBuf st;
+    gchar *path;
+
+    if (!g_str_has_suffix (name, ".rtp"))
+      continue;
+
+    path = g_build_filename (cache->dir, name, NULL);
+    if (g_stat (path, &st) == 0)
+      files = g_list_prepend (files, cache_file_new (name, st.st_size,
+              st.st_mtime));
+    g_free (path);
+  }
+  g_dir_close (dir);
+
+  /* the modification time of a file is updated when it is replayed */
+  files = g_list_sort (files, (GCompareFunc) cache_file_compare);
+  for (walk = files; walk; walk = walk->next) {
+    CacheFile *file = walk->data;
+
+    g_queue_push_tail_link (&cache->lru, &file->link);
+    g_hash_table_insert (cache->files, file->name, file);
+    cache->size += file->size;
+  }
+  g_list_free (files);
+
+  GST_DEBUG ("found %u files of %" G_GUINT64_FORMAT " bytes in %s",
+      cache->lru.length, cache->size, cache->dir);
+}
+
+static GstRTSPRtpCache *
+cache_ref (GstRTSPRtpCache * cache)
+{
+  g_mutex_lock (&caches_lock);
+  cache->ref_count++;
+  g_mutex_unlock (&caches_lock);
+
+  return cache;
+}
+
+/**
+ * gst_rtsp_rtp_cache_get:
+ * @dir: a directory
+ *
+ * Get the RTP cache in @dir, creating it when it does not exist yet. All the
+ * users of the same directory share the cache.
+ *
+ * Returns: (transfer full): the #GstRTSPRtpCache of @dir, release with
+ * gst_rtsp_rtp_cache_unref().
+ */
+GstRTSPRtpCache *
+gst_rtsp_rtp_cache_get (const gchar * dir)
+{
+  GstRTSPRtpCache *cache;
+
+  g_return_val_if_fail (dir != NULL, NULL);
+
+  g_mutex_lock (&caches_lock);
+  if (G_UNLIKELY (caches == NULL)) {
+    GST_DEBUG_CATEGORY_INIT (rtsp_rtp_cache_debug, "rtsprtpcache", 0,
+        "GstRTSPRtpCache");
+    caches = g_hash_table_new (g_str_hash, g_str_equal);
+  }
+
+  cache = g_hash_table_lookup (caches, dir);
+  if (cache) {
+    cache->ref_count++;
+    g_mutex_unlock (&caches_lock);
+    return cache;
+  }
+
+  cache = g_slice_new0 (GstRTSPRtpCache);
+  cache->ref_count = 1;
+  cache->dir = g_strdup (dir);
+  g_mutex_init (&cache->lock);
+  cache->max_size = DEFAULT_MAX_SIZE;
+  g_queue_init (&cache->lru);
+  cache->files = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+      (GDestroyNotify) cache_file_free);
+  cache->recording = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      NULL);
+
+  if (g_mkdir_with_parents (dir, 0755) != 0)
+    GST_WARNING ("could not create cache directory %s", dir);
+  cache_scan (cache);
+
+  g_hash_table_insert (caches, cache->dir, cache);
+  g_mutex_unlock (&caches_lock);
+
+  return cache;
+}
+
+/**
+ * gst_rtsp_rtp_cache_unref:
+ * @cache: (transfer full): a #GstRTSPRtpCache
+ *
+ * Release a cache obtained with gst_rtsp_rtp_cache_get().
+ */
+void
+gst_rtsp_rtp_cache_unref (GstRTSPRtpCache * cache)
+{
+  g_return_if_fail (cache != NULL);
+
+  g_mutex_lock (&caches_lock);
+  if (--cache->ref_count > 0) {
+    g_mutex_unlock (&caches_lock);
+    return;
+  }
+  g_hash_table_remove (caches, cache->dir);
+  g_mutex_unlock (&caches_lock);
+
+  GST_DEBUG ("free cache of %s", cache->dir);
+
+  g_hash_table_unref (cache->files);
+  g_hash_table_unref (cache->recording);
+  g_mutex_clear (&cache->lock);
+  g_free (cache->dir);
+  g_slice_free (GstRTSPRtpCache, cache);
+}
+
+/**
+ * gst_rtsp_rtp_cache_set_max_size:
+ * @cache: a #GstRTSPRtpCache
+ * @max_size: the maximum size of the cache in bytes
+ *
+ * Limit the size of the files in @cache to @max_size. The least recently
+ * used files are deleted when the cache grows larger.
+ */
+void
+gst_rtsp_rtp_cache_set_max_size (GstRTSPRtpCache * cache, guint64 max_size)
+{
+  g_return_if_fail (cache != NULL);
+
+  g_mutex_lock (&cache->lock);
+  cache->max_size = max_size;
+  cache_evict (cache);
+  g_mutex_unlock (&cache->lock);
+}
+
+/* replaying */
+typedef struct
+{
+  CacheEntry *entry;
+  guint stream;
+  gint64 n_loops;               /* the number of passes, -1 for infinite */
+
+  GMutex lock;
+  gsize pos;                    /* offset of the next record */
+  gint64 loops;                 /* the passes left after this one */
+  GstClockTime offset;          /* added to the time of the packets */
+} ReplaySource;
+
+static void
+replay_source_free (ReplaySource * src)
+{
+  cache_entry_unref (src->entry);
+  g_mutex_clear (&src->lock);
+  g_slice_free (ReplaySource, src);
+}
+
+static gsize
+replay_source_start (ReplaySource * src)
+{
+  CacheStream *stream;
+
+  stream = &g_array_index (src->entry->streams, CacheStream, src->stream);
+
+  /* a stream without packets starts at the end */
+  return stream->first ? stream->first : src->entry->size;
+}
+
+/* called with the replay source lock */
+static void
+replay_source_set_pass (ReplaySource * src, gint64 pass)
+{
+  src->loops = src->n_loops < 0 ? -1 : src->n_loops - 1 - pass;
+  src->offset = pass * src->entry->period;
+}
+
+/* called with the replay source lock */
+static gboolean
+replay_source_next_pass (ReplaySource * src)
+{
+  CacheStream *stream;
+
+  stream = &g_array_index (src->entry->streams, CacheStream, src->stream);
+  if (src->loops == 0 || stream->first == 0 || src->entry->period == 0)
+    return FALSE;
+
+  if (src->loops > 0)
+    src->loops--;
+  src->offset += src->entry->period;
+  src->pos = stream->first;
+
+  GST_DEBUG ("stream %u loops, offset %" GST_TIME_FORMAT, src->stream,
+      GST_TIME_ARGS (src->offset));
+
+  return TRUE;
+}
+
+static GstBuffer *
+replay_make_packet (CacheEntry * entry, CacheRecord * rec,
+    GstClockTime offset)
+{
+  const guint8 *data = entry->data + rec->data;
+  GstBuffer *buffer;
+  gsize header_len;
+
+  if (rec->size < 12)
+    return NULL;
+
+  header_len = 12 + (data[0] & 0x0f) * 4;
+  if (data[0] & 0x10) {
+    if (rec->size < header_len + 4)
+      return NULL;
+    header_len += 4 + GST_READ_UINT16_BE (data + header_len + 2) * 4;
+  }
+  if (header_len > rec->size)
+    return NULL;
+
+  /* the payloader rewrites the header in a copy, the payload is shared with
+   * the mapped file */
+  buffer = gst_buffer_new_allocate (NULL, header_len, NULL);
+  gst_buffer_fill (buffer, 0, data, header_len);
+  if (rec->size > header_len)
+    gst_buffer_append_memory (buffer,
+        gst_memory_new_wrapped (0, (gpointer) data, rec->size, header_len,
+            rec->size - header_len, cache_entry_ref (entry),
+            (GDestroyNotify) cache_entry_unref));
+
+  if (GST_CLOCK_TIME_IS_VALID (rec->time))
+    GST_BUFFER_PTS (buffer) = rec->time + offset;
+  if (!(rec->flags & RECORD_FLAG_KEYFRAME))
+    GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+
+  return buffer;
+}
+
+static void
+replay_need_data (GstAppSrc * appsrc, guint length, gpointer user_data)
+{
+  ReplaySource *src = user_data;
+  CacheEntry *entry = src->entry;
+  CacheRecord rec;
+  guint pushed = 0;
+  gboolean eos = FALSE;
+
+  g_mutex_lock (&src->lock);
+  while (pushed < REPLAY_CHUNK) {
+    GstBuffer *buffer;
+
+    if (!read_record (entry->data, entry->size, src->pos, &rec) ||
+        rec.type == RECORD_END) {
+      if (replay_source_next_pass (src))
+        continue;
+      eos = TRUE;
+      break;
+    }
+    src->pos = rec.next;
+
+    if (rec.type != RECORD_PACKET || rec.stream != src->stream)
+      continue;
+
+    if ((buffer = replay_make_packet (entry, &rec, src->offset)) == NULL)
+      continue;
+
+    gst_app_src_push_buffer (appsrc, buffer);
+    pushed++;
+  }
+  g_mutex_unlock (&src->lock);
+
+  if (eos)
+    gst_app_src_end_of_stream (appsrc);
+}
+
+static gboolean
+replay_seek_data (GstAppSrc * appsrc, guint64 time, gpointer user_data)
+{
+  ReplaySource *src = user_data;
+  CacheStream *stream;
+  gint64 pass = 0;
+  gint i;
+
+  stream = &g_array_index (src->entry->streams, CacheStream, src->stream);
+
+  GST_DEBUG ("stream %u seek to %" GST_TIME_FORMAT, src->stream,
+      GST_TIME_ARGS (time));
+
+  /* find the pass of the position when looping */
+  if (src->n_loops != 1 && src->entry->period > 0) {
+    pass = time / src->entry->period;
+    if (src->n_loops > 0)
+      pass = MIN (pass, src->n_loops - 1);
+    time -= pass * src->entry->period;
+  }
+
+  /* start at the last keyframe before the position */
+  g_mutex_lock (&src->lock);
+  replay_source_set_pass (src, pass);
+  src->pos = replay_source_start (src);
+  for (i = stream->keyframes->len - 1; i >= 0; i--) {
+    CacheKeyframe *keyframe = &g_array_index (stream->keyframes,
+        CacheKeyframe, i);
+
+    if (keyframe->time <= time) {
+      src->pos = keyframe->pos;
+      break;
+    }
+  }
+  g_mutex_unlock (&src->lock);
+
+  return TRUE;
+}
+
+static GstElement *
+replay_create (CacheEntry * entry, gint64 loops)
+{
+  GstElement *bin;
+  guint i;
+
+  bin = gst_bin_new ("rtpcache");
+
+  for (i = 0; i < entry->streams->len; i++) {
+    CacheStream *stream = &g_array_index (entry->streams, CacheStream, i);
+    GstAppSrcCallbacks callbacks = { NULL, };
+    GstElement *appsrc, *pay;
+    ReplaySource *src;
+    gchar *name;
+
+    appsrc = gst_element_factory_make ("appsrc", NULL);
+    if (appsrc == NULL)
+      goto no_appsrc;
+
+    name = g_strdup_printf ("pay%u", i);
+    pay = gst_rtsp_rtp_forward_new (name);
+    g_free (name);
+
+    /* an endless loop has no duration and can't seek */
+    g_object_set (appsrc, "caps", stream->caps, "format", GST_FORMAT_TIME,
+        "stream-type", loops < 0 ? GST_APP_STREAM_TYPE_STREAM :
+        GST_APP_STREAM_TYPE_SEEKABLE, NULL);
+    if (loops > 0)
+      gst_app_src_set_duration (GST_APP_SRC (appsrc),
+          (loops - 1) * entry->period + entry->duration);
+
+    src = g_slice_new0 (ReplaySource);
+    src->entry = cache_entry_ref (entry);
+    src->stream = i;
+    src->n_loops = loops;
+    g_mutex_init (&src->lock);
+    replay_source_set_pass (src, 0);
+    src->pos = replay_source_start (src);
+
+    callbacks.need_data = replay_need_data;
+    callbacks.seek_data = replay_seek_data;
+    gst_app_src_set_callbacks (GST_APP_SRC (appsrc), &callbacks, src,
+        (GDestroyNotify) replay_source_free);
+
+    gst_bin_add_many (GST_BIN (bin), appsrc, pay, NULL);
+    gst_element_link (appsrc, pay);
+  }
+
+  return bin;
+
+  /* ERRORS */
+no_appsrc:
+  {
+    GST_ERROR ("can't create appsrc element");
+    gst_object_unref (bin);
+    return NULL;
+  }
+}
+
+/**
+ * gst_rtsp_rtp_cache_get_source_version:
+ * @uri: the URI of an asset
+ *
+ * Get the version of the asset at @uri to record with its packets, made of
+ * its size and entity tag, or modification time when it has no entity tag.
+ *
+ * Returns: (transfer full) (nullable): the version of the asset or %NULL when
+ * it can't be queried.
+ */
+gchar *
+gst_rtsp_rtp_cache_get_source_version (const gchar * uri)
+{
+  GFile *file;
+  GFileInfo *info;
+  gchar *version;
+
+  g_return_val_if_fail (uri != NULL, NULL);
+
+  file = g_file_new_for_uri (uri);
+  info = g_file_query_info (file, G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+      G_FILE_ATTRIBUTE_TIME_MODIFIED "," G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC
+      "," G_FILE_ATTRIBUTE_ETAG_VALUE, G_FILE_QUERY_INFO_NONE, NULL, NULL);
+  g_object_unref (file);
+  if (info == NULL)
+    return NULL;
+
+  if (g_file_info_get_etag (info))
+    version = g_strdup_printf ("size=%" G_GINT64_FORMAT " etag=%s",
+        (gint64) g_file_info_get_size (info), g_file_info_get_etag (info));
+  else
+    version = g_strdup_printf ("size=%" G_GINT64_FORMAT " mtime=%"
+        G_GUINT64_FORMAT ".%06u", (gint64) g_file_info_get_size (info),
+        g_file_info_get_attribute_uint64 (info,
+            G_FILE_ATTRIBUTE_TIME_MODIFIED),
+        g_file_info_get_attribute_uint32 (info,
+            G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC));
+  g_object_unref (info);
+
+  return version;
+}
+
+/**
+ * gst_rtsp_rtp_cache_create_replay:
+ * @cache: a #GstRTSPRtpCache
+ * @key: a string that identifies the asset, like its URI
+ * @source: (nullable): the version of the asset, like its size and
+ *   modification time, or %NULL when it is not known
+ * @loops: the number of times to play the asset, -1 for infinite
+ *
+ * Create a bin that replays the cached packets of the asset with @key. The
+ * bin contains a payloader named pay\%d for each stream of the asset.
+ *
+ * When the packets were recorded from another @source than the asset has
+ * now, the stale file is removed from @cache and %NULL is returned so that
+ * the asset is recorded again.
+ *
+ * When @loops is not 1, the streams start over after the last packet of the
+ * asset. The packets of the next pass follow the packets of the previous
+ * pass with the same spacing as the packets within the asset.
+ *
+ * Returns: (transfer floating) (nullable): a new bin or %NULL when the asset
+ * is not in @cache.
+ */
+GstElement *
+gst_rtsp_rtp_cache_create_replay (GstRTSPRtpCache * cache, const gchar * key,
+    const gchar * source, gint64 loops)
+{
+  CacheFile *file;
+  CacheEntry *entry;
+  GstElement *bin;
+  gchar *name, *path;
+
+  g_return_val_if_fail (cache != NULL, NULL);
+  g_return_val_if_fail (key != NULL, NULL);
+  g_return_val_if_fail (loops != 0 && loops >= -1, NULL);
+
+  name = cache_make_name (key);
+  path = g_build_filename (cache->dir, name, NULL);
+
+  g_mutex_lock (&cache->lock);
+  file = g_hash_table_lookup (cache->files, name);
+  if (file == NULL)
+    goto not_cached;
+
+  if (file->entry == NULL) {
+    GError *error = NULL;
+
+    file->entry = cache_entry_load (path, &error);
+    if (file->entry == NULL) {
+      GST_WARNING ("removing %s: %s", path, error->message);
+      g_clear_error (&error);
+      cache_remove_file (cache, file);
+      goto not_cached;
+    }
+  }
+  if (source && g_strcmp0 (file->entry->source, source) != 0)
+    goto stale;
+  entry = cache_entry_ref (file->entry);
+
+  /* most recently used, also after a restart */
+  g_queue_unlink (&cache->lru, &file->link);
+  g_queue_push_head_link (&cache->lru, &file->link);
+  g_utime (path, NULL);
+  g_mutex_unlock (&cache->lock);
+
+  GST_INFO ("replaying %u streams from %s", entry->streams->len, path);
+
+  bin = replay_create (entry, loops);
+  cache_entry_unref (entry);
+  g_free (path);
+  g_free (name);
+
+  return bin;
+
+  /* ERRORS */
+stale:
+  {
+    GST_INFO ("removing %s, recorded from %s instead of %s", path,
+        GST_STR_NULL (file->entry->source), source);
+    cache_remove_file (cache, file);
+    goto not_cached;
+  }
+not_cached:
+  {
+    g_mutex_unlock (&cache->lock);
+    g_free (path);
+    g_free (name);
+    return NULL;
+  }
+}
+
+/* recording */
+typedef enum
+{
+  RECORDER_WAITING,             /* no packet was written yet */
+  RECORDER_WRITING,
+  RECORDER_DONE                 /* the stream played until its end */
+} RecorderState;
+
+typedef struct
+{
+  GstRTSPRtpCache *cache;
+  gchar *name;
+  gchar *tmp_path;
+
+  GMutex lock;                  /* protects everything below */
+  FILE *file;                   /* NULL when done */
+  GPtrArray *pads;              /* the pads of the streams */
+  GArray *probes;               /* of gulong, one for each pad */
+  GArray *states;               /* of RecorderState, one for each pad */
+  guint n_done;
+} CacheRecorder;
+
+static void
+cache_recording_done (GstRTSPRtpCache * cache, const gchar * name,
+    gboolean success)
+{
+  GStatBuf st;
+  gchar *path;
+
+  path = g_build_filename (cache->dir, name, NULL);
+
+  g_mutex_lock (&cache->lock);
+  if (success && g_stat (path, &st) == 0) {
+    CacheFile *file;
+
+    GST_INFO ("recorded %s of %" G_GUINT64_FORMAT " bytes", path,
+        (guint64) st.st_size);
+
+    file = cache_file_new (name, st.st_size, st.st_mtime);
+    g_queue_push_head_link (&cache->lru, &file->link);
+    g_hash_table_insert (cache->files, file->name, file);
+    cache->size += file->size;
+    cache_evict (cache);
+  }
+  g_hash_table_remove (cache->recording, name);
+  g_mutex_unlock (&cache->lock);
+
+  g_free (path);
+}
+
+/* called with the recorder lock */
+static void
+recorder_abort (CacheRecorder * recorder)
+{
+  if (recorder->file == NULL)
+    return;
+
+  GST_DEBUG ("stop recording %s", recorder->name);
+
+  fclose (recorder->file);
+  recorder->file = NULL;
+  g_unlink (recorder->tmp_path);
+  cache_recording_done (recorder->cache, recorder->name, FALSE);
+}
+
+static gboolean
+write_record (FILE * file, guint8 type, guint stream, guint8 flags,
+    GstClockTime time, const guint8 * data, gsize size)
+{
+  guint8 header[RECORD_HEADER_LEN] = { 0, };
+
+  header[0] = type;
+  header[1] = stream;
+  header[2] = flags;
+  GST_WRITE_UINT32_BE (header + 4, size);
+  GST_WRITE_UINT64_BE (header + 8, time);
+
+  return fwrite (header, 1, RECORD_HEADER_LEN, file) == RECORD_HEADER_LEN &&
+      (size == 0 || fwrite (data, 1, size, file) == size);
+}
+
+/* called with the recorder lock */
+static gboolean
+recorder_write (CacheRecorder * recorder, guint8 type, guint stream,
+    guint8 flags, GstClockTime time, const guint8 * data, gsize size)
+{
+  if (!write_record (recorder->file, type, stream, flags, time, data, size)) {
+    GST_WARNING ("failed to write %s", recorder->tmp_path);
+    recorder_abort (recorder);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/* called with the recorder lock */
+static void
+recorder_write_caps (CacheRecorder * recorder, guint stream, GstCaps * caps)
+{
+  gchar *str;
+
+  str = gst_caps_to_string (caps);
+  recorder_write (recorder, RECORD_CAPS, stream, 0, GST_CLOCK_TIME_NONE,
+      (const guint8 *) str, strlen (str));
+  g_free (str);
+}
+
+/* called with the recorder lock */
+static void
+recorder_write_packet (CacheRecorder * recorder, guint stream, GstPad * pad,
+    GstBuffer * buffer)
+{
+  GstClockTime time = GST_BUFFER_PTS (buffer);
+  GstEvent *event;
+  GstMapInfo map;
+  guint8 flags = 0;
+
+  if (recorder->file == NULL)
+    return;
+
+  event = gst_pad_get_sticky_event (pad, GST_EVENT_SEGMENT, 0);
+  if (event) {
+    const GstSegment *segment;
+
+    gst_event_parse_segment (event, &segment);
+    if (segment->format == GST_FORMAT_TIME && GST_CLOCK_TIME_IS_VALID (time))
+      time = gst_segment_to_stream_time (segment, GST_FORMAT_TIME, time);
+    gst_event_unref (event);
+  }
+
+  if (!GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT))
+    flags |= RECORD_FLAG_KEYFRAME;
+
+  if (!gst_buffer_map (buffer, &map, GST_MAP_READ))
+    return;
+  recorder_write (recorder, RECORD_PACKET, stream, flags, time, map.data,
+      map.size);
+  gst_buffer_unmap (buffer, &map);
+}
+
+/* called with the recorder lock */
+static void
+recorder_finish (CacheRecorder * recorder)
+{
+  gchar *path;
+  gboolean success;
+
+  if (!recorder_write (recorder, RECORD_END, 0, 0, GST_CLOCK_TIME_NONE, NULL,
+          0))
+    return;
+
+  path = g_build_filename (recorder->cache->dir, recorder->name, NULL);
+  success = fclose (recorder->file) == 0 &&
+      g_rename (recorder->tmp_path, path) == 0;
+  recorder->file = NULL;
+  if (!success) {
+    GST_WARNING ("failed to save %s", path);
+    g_unlink (recorder->tmp_path);
+  }
+  g_free (path);
+
+  cache_recording_done (recorder->cache, recorder->name, success);
+}
+
+static GstPadProbeReturn
+recorder_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  CacheRecorder *recorder = user_data;
+  RecorderState *state;
+  guint stream;
+
+  g_mutex_lock (&recorder->lock);
+  if (recorder->file == NULL)
+    goto done;
+
+  for (stream = 0; stream < recorder->pads->len; stream++) {
+    if (g_ptr_array_index (recorder->pads, stream) == pad)
+      break;
+  }
+  if (stream == recorder->pads->len)
+    goto done;
+
+  state = &g_array_index (recorder->states, RecorderState, stream);
+  if (*state == RECORDER_DONE)
+    goto done;
+
+  if (info->type & (GST_PAD_PROBE_TYPE_BUFFER |
+          GST_PAD_PROBE_TYPE_BUFFER_LIST))
+    *state = RECORDER_WRITING;
+
+  if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+    recorder_write_packet (recorder, stream, pad,
+        GST_PAD_PROBE_INFO_BUFFER (info));
+  } else if (info->type & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+    GstBufferList *list = GST_PAD_PROBE_INFO_BUFFER_LIST (info);
+    guint i, len = gst_buffer_list_length (list);
+
+    for (i = 0; i < len; i++)
+      recorder_write_packet (recorder, stream, pad,
+          gst_buffer_list_get (list, i));
+  } else {
+    GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+
+    switch (GST_EVENT_TYPE (event)) {
+      case GST_EVENT_CAPS:
+      {
+        GstCaps *caps;
+
+        gst_event_parse_caps (event, &caps);
+        recorder_write_caps (recorder, stream, caps);
+        break;
+      }
+      case GST_EVENT_FLUSH_START:
+        /* a seek, the packets no longer play the asset from start to end.
+         * A seek before the first packet, like the one that starts a loop,
+         * does not matter. */
+        if (*state == RECORDER_WRITING)
+          recorder_abort (recorder);
+        break;
+      case GST_EVENT_SEGMENT:
+      {
+        const GstSegment *segment;
+
+        if (*state != RECORDER_WRITING)
+          break;
+
+        /* a loop starts over, the stream played until its end */
+        gst_event_parse_segment (event, &segment);
+        if (segment->time != 0) {
+          recorder_abort (recorder);
+          break;
+        }
+      }
+        /* fallthrough */
+      case GST_EVENT_EOS:
+        *state = RECORDER_DONE;
+        if (++recorder->n_done == recorder->pads->len)
+          recorder_finish (recorder);
+        break;
+      default:
+        break;
+    }
+  }
+
+done:
+  g_mutex_unlock (&recorder->lock);
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* called with the recorder lock */
+static void
+recorder_remove_probes (CacheRecorder * recorder)
+{
+  guint i;
+
+  for (i = 0; i < recorder->pads->len; i++)
+    gst_pad_remove_probe (g_ptr_array_index (recorder->pads, i),
+        g_array_index (recorder->probes, gulong, i));
+  g_ptr_array_set_size (recorder->pads, 0);
+  g_array_set_size (recorder->probes, 0);
+  g_array_set_size (recorder->states, 0);
+}
+
+static void
+recorder_new_stream (GstRTSPMedia * media, GstRTSPStream * stream,
+    CacheRecorder * recorder)
+{
+  GstPad *pad;
+  GstCaps *caps;
+  RecorderState state = RECORDER_WAITING;
+  gulong id;
+
+  pad = gst_rtsp_stream_get_srcpad (stream);
+  if (pad == NULL)
+    return;
+
+  g_mutex_lock (&recorder->lock);
+  if (recorder->file == NULL || recorder->pads->len > G_MAXUINT8) {
+    recorder_abort (recorder);
+    g_mutex_unlock (&recorder->lock);
+    gst_object_unref (pad);
+    return;
+  }
+
+  if ((caps = gst_pad_get_current_caps (pad))) {
+    recorder_write_caps (recorder, recorder->pads->len, caps);
+    gst_caps_unref (caps);
+  }
+
+  id = gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER |
+      GST_PAD_PROBE_TYPE_BUFFER_LIST | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM |
+      GST_PAD_PROBE_TYPE_EVENT_FLUSH, recorder_probe, recorder, NULL);
+  g_ptr_array_add (recorder->pads, pad);
+  g_array_append_val (recorder->probes, id);
+  g_array_append_val (recorder->states, state);
+  g_mutex_unlock (&recorder->lock);
+}
+
+static void
+recorder_unprepared (GstRTSPMedia * media, CacheRecorder * recorder)
+{
+  g_mutex_lock (&recorder->lock);
+  recorder_abort (recorder);
+  recorder_remove_probes (recorder);
+  g_mutex_unlock (&recorder->lock);
+}
+
+static void
+recorder_free (CacheRecorder * recorder)
+{
+  g_mutex_lock (&recorder->lock);
+  recorder_abort (recorder);
+  recorder_remove_probes (recorder);
+  g_mutex_unlock (&recorder->lock);
+
+  g_ptr_array_unref (recorder->pads);
+  g_array_unref (recorder->probes);
+  g_array_unref (recorder->states);
+  g_mutex_clear (&recorder->lock);
+  gst_rtsp_rtp_cache_unref (recorder->cache);
+  g_free (recorder->tmp_path);
+  g_free (recorder->name);
+  g_slice_free (CacheRecorder, recorder);
+}
+
+/**
+ * gst_rtsp_rtp_cache_record:
+ * @cache: a #GstRTSPRtpCache
+ * @key: a string that identifies the asset, like its URI
+ * @source: (nullable): the version of the asset, like its size and
+ *   modification time, or %NULL when it is not known
+ * @media: a #GstRTSPMedia of the asset that was not prepared yet
+ *
+ * Record the packets of the streams of @media in @cache. The packets are
+ * only kept when @media plays the asset from start to end without seeking.
+ * When @media loops over the asset, the first pass is recorded.
+ * Nothing is recorded when the asset is in @cache already or when another
+ * media is recording it.
+ */
+void
+gst_rtsp_rtp_cache_record (GstRTSPRtpCache * cache, const gchar * key,
+    const gchar * source, GstRTSPMedia * media)
+{
+  CacheRecorder *recorder;
+  gchar *name, *tmp_path;
+  FILE *file;
+  guint i, n_streams;
+
+  g_return_if_fail (cache != NULL);
+  g_return_if_fail (key != NULL);
+  g_return_if_fail (GST_IS_RTSP_MEDIA (media));
+
+  name = cache_make_name (key);
+  tmp_path = g_strdup_printf ("%s" G_DIR_SEPARATOR_S "%s.tmp", cache->dir,
+      name);
+
+  g_mutex_lock (&cache->lock);
+  if (g_hash_table_contains (cache->files, name) ||
+      g_hash_table_contains (cache->recording, name))
+    goto skip;
+
+  file = g_fopen (tmp_path, "wb");
+  if (file == NULL || fwrite (CACHE_MAGIC, 1, CACHE_MAGIC_LEN, file) !=
+      CACHE_MAGIC_LEN)
+    goto open_failed;
+  if (source && !write_record (file, RECORD_SOURCE, 0, 0, GST_CLOCK_TIME_NONE,
+          (const guint8 *) source, strlen (source)))
+    goto open_failed;
+
+  g_hash_table_add (cache->recording, g_strdup (name));
+  g_mutex_unlock (&cache->lock);
+
+  GST_INFO ("recording %s in %s", key, tmp_path);
+
+  recorder = g_slice_new0 (CacheRecorder);
+  recorder->cache = cache_ref (cache);
+  recorder->name = name;
+  recorder->tmp_path = tmp_path;
+  g_mutex_init (&recorder->lock);
+  recorder->file = file;
+  recorder->pads = g_ptr_array_new_with_free_func (gst_object_unref);
+  recorder->probes = g_array_new (FALSE, FALSE, sizeof (gulong));
+  recorder->states = g_array_new (FALSE, FALSE, sizeof (RecorderState));
+
+  g_signal_connect (media, "new-stream", (GCallback) recorder_new_stream,
+      recorder);
+  g_signal_connect (media, "unprepared", (GCallback) recorder_unprepared,
+      recorder);
+  g_object_set_data_full (G_OBJECT (media), "gst-rtsp-rtp-cache-recorder",
+      recorder, (GDestroyNotify) recorder_free);
+
+  n_streams = gst_rtsp_media_n_streams (media);
+  for (i = 0; i < n_streams; i++)
+    recorder_new_stream (media, gst_rtsp_media_get_stream (media, i),
+        recorder);
+
+  return;
+
+  /* ERRORS */
+skip:
+  {
+    g_mutex_unlock (&cache->lock);
+    g_free (tmp_path);
+    g_free (name);
+    return;
+  }
+open_failed:
+  {
+    GST_WARNING ("could not record in %s", tmp_path);
+    if (file) {
+      fclose (file);
+      g_unlink (tmp_path);
+    }
+    g_mutex_unlock (&cache->lock);
+    g_free (tmp_path);
+    g_free (name);
+    return;
+  }
+}
@@ -0,0 +1,52 @@
+/* GStreamer
+ * Copyright (C) 2021 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_RTSP_RTP_CACHE_H__
+#define __GST_RTSP_RTP_CACHE_H__
+
+#include <gst/gst.h>
+
+#include "rtsp-media.h"
+
+G_BEGIN_DECLS
+
+typedef struct _GstRTSPRtpCache GstRTSPRtpCache;
+
+GstRTSPRtpCache * gst_rtsp_rtp_cache_get           (const gchar *dir);
+
+void              gst_rtsp_rtp_cache_unref         (GstRTSPRtpCache *cache);
+
+void              gst_rtsp_rtp_cache_set_max_size  (GstRTSPRtpCache *cache,
+                                                    guint64 max_size);
+
+gchar *           gst_rtsp_rtp_cache_get_source_version (const gchar *uri);
+
+GstElement *      gst_rtsp_rtp_cache_create_replay (GstRTSPRtpCache *cache,
+                                                    const gchar *key,
+                                                    const gchar *source,
+                                                    gint64 loops);
+
+void              gst_rtsp_rtp_cache_record        (GstRTSPRtpCache *cache,
+                                                    const gchar *key,
+                                                    const gchar *source,
+                                                    GstRTSPMedia *media);
+
+G_END_DECLS
+
+#endif /* __GST_RTSP_RTP_CACHE_H__ */
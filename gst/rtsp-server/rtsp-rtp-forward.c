@@ -0,0 +1,145 @@
+/* GStreamer
+ * Copyright (C) 2021 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+/* A payloader for RTP packets that were payloaded elsewhere, like the
+ * packets replayed from the RTP cache or received from an upstream RTSP
+ * server. The base class gives the packets the SSRC, sequence numbers and
+ * timestamps of the stream, the payload of the packets is not touched.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/rtp/gstrtpbasepayload.h>
+
+#include "rtsp-rtp-forward.h"
+
+GST_DEBUG_CATEGORY_STATIC (rtsp_rtp_forward_debug);
+#define GST_CAT_DEFAULT rtsp_rtp_forward_debug
+
+typedef struct
+{
+  GstRTPBasePayload payload;
+} GstRTSPForwardPay;
+
+typedef struct
+{
+  GstRTPBasePayloadClass parent_class;
+} GstRTSPForwardPayClass;
+
+static GstStaticPadTemplate forward_pay_sink_template =
+GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("application/x-rtp"));
+
+static GstStaticPadTemplate forward_pay_src_template =
+GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("application/x-rtp"));
+
+static GType gst_rtsp_forward_pay_get_type (void);
+
+G_DEFINE_TYPE (GstRTSPForwardPay, gst_rtsp_forward_pay,
+    GST_TYPE_RTP_BASE_PAYLOAD);
+
+static gboolean
+gst_rtsp_forward_pay_set_caps (GstRTPBasePayload * payload, GstCaps * caps)
+{
+  GstStructure *s;
+  const gchar *media, *encoding_name;
+  gint clock_rate = 0, pt = -1;
+  gboolean res;
+
+  s = gst_structure_copy (gst_caps_get_structure (caps, 0));
+  media = gst_structure_get_string (s, "media");
+  encoding_name = gst_structure_get_string (s, "encoding-name");
+  gst_structure_get_int (s, "clock-rate", &clock_rate);
+  if (media == NULL || encoding_name == NULL || clock_rate <= 0) {
+    GST_WARNING_OBJECT (payload, "incomplete caps %" GST_PTR_FORMAT, caps);
+    gst_structure_free (s);
+    return FALSE;
+  }
+
+  if (gst_structure_get_int (s, "payload", &pt))
+    g_object_set (payload, "pt", pt, NULL);
+  gst_rtp_base_payload_set_options (payload, media, pt < 0 || pt >= 96,
+      encoding_name, clock_rate);
+
+  /* keep the fields that describe the payload, like the codec data, but not
+   * the ones of the payloader or the session that produced the packets */
+  gst_structure_remove_fields (s, "media", "payload", "clock-rate",
+      "encoding-name", "ssrc", "timestamp-offset", "seqnum-offset",
+      "clock-base", "seqnum-base", "npt-start", "npt-stop", "play-speed",
+      "play-scale", "onvif-mode", NULL);
+  res = gst_rtp_base_payload_set_outcaps_structure (payload, s);
+  gst_structure_free (s);
+
+  return res;
+}
+
+static GstFlowReturn
+gst_rtsp_forward_pay_handle_buffer (GstRTPBasePayload * payload,
+    GstBuffer * buffer)
+{
+  return gst_rtp_base_payload_push (payload, buffer);
+}
+
+static void
+gst_rtsp_forward_pay_class_init (GstRTSPForwardPayClass * klass)
+{
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+  GstRTPBasePayloadClass *payload_class = GST_RTP_BASE_PAYLOAD_CLASS (klass);
+
+  gst_element_class_add_static_pad_template (element_class,
+      &forward_pay_sink_template);
+  gst_element_class_add_static_pad_template (element_class,
+      &forward_pay_src_template);
+  gst_element_class_set_static_metadata (element_class,
+      "RTP forward payloader", "Codec/Payloader/Network/RTP",
+      "Sends RTP packets with a new SSRC, sequence numbers and timestamps",
+      "GStreamer developers");
+
+  payload_class->set_caps = gst_rtsp_forward_pay_set_caps;
+  payload_class->handle_buffer = gst_rtsp_forward_pay_handle_buffer;
+
+  GST_DEBUG_CATEGORY_INIT (rtsp_rtp_forward_debug, "rtsprtpforward", 0,
+      "GstRTSPRtpForward");
+}
+
+static void
+gst_rtsp_forward_pay_init (GstRTSPForwardPay * pay)
+{
+}
+
+/**
+ * gst_rtsp_rtp_forward_new:
+ * @name: (allow-none): the name of the element
+ *
+ * Create a payloader that sends the RTP packets it receives with the SSRC,
+ * sequence numbers and timestamps of its own stream. The caps of the
+ * packets must have the media, encoding-name and clock-rate fields.
+ *
+ * Returns: (transfer floating): a new payloader element
+ */
+GstElement *
+gst_rtsp_rtp_forward_new (const gchar * name)
+{
+  return g_object_new (gst_rtsp_forward_pay_get_type (), "name", name, NULL);
+}
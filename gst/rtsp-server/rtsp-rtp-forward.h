@@ -1,6 +1,5 @@
 /* GStreamer
- * Copyright (C) 2019 Mathieu Duponchelle <mathieu@centricular.com>
- * Copyright (C) 2020 Seungha Yang <seungha@centricular.com>
+ * Copyright (C) 2021 GStreamer developers
  *
  * This library is free software; you can redistribute it and/or
  * modify it under the terms of the GNU Library General Public
@@ -18,19 +17,15 @@
  * Boston, MA 02110-1301, USA.
  */
 
+#ifndef __GST_RTSP_RTP_FORWARD_H__
+#define __GST_RTSP_RTP_FORWARD_H__
 
 #include <gst/gst.h>
 
-#include <gst/rtsp-server/rtsp-server.h>
-
 G_BEGIN_DECLS
 
-#define GST_TYPE_REPLAY_BIN (gst_replay_bin_get_type ())
-G_DECLARE_FINAL_TYPE (GstReplayBin, gst_replay_bin, GST, REPLAY_BIN, GstBin);
-
-#define GST_TYPE_RTSP_MEDIA_FACTORY_REPLAY (gst_rtsp_media_factory_replay_get_type ())
-G_DECLARE_FINAL_TYPE (GstRTSPMediaFactoryReplay,
-    gst_rtsp_media_factory_replay, GST, RTSP_MEDIA_FACTORY_REPLAY,
-    GstRTSPMediaFactory);
+GstElement * gst_rtsp_rtp_forward_new (const gchar *name);
 
 G_END_DECLS
+
+#endif /* __GST_RTSP_RTP_FORWARD_H__ */
@@ -36,6 +36,19 @@
 #include <gst/sdp/gstmikey.h>
 
 #include "rtsp-sdp.h"
+#include "rtsp-server-internal.h"
+
+/* the last cookie handed out, see gst_rtsp_sdp_next_cookie() */
+static gint sdp_cookie_seq = 0;
+
+/* Get a new cookie, larger than all cookies handed out before. Objects that
+ * end up in the SDP take a new cookie when they change. The largest cookie
+ * of the objects in an SDP changes when any of them changes. */
+guint
+gst_rtsp_sdp_next_cookie (void)
+{
+  return (guint) g_atomic_int_add (&sdp_cookie_seq, 1) + 1;
+}
 
 static gboolean
 get_info_from_tags (GstPad * pad, GstEvent ** event, gpointer user_data)
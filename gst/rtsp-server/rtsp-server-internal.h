@@ -25,6 +25,8 @@
 G_BEGIN_DECLS
 
 #include "rtsp-stream-transport.h"
+#include "rtsp-session-pool.h"
+#include "rtsp-media-factory-uri.h"
 
 /* Internal GstRTSPStreamTransport interface */
 
@@ -59,7 +61,79 @@ gboolean                 gst_rtsp_stream_transport_check_back_pressure (GstRTSPS
 gboolean                 gst_rtsp_stream_is_tcp_receiver (GstRTSPStream * stream);
 
 void                     gst_rtsp_media_set_enable_rtcp (GstRTSPMedia *media, gboolean enable);
+void                     gst_rtsp_media_release_prepare (GstRTSPMedia *media);
+void                     gst_rtsp_media_unprepare_released (GstRTSPMedia *media);
+gboolean                 gst_rtsp_media_has_idle_sdp (GstRTSPMedia *media);
+void                     gst_rtsp_media_set_keep_live_sdp (GstRTSPMedia *media, gboolean keep);
+gboolean                 gst_rtsp_media_get_idle_sdp (GstRTSPMedia *media,
+                                                      GstSDPMessage **sdp,
+                                                      gboolean *is_ipv6,
+                                                      gchar **server_ip);
+void                     gst_rtsp_media_set_idle_sdp (GstRTSPMedia *media,
+                                                      const GstSDPMessage *sdp,
+                                                      gboolean is_ipv6,
+                                                      const gchar *server_ip);
+gboolean                 gst_rtsp_media_idle_sdp_changed (GstRTSPMedia *media);
+gboolean                 gst_rtsp_media_can_merge (GstRTSPMedia *media);
+GstRTSPStatusCode        gst_rtsp_media_merge_seek (GstRTSPMedia *media,
+                                                    gboolean active,
+                                                    const GstRTSPTimeRange *range,
+                                                    gdouble rate,
+                                                    gboolean *merged);
+gchar *                  gst_rtsp_media_lookup_sdp (GstRTSPMedia *media,
+                                                    GstSDPInfo *info,
+                                                    guint *cookie);
+void                     gst_rtsp_media_store_sdp (GstRTSPMedia *media,
+                                                   GstSDPInfo *info,
+                                                   guint cookie,
+                                                   const gchar *sdp);
 void                     gst_rtsp_stream_set_enable_rtcp (GstRTSPStream *stream, gboolean enable);
+guint                    gst_rtsp_stream_get_sdp_cookie (GstRTSPStream *stream);
+void                     gst_rtsp_stream_set_force_keyunit_interval (GstRTSPStream *stream,
+                                                                     GstClockTime interval);
+void                     gst_rtsp_stream_get_force_keyunit_stats (GstRTSPStream *stream,
+                                                                  guint64 *honored,
+                                                                  guint64 *suppressed);
+void                     gst_rtsp_stream_set_idle_unused (GstRTSPStream *stream,
+                                                          gboolean idle);
+void                     gst_rtsp_stream_set_gated (GstRTSPStream *stream,
+                                                    gboolean gated);
+void                     gst_rtsp_stream_set_drop_blocked (GstRTSPStream *stream,
+                                                           gboolean drop);
+gboolean                 gst_rtsp_stream_get_timeshift_rtpinfo (GstRTSPStream *stream,
+                                                                GstRTSPStreamTransport *trans,
+                                                                guint *rtptime,
+                                                                guint *seq,
+                                                                guint *clock_rate);
+void                     gst_rtsp_stream_set_gop_keep_start (GstRTSPStream *stream,
+                                                             GstClockTime duration);
+GstClockTime             gst_rtsp_stream_get_gop_start_time (GstRTSPStream *stream);
+gboolean                 gst_rtsp_stream_get_gop_rtpinfo (GstRTSPStream *stream,
+                                                          GstRTSPStreamTransport *trans,
+                                                          guint *rtptime,
+                                                          guint *seq,
+                                                          guint *clock_rate,
+                                                          GstClockTime *running_time);
+
+/* Internal GstRTSPMediaFactoryURI interface */
+
+void                     gst_rtsp_media_factory_uri_set_loops (GstRTSPMediaFactoryURI *factory,
+                                                               gint64 loops);
+gint64                   gst_rtsp_media_factory_uri_get_loops (GstRTSPMediaFactoryURI *factory);
+
+/* Internal SDP interface */
+
+guint                    gst_rtsp_sdp_next_cookie (void);
+
+/* Internal GstRTSPSession interface */
+
+void                     gst_rtsp_session_set_pool (GstRTSPSession *session,
+                                                    GstRTSPSessionPool *pool);
+
+/* Internal GstRTSPSessionPool interface */
+
+void                     gst_rtsp_session_pool_update_expiry (GstRTSPSessionPool *pool,
+                                                              GstRTSPSession *session);
 
 G_END_DECLS
 
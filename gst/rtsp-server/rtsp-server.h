@@ -44,6 +44,10 @@ G_BEGIN_DECLS
 #include "rtsp-session-media.h"
 #include "rtsp-sdp.h"
 #include "rtsp-media-factory-uri.h"
+#include "rtsp-media-factory-relay.h"
+#include "rtsp-media-factory-push.h"
+#include "rtsp-media-factory-replay.h"
+#include "rtsp-source-hub.h"
 #include "rtsp-params.h"
 
 #include "rtsp-onvif-client.h"
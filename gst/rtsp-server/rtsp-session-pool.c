@@ -44,13 +44,39 @@
 #endif
 
 #include "rtsp-session-pool.h"
+#include "rtsp-server-internal.h"
 
-struct _GstRTSPSessionPoolPrivate
+/* a session in the pool. The expiry time is a lower bound of the time the
+ * session expires, sessions are not rescheduled when they are touched but
+ * when their expiry time is reached */
+typedef struct
+{
+  GstRTSPSession *session;
+  gint64 expiry;
+  gint index;                   /* position in the expiry heap or -1 */
+} SessionEntry;
+
+/* the sessions are spread over a number of shards based on the hash of the
+ * session id so that lookups from different threads don't all contend on
+ * the same lock */
+#define N_SHARDS 16
+
+typedef struct
 {
   GMutex lock;                  /* protects everything in this struct */
-  guint max_sessions;
   GHashTable *sessions;
-  guint sessions_cookie;
+  guint cookie;
+
+  /* min-heap of SessionEntry, ordered on expiry */
+  GPtrArray *expiry;
+} SessionShard;
+
+struct _GstRTSPSessionPoolPrivate
+{
+  guint max_sessions;           /* atomic */
+  gint n_sessions;              /* atomic */
+
+  SessionShard shards[N_SHARDS];
 };
 
 #define DEFAULT_MAX_SESSIONS 0
@@ -124,19 +150,218 @@ gst_rtsp_session_pool_class_init (GstRTSPSessionPoolClass * klass)
       "GstRTSPSessionPool");
 }
 
+static void
+session_entry_free (SessionEntry * entry)
+{
+  gst_rtsp_session_set_pool (entry->session, NULL);
+  g_object_unref (entry->session);
+  g_slice_free (SessionEntry, entry);
+}
+
 static void
 gst_rtsp_session_pool_init (GstRTSPSessionPool * pool)
 {
   GstRTSPSessionPoolPrivate *priv;
+  guint i;
 
   pool->priv = priv = gst_rtsp_session_pool_get_instance_private (pool);
 
-  g_mutex_init (&priv->lock);
-  priv->sessions = g_hash_table_new_full (g_str_hash, g_str_equal,
-      NULL, g_object_unref);
+  for (i = 0; i < N_SHARDS; i++) {
+    SessionShard *shard = &priv->shards[i];
+
+    g_mutex_init (&shard->lock);
+    shard->sessions = g_hash_table_new_full (g_str_hash, g_str_equal,
+        NULL, (GDestroyNotify) session_entry_free);
+    shard->expiry = g_ptr_array_new ();
+  }
   priv->max_sessions = DEFAULT_MAX_SESSIONS;
 }
 
+static SessionShard *
+get_shard (GstRTSPSessionPoolPrivate * priv, const gchar * sessionid)
+{
+  guint hash = g_str_hash (sessionid);
+
+  /* mix in the high bits, the hash table uses the low bits */
+  return &priv->shards[(hash ^ (hash >> 16)) % N_SHARDS];
+}
+
+#define HEAP_ENTRY(shard,i) ((SessionEntry *) g_ptr_array_index ((shard)->expiry, (i)))
+
+static void
+heap_set (SessionShard * shard, gint index, SessionEntry * entry)
+{
+  g_ptr_array_index (shard->expiry, index) = entry;
+  entry->index = index;
+}
+
+static void
+heap_sift_up (SessionShard * shard, gint index)
+{
+  SessionEntry *entry = HEAP_ENTRY (shard, index);
+
+  while (index > 0) {
+    gint parent = (index - 1) / 2;
+    SessionEntry *p = HEAP_ENTRY (shard, parent);
+
+    if (p->expiry <= entry->expiry)
+      break;
+
+    heap_set (shard, index, p);
+    index = parent;
+  }
+  heap_set (shard, index, entry);
+}
+
+static void
+heap_sift_down (SessionShard * shard, gint index)
+{
+  SessionEntry *entry = HEAP_ENTRY (shard, index);
+  gint len = shard->expiry->len;
+
+  while (TRUE) {
+    gint child = 2 * index + 1;
+    SessionEntry *c;
+
+    if (child >= len)
+      break;
+
+    if (child + 1 < len &&
+        HEAP_ENTRY (shard, child + 1)->expiry < HEAP_ENTRY (shard, child)->expiry)
+      child++;
+
+    c = HEAP_ENTRY (shard, child);
+    if (entry->expiry <= c->expiry)
+      break;
+
+    heap_set (shard, index, c);
+    index = child;
+  }
+  heap_set (shard, index, entry);
+}
+
+static void
+heap_remove (SessionShard * shard, SessionEntry * entry)
+{
+  gint index = entry->index;
+  SessionEntry *last;
+
+  if (index < 0)
+    return;
+
+  entry->index = -1;
+  last = g_ptr_array_remove_index_fast (shard->expiry, index);
+  if (last == entry)
+    return;
+
+  /* the last entry was moved to index, restore the heap property */
+  heap_set (shard, index, last);
+  if (index > 0 && HEAP_ENTRY (shard, (index - 1) / 2)->expiry > last->expiry)
+    heap_sift_up (shard, index);
+  else
+    heap_sift_down (shard, index);
+}
+
+/* returns the monotonic time at which @sess expires, or -1 when it never
+ * expires */
+static gint64
+session_get_expiry (GstRTSPSession * sess, gint64 now)
+{
+  gint timeout;
+
+  timeout = gst_rtsp_session_next_timeout_usec (sess, now);
+  if (timeout < 0)
+    return -1;
+
+  return now + (gint64) timeout * 1000;
+}
+
+/* recalculate the expiry time of @entry and update its position in the heap.
+ * must be called with the lock of @shard */
+static void
+schedule_entry (SessionShard * shard, SessionEntry * entry,
+    gint64 now)
+{
+  gint64 expiry, old;
+
+  expiry = session_get_expiry (entry->session, now);
+  if (expiry < 0) {
+    heap_remove (shard, entry);
+    return;
+  }
+
+  old = entry->expiry;
+  entry->expiry = expiry;
+
+  if (entry->index < 0) {
+    g_ptr_array_add (shard->expiry, entry);
+    entry->index = shard->expiry->len - 1;
+    heap_sift_up (shard, entry->index);
+  } else if (expiry < old) {
+    heap_sift_up (shard, entry->index);
+  } else {
+    heap_sift_down (shard, entry->index);
+  }
+}
+
+/* reschedule the sessions that were touched after they were put in the heap
+ * until the top of the heap is a session that really expired at @now or
+ * expires in the future. Returns the first expired entry or %NULL.
+ * must be called with the lock of @shard */
+static SessionEntry *
+refresh_expired (SessionShard * shard, gint64 now)
+{
+  while (shard->expiry->len > 0) {
+    SessionEntry *top = HEAP_ENTRY (shard, 0);
+
+    if (top->expiry > now)
+      break;
+
+    schedule_entry (shard, top, now);
+    if (top->index >= 0 && top->expiry <= now)
+      return top;
+  }
+  return NULL;
+}
+
+/* remove @entry from the pool, must be called with the lock of @shard. When
+ * @iter is not %NULL, it points to @entry. Returns the ref that the pool had
+ * on the session */
+static GstRTSPSession *
+steal_entry (GstRTSPSessionPoolPrivate * priv, SessionShard * shard,
+    SessionEntry * entry, GHashTableIter * iter)
+{
+  GstRTSPSession *sess = entry->session;
+
+  heap_remove (shard, entry);
+  if (iter)
+    g_hash_table_iter_steal (iter);
+  else
+    g_hash_table_steal (shard->sessions, gst_rtsp_session_get_sessionid (sess));
+  gst_rtsp_session_set_pool (sess, NULL);
+  g_slice_free (SessionEntry, entry);
+  shard->cookie++;
+  g_atomic_int_add (&priv->n_sessions, -1);
+
+  return sess;
+}
+
+/* called by the session when its timeout changed */
+void
+gst_rtsp_session_pool_update_expiry (GstRTSPSessionPool * pool,
+    GstRTSPSession * sess)
+{
+  const gchar *sessionid = gst_rtsp_session_get_sessionid (sess);
+  SessionShard *shard = get_shard (pool->priv, sessionid);
+  SessionEntry *entry;
+
+  g_mutex_lock (&shard->lock);
+  entry = g_hash_table_lookup (shard->sessions, sessionid);
+  if (entry && entry->session == sess)
+    schedule_entry (shard, entry, g_get_monotonic_time ());
+  g_mutex_unlock (&shard->lock);
+}
+
 static GstRTSPFilterResult
 remove_sessions_func (GstRTSPSessionPool * pool, GstRTSPSession * session,
     gpointer user_data)
@@ -149,10 +374,16 @@ gst_rtsp_session_pool_finalize (GObject * object)
 {
   GstRTSPSessionPool *pool = GST_RTSP_SESSION_POOL (object);
   GstRTSPSessionPoolPrivate *priv = pool->priv;
+  guint i;
 
   gst_rtsp_session_pool_filter (pool, remove_sessions_func, NULL);
-  g_hash_table_unref (priv->sessions);
-  g_mutex_clear (&priv->lock);
+  for (i = 0; i < N_SHARDS; i++) {
+    SessionShard *shard = &priv->shards[i];
+
+    g_hash_table_unref (shard->sessions);
+    g_ptr_array_free (shard->expiry, TRUE);
+    g_mutex_clear (&shard->lock);
+  }
 
   G_OBJECT_CLASS (gst_rtsp_session_pool_parent_class)->finalize (object);
 }
@@ -224,9 +455,7 @@ gst_rtsp_session_pool_set_max_sessions (GstRTSPSessionPool * pool, guint max)
 
   priv = pool->priv;
 
-  g_mutex_lock (&priv->lock);
-  priv->max_sessions = max;
-  g_mutex_unlock (&priv->lock);
+  g_atomic_int_set (&priv->max_sessions, max);
 }
 
 /**
@@ -248,9 +477,7 @@ gst_rtsp_session_pool_get_max_sessions (GstRTSPSessionPool * pool)
 
   priv = pool->priv;
 
-  g_mutex_lock (&priv->lock);
-  result = priv->max_sessions;
-  g_mutex_unlock (&priv->lock);
+  result = g_atomic_int_get (&priv->max_sessions);
 
   return result;
 }
@@ -273,9 +500,7 @@ gst_rtsp_session_pool_get_n_sessions (GstRTSPSessionPool * pool)
 
   priv = pool->priv;
 
-  g_mutex_lock (&priv->lock);
-  result = g_hash_table_size (priv->sessions);
-  g_mutex_unlock (&priv->lock);
+  result = g_atomic_int_get (&priv->n_sessions);
 
   return result;
 }
@@ -294,21 +519,23 @@ gst_rtsp_session_pool_get_n_sessions (GstRTSPSessionPool * pool)
 GstRTSPSession *
 gst_rtsp_session_pool_find (GstRTSPSessionPool * pool, const gchar * sessionid)
 {
-  GstRTSPSessionPoolPrivate *priv;
-  GstRTSPSession *result;
+  SessionShard *shard;
+  GstRTSPSession *result = NULL;
+  SessionEntry *entry;
 
   g_return_val_if_fail (GST_IS_RTSP_SESSION_POOL (pool), NULL);
   g_return_val_if_fail (sessionid != NULL, NULL);
 
-  priv = pool->priv;
+  shard = get_shard (pool->priv, sessionid);
+
+  g_mutex_lock (&shard->lock);
+  entry = g_hash_table_lookup (shard->sessions, sessionid);
+  if (entry)
+    result = g_object_ref (entry->session);
+  g_mutex_unlock (&shard->lock);
 
-  g_mutex_lock (&priv->lock);
-  result = g_hash_table_lookup (priv->sessions, sessionid);
-  if (result) {
-    g_object_ref (result);
+  if (result)
     gst_rtsp_session_touch (result);
-  }
-  g_mutex_unlock (&priv->lock);
 
   return result;
 }
@@ -348,8 +575,10 @@ gst_rtsp_session_pool_create (GstRTSPSessionPool * pool)
   GstRTSPSessionPoolPrivate *priv;
   GstRTSPSession *result = NULL;
   GstRTSPSessionPoolClass *klass;
+  SessionShard *shard;
   gchar *id = NULL;
-  guint retry;
+  guint retry, max_sessions;
+  gint n_sessions;
 
   g_return_val_if_fail (GST_IS_RTSP_SESSION_POOL (pool), NULL);
 
@@ -357,6 +586,15 @@ gst_rtsp_session_pool_create (GstRTSPSessionPool * pool)
 
   klass = GST_RTSP_SESSION_POOL_GET_CLASS (pool);
 
+  /* check session limit and reserve a place for the new session */
+  do {
+    n_sessions = g_atomic_int_get (&priv->n_sessions);
+    max_sessions = g_atomic_int_get (&priv->max_sessions);
+    if (max_sessions > 0 && (guint) n_sessions >= max_sessions)
+      goto too_many_sessions;
+  } while (!g_atomic_int_compare_and_exchange (&priv->n_sessions, n_sessions,
+          n_sessions + 1));
+
   retry = 0;
   do {
     /* start by creating a new random session id, we assume that this is random
@@ -369,33 +607,34 @@ gst_rtsp_session_pool_create (GstRTSPSessionPool * pool)
     if (id == NULL)
       goto no_session;
 
-    g_mutex_lock (&priv->lock);
-    /* check session limit */
-    if (priv->max_sessions > 0) {
-      if (g_hash_table_size (priv->sessions) >= priv->max_sessions)
-        goto too_many_sessions;
-    }
+    shard = get_shard (priv, id);
+
+    g_mutex_lock (&shard->lock);
     /* check if the sessionid existed */
-    result = g_hash_table_lookup (priv->sessions, id);
-    if (result) {
+    if (g_hash_table_contains (shard->sessions, id)) {
       /* found, retry with a different session id */
-      result = NULL;
       retry++;
       if (retry > 100)
         goto collision;
     } else {
+      SessionEntry *entry;
+
       /* not found, create session and insert it in the pool */
       if (klass->create_session)
         result = klass->create_session (pool, id);
       if (result == NULL)
-        goto too_many_sessions;
+        goto no_create;
       /* take additional ref for the pool */
-      g_object_ref (result);
-      g_hash_table_insert (priv->sessions,
-          (gchar *) gst_rtsp_session_get_sessionid (result), result);
-      priv->sessions_cookie++;
+      entry = g_slice_new (SessionEntry);
+      entry->session = g_object_ref (result);
+      entry->index = -1;
+      g_hash_table_insert (shard->sessions,
+          (gchar *) gst_rtsp_session_get_sessionid (result), entry);
+      schedule_entry (shard, entry, g_get_monotonic_time ());
+      gst_rtsp_session_set_pool (result, pool);
+      shard->cookie++;
     }
-    g_mutex_unlock (&priv->lock);
+    g_mutex_unlock (&shard->lock);
 
     g_free (id);
   } while (result == NULL);
@@ -403,27 +642,36 @@ gst_rtsp_session_pool_create (GstRTSPSessionPool * pool)
   return result;
 
   /* ERRORS */
+too_many_sessions:
+  {
+    GST_WARNING ("session pool reached max sessions of %d", max_sessions);
+    return NULL;
+  }
 no_function:
   {
     GST_WARNING ("no create_session_id vmethod in GstRTSPSessionPool %p", pool);
+    g_atomic_int_add (&priv->n_sessions, -1);
     return NULL;
   }
 no_session:
   {
     GST_WARNING ("can't create session id with GstRTSPSessionPool %p", pool);
+    g_atomic_int_add (&priv->n_sessions, -1);
     return NULL;
   }
 collision:
   {
     GST_WARNING ("can't find unique sessionid for GstRTSPSessionPool %p", pool);
-    g_mutex_unlock (&priv->lock);
+    g_mutex_unlock (&shard->lock);
+    g_atomic_int_add (&priv->n_sessions, -1);
     g_free (id);
     return NULL;
   }
-too_many_sessions:
+no_create:
   {
-    GST_WARNING ("session pool reached max sessions of %d", priv->max_sessions);
-    g_mutex_unlock (&priv->lock);
+    GST_WARNING ("can't create session with GstRTSPSessionPool %p", pool);
+    g_mutex_unlock (&shard->lock);
+    g_atomic_int_add (&priv->n_sessions, -1);
     g_free (id);
     return NULL;
   }
@@ -442,21 +690,25 @@ gboolean
 gst_rtsp_session_pool_remove (GstRTSPSessionPool * pool, GstRTSPSession * sess)
 {
   GstRTSPSessionPoolPrivate *priv;
+  SessionShard *shard;
+  SessionEntry *entry;
+  const gchar *sessionid;
   gboolean found;
 
   g_return_val_if_fail (GST_IS_RTSP_SESSION_POOL (pool), FALSE);
   g_return_val_if_fail (GST_IS_RTSP_SESSION (sess), FALSE);
 
   priv = pool->priv;
+  sessionid = gst_rtsp_session_get_sessionid (sess);
+  shard = get_shard (priv, sessionid);
 
-  g_mutex_lock (&priv->lock);
+  g_mutex_lock (&shard->lock);
   g_object_ref (sess);
-  found =
-      g_hash_table_remove (priv->sessions,
-      gst_rtsp_session_get_sessionid (sess));
+  entry = g_hash_table_lookup (shard->sessions, sessionid);
+  found = (entry != NULL);
   if (found)
-    priv->sessions_cookie++;
-  g_mutex_unlock (&priv->lock);
+    g_object_unref (steal_entry (priv, shard, entry, NULL));
+  g_mutex_unlock (&shard->lock);
 
   if (found)
     g_signal_emit (pool, gst_rtsp_session_pool_signals[SIGNAL_SESSION_REMOVED],
@@ -467,28 +719,6 @@ gst_rtsp_session_pool_remove (GstRTSPSessionPool * pool, GstRTSPSession * sess)
   return found;
 }
 
-typedef struct
-{
-  gint64 now_monotonic_time;
-  GstRTSPSessionPool *pool;
-  GList *removed;
-} CleanupData;
-
-static gboolean
-cleanup_func (gchar * sessionid, GstRTSPSession * sess, CleanupData * data)
-{
-  gboolean expired;
-
-  expired = gst_rtsp_session_is_expired_usec (sess, data->now_monotonic_time);
-
-  if (expired) {
-    GST_DEBUG ("session expired");
-    data->removed = g_list_prepend (data->removed, g_object_ref (sess));
-  }
-
-  return expired;
-}
-
 /**
  * gst_rtsp_session_pool_cleanup:
  * @pool: a #GstRTSPSessionPool
@@ -502,28 +732,32 @@ guint
 gst_rtsp_session_pool_cleanup (GstRTSPSessionPool * pool)
 {
   GstRTSPSessionPoolPrivate *priv;
-  guint result;
-  CleanupData data;
-  GList *walk;
+  guint i, result = 0;
+  gint64 now_monotonic_time;
+  SessionEntry *entry;
+  GList *removed = NULL, *walk;
 
   g_return_val_if_fail (GST_IS_RTSP_SESSION_POOL (pool), 0);
 
   priv = pool->priv;
 
-  data.now_monotonic_time = g_get_monotonic_time ();
+  now_monotonic_time = g_get_monotonic_time ();
 
-  data.pool = pool;
-  data.removed = NULL;
+  for (i = 0; i < N_SHARDS; i++) {
+    SessionShard *shard = &priv->shards[i];
 
-  g_mutex_lock (&priv->lock);
-  result =
-      g_hash_table_foreach_remove (priv->sessions, (GHRFunc) cleanup_func,
-      &data);
-  if (result > 0)
-    priv->sessions_cookie++;
-  g_mutex_unlock (&priv->lock);
+    g_mutex_lock (&shard->lock);
+    /* only the sessions at the top of the heap can be expired */
+    while ((entry = refresh_expired (shard, now_monotonic_time))) {
+      GST_DEBUG ("session expired");
+      removed = g_list_prepend (removed,
+          steal_entry (priv, shard, entry, NULL));
+      result++;
+    }
+    g_mutex_unlock (&shard->lock);
+  }
 
-  for (walk = data.removed; walk; walk = walk->next) {
+  for (walk = removed; walk; walk = walk->next) {
     GstRTSPSession *sess = walk->data;
 
     g_signal_emit (pool,
@@ -531,7 +765,7 @@ gst_rtsp_session_pool_cleanup (GstRTSPSessionPool * pool)
 
     g_object_unref (sess);
   }
-  g_list_free (data.removed);
+  g_list_free (removed);
 
   return result;
 }
@@ -570,7 +804,7 @@ gst_rtsp_session_pool_filter (GstRTSPSessionPool * pool,
   gpointer key, value;
   GList *result;
   GHashTable *visited;
-  guint cookie;
+  guint i, cookie;
 
   g_return_val_if_fail (GST_IS_RTSP_SESSION_POOL (pool), NULL);
 
@@ -580,70 +814,78 @@ gst_rtsp_session_pool_filter (GstRTSPSessionPool * pool,
   if (func)
     visited = g_hash_table_new_full (NULL, NULL, g_object_unref, NULL);
 
-  g_mutex_lock (&priv->lock);
-restart:
-  g_hash_table_iter_init (&iter, priv->sessions);
-  cookie = priv->sessions_cookie;
-  while (g_hash_table_iter_next (&iter, &key, &value)) {
-    GstRTSPSession *session = value;
-    GstRTSPFilterResult res;
-    gboolean changed;
-
-    if (func) {
-      /* only visit each session once */
-      if (g_hash_table_contains (visited, session))
-        continue;
-
-      g_hash_table_add (visited, g_object_ref (session));
-      g_mutex_unlock (&priv->lock);
-
-      res = func (pool, session, user_data);
-
-      g_mutex_lock (&priv->lock);
-    } else
-      res = GST_RTSP_FILTER_REF;
-
-    changed = (cookie != priv->sessions_cookie);
-
-    switch (res) {
-      case GST_RTSP_FILTER_REMOVE:
-      {
-        gboolean removed = TRUE;
-
-        if (changed)
-          /* something changed, check if we still have the session */
-          removed = g_hash_table_remove (priv->sessions, key);
-        else
-          g_hash_table_iter_remove (&iter);
-
-        if (removed) {
-          /* if we managed to remove the session, update the cookie and
-           * signal */
-          cookie = ++priv->sessions_cookie;
-          g_mutex_unlock (&priv->lock);
-
-          g_signal_emit (pool,
-              gst_rtsp_session_pool_signals[SIGNAL_SESSION_REMOVED], 0,
-              session);
-
-          g_mutex_lock (&priv->lock);
-          /* cookie could have changed again, make sure we restart */
-          changed |= (cookie != priv->sessions_cookie);
+  for (i = 0; i < N_SHARDS; i++) {
+    SessionShard *shard = &priv->shards[i];
+
+    g_mutex_lock (&shard->lock);
+  restart:
+    g_hash_table_iter_init (&iter, shard->sessions);
+    cookie = shard->cookie;
+    while (g_hash_table_iter_next (&iter, &key, &value)) {
+      GstRTSPSession *session = ((SessionEntry *) value)->session;
+      GstRTSPFilterResult res;
+      gboolean changed;
+
+      if (func) {
+        /* only visit each session once */
+        if (g_hash_table_contains (visited, session))
+          continue;
+
+        g_hash_table_add (visited, g_object_ref (session));
+        g_mutex_unlock (&shard->lock);
+
+        res = func (pool, session, user_data);
+
+        g_mutex_lock (&shard->lock);
+      } else
+        res = GST_RTSP_FILTER_REF;
+
+      changed = (cookie != shard->cookie);
+
+      switch (res) {
+        case GST_RTSP_FILTER_REMOVE:
+        {
+          SessionEntry *entry = value;
+          gboolean removed = TRUE;
+
+          if (changed) {
+            /* something changed, check if we still have the session */
+            entry = g_hash_table_lookup (shard->sessions, key);
+            removed = (entry != NULL && entry->session == session);
+          }
+
+          if (removed) {
+            /* the visited table keeps the session alive while signaling */
+            g_object_unref (steal_entry (priv, shard, entry,
+                    changed ? NULL : &iter));
+            /* if we managed to remove the session, update the cookie and
+             * signal */
+            cookie = shard->cookie;
+            g_mutex_unlock (&shard->lock);
+
+            g_signal_emit (pool,
+                gst_rtsp_session_pool_signals[SIGNAL_SESSION_REMOVED], 0,
+                session);
+
+            g_mutex_lock (&shard->lock);
+            /* cookie could have changed again, make sure we restart */
+            changed |= (cookie != shard->cookie);
+          }
+          break;
         }
-        break;
+        case GST_RTSP_FILTER_REF:
+          /* keep ref */
+          result = g_list_prepend (result, g_object_ref (session));
+          break;
+        case GST_RTSP_FILTER_KEEP:
+        default:
+          break;
       }
-      case GST_RTSP_FILTER_REF:
-        /* keep ref */
-        result = g_list_prepend (result, g_object_ref (session));
-        break;
-      case GST_RTSP_FILTER_KEEP:
-      default:
-        break;
+      if (changed)
+        goto restart;
     }
-    if (changed)
-      goto restart;
+    g_mutex_unlock (&shard->lock);
   }
-  g_mutex_unlock (&priv->lock);
 
   if (func)
     g_hash_table_unref (visited);
@@ -658,35 +900,39 @@ typedef struct
   gint timeout;
 } GstPoolSource;
 
-static void
-collect_timeout (gchar * sessionid, GstRTSPSession * sess, GstPoolSource * psrc)
-{
-  gint timeout;
-  gint64 now_monotonic_time;
-
-  now_monotonic_time = g_get_monotonic_time ();
-
-  timeout = gst_rtsp_session_next_timeout_usec (sess, now_monotonic_time);
-
-  GST_INFO ("%p: next timeout: %d", sess, timeout);
-  if (psrc->timeout == -1 || timeout < psrc->timeout)
-    psrc->timeout = timeout;
-}
-
 static gboolean
 gst_pool_source_prepare (GSource * source, gint * timeout)
 {
   GstRTSPSessionPoolPrivate *priv;
   GstPoolSource *psrc;
   gboolean result;
+  gint64 now_monotonic_time, next = -1;
+  guint i;
 
   psrc = (GstPoolSource *) source;
   psrc->timeout = -1;
   priv = psrc->pool->priv;
 
-  g_mutex_lock (&priv->lock);
-  g_hash_table_foreach (priv->sessions, (GHFunc) collect_timeout, psrc);
-  g_mutex_unlock (&priv->lock);
+  now_monotonic_time = g_get_monotonic_time ();
+
+  for (i = 0; i < N_SHARDS && next != 0; i++) {
+    SessionShard *shard = &priv->shards[i];
+
+    g_mutex_lock (&shard->lock);
+    if (refresh_expired (shard, now_monotonic_time)) {
+      next = 0;
+    } else if (shard->expiry->len > 0) {
+      gint64 expiry = HEAP_ENTRY (shard, 0)->expiry - now_monotonic_time;
+
+      if (next == -1 || expiry < next)
+        next = expiry;
+    }
+    g_mutex_unlock (&shard->lock);
+  }
+
+  /* round up so that we don't wake up before the session expired */
+  if (next >= 0)
+    psrc->timeout = MIN ((next + 999) / 1000, G_MAXINT);
 
   if (timeout)
     *timeout = psrc->timeout;
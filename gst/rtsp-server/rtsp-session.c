@@ -49,26 +49,37 @@
 #include <string.h>
 
 #include "rtsp-session.h"
+#include "rtsp-server-internal.h"
 
 struct _GstRTSPSessionPrivate
 {
   GMutex lock;                  /* protects everything but sessionid and create_time */
   gchar *sessionid;
 
-  guint timeout;
+  guint timeout;                /* atomic */
   gboolean timeout_always_visible;
-  GMutex last_access_lock;
+  GMutex last_access_lock;      /* only used without lock-free 64 bits atomics */
   gint64 last_access_monotonic_time;
   gint64 last_access_real_time;
   gint expire_count;
 
   GList *medias;
   guint medias_cookie;
-  guint extra_time_timeout;
+  guint extra_time_timeout;     /* atomic */
+
+  /* the session pool that tracks the expiry of this session */
+  GWeakRef pool;
 };
 
 #undef DEBUG
 
+/* the last access times are updated for every request and keepalive and are
+ * read by the session pool, use lock-free atomics when the platform has them
+ * for 64 bits values */
+#if defined (__GCC_HAVE_SYNC_COMPARE_AND_SWAP_8) && defined (__ATOMIC_RELAXED)
+#define LAST_ACCESS_LOCK_FREE 1
+#endif
+
 #define DEFAULT_TIMEOUT	       60
 #define NO_TIMEOUT              -1
 #define DEFAULT_ALWAYS_VISIBLE  FALSE
@@ -158,6 +169,7 @@ gst_rtsp_session_init (GstRTSPSession * session)
 
   g_mutex_init (&priv->lock);
   g_mutex_init (&priv->last_access_lock);
+  g_weak_ref_init (&priv->pool, NULL);
   priv->timeout = DEFAULT_TIMEOUT;
   priv->extra_time_timeout = DEFAULT_EXTRA_TIMEOUT;
 
@@ -180,6 +192,7 @@ gst_rtsp_session_finalize (GObject * obj)
 
   /* free session id */
   g_free (priv->sessionid);
+  g_weak_ref_clear (&priv->pool);
   g_mutex_clear (&priv->last_access_lock);
   g_mutex_clear (&priv->lock);
 
@@ -204,13 +217,32 @@ gst_rtsp_session_get_property (GObject * object, guint propid,
       g_value_set_boolean (value, priv->timeout_always_visible);
       break;
     case PROP_EXTRA_TIME_TIMEOUT:
-      g_value_set_uint (value, priv->extra_time_timeout);
+      g_value_set_uint (value, g_atomic_int_get (&priv->extra_time_timeout));
       break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, propid, pspec);
   }
 }
 
+/* let the pool know that the time when we expire changed */
+static void
+update_pool_expiry (GstRTSPSession * session)
+{
+  GstRTSPSessionPool *pool;
+
+  pool = g_weak_ref_get (&session->priv->pool);
+  if (pool) {
+    gst_rtsp_session_pool_update_expiry (pool, session);
+    g_object_unref (pool);
+  }
+}
+
+void
+gst_rtsp_session_set_pool (GstRTSPSession * session, GstRTSPSessionPool * pool)
+{
+  g_weak_ref_set (&session->priv->pool, pool);
+}
+
 static void
 gst_rtsp_session_set_property (GObject * object, guint propid,
     const GValue * value, GParamSpec * pspec)
@@ -232,9 +264,8 @@ gst_rtsp_session_set_property (GObject * object, guint propid,
       g_mutex_unlock (&priv->lock);
       break;
     case PROP_EXTRA_TIME_TIMEOUT:
-      g_mutex_lock (&priv->lock);
-      priv->extra_time_timeout = g_value_get_uint (value);
-      g_mutex_unlock (&priv->lock);
+      g_atomic_int_set (&priv->extra_time_timeout, g_value_get_uint (value));
+      update_pool_expiry (session);
       break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, propid, pspec);
@@ -537,15 +568,17 @@ gst_rtsp_session_get_header (GstRTSPSession * session)
 {
   GstRTSPSessionPrivate *priv;
   gchar *result;
+  guint timeout;
 
   g_return_val_if_fail (GST_IS_RTSP_SESSION (session), NULL);
 
   priv = session->priv;
 
+  timeout = g_atomic_int_get (&priv->timeout);
 
   g_mutex_lock (&priv->lock);
-  if (priv->timeout_always_visible || priv->timeout != 60)
-    result = g_strdup_printf ("%s;timeout=%d", priv->sessionid, priv->timeout);
+  if (priv->timeout_always_visible || timeout != 60)
+    result = g_strdup_printf ("%s;timeout=%d", priv->sessionid, timeout);
   else
     result = g_strdup (priv->sessionid);
   g_mutex_unlock (&priv->lock);
@@ -570,9 +603,9 @@ gst_rtsp_session_set_timeout (GstRTSPSession * session, guint timeout)
 
   priv = session->priv;
 
-  g_mutex_lock (&priv->lock);
-  priv->timeout = timeout;
-  g_mutex_unlock (&priv->lock);
+  g_atomic_int_set (&priv->timeout, timeout);
+
+  update_pool_expiry (session);
 }
 
 /**
@@ -593,9 +626,41 @@ gst_rtsp_session_get_timeout (GstRTSPSession * session)
 
   priv = session->priv;
 
-  g_mutex_lock (&priv->lock);
-  res = priv->timeout;
-  g_mutex_unlock (&priv->lock);
+  res = g_atomic_int_get (&priv->timeout);
+
+  return res;
+}
+
+static void
+set_last_access (GstRTSPSessionPrivate * priv)
+{
+  gint64 monotonic_time = g_get_monotonic_time ();
+  gint64 real_time = g_get_real_time ();
+
+#ifdef LAST_ACCESS_LOCK_FREE
+  __atomic_store_n (&priv->last_access_monotonic_time, monotonic_time,
+      __ATOMIC_RELAXED);
+  __atomic_store_n (&priv->last_access_real_time, real_time, __ATOMIC_RELAXED);
+#else
+  g_mutex_lock (&priv->last_access_lock);
+  priv->last_access_monotonic_time = monotonic_time;
+  priv->last_access_real_time = real_time;
+  g_mutex_unlock (&priv->last_access_lock);
+#endif
+}
+
+static gint64
+get_last_access (GstRTSPSessionPrivate * priv, gint64 * last_access)
+{
+  gint64 res;
+
+#ifdef LAST_ACCESS_LOCK_FREE
+  res = __atomic_load_n (last_access, __ATOMIC_RELAXED);
+#else
+  g_mutex_lock (&priv->last_access_lock);
+  res = *last_access;
+  g_mutex_unlock (&priv->last_access_lock);
+#endif
 
   return res;
 }
@@ -605,20 +670,16 @@ gst_rtsp_session_get_timeout (GstRTSPSession * session)
  * @session: a #GstRTSPSession
  *
  * Update the last_access time of the session to the current time.
+ *
+ * This function does not take any lock on platforms with lock-free 64 bits
+ * atomic operations.
  */
 void
 gst_rtsp_session_touch (GstRTSPSession * session)
 {
-  GstRTSPSessionPrivate *priv;
-
   g_return_if_fail (GST_IS_RTSP_SESSION (session));
 
-  priv = session->priv;
-
-  g_mutex_lock (&priv->last_access_lock);
-  priv->last_access_monotonic_time = g_get_monotonic_time ();
-  priv->last_access_real_time = g_get_real_time ();
-  g_mutex_unlock (&priv->last_access_lock);
+  set_last_access (session->priv);
 }
 
 /**
@@ -662,35 +723,30 @@ gst_rtsp_session_next_timeout_usec (GstRTSPSession * session, gint64 now)
 {
   GstRTSPSessionPrivate *priv;
   gint res;
+  guint timeout;
   GstClockTime last_access, now_ns;
 
   g_return_val_if_fail (GST_IS_RTSP_SESSION (session), -1);
 
   priv = session->priv;
 
-  g_mutex_lock (&priv->lock);
   /* If timeout is set to 0, we never timeout */
-  if (priv->timeout == 0) {
-    g_mutex_unlock (&priv->lock);
+  timeout = g_atomic_int_get (&priv->timeout);
+  if (timeout == 0)
     return NO_TIMEOUT;
-  }
-  g_mutex_unlock (&priv->lock);
 
-  g_mutex_lock (&priv->last_access_lock);
   if (g_atomic_int_get (&priv->expire_count) != 0) {
     /* touch session when the expire count is not 0 */
-    priv->last_access_monotonic_time = g_get_monotonic_time ();
-    priv->last_access_real_time = g_get_real_time ();
+    set_last_access (priv);
   }
 
-  last_access = GST_USECOND * (priv->last_access_monotonic_time);
+  last_access = GST_USECOND *
+      get_last_access (priv, &priv->last_access_monotonic_time);
 
   /* add timeout allow for priv->extra_time_timeout
    * seconds of extra time */
-  last_access += priv->timeout * GST_SECOND +
-      (priv->extra_time_timeout * GST_SECOND);
-
-  g_mutex_unlock (&priv->last_access_lock);
+  last_access += timeout * GST_SECOND +
+      (g_atomic_int_get (&priv->extra_time_timeout) * GST_SECOND);
 
   now_ns = GST_USECOND * now;
 
@@ -729,21 +785,18 @@ gst_rtsp_session_next_timeout (GstRTSPSession * session, GTimeVal * now)
 
   priv = session->priv;
 
-  g_mutex_lock (&priv->last_access_lock);
   if (g_atomic_int_get (&priv->expire_count) != 0) {
     /* touch session when the expire count is not 0 */
-    priv->last_access_monotonic_time = g_get_monotonic_time ();
-    priv->last_access_real_time = g_get_real_time ();
+    set_last_access (priv);
   }
 
-  last_access = GST_USECOND * (priv->last_access_real_time);
+  last_access = GST_USECOND *
+      get_last_access (priv, &priv->last_access_real_time);
 
   /* add timeout allow for priv->extra_time_timeout
    * seconds of extra time */
-  last_access += priv->timeout * GST_SECOND +
-      (priv->extra_time_timeout * GST_SECOND);
-
-  g_mutex_unlock (&priv->last_access_lock);
+  last_access += g_atomic_int_get (&priv->timeout) * GST_SECOND +
+      (g_atomic_int_get (&priv->extra_time_timeout) * GST_SECOND);
 
   now_ns = GST_TIMEVAL_TO_TIME (*now);
 
@@ -0,0 +1,1228 @@
+/* GStreamer
+ * Copyright (C) 2021 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+/**
+ * SECTION:rtsp-source-hub
+ * @short_description: A capture pipeline shared by several factories
+ * @see_also: #GstRTSPMediaFactory, #GstRTSPMedia
+ *
+ * A #GstRTSPSourceHub runs one capture pipeline, given with
+ * gst_rtsp_source_hub_set_launch(), for the media of any number of
+ * factories. This way a camera can be served as several mount points, like
+ * the full resolution, a scaled down stream and the audio only, while the
+ * device is opened once.
+ *
+ * The outputs of the hub are the elements of its launch line with a source
+ * pad that is not linked, the name of the output is the name of the element.
+ * The launch lines of the factories read an output with the rtsphubsrc
+ * element, which is available once a hub was created:
+ *
+ * |[
+ *   hub = gst_rtsp_source_hub_new ("camera");
+ *   gst_rtsp_source_hub_set_launch (hub, "v4l2src ! videoconvert name=video "
+ *       "alsasrc ! audioconvert name=audio");
+ *
+ *   gst_rtsp_media_factory_set_launch (factory, "( rtsphubsrc hub=camera "
+ *       "output=video ! videoscale ! video/x-raw, width=640, height=360 ! "
+ *       "x264enc tune=zerolatency ! rtph264pay name=pay0 pt=96 )");
+ * ]|
+ *
+ * The hub starts its pipeline when the first rtsphubsrc starts and stops it
+ * when the last one stops. The buffers of an output are not copied, every
+ * rtsphubsrc gets a reference. Each rtsphubsrc has its own queue in which it
+ * keeps at most max-time of buffers, a consumer that can't keep up drops
+ * its oldest buffers without slowing down the hub or the other consumers.
+ * After an error of the pipeline, the outputs end until the hub restarts.
+ *
+ * Since: 1.20
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/base/gstpushsrc.h>
+
+#include "rtsp-source-hub.h"
+
+typedef struct _GstRTSPHubSrc GstRTSPHubSrc;
+
+/* an unlinked source pad of the pipeline */
+typedef struct
+{
+  GstRTSPSourceHub *hub;        /* no ref */
+  gchar *name;
+  GstPad *pad;
+
+  /* protected by the hub lock */
+  GstSegment segment;
+  GstCaps *caps;
+  GList *srcs;                  /* the rtsphubsrc that read the output */
+  gboolean eos;
+} HubOutput;
+
+struct _GstRTSPSourceHubPrivate
+{
+  gchar *name;
+
+  GMutex lock;                  /* protects everything below */
+  gchar *launch;
+  GHashTable *outputs;          /* name -> HubOutput */
+  guint n_consumers;
+
+  GMutex state_lock;            /* serializes starting and stopping */
+  GstElement *pipeline;         /* protected by state_lock */
+  GstClock *clock;
+};
+
+#define DEFAULT_NAME        NULL
+#define DEFAULT_LAUNCH      NULL
+
+enum
+{
+  PROP_0,
+  PROP_NAME,
+  PROP_LAUNCH,
+  PROP_LAST
+};
+
+GST_DEBUG_CATEGORY_STATIC (rtsp_source_hub_debug);
+#define GST_CAT_DEFAULT rtsp_source_hub_debug
+
+/* the hubs by name, so that launch lines can reference them */
+typedef struct
+{
+  GstRTSPSourceHub *hub;        /* no ref, to compare */
+  GWeakRef ref;
+} HubEntry;
+
+static GMutex hubs_lock;
+static GHashTable *hubs;        /* name -> HubEntry */
+
+static void gst_rtsp_source_hub_get_property (GObject * object,
+    guint propid, GValue * value, GParamSpec * pspec);
+static void gst_rtsp_source_hub_set_property (GObject * object,
+    guint propid, const GValue * value, GParamSpec * pspec);
+static void gst_rtsp_source_hub_constructed (GObject * obj);
+static void gst_rtsp_source_hub_finalize (GObject * obj);
+
+static gboolean hub_attach (GstRTSPSourceHub * hub, GstRTSPHubSrc * src,
+    const gchar * output);
+static void hub_detach (GstRTSPSourceHub * hub, GstRTSPHubSrc * src);
+
+G_DEFINE_TYPE_WITH_PRIVATE (GstRTSPSourceHub, gst_rtsp_source_hub,
+    G_TYPE_OBJECT);
+
+/* the consumer of an output, a live source that pushes the buffers of the
+ * output from its own queue and streaming thread */
+typedef struct
+{
+  GstClockTime time;            /* the clock time of the buffer */
+  GstBuffer *buffer;
+  GstCaps *caps;                /* new caps before the buffer or NULL */
+} HubItem;
+
+struct _GstRTSPHubSrc
+{
+  GstPushSrc parent;
+
+  /* protected by the object lock */
+  gchar *hub_name;
+  gchar *output;
+  GstClockTime max_time;
+
+  GstRTSPSourceHub *hub;        /* while started */
+  GstClock *hub_clock;
+
+  GMutex lock;                  /* protects everything below */
+  GCond cond;
+  GQueue items;                 /* of HubItem */
+  GstCaps *next_caps;           /* for the next item */
+  gboolean eos;
+  gboolean flushing;
+};
+
+typedef struct
+{
+  GstPushSrcClass parent_class;
+} GstRTSPHubSrcClass;
+
+#define DEFAULT_HUB_NAME    NULL
+#define DEFAULT_OUTPUT      NULL
+#define DEFAULT_MAX_TIME    (200 * GST_MSECOND)
+
+/* whatever the max-time, for outputs without timestamps */
+#define HUB_SRC_MAX_ITEMS   256
+
+enum
+{
+  PROP_SRC_0,
+  PROP_SRC_HUB,
+  PROP_SRC_OUTPUT,
+  PROP_SRC_MAX_TIME
+};
+
+static GstStaticPadTemplate hub_src_template = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+static GType gst_rtsp_hub_src_get_type (void);
+
+G_DEFINE_TYPE (GstRTSPHubSrc, gst_rtsp_hub_src, GST_TYPE_PUSH_SRC);
+
+static void
+hub_item_free (HubItem * item)
+{
+  gst_buffer_unref (item->buffer);
+  if (item->caps)
+    gst_caps_unref (item->caps);
+  g_slice_free (HubItem, item);
+}
+
+/* called with the src lock */
+static void
+hub_src_clear (GstRTSPHubSrc * src)
+{
+  HubItem *item;
+
+  while ((item = g_queue_pop_head (&src->items)))
+    hub_item_free (item);
+  gst_caps_replace (&src->next_caps, NULL);
+}
+
+/* called by the hub with the hub lock */
+static void
+hub_src_push (GstRTSPHubSrc * src, GstBuffer * buffer, GstClockTime time)
+{
+  HubItem *item, *head;
+  GstClockTime max_time;
+
+  GST_OBJECT_LOCK (src);
+  max_time = src->max_time;
+  GST_OBJECT_UNLOCK (src);
+
+  item = g_slice_new (HubItem);
+  item->time = time;
+  item->buffer = gst_buffer_ref (buffer);
+
+  g_mutex_lock (&src->lock);
+  item->caps = src->next_caps;
+  src->next_caps = NULL;
+  g_queue_push_tail (&src->items, item);
+
+  /* drop the oldest buffers, the caps go with the next buffer */
+  while ((head = g_queue_peek_head (&src->items)) != item) {
+    if (src->items.length <= HUB_SRC_MAX_ITEMS &&
+        (!GST_CLOCK_TIME_IS_VALID (head->time) ||
+            !GST_CLOCK_TIME_IS_VALID (time) || time - head->time <= max_time))
+      break;
+
+    g_queue_pop_head (&src->items);
+    GST_LOG_OBJECT (src, "dropping buffer of %" GST_TIME_FORMAT,
+        GST_TIME_ARGS (head->time));
+    if (head->caps) {
+      HubItem *next = g_queue_peek_head (&src->items);
+
+      if (next->caps == NULL)
+        next->caps = gst_caps_ref (head->caps);
+    }
+    hub_item_free (head);
+  }
+  g_cond_signal (&src->cond);
+  g_mutex_unlock (&src->lock);
+}
+
+/* called by the hub with the hub lock */
+static void
+hub_src_set_caps (GstRTSPHubSrc * src, GstCaps * caps)
+{
+  g_mutex_lock (&src->lock);
+  gst_caps_replace (&src->next_caps, caps);
+  g_mutex_unlock (&src->lock);
+}
+
+/* called by the hub with the hub lock */
+static void
+hub_src_set_eos (GstRTSPHubSrc * src)
+{
+  g_mutex_lock (&src->lock);
+  src->eos = TRUE;
+  g_cond_signal (&src->cond);
+  g_mutex_unlock (&src->lock);
+}
+
+static GstFlowReturn
+gst_rtsp_hub_src_create (GstPushSrc * psrc, GstBuffer ** buf)
+{
+  GstRTSPHubSrc *src = (GstRTSPHubSrc *) psrc;
+  GstElement *element = GST_ELEMENT_CAST (src);
+  GstClock *clock;
+  GstBuffer *buffer;
+  HubItem *item;
+
+  g_mutex_lock (&src->lock);
+  while (!src->flushing && !src->eos && g_queue_is_empty (&src->items))
+    g_cond_wait (&src->cond, &src->lock);
+  if (src->flushing)
+    goto flushing;
+  if ((item = g_queue_pop_head (&src->items)) == NULL)
+    goto eos;
+  g_mutex_unlock (&src->lock);
+
+  if (item->caps && !gst_base_src_set_caps (GST_BASE_SRC_CAST (src),
+          item->caps))
+    goto not_negotiated;
+
+  /* a new reference to the metadata, the memory stays shared */
+  buffer = gst_buffer_make_writable (gst_buffer_ref (item->buffer));
+  GST_BUFFER_DTS (buffer) = GST_CLOCK_TIME_NONE;
+
+  /* the buffer plays at the same clock time as in the hub */
+  clock = gst_element_get_clock (element);
+  if (clock) {
+    GstClockTime base_time = gst_element_get_base_time (element);
+    GstClockTime time = item->time;
+
+    if (clock != src->hub_clock || !GST_CLOCK_TIME_IS_VALID (time))
+      time = gst_clock_get_time (clock);
+    GST_BUFFER_PTS (buffer) = time > base_time ? time - base_time : 0;
+    gst_object_unref (clock);
+  }
+  hub_item_free (item);
+
+  *buf = buffer;
+
+  return GST_FLOW_OK;
+
+  /* ERRORS */
+flushing:
+  {
+    g_mutex_unlock (&src->lock);
+    return GST_FLOW_FLUSHING;
+  }
+eos:
+  {
+    g_mutex_unlock (&src->lock);
+    GST_DEBUG_OBJECT (src, "the output of the hub ended");
+    return GST_FLOW_EOS;
+  }
+not_negotiated:
+  {
+    hub_item_free (item);
+    return GST_FLOW_NOT_NEGOTIATED;
+  }
+}
+
+static gboolean
+gst_rtsp_hub_src_start (GstBaseSrc * bsrc)
+{
+  GstRTSPHubSrc *src = (GstRTSPHubSrc *) bsrc;
+  GstRTSPSourceHub *hub;
+  gchar *hub_name, *output;
+
+  GST_OBJECT_LOCK (src);
+  hub_name = g_strdup (src->hub_name);
+  output = g_strdup (src->output);
+  GST_OBJECT_UNLOCK (src);
+
+  if (hub_name == NULL || (hub = gst_rtsp_source_hub_find (hub_name)) == NULL)
+    goto no_hub;
+
+  g_mutex_lock (&src->lock);
+  src->eos = FALSE;
+  g_mutex_unlock (&src->lock);
+
+  if (output == NULL || !hub_attach (hub, src, output))
+    goto no_output;
+
+  src->hub = hub;
+  g_free (hub_name);
+  g_free (output);
+
+  return TRUE;
+
+  /* ERRORS */
+no_hub:
+  {
+    GST_ELEMENT_ERROR (src, RESOURCE, NOT_FOUND, (NULL),
+        ("no source hub named %s", GST_STR_NULL (hub_name)));
+    g_free (hub_name);
+    g_free (output);
+    return FALSE;
+  }
+no_output:
+  {
+    GST_ELEMENT_ERROR (src, RESOURCE, NOT_FOUND, (NULL),
+        ("source hub %s has no output %s", hub_name, GST_STR_NULL (output)));
+    g_object_unref (hub);
+    g_free (hub_name);
+    g_free (output);
+    return FALSE;
+  }
+}
+
+static gboolean
+gst_rtsp_hub_src_stop (GstBaseSrc * bsrc)
+{
+  GstRTSPHubSrc *src = (GstRTSPHubSrc *) bsrc;
+
+  if (src->hub) {
+    hub_detach (src->hub, src);
+    g_object_unref (src->hub);
+    src->hub = NULL;
+  }
+  if (src->hub_clock) {
+    gst_object_unref (src->hub_clock);
+    src->hub_clock = NULL;
+  }
+
+  g_mutex_lock (&src->lock);
+  hub_src_clear (src);
+  g_mutex_unlock (&src->lock);
+
+  return TRUE;
+}
+
+static gboolean
+gst_rtsp_hub_src_unlock (GstBaseSrc * bsrc)
+{
+  GstRTSPHubSrc *src = (GstRTSPHubSrc *) bsrc;
+
+  g_mutex_lock (&src->lock);
+  src->flushing = TRUE;
+  g_cond_signal (&src->cond);
+  g_mutex_unlock (&src->lock);
+
+  return TRUE;
+}
+
+static gboolean
+gst_rtsp_hub_src_unlock_stop (GstBaseSrc * bsrc)
+{
+  GstRTSPHubSrc *src = (GstRTSPHubSrc *) bsrc;
+
+  g_mutex_lock (&src->lock);
+  src->flushing = FALSE;
+  g_mutex_unlock (&src->lock);
+
+  return TRUE;
+}
+
+static gboolean
+gst_rtsp_hub_src_query (GstBaseSrc * bsrc, GstQuery * query)
+{
+  GstRTSPHubSrc *src = (GstRTSPHubSrc *) bsrc;
+
+  if (GST_QUERY_TYPE (query) == GST_QUERY_LATENCY) {
+    GstClockTime max_time;
+
+    /* a buffer waits at most max-time in the queue */
+    GST_OBJECT_LOCK (src);
+    max_time = src->max_time;
+    GST_OBJECT_UNLOCK (src);
+
+    gst_query_set_latency (query, TRUE, 0, max_time);
+    return TRUE;
+  }
+
+  return GST_BASE_SRC_CLASS (gst_rtsp_hub_src_parent_class)->query (bsrc,
+      query);
+}
+
+static void
+gst_rtsp_hub_src_get_property (GObject * object, guint propid,
+    GValue * value, GParamSpec * pspec)
+{
+  GstRTSPHubSrc *src = (GstRTSPHubSrc *) object;
+
+  GST_OBJECT_LOCK (src);
+  switch (propid) {
+    case PROP_SRC_HUB:
+      g_value_set_string (value, src->hub_name);
+      break;
+    case PROP_SRC_OUTPUT:
+      g_value_set_string (value, src->output);
+      break;
+    case PROP_SRC_MAX_TIME:
+      g_value_set_uint64 (value, src->max_time);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, propid, pspec);
+  }
+  GST_OBJECT_UNLOCK (src);
+}
+
+static void
+gst_rtsp_hub_src_set_property (GObject * object, guint propid,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstRTSPHubSrc *src = (GstRTSPHubSrc *) object;
+
+  GST_OBJECT_LOCK (src);
+  switch (propid) {
+    case PROP_SRC_HUB:
+      g_free (src->hub_name);
+      src->hub_name = g_value_dup_string (value);
+      break;
+    case PROP_SRC_OUTPUT:
+      g_free (src->output);
+      src->output = g_value_dup_string (value);
+      break;
+    case PROP_SRC_MAX_TIME:
+      src->max_time = g_value_get_uint64 (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, propid, pspec);
+  }
+  GST_OBJECT_UNLOCK (src);
+}
+
+static void
+gst_rtsp_hub_src_finalize (GObject * obj)
+{
+  GstRTSPHubSrc *src = (GstRTSPHubSrc *) obj;
+
+  hub_src_clear (src);
+  g_free (src->hub_name);
+  g_free (src->output);
+  g_mutex_clear (&src->lock);
+  g_cond_clear (&src->cond);
+
+  G_OBJECT_CLASS (gst_rtsp_hub_src_parent_class)->finalize (obj);
+}
+
+static void
+gst_rtsp_hub_src_class_init (GstRTSPHubSrcClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+  GstBaseSrcClass *basesrc_class = GST_BASE_SRC_CLASS (klass);
+  GstPushSrcClass *pushsrc_class = GST_PUSH_SRC_CLASS (klass);
+
+  gobject_class->get_property = gst_rtsp_hub_src_get_property;
+  gobject_class->set_property = gst_rtsp_hub_src_set_property;
+  gobject_class->finalize = gst_rtsp_hub_src_finalize;
+
+  g_object_class_install_property (gobject_class, PROP_SRC_HUB,
+      g_param_spec_string ("hub", "Hub", "The name of the source hub",
+          DEFAULT_HUB_NAME, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_SRC_OUTPUT,
+      g_param_spec_string ("output", "Output",
+          "The name of the output of the hub", DEFAULT_OUTPUT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_SRC_MAX_TIME,
+      g_param_spec_uint64 ("max-time", "Max Time",
+          "The maximum time of the buffers that wait in the queue, older "
+          "buffers are dropped", 0, G_MAXUINT64, DEFAULT_MAX_TIME,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  basesrc_class->start = gst_rtsp_hub_src_start;
+  basesrc_class->stop = gst_rtsp_hub_src_stop;
+  basesrc_class->unlock = gst_rtsp_hub_src_unlock;
+  basesrc_class->unlock_stop = gst_rtsp_hub_src_unlock_stop;
+  basesrc_class->query = gst_rtsp_hub_src_query;
+  pushsrc_class->create = gst_rtsp_hub_src_create;
+
+  gst_element_class_add_static_pad_template (element_class,
+      &hub_src_template);
+  gst_element_class_set_static_metadata (element_class,
+      "RTSP source hub source", "Source",
+      "Reads an output of a GstRTSPSourceHub", "GStreamer developers");
+}
+
+static void
+gst_rtsp_hub_src_init (GstRTSPHubSrc * src)
+{
+  src->max_time = DEFAULT_MAX_TIME;
+  g_mutex_init (&src->lock);
+  g_cond_init (&src->cond);
+  g_queue_init (&src->items);
+
+  gst_base_src_set_live (GST_BASE_SRC_CAST (src), TRUE);
+  gst_base_src_set_format (GST_BASE_SRC_CAST (src), GST_FORMAT_TIME);
+}
+
+static void
+hub_output_free (HubOutput * output)
+{
+  g_free (output->name);
+  gst_object_unref (output->pad);
+  if (output->caps)
+    gst_caps_unref (output->caps);
+  g_list_free (output->srcs);
+  g_slice_free (HubOutput, output);
+}
+
+static void
+gst_rtsp_source_hub_class_init (GstRTSPSourceHubClass * klass)
+{
+  GObjectClass *gobject_class;
+
+  gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->get_property = gst_rtsp_source_hub_get_property;
+  gobject_class->set_property = gst_rtsp_source_hub_set_property;
+  gobject_class->constructed = gst_rtsp_source_hub_constructed;
+  gobject_class->finalize = gst_rtsp_source_hub_finalize;
+
+  /**
+   * GstRTSPSourceHub:name:
+   *
+   * The name of the hub, the hub property of rtsphubsrc.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_NAME,
+      g_param_spec_string ("name", "Name", "The name of the hub",
+          DEFAULT_NAME, G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY |
+          G_PARAM_STATIC_STRINGS));
+  /**
+   * GstRTSPSourceHub:launch:
+   *
+   * The gst_parse_launch() line of the pipeline of the hub.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_LAUNCH,
+      g_param_spec_string ("launch", "Launch",
+          "A launch description of the pipeline", DEFAULT_LAUNCH,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  GST_DEBUG_CATEGORY_INIT (rtsp_source_hub_debug, "rtspsourcehub", 0,
+      "GstRTSPSourceHub");
+
+  /* so that the launch lines of the factories find it */
+  gst_element_register (NULL, "rtsphubsrc", GST_RANK_NONE,
+      gst_rtsp_hub_src_get_type ());
+}
+
+static void
+gst_rtsp_source_hub_init (GstRTSPSourceHub * hub)
+{
+  GstRTSPSourceHubPrivate *priv =
+      gst_rtsp_source_hub_get_instance_private (hub);
+
+  hub->priv = priv;
+
+  g_mutex_init (&priv->lock);
+  g_mutex_init (&priv->state_lock);
+  priv->outputs = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+      (GDestroyNotify) hub_output_free);
+}
+
+static void
+hub_entry_free (HubEntry * entry)
+{
+  g_weak_ref_clear (&entry->ref);
+  g_slice_free (HubEntry, entry);
+}
+
+static void
+gst_rtsp_source_hub_constructed (GObject * obj)
+{
+  GstRTSPSourceHub *hub = GST_RTSP_SOURCE_HUB (obj);
+  HubEntry *entry;
+
+  G_OBJECT_CLASS (gst_rtsp_source_hub_parent_class)->constructed (obj);
+
+  if (hub->priv->name == NULL)
+    return;
+
+  entry = g_slice_new0 (HubEntry);
+  entry->hub = hub;
+  g_weak_ref_init (&entry->ref, hub);
+
+  /* the last hub with a name wins */
+  g_mutex_lock (&hubs_lock);
+  if (hubs == NULL)
+    hubs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+        (GDestroyNotify) hub_entry_free);
+  g_hash_table_insert (hubs, g_strdup (hub->priv->name), entry);
+  g_mutex_unlock (&hubs_lock);
+}
+
+static void
+gst_rtsp_source_hub_finalize (GObject * obj)
+{
+  GstRTSPSourceHub *hub = GST_RTSP_SOURCE_HUB (obj);
+  GstRTSPSourceHubPrivate *priv = hub->priv;
+
+  GST_DEBUG_OBJECT (hub, "finalize");
+
+  if (priv->name) {
+    HubEntry *entry;
+
+    g_mutex_lock (&hubs_lock);
+    entry = g_hash_table_lookup (hubs, priv->name);
+    if (entry && entry->hub == hub)
+      g_hash_table_remove (hubs, priv->name);
+    g_mutex_unlock (&hubs_lock);
+  }
+
+  /* the consumers hold a ref, the pipeline was stopped */
+  g_hash_table_unref (priv->outputs);
+  g_free (priv->name);
+  g_free (priv->launch);
+  g_mutex_clear (&priv->lock);
+  g_mutex_clear (&priv->state_lock);
+
+  G_OBJECT_CLASS (gst_rtsp_source_hub_parent_class)->finalize (obj);
+}
+
+static void
+gst_rtsp_source_hub_get_property (GObject * object, guint propid,
+    GValue * value, GParamSpec * pspec)
+{
+  GstRTSPSourceHub *hub = GST_RTSP_SOURCE_HUB (object);
+
+  switch (propid) {
+    case PROP_NAME:
+      g_value_take_string (value, gst_rtsp_source_hub_get_name (hub));
+      break;
+    case PROP_LAUNCH:
+      g_value_take_string (value, gst_rtsp_source_hub_get_launch (hub));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, propid, pspec);
+  }
+}
+
+static void
+gst_rtsp_source_hub_set_property (GObject * object, guint propid,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstRTSPSourceHub *hub = GST_RTSP_SOURCE_HUB (object);
+
+  switch (propid) {
+    case PROP_NAME:
+      hub->priv->name = g_value_dup_string (value);
+      break;
+    case PROP_LAUNCH:
+      gst_rtsp_source_hub_set_launch (hub, g_value_get_string (value));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, propid, pspec);
+  }
+}
+
+static GstPadProbeReturn
+hub_output_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  HubOutput *output = user_data;
+  GstRTSPSourceHubPrivate *priv = output->hub->priv;
+  GList *walk;
+
+  g_mutex_lock (&priv->lock);
+  if (info->type & (GST_PAD_PROBE_TYPE_BUFFER |
+          GST_PAD_PROBE_TYPE_BUFFER_LIST)) {
+    GstClockTime base_time;
+    GstBufferList *list = NULL;
+    GstBuffer *buffer;
+    guint i, len = 1;
+
+    if (output->srcs == NULL)
+      goto done;
+
+    base_time = gst_element_get_base_time (GST_PAD_PARENT (pad));
+    if (info->type & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+      list = GST_PAD_PROBE_INFO_BUFFER_LIST (info);
+      len = gst_buffer_list_length (list);
+    }
+
+    for (i = 0; i < len; i++) {
+      GstClockTime time;
+
+      buffer = list ? gst_buffer_list_get (list, i) :
+          GST_PAD_PROBE_INFO_BUFFER (info);
+
+      /* the clock time, the consumers have their own base time */
+      time = gst_segment_to_running_time (&output->segment, GST_FORMAT_TIME,
+          GST_BUFFER_PTS (buffer));
+      if (GST_CLOCK_TIME_IS_VALID (time))
+        time += base_time;
+
+      for (walk = output->srcs; walk; walk = walk->next)
+        hub_src_push (walk->data, buffer, time);
+    }
+  } else {
+    GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+
+    switch (GST_EVENT_TYPE (event)) {
+      case GST_EVENT_CAPS:
+      {
+        GstCaps *caps;
+
+        gst_event_parse_caps (event, &caps);
+        gst_caps_replace (&output->caps, caps);
+        for (walk = output->srcs; walk; walk = walk->next)
+          hub_src_set_caps (walk->data, caps);
+        break;
+      }
+      case GST_EVENT_SEGMENT:
+        gst_event_copy_segment (event, &output->segment);
+        break;
+      case GST_EVENT_EOS:
+        output->eos = TRUE;
+        for (walk = output->srcs; walk; walk = walk->next)
+          hub_src_set_eos (walk->data);
+        break;
+      default:
+        break;
+    }
+  }
+
+done:
+  g_mutex_unlock (&priv->lock);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static GstBusSyncReply
+hub_bus_handler (GstBus * bus, GstMessage * message, gpointer user_data)
+{
+  GstRTSPSourceHub *hub = user_data;
+  GstRTSPSourceHubPrivate *priv = hub->priv;
+
+  /* nobody else watches the bus, the outputs end on errors */
+  if (GST_MESSAGE_TYPE (message) == GST_MESSAGE_ERROR) {
+    GHashTableIter iter;
+    gpointer value;
+    GError *error;
+    gchar *debug;
+
+    gst_message_parse_error (message, &error, &debug);
+    GST_WARNING_OBJECT (hub, "error from %s: %s (%s)",
+        GST_MESSAGE_SRC_NAME (message), error->message, GST_STR_NULL (debug));
+    g_clear_error (&error);
+    g_free (debug);
+
+    g_mutex_lock (&priv->lock);
+    g_hash_table_iter_init (&iter, priv->outputs);
+    while (g_hash_table_iter_next (&iter, NULL, &value)) {
+      HubOutput *output = value;
+      GList *walk;
+
+      output->eos = TRUE;
+      for (walk = output->srcs; walk; walk = walk->next)
+        hub_src_set_eos (walk->data);
+    }
+    g_mutex_unlock (&priv->lock);
+  }
+
+  return GST_BUS_DROP;
+}
+
+/* called with the state lock, links the unlinked source pads to a fakesink
+ * and makes them the outputs */
+static void
+hub_add_outputs (GstRTSPSourceHub * hub)
+{
+  GstRTSPSourceHubPrivate *priv = hub->priv;
+  GList *outputs = NULL, *walk;
+  GstIterator *it;
+  GValue item = G_VALUE_INIT;
+  gboolean done = FALSE;
+
+  it = gst_bin_iterate_recurse (GST_BIN (priv->pipeline));
+  while (!done) {
+    switch (gst_iterator_next (it, &item)) {
+      case GST_ITERATOR_OK:
+      {
+        GstElement *element = g_value_get_object (&item);
+        GList *l;
+
+        GST_OBJECT_LOCK (element);
+        for (l = element->srcpads; l; l = l->next) {
+          GstPad *pad = l->data;
+
+          if (!GST_PAD_IS_LINKED (pad)) {
+            HubOutput *output = g_slice_new0 (HubOutput);
+
+            output->hub = hub;
+            output->name = g_strdup (GST_ELEMENT_NAME (element));
+            output->pad = gst_object_ref (pad);
+            gst_segment_init (&output->segment, GST_FORMAT_TIME);
+            outputs = g_list_prepend (outputs, output);
+            break;
+          }
+        }
+        GST_OBJECT_UNLOCK (element);
+        g_value_reset (&item);
+        break;
+      }
+      case GST_ITERATOR_RESYNC:
+        g_list_free_full (outputs, (GDestroyNotify) hub_output_free);
+        outputs = NULL;
+        gst_iterator_resync (it);
+        break;
+      default:
+        done = TRUE;
+        break;
+    }
+  }
+  g_value_unset (&item);
+  gst_iterator_free (it);
+
+  for (walk = outputs; walk; walk = walk->next) {
+    HubOutput *output = walk->data;
+    GstElement *sink;
+    GstPad *sinkpad;
+
+    if (g_hash_table_contains (priv->outputs, output->name)) {
+      GST_WARNING_OBJECT (hub, "ignoring output with duplicate name %s",
+          output->name);
+      hub_output_free (output);
+      continue;
+    }
+
+    GST_DEBUG_OBJECT (hub, "output %s", output->name);
+
+    sink = gst_element_factory_make ("fakesink", NULL);
+    g_object_set (sink, "sync", FALSE, "async", FALSE,
+        "enable-last-sample", FALSE, NULL);
+    gst_bin_add (GST_BIN (priv->pipeline), sink);
+    sinkpad = gst_element_get_static_pad (sink, "sink");
+    gst_pad_link_maybe_ghosting (output->pad, sinkpad);
+    gst_object_unref (sinkpad);
+
+    gst_pad_add_probe (output->pad, GST_PAD_PROBE_TYPE_BUFFER |
+        GST_PAD_PROBE_TYPE_BUFFER_LIST |
+        GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, hub_output_probe, output, NULL);
+
+    g_mutex_lock (&priv->lock);
+    g_hash_table_insert (priv->outputs, output->name, output);
+    g_mutex_unlock (&priv->lock);
+  }
+  g_list_free (outputs);
+}
+
+/* called with the state lock */
+static gboolean
+hub_start (GstRTSPSourceHub * hub)
+{
+  GstRTSPSourceHubPrivate *priv = hub->priv;
+  GstElement *element;
+  GError *error = NULL;
+  GstBus *bus;
+  gchar *launch;
+
+  g_mutex_lock (&priv->lock);
+  launch = g_strdup (priv->launch);
+  g_mutex_unlock (&priv->lock);
+
+  if (launch == NULL)
+    goto no_launch;
+
+  element = gst_parse_launch (launch, &error);
+  if (element == NULL)
+    goto parse_error;
+  if (error) {
+    GST_WARNING_OBJECT (hub, "recoverable parsing error: %s",
+        error->message);
+    g_clear_error (&error);
+  }
+
+  if (GST_IS_PIPELINE (element)) {
+    priv->pipeline = element;
+  } else {
+    priv->pipeline = gst_pipeline_new (priv->name);
+    gst_bin_add (GST_BIN (priv->pipeline), element);
+  }
+  gst_object_ref_sink (priv->pipeline);
+
+  /* the consumers use the system clock as well, usually */
+  priv->clock = gst_system_clock_obtain ();
+  gst_pipeline_use_clock (GST_PIPELINE (priv->pipeline), priv->clock);
+
+  bus = gst_pipeline_get_bus (GST_PIPELINE (priv->pipeline));
+  gst_bus_set_sync_handler (bus, hub_bus_handler, hub, NULL);
+  gst_object_unref (bus);
+
+  hub_add_outputs (hub);
+
+  GST_INFO_OBJECT (hub, "starting %s", launch);
+  g_free (launch);
+
+  if (gst_element_set_state (priv->pipeline, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE)
+    goto start_failed;
+
+  return TRUE;
+
+  /* ERRORS */
+no_launch:
+  {
+    GST_WARNING_OBJECT (hub, "no launch line");
+    return FALSE;
+  }
+parse_error:
+  {
+    GST_WARNING_OBJECT (hub, "could not parse %s: %s", launch,
+        error ? error->message : "unknown reason");
+    g_clear_error (&error);
+    g_free (launch);
+    return FALSE;
+  }
+start_failed:
+  {
+    GST_WARNING_OBJECT (hub, "could not start the pipeline");
+    return FALSE;
+  }
+}
+
+/* called with the state lock */
+static void
+hub_stop (GstRTSPSourceHub * hub)
+{
+  GstRTSPSourceHubPrivate *priv = hub->priv;
+
+  if (priv->pipeline == NULL)
+    return;
+
+  GST_INFO_OBJECT (hub, "stopping");
+
+  gst_element_set_state (priv->pipeline, GST_STATE_NULL);
+  gst_object_unref (priv->pipeline);
+  priv->pipeline = NULL;
+  gst_object_unref (priv->clock);
+  priv->clock = NULL;
+
+  g_mutex_lock (&priv->lock);
+  g_hash_table_remove_all (priv->outputs);
+  g_mutex_unlock (&priv->lock);
+}
+
+static gboolean
+hub_attach (GstRTSPSourceHub * hub, GstRTSPHubSrc * src, const gchar * name)
+{
+  GstRTSPSourceHubPrivate *priv = hub->priv;
+  HubOutput *output;
+
+  g_mutex_lock (&priv->state_lock);
+  if (priv->pipeline == NULL && !hub_start (hub)) {
+    hub_stop (hub);
+    goto failed;
+  }
+
+  g_mutex_lock (&priv->lock);
+  output = g_hash_table_lookup (priv->outputs, name);
+  if (output == NULL) {
+    g_mutex_unlock (&priv->lock);
+    if (priv->n_consumers == 0)
+      hub_stop (hub);
+    goto failed;
+  }
+
+  GST_DEBUG_OBJECT (hub, "%s reads output %s", GST_ELEMENT_NAME (src), name);
+
+  output->srcs = g_list_prepend (output->srcs, src);
+  priv->n_consumers++;
+  if (output->caps)
+    hub_src_set_caps (src, output->caps);
+  if (output->eos)
+    hub_src_set_eos (src);
+  src->hub_clock = gst_object_ref (priv->clock);
+  g_mutex_unlock (&priv->lock);
+  g_mutex_unlock (&priv->state_lock);
+
+  return TRUE;
+
+failed:
+  {
+    g_mutex_unlock (&priv->state_lock);
+    return FALSE;
+  }
+}
+
+static void
+hub_detach (GstRTSPSourceHub * hub, GstRTSPHubSrc * src)
+{
+  GstRTSPSourceHubPrivate *priv = hub->priv;
+  GHashTableIter iter;
+  gpointer value;
+  gboolean last;
+
+  g_mutex_lock (&priv->state_lock);
+  g_mutex_lock (&priv->lock);
+  g_hash_table_iter_init (&iter, priv->outputs);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    HubOutput *output = value;
+
+    output->srcs = g_list_remove (output->srcs, src);
+  }
+  last = (--priv->n_consumers == 0);
+  g_mutex_unlock (&priv->lock);
+
+  /* the capture device is released when nobody reads it */
+  if (last)
+    hub_stop (hub);
+  g_mutex_unlock (&priv->state_lock);
+}
+
+/**
+ * gst_rtsp_source_hub_new:
+ * @name: the name of the hub
+ *
+ * Create a new #GstRTSPSourceHub with @name. The rtsphubsrc elements with
+ * @name as their hub property read the outputs of the hub as long as it
+ * exists. When several hubs have the same name, the last one is used.
+ *
+ * Returns: (transfer full): a new #GstRTSPSourceHub
+ *
+ * Since: 1.20
+ */
+GstRTSPSourceHub *
+gst_rtsp_source_hub_new (const gchar * name)
+{
+  GstRTSPSourceHub *result;
+
+  g_return_val_if_fail (name != NULL, NULL);
+
+  result = g_object_new (GST_TYPE_RTSP_SOURCE_HUB, "name", name, NULL);
+
+  return result;
+}
+
+/**
+ * gst_rtsp_source_hub_find:
+ * @name: the name of a hub
+ *
+ * Find the hub with @name.
+ *
+ * Returns: (transfer full) (nullable): the #GstRTSPSourceHub with @name or
+ * %NULL when there is none. g_object_unref() after usage.
+ *
+ * Since: 1.20
+ */
+GstRTSPSourceHub *
+gst_rtsp_source_hub_find (const gchar * name)
+{
+  GstRTSPSourceHub *result = NULL;
+  HubEntry *entry;
+
+  g_return_val_if_fail (name != NULL, NULL);
+
+  g_mutex_lock (&hubs_lock);
+  if (hubs && (entry = g_hash_table_lookup (hubs, name)))
+    result = g_weak_ref_get (&entry->ref);
+  g_mutex_unlock (&hubs_lock);
+
+  return result;
+}
+
+/**
+ * gst_rtsp_source_hub_get_name:
+ * @hub: a #GstRTSPSourceHub
+ *
+ * Get the name of @hub.
+ *
+ * Returns: (transfer full): the name of @hub. g_free() after usage.
+ *
+ * Since: 1.20
+ */
+gchar *
+gst_rtsp_source_hub_get_name (GstRTSPSourceHub * hub)
+{
+  g_return_val_if_fail (GST_IS_RTSP_SOURCE_HUB (hub), NULL);
+
+  return g_strdup (hub->priv->name);
+}
+
+/**
+ * gst_rtsp_source_hub_set_launch:
+ * @hub: a #GstRTSPSourceHub
+ * @launch: the launch description
+ *
+ * The gst_parse_launch() line of the pipeline of @hub. The elements with an
+ * unlinked source pad are the outputs of @hub.
+ *
+ * The pipeline is created when the first rtsphubsrc of @hub starts, a
+ * running pipeline keeps its launch line until it stops.
+ *
+ * Since: 1.20
+ */
+void
+gst_rtsp_source_hub_set_launch (GstRTSPSourceHub * hub, const gchar * launch)
+{
+  GstRTSPSourceHubPrivate *priv;
+
+  g_return_if_fail (GST_IS_RTSP_SOURCE_HUB (hub));
+  g_return_if_fail (launch != NULL);
+
+  priv = hub->priv;
+
+  g_mutex_lock (&priv->lock);
+  g_free (priv->launch);
+  priv->launch = g_strdup (launch);
+  g_mutex_unlock (&priv->lock);
+}
+
+/**
+ * gst_rtsp_source_hub_get_launch:
+ * @hub: a #GstRTSPSourceHub
+ *
+ * Get the gst_parse_launch() line of the pipeline of @hub.
+ *
+ * Returns: (transfer full) (nullable): the launch description. g_free()
+ * after usage.
+ *
+ * Since: 1.20
+ */
+gchar *
+gst_rtsp_source_hub_get_launch (GstRTSPSourceHub * hub)
+{
+  GstRTSPSourceHubPrivate *priv;
+  gchar *result;
+
+  g_return_val_if_fail (GST_IS_RTSP_SOURCE_HUB (hub), NULL);
+
+  priv = hub->priv;
+
+  g_mutex_lock (&priv->lock);
+  result = g_strdup (priv->launch);
+  g_mutex_unlock (&priv->lock);
+
+  return result;
+}
+
+/**
+ * gst_rtsp_source_hub_n_consumers:
+ * @hub: a #GstRTSPSourceHub
+ *
+ * Get the number of rtsphubsrc elements that read the outputs of @hub.
+ *
+ * Returns: the number of consumers of @hub.
+ *
+ * Since: 1.20
+ */
+guint
+gst_rtsp_source_hub_n_consumers (GstRTSPSourceHub * hub)
+{
+  GstRTSPSourceHubPrivate *priv;
+  guint result;
+
+  g_return_val_if_fail (GST_IS_RTSP_SOURCE_HUB (hub), 0);
+
+  priv = hub->priv;
+
+  g_mutex_lock (&priv->lock);
+  result = priv->n_consumers;
+  g_mutex_unlock (&priv->lock);
+
+  return result;
+}
@@ -0,0 +1,102 @@
+/* GStreamer
+ * Copyright (C) 2021 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_RTSP_SOURCE_HUB_H__
+#define __GST_RTSP_SOURCE_HUB_H__
+
+#include <gst/gst.h>
+#include "rtsp-server-prelude.h"
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_RTSP_SOURCE_HUB              (gst_rtsp_source_hub_get_type ())
+#define GST_IS_RTSP_SOURCE_HUB(obj)           (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GST_TYPE_RTSP_SOURCE_HUB))
+#define GST_IS_RTSP_SOURCE_HUB_CLASS(klass)   (G_TYPE_CHECK_CLASS_TYPE ((klass), GST_TYPE_RTSP_SOURCE_HUB))
+#define GST_RTSP_SOURCE_HUB_GET_CLASS(obj)    (G_TYPE_INSTANCE_GET_CLASS ((obj), GST_TYPE_RTSP_SOURCE_HUB, GstRTSPSourceHubClass))
+#define GST_RTSP_SOURCE_HUB(obj)              (G_TYPE_CHECK_INSTANCE_CAST ((obj), GST_TYPE_RTSP_SOURCE_HUB, GstRTSPSourceHub))
+#define GST_RTSP_SOURCE_HUB_CLASS(klass)      (G_TYPE_CHECK_CLASS_CAST ((klass), GST_TYPE_RTSP_SOURCE_HUB, GstRTSPSourceHubClass))
+#define GST_RTSP_SOURCE_HUB_CAST(obj)         ((GstRTSPSourceHub*)(obj))
+#define GST_RTSP_SOURCE_HUB_CLASS_CAST(klass) ((GstRTSPSourceHubClass*)(klass))
+
+typedef struct _GstRTSPSourceHub GstRTSPSourceHub;
+typedef struct _GstRTSPSourceHubClass GstRTSPSourceHubClass;
+typedef struct _GstRTSPSourceHubPrivate GstRTSPSourceHubPrivate;
+
+/**
+ * GstRTSPSourceHub:
+ *
+ * A capture pipeline shared by the media of several factories.
+ *
+ * Since: 1.20
+ */
+struct _GstRTSPSourceHub {
+  GObject       parent;
+
+  /*< private >*/
+  GstRTSPSourceHubPrivate *priv;
+  gpointer _gst_reserved[GST_PADDING];
+};
+
+/**
+ * GstRTSPSourceHubClass:
+ *
+ * The #GstRTSPSourceHub class structure.
+ *
+ * Since: 1.20
+ */
+struct _GstRTSPSourceHubClass {
+  GObjectClass  parent_class;
+
+  /*< private >*/
+  gpointer _gst_reserved[GST_PADDING];
+};
+
+GST_RTSP_SERVER_API
+GType                 gst_rtsp_source_hub_get_type      (void);
+
+/* creating the hub */
+
+GST_RTSP_SERVER_API
+GstRTSPSourceHub *    gst_rtsp_source_hub_new           (const gchar *name);
+
+GST_RTSP_SERVER_API
+GstRTSPSourceHub *    gst_rtsp_source_hub_find          (const gchar *name);
+
+/* configuring the hub */
+
+GST_RTSP_SERVER_API
+gchar *               gst_rtsp_source_hub_get_name      (GstRTSPSourceHub *hub);
+
+GST_RTSP_SERVER_API
+void                  gst_rtsp_source_hub_set_launch    (GstRTSPSourceHub *hub,
+                                                         const gchar *launch);
+
+GST_RTSP_SERVER_API
+gchar *               gst_rtsp_source_hub_get_launch    (GstRTSPSourceHub *hub);
+
+GST_RTSP_SERVER_API
+guint                 gst_rtsp_source_hub_n_consumers   (GstRTSPSourceHub *hub);
+
+#ifdef G_DEFINE_AUTOPTR_CLEANUP_FUNC
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(GstRTSPSourceHub, gst_object_unref)
+#endif
+
+G_END_DECLS
+
+#endif /* __GST_RTSP_SOURCE_HUB_H__ */
@@ -515,7 +515,13 @@ gst_rtsp_stream_transport_get_rtpinfo (GstRTSPStreamTransport * trans,
 
   if (!gst_rtsp_stream_is_sender (priv->stream))
     return NULL;
-  if (!gst_rtsp_stream_get_rtpinfo (priv->stream, &rtptime, &seq, &clock_rate,
+  /* time-shifted transports start in the past, without running-time, and
+   * the transports that got the cached GOP start at its first packet */
+  if (!gst_rtsp_stream_get_timeshift_rtpinfo (priv->stream, trans, &rtptime,
+          &seq, &clock_rate) &&
+      !gst_rtsp_stream_get_gop_rtpinfo (priv->stream, trans, &rtptime, &seq,
+          &clock_rate, &running_time) &&
+      !gst_rtsp_stream_get_rtpinfo (priv->stream, &rtptime, &seq, &clock_rate,
           &running_time))
     return NULL;
 
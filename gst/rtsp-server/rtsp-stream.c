@@ -76,16 +76,56 @@
 
 #include <gst/app/gstappsrc.h>
 #include <gst/app/gstappsink.h>
+#include <gst/base/gstqueuearray.h>
 
 #include <gst/rtp/gstrtpbuffer.h>
 
 #include "rtsp-stream.h"
 #include "rtsp-server-internal.h"
 
+/* a packet in the time-shift ring buffer */
+typedef struct
+{
+  guint64 offset;
+  guint size;
+  GstClockTime time;
+  gboolean keyframe;            /* first packet of a keyframe */
+  guint16 seq;
+  guint32 rtptime;
+} TimeshiftEntry;
+
+/* a packet queued for the time-shift thread */
+typedef struct
+{
+  GstBuffer *buffer;
+  GstClockTime time;
+} TimeshiftPacket;
+
+/* a transport that receives the packets from the time-shift ring buffer */
+typedef struct
+{
+  GstRTSPStreamTransport *trans;
+  guint64 serial;               /* of the next entry to send */
+  GstClockTime delay;
+  gboolean active;
+} TimeshiftReader;
+
+/* the first cached packet that was sent to a transport */
+typedef struct
+{
+  GstRTSPStreamTransport *trans;
+  guint rtptime;
+  guint seq;
+  guint clock_rate;
+  GstClockTime running_time;
+} GopStart;
+
 struct _GstRTSPStreamPrivate
 {
   GMutex lock;
   guint idx;
+  /* changes when something that goes in the SDP changes */
+  guint sdp_cookie;
   /* Only one pad is ever set */
   GstPad *srcpad, *sinkpad;
   GstElement *payloader;
@@ -177,6 +217,7 @@ struct _GstRTSPStreamPrivate
 
   /* the caps of the stream */
   gulong caps_sig;
+  gulong tags_probe;
   GstCaps *caps;
 
   /* transports we stream to */
@@ -205,6 +246,7 @@ struct _GstRTSPStreamPrivate
   /* stream blocking */
   gulong blocked_id[2];
   gboolean blocking;
+  gboolean drop_blocked;        /* drop instead of holding the data */
 
   /* current stream postion */
   GstClockTime position;
@@ -230,6 +272,72 @@ struct _GstRTSPStreamPrivate
   gulong block_early_rtcp_probe;
   GstPad *block_early_rtcp_pad_ipv6;
   gulong block_early_rtcp_probe_ipv6;
+
+  /* the RTP packets since the last keyframe, replayed to new transports */
+  GMutex gop_lock;
+  guint gop_cache_size;         /* max bytes, protected by gop_lock */
+  gulong gop_probe;
+  guint gop_pt;
+  GQueue gop_cache;             /* protected by gop_lock */
+  gsize gop_bytes;
+  gboolean gop_valid;
+  gboolean gop_have_rtptime;
+  guint32 gop_last_rtptime;
+  /* while the cache holds the packets since the start of the segment, it
+   * keeps them for gop_keep_start, for the clients that join a VOD media from
+   * the start. gop_start_time is the stream time of the cached packets */
+  GstClockTime gop_keep_start;
+  gboolean gop_at_start;
+  GstClockTime gop_first_pts;
+  GstClockTime gop_start_time;
+  /* UDP transports that are kept out of the udpsink until they were sent the
+   * cached GOP, and where the transports that got it start. protected by lock */
+  GList *gop_held;
+  GList *gop_starts;
+
+  /* send only the keyframes during trick play, the segment and timestamps
+   * are only used from the streaming thread of trickmode_pad */
+  gboolean keyframe_trickmode;
+  GstPad *trickmode_pad;
+  gulong trickmode_probe;
+  gboolean trickmode_active;
+  GstSegment trickmode_segment;
+
+  /* force a keyframe when a transport is added, at most once per interval */
+  GstClockTime keyunit_interval;
+  gint64 keyunit_last;
+  guint64 keyunit_honored;
+  guint64 keyunit_suppressed;
+
+  /* drop the input of the encoder while there are no transports */
+  gboolean idle_unused;
+  GstPad *idle_pad;
+  gulong idle_probe;
+  gulong resume_probe;
+  gboolean keyunit_resume;
+  gboolean gated;
+
+  /* the RTP packets of the last duration, in a ring buffer in a file */
+  GMutex timeshift_lock;        /* locking order: lock, timeshift_lock */
+  GstClockTime timeshift_duration;
+  guint64 timeshift_size;
+  gulong timeshift_probe;
+  guint timeshift_pt;
+  /* the file is only accessed from timeshift_thread, which gets the packets
+   * of the probe from timeshift_queue */
+  GThread *timeshift_thread;
+  GCond timeshift_cond;
+  gboolean timeshift_running;
+  GQueue timeshift_queue;       /* of TimeshiftPacket */
+  GFile *timeshift_file;
+  GFileIOStream *timeshift_io;
+  GstQueueArray *timeshift_index;       /* of TimeshiftEntry */
+  guint64 timeshift_first;      /* serial of the first entry in the index */
+  guint64 timeshift_offset;     /* where the next packet is written */
+  GstClockTime timeshift_last;  /* running time of the last packet */
+  gboolean timeshift_have_rtptime;
+  guint32 timeshift_last_rtptime;
+  GList *timeshift_readers;     /* of TimeshiftReader */
 };
 
 #define DEFAULT_CONTROL         NULL
@@ -240,6 +348,20 @@ struct _GstRTSPStreamPrivate
 #define DEFAULT_BIND_MCAST_ADDRESS FALSE
 #define DEFAULT_DO_RATE_CONTROL TRUE
 #define DEFAULT_ENABLE_RTCP TRUE
+#define DEFAULT_GOP_CACHE_SIZE 0
+#define DEFAULT_TIMESHIFT_DURATION 0
+#define DEFAULT_TIMESHIFT_SIZE (64 * 1024 * 1024)
+
+/* packets that wait for the time-shift thread before they are dropped */
+#define TIMESHIFT_MAX_QUEUED 1024
+
+/* the cached GOP is sent to a new UDP transport in bursts of this many
+ * packets, with GOP_BURST_INTERVAL microseconds in between */
+#define GOP_BURST_PACKETS 16
+#define GOP_BURST_INTERVAL 1000
+/* rounds of sending the packets that were cached during the replay before
+ * the last ones are sent while the streaming thread waits */
+#define GOP_CATCHUP_ROUNDS 4
 
 enum
 {
@@ -273,6 +395,12 @@ static void gst_rtsp_stream_finalize (GObject * obj);
 static gboolean
 update_transport (GstRTSPStream * stream, GstRTSPStreamTransport * trans,
     gboolean add);
+static void gop_start_remove (GstRTSPStream * stream,
+    GstRTSPStreamTransport * trans);
+static void gop_release_held (GstRTSPStream * stream,
+    GstRTSPStreamTransport * trans);
+static void update_idle (GstRTSPStream * stream);
+static void send_force_keyunit (GstRTSPStream * stream);
 
 static guint gst_rtsp_stream_signals[SIGNAL_LAST] = { 0 };
 
@@ -340,8 +468,19 @@ gst_rtsp_stream_init (GstRTSPStream * stream)
   priv->bind_mcast_address = DEFAULT_BIND_MCAST_ADDRESS;
   priv->do_rate_control = DEFAULT_DO_RATE_CONTROL;
   priv->enable_rtcp = DEFAULT_ENABLE_RTCP;
+  priv->gop_cache_size = DEFAULT_GOP_CACHE_SIZE;
+  priv->gop_first_pts = GST_CLOCK_TIME_NONE;
+  priv->gop_start_time = GST_CLOCK_TIME_NONE;
+  priv->timeshift_duration = DEFAULT_TIMESHIFT_DURATION;
+  priv->timeshift_size = DEFAULT_TIMESHIFT_SIZE;
+  priv->keyunit_interval = GST_CLOCK_TIME_NONE;
 
   g_mutex_init (&priv->lock);
+  g_mutex_init (&priv->gop_lock);
+  g_queue_init (&priv->gop_cache);
+  g_mutex_init (&priv->timeshift_lock);
+  g_cond_init (&priv->timeshift_cond);
+  g_queue_init (&priv->timeshift_queue);
 
   priv->continue_sending = TRUE;
   priv->send_cookie = 0;
@@ -377,6 +516,12 @@ free_mcast_client (gpointer data)
   g_free (client);
 }
 
+static void
+gop_start_free (GopStart * start)
+{
+  g_slice_free (GopStart, start);
+}
+
 static void
 gst_rtsp_stream_finalize (GObject * obj)
 {
@@ -434,6 +579,12 @@ gst_rtsp_stream_finalize (GObject * obj)
     gst_object_unref (priv->sinkpad);
   g_free (priv->control);
   g_mutex_clear (&priv->lock);
+  g_queue_clear_full (&priv->gop_cache, (GDestroyNotify) gst_buffer_unref);
+  g_list_free (priv->gop_held);
+  g_list_free_full (priv->gop_starts, (GDestroyNotify) gop_start_free);
+  g_mutex_clear (&priv->gop_lock);
+  g_mutex_clear (&priv->timeshift_lock);
+  g_cond_clear (&priv->timeshift_cond);
 
   g_hash_table_unref (priv->keys);
   g_hash_table_destroy (priv->ptmap);
@@ -653,6 +804,7 @@ gst_rtsp_stream_set_control (GstRTSPStream * stream, const gchar * control)
   g_mutex_lock (&priv->lock);
   g_free (priv->control);
   priv->control = g_strdup (control);
+  priv->sdp_cookie = gst_rtsp_sdp_next_cookie ();
   g_mutex_unlock (&priv->lock);
 }
 
@@ -869,6 +1021,7 @@ gst_rtsp_stream_set_profiles (GstRTSPStream * stream, GstRTSPProfile profiles)
 
   g_mutex_lock (&priv->lock);
   priv->profiles = profiles;
+  priv->sdp_cookie = gst_rtsp_sdp_next_cookie ();
   g_mutex_unlock (&priv->lock);
 }
 
@@ -916,6 +1069,7 @@ gst_rtsp_stream_set_protocols (GstRTSPStream * stream,
 
   g_mutex_lock (&priv->lock);
   priv->allowed_protocols = protocols;
+  priv->sdp_cookie = gst_rtsp_sdp_next_cookie ();
   g_mutex_unlock (&priv->lock);
 }
 
@@ -970,6 +1124,7 @@ gst_rtsp_stream_set_address_pool (GstRTSPStream * stream,
     priv->pool = pool ? g_object_ref (pool) : NULL;
   else
     old = NULL;
+  priv->sdp_cookie = gst_rtsp_sdp_next_cookie ();
   g_mutex_unlock (&priv->lock);
 
   if (old)
@@ -1029,6 +1184,7 @@ gst_rtsp_stream_set_multicast_iface (GstRTSPStream * stream,
     priv->multicast_iface = multicast_iface ? g_strdup (multicast_iface) : NULL;
   else
     old = NULL;
+  priv->sdp_cookie = gst_rtsp_sdp_next_cookie ();
   g_mutex_unlock (&priv->lock);
 
   if (old)
@@ -1194,6 +1350,7 @@ gst_rtsp_stream_reserve_address (GstRTSPStream * stream,
         port, n_ports, ttl, addrp);
     if (res != GST_RTSP_ADDRESS_POOL_OK)
       goto no_address;
+    priv->sdp_cookie = gst_rtsp_sdp_next_cookie ();
 
     /* FIXME: Also reserve the same port with unicast ANY address, since that's
      * where we are going to bind our socket. */
@@ -2187,6 +2344,293 @@ gst_rtsp_stream_get_buffer_size (GstRTSPStream * stream)
   return buffer_size;
 }
 
+/* must be called with gop_lock */
+static void
+gop_cache_clear (GstRTSPStream * stream)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  GstBuffer *buffer;
+
+  while ((buffer = g_queue_pop_head (&priv->gop_cache)))
+    gst_buffer_unref (buffer);
+  priv->gop_bytes = 0;
+}
+
+/**
+ * gst_rtsp_stream_set_gop_cache_size:
+ * @stream: a #GstRTSPStream
+ * @size: the maximum size of the cache in bytes, 0 disables the cache
+ *
+ * Keep the RTP packets that @stream sent since the last keyframe, up to
+ * @size bytes. The packets are sent to each new unicast transport before the
+ * live packets, so that clients can start decoding right away instead of
+ * waiting for the next keyframe. When the packets of a GOP don't fit in
+ * @size, nothing is cached until the next keyframe.
+ *
+ * Keyframes are found from the #GST_BUFFER_FLAG_DELTA_UNIT flag that the
+ * payloader puts on the RTP packets.
+ *
+ * Needs to be set before the stream is joined to a bin.
+ *
+ * Since: 1.20
+ */
+void
+gst_rtsp_stream_set_gop_cache_size (GstRTSPStream * stream, guint size)
+{
+  GstRTSPStreamPrivate *priv;
+
+  g_return_if_fail (GST_IS_RTSP_STREAM (stream));
+
+  priv = stream->priv;
+
+  g_mutex_lock (&priv->gop_lock);
+  priv->gop_cache_size = size;
+  if (size == 0) {
+    gop_cache_clear (stream);
+    priv->gop_valid = FALSE;
+  }
+  g_mutex_unlock (&priv->gop_lock);
+}
+
+/**
+ * gst_rtsp_stream_get_gop_cache_size:
+ * @stream: a #GstRTSPStream
+ *
+ * Get the maximum size of the GOP cache of @stream.
+ *
+ * Returns: the size of the GOP cache in bytes, 0 when it is disabled.
+ *
+ * Since: 1.20
+ */
+guint
+gst_rtsp_stream_get_gop_cache_size (GstRTSPStream * stream)
+{
+  GstRTSPStreamPrivate *priv;
+  guint size;
+
+  g_return_val_if_fail (GST_IS_RTSP_STREAM (stream), 0);
+
+  priv = stream->priv;
+
+  g_mutex_lock (&priv->gop_lock);
+  size = priv->gop_cache_size;
+  g_mutex_unlock (&priv->gop_lock);
+
+  return size;
+}
+
+/* Keep all the packets since the start of the segment in the GOP cache of
+ * @stream for @duration instead of only the last GOP, for the clients that
+ * join a VOD media from the start, see gst_rtsp_media_set_merge_window() */
+void
+gst_rtsp_stream_set_gop_keep_start (GstRTSPStream * stream,
+    GstClockTime duration)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+
+  g_mutex_lock (&priv->gop_lock);
+  priv->gop_keep_start = duration;
+  g_mutex_unlock (&priv->gop_lock);
+}
+
+/* The stream time from which the GOP cache of @stream holds all the packets,
+ * GST_CLOCK_TIME_NONE when nothing is cached */
+GstClockTime
+gst_rtsp_stream_get_gop_start_time (GstRTSPStream * stream)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  GstClockTime time = GST_CLOCK_TIME_NONE;
+
+  g_mutex_lock (&priv->gop_lock);
+  if (priv->gop_valid && !g_queue_is_empty (&priv->gop_cache))
+    time = priv->gop_start_time;
+  g_mutex_unlock (&priv->gop_lock);
+
+  return time;
+}
+
+/**
+ * gst_rtsp_stream_set_keyframe_trickmode:
+ * @stream: a #GstRTSPStream
+ * @keyframes: the new value
+ *
+ * Send only the keyframes of @stream during trick play, for seeks with
+ * #GST_SEEK_FLAG_TRICKMODE and a rate other than 1.0 that the demuxer and
+ * decoders did not apply themselves. The frames without a keyframe are
+ * dropped before they are payloaded, and the timestamps of the keyframes
+ * are rewritten to their running time in a segment with the rate as its
+ * applied rate, so that the RTP timestamps advance at the normal pace and
+ * the response of the PLAY request has the Scale of the seek.
+ *
+ * Needs to be set before the stream is joined to a bin.
+ *
+ * Since: 1.20
+ */
+void
+gst_rtsp_stream_set_keyframe_trickmode (GstRTSPStream * stream,
+    gboolean keyframes)
+{
+  GstRTSPStreamPrivate *priv;
+
+  g_return_if_fail (GST_IS_RTSP_STREAM (stream));
+
+  priv = stream->priv;
+
+  g_mutex_lock (&priv->lock);
+  priv->keyframe_trickmode = keyframes;
+  g_mutex_unlock (&priv->lock);
+}
+
+/**
+ * gst_rtsp_stream_is_keyframe_trickmode:
+ * @stream: a #GstRTSPStream
+ *
+ * Check if @stream sends only its keyframes during trick play.
+ *
+ * Returns: %TRUE if @stream drops the other frames during trick play.
+ *
+ * Since: 1.20
+ */
+gboolean
+gst_rtsp_stream_is_keyframe_trickmode (GstRTSPStream * stream)
+{
+  GstRTSPStreamPrivate *priv;
+  gboolean res;
+
+  g_return_val_if_fail (GST_IS_RTSP_STREAM (stream), FALSE);
+
+  priv = stream->priv;
+
+  g_mutex_lock (&priv->lock);
+  res = priv->keyframe_trickmode;
+  g_mutex_unlock (&priv->lock);
+
+  return res;
+}
+
+/* replace a trick play segment, which the demuxer did not apply, with a
+ * segment at normal rate that has the rate as its applied rate. The
+ * running time of the new segment is the same as its position, so that the
+ * timestamps of the buffers become their running time. */
+static GstEvent *
+trickmode_segment (GstRTSPStream * stream, GstEvent * event)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  const GstSegment *segment;
+  GstSegment applied;
+  GstEvent *result;
+  guint64 start;
+
+  gst_event_parse_segment (event, &segment);
+
+  priv->trickmode_active = segment->format == GST_FORMAT_TIME &&
+      (segment->flags & GST_SEGMENT_FLAG_TRICKMODE) && segment->rate != 1.0 &&
+      segment->applied_rate == 1.0;
+  if (!priv->trickmode_active)
+    return event;
+
+  gst_segment_copy_into (segment, &priv->trickmode_segment);
+
+  gst_segment_init (&applied, GST_FORMAT_TIME);
+  applied.flags = segment->flags;
+  applied.applied_rate = segment->rate;
+  applied.base = segment->base;
+  applied.start = applied.position = segment->base;
+  applied.duration = segment->duration;
+
+  /* the stream time where the playback starts */
+  start = segment->rate > 0.0 ? segment->start : segment->stop;
+  applied.time = gst_segment_to_stream_time (segment, GST_FORMAT_TIME, start);
+  if (applied.time == -1)
+    applied.time = segment->time;
+
+  GST_DEBUG_OBJECT (stream, "sending keyframes only at rate %f",
+      segment->rate);
+
+  result = gst_event_new_segment (&applied);
+  gst_event_set_seqnum (result, gst_event_get_seqnum (event));
+  gst_event_unref (event);
+
+  return result;
+}
+
+/* drop @buffer when it is no keyframe or outside of the trick play
+ * segment, otherwise give its timestamps in the running time */
+static gboolean
+trickmode_buffer (GstRTSPStream * stream, GstBuffer ** buffer)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  GstSegment *segment = &priv->trickmode_segment;
+  GstClockTime pts, dts, duration;
+
+  if (GST_BUFFER_FLAG_IS_SET (*buffer, GST_BUFFER_FLAG_DELTA_UNIT))
+    return FALSE;
+
+  pts = GST_BUFFER_PTS (*buffer);
+  dts = GST_BUFFER_DTS (*buffer);
+  duration = GST_BUFFER_DURATION (*buffer);
+
+  if (GST_CLOCK_TIME_IS_VALID (pts)) {
+    pts = gst_segment_to_running_time (segment, GST_FORMAT_TIME, pts);
+    if (pts == -1)
+      return FALSE;
+  }
+  if (GST_CLOCK_TIME_IS_VALID (dts))
+    dts = gst_segment_to_running_time (segment, GST_FORMAT_TIME, dts);
+  if (GST_CLOCK_TIME_IS_VALID (duration))
+    duration = duration / ABS (segment->rate);
+
+  *buffer = gst_buffer_make_writable (*buffer);
+  GST_BUFFER_PTS (*buffer) = pts;
+  GST_BUFFER_DTS (*buffer) = dts;
+  GST_BUFFER_DURATION (*buffer) = duration;
+
+  return TRUE;
+}
+
+static gboolean
+trickmode_list_func (GstBuffer ** buffer, guint idx, GstRTSPStream * stream)
+{
+  if (!trickmode_buffer (stream, buffer))
+    gst_clear_buffer (buffer);
+
+  return TRUE;
+}
+
+static GstPadProbeReturn
+trickmode_probe (GstPad * pad, GstPadProbeInfo * info, GstRTSPStream * stream)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+
+  if (info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+    GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+
+    if (GST_EVENT_TYPE (event) == GST_EVENT_SEGMENT)
+      GST_PAD_PROBE_INFO_DATA (info) = trickmode_segment (stream, event);
+    else if (GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP)
+      priv->trickmode_active = FALSE;
+  } else if (!priv->trickmode_active) {
+    /* nothing to do */
+  } else if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+
+    if (!trickmode_buffer (stream, &buffer))
+      return GST_PAD_PROBE_DROP;
+    GST_PAD_PROBE_INFO_DATA (info) = buffer;
+  } else if (info->type & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+    GstBufferList *list = GST_PAD_PROBE_INFO_BUFFER_LIST (info);
+
+    list = gst_buffer_list_make_writable (list);
+    gst_buffer_list_foreach (list, (GstBufferListFunc) trickmode_list_func,
+        stream);
+    GST_PAD_PROBE_INFO_DATA (info) = list;
+    if (gst_buffer_list_length (list) == 0)
+      return GST_PAD_PROBE_DROP;
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
 /**
  * gst_rtsp_stream_set_max_mcast_ttl:
  * @stream: a #GstRTSPStream
@@ -2331,90 +2775,547 @@ caps_notify (GstPad * pad, GParamSpec * unused, GstRTSPStream * stream)
   g_mutex_lock (&priv->lock);
   oldcaps = priv->caps;
   priv->caps = newcaps;
+  priv->sdp_cookie = gst_rtsp_sdp_next_cookie ();
   g_mutex_unlock (&priv->lock);
 
   if (oldcaps)
     gst_caps_unref (oldcaps);
 }
 
-static void
-dump_structure (const GstStructure * s)
+/* executed from streaming thread */
+static GstPadProbeReturn
+tags_probe (GstPad * pad, GstPadProbeInfo * info, GstRTSPStream * stream)
 {
-  gchar *sstr;
+  GstRTSPStreamPrivate *priv = stream->priv;
 
-  sstr = gst_structure_to_string (s);
-  GST_INFO ("structure: %s", sstr);
-  g_free (sstr);
+  if (GST_EVENT_TYPE (GST_PAD_PROBE_INFO_EVENT (info)) == GST_EVENT_TAG) {
+    g_mutex_lock (&priv->lock);
+    priv->sdp_cookie = gst_rtsp_sdp_next_cookie ();
+    g_mutex_unlock (&priv->lock);
+  }
+
+  return GST_PAD_PROBE_OK;
 }
 
-static GstRTSPStreamTransport *
-find_transport (GstRTSPStream * stream, const gchar * rtcp_from)
+/* the stream time of the GOP that starts with the packet with @pts, from
+ * the start of the segment when it is @at_start. Must be called with
+ * gop_lock */
+static GstClockTime
+gop_stream_time (GstRTSPStream * stream, GstClockTime pts, gboolean at_start)
 {
   GstRTSPStreamPrivate *priv = stream->priv;
-  GList *walk;
-  GstRTSPStreamTransport *result = NULL;
-  const gchar *tmp;
-  gchar *dest;
-  guint port;
+  GstEvent *event;
+  const GstSegment *segment;
+  GstClockTime time = GST_CLOCK_TIME_NONE;
 
-  if (rtcp_from == NULL)
-    return NULL;
+  event = gst_pad_get_sticky_event (priv->send_src[0], GST_EVENT_SEGMENT, 0);
+  if (event == NULL)
+    return time;
 
-  tmp = g_strrstr (rtcp_from, ":");
-  if (tmp == NULL)
-    return NULL;
+  gst_event_parse_segment (event, &segment);
+  if (segment->format == GST_FORMAT_TIME) {
+    if (at_start)
+      time = segment->time;
+    else
+      time = gst_segment_to_stream_time (segment, GST_FORMAT_TIME, pts);
+  }
+  gst_event_unref (event);
 
-  port = atoi (tmp + 1);
-  dest = g_strndup (rtcp_from, tmp - rtcp_from);
+  return time;
+}
 
-  g_mutex_lock (&priv->lock);
-  GST_INFO ("finding %s:%d in %d transports", dest, port,
-      g_list_length (priv->transports));
+/* must be called with gop_lock */
+static gboolean
+gop_cache_keeps_start (GstRTSPStream * stream, GstClockTime pts)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
 
-  for (walk = priv->transports; walk; walk = g_list_next (walk)) {
-    GstRTSPStreamTransport *trans = walk->data;
-    const GstRTSPTransport *tr;
-    gint min, max;
+  return priv->gop_valid && priv->gop_at_start && priv->gop_keep_start > 0 &&
+      GST_CLOCK_TIME_IS_VALID (pts) &&
+      GST_CLOCK_TIME_IS_VALID (priv->gop_first_pts) &&
+      pts < priv->gop_first_pts + priv->gop_keep_start;
+}
 
-    tr = gst_rtsp_stream_transport_get_transport (trans);
+/* must be called with gop_lock */
+static void
+gop_cache_add (GstRTSPStream * stream, GstBuffer * buffer)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  GstClockTime pts = GST_BUFFER_PTS (buffer);
+  guint32 rtptime;
+  guint pt;
+  gsize size;
 
-    if (priv->client_side) {
-      /* In client side mode the 'destination' is the RTSP server, so send
-       * to those ports */
-      min = tr->server_port.min;
-      max = tr->server_port.max;
-    } else {
-      min = tr->client_port.min;
-      max = tr->client_port.max;
-    }
+  if (!gst_rtp_buffer_map (buffer, GST_MAP_READ, &rtp))
+    return;
+  pt = gst_rtp_buffer_get_payload_type (&rtp);
+  rtptime = gst_rtp_buffer_get_timestamp (&rtp);
+  gst_rtp_buffer_unmap (&rtp);
 
-    if ((g_ascii_strcasecmp (tr->destination, dest) == 0) &&
-        (min == port || max == port)) {
-      result = trans;
-      break;
-    }
-  }
-  if (result)
-    g_object_ref (result);
-  g_mutex_unlock (&priv->lock);
+  /* retransmission and FEC packets have their own payload type */
+  if (pt != priv->gop_pt)
+    return;
 
-  g_free (dest);
+  /* the first packet of a keyframe starts a new GOP, unless the packets
+   * since the start are still kept */
+  if (!GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT) &&
+      (!priv->gop_have_rtptime || rtptime != priv->gop_last_rtptime) &&
+      !gop_cache_keeps_start (stream, pts)) {
+    gop_cache_clear (stream);
+    priv->gop_valid = TRUE;
+    priv->gop_at_start = !priv->gop_have_rtptime;
+    priv->gop_first_pts = pts;
+    priv->gop_start_time = gop_stream_time (stream, pts, priv->gop_at_start);
+  }
+  priv->gop_last_rtptime = rtptime;
+  priv->gop_have_rtptime = TRUE;
+
+  if (!priv->gop_valid)
+    return;
 
-  return result;
+  size = gst_buffer_get_size (buffer);
+  if (priv->gop_bytes + size > priv->gop_cache_size) {
+    GST_DEBUG_OBJECT (stream, "GOP larger than %u bytes, not caching",
+        priv->gop_cache_size);
+    gop_cache_clear (stream);
+    priv->gop_valid = FALSE;
+    priv->gop_at_start = FALSE;
+    return;
+  }
+
+  g_queue_push_tail (&priv->gop_cache, gst_buffer_ref (buffer));
+  priv->gop_bytes += size;
 }
 
-static GstRTSPStreamTransport *
-check_transport (GObject * source, GstRTSPStream * stream)
+/* executed from streaming thread */
+static GstPadProbeReturn
+gop_cache_probe (GstPad * pad, GstPadProbeInfo * info, GstRTSPStream * stream)
 {
-  GstStructure *stats;
-  GstRTSPStreamTransport *trans;
+  GstRTSPStreamPrivate *priv = stream->priv;
 
-  /* see if we have a stream to match with the origin of the RTCP packet */
-  trans = g_object_get_qdata (source, ssrc_stream_map_key);
-  if (trans == NULL) {
-    g_object_get (source, "stats", &stats, NULL);
-    if (stats) {
-      const gchar *rtcp_from;
+  g_mutex_lock (&priv->gop_lock);
+  if (priv->gop_cache_size == 0)
+    goto done;
+
+  if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+    gop_cache_add (stream, GST_PAD_PROBE_INFO_BUFFER (info));
+  } else if (info->type & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+    GstBufferList *list = GST_PAD_PROBE_INFO_BUFFER_LIST (info);
+    guint i, len = gst_buffer_list_length (list);
+
+    for (i = 0; i < len; i++)
+      gop_cache_add (stream, gst_buffer_list_get (list, i));
+  } else if (GST_EVENT_TYPE (GST_PAD_PROBE_INFO_EVENT (info)) ==
+      GST_EVENT_FLUSH_STOP) {
+    /* after a seek, the packets continue from another position */
+    gop_cache_clear (stream);
+    priv->gop_valid = FALSE;
+    priv->gop_have_rtptime = FALSE;
+    priv->gop_at_start = FALSE;
+  }
+
+done:
+  g_mutex_unlock (&priv->gop_lock);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+timeshift_reader_free (TimeshiftReader * reader)
+{
+  g_object_unref (reader->trans);
+  g_slice_free (TimeshiftReader, reader);
+}
+
+/* must be called with timeshift_lock */
+static TimeshiftReader *
+timeshift_find_reader (GstRTSPStream * stream, GstRTSPStreamTransport * trans)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  GList *walk;
+
+  for (walk = priv->timeshift_readers; walk; walk = walk->next) {
+    TimeshiftReader *reader = walk->data;
+
+    if (reader->trans == trans)
+      return reader;
+  }
+
+  return NULL;
+}
+
+/* Remember where @trans starts, at the first packet @buffer of the cached GOP
+ * it is sent. Must be called with lock */
+static void
+gop_start_add (GstRTSPStream * stream, GstRTSPStreamTransport * trans,
+    GstBuffer * buffer)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  GstEvent *event;
+  const GstSegment *segment;
+  GstCaps *caps;
+  GstClockTime rt = GST_CLOCK_TIME_NONE;
+  gint rate = 0;
+  GopStart *start;
+
+  gop_start_remove (stream, trans);
+
+  event = gst_pad_get_sticky_event (priv->send_src[0], GST_EVENT_SEGMENT, 0);
+  if (event) {
+    gst_event_parse_segment (event, &segment);
+    rt = gst_segment_to_running_time (segment, GST_FORMAT_TIME,
+        GST_BUFFER_PTS (buffer));
+    gst_event_unref (event);
+  }
+  if ((caps = gst_pad_get_current_caps (priv->send_src[0]))) {
+    gst_structure_get_int (gst_caps_get_structure (caps, 0), "clock-rate",
+        &rate);
+    gst_caps_unref (caps);
+  }
+
+  if (!GST_CLOCK_TIME_IS_VALID (rt) || rate == 0 ||
+      !gst_rtp_buffer_map (buffer, GST_MAP_READ, &rtp))
+    return;
+
+  start = g_slice_new (GopStart);
+  start->trans = trans;
+  start->seq = gst_rtp_buffer_get_seq (&rtp);
+  start->rtptime = gst_rtp_buffer_get_timestamp (&rtp);
+  start->clock_rate = rate;
+  start->running_time = rt;
+  gst_rtp_buffer_unmap (&rtp);
+
+  priv->gop_starts = g_list_prepend (priv->gop_starts, start);
+}
+
+/* must be called with lock */
+static void
+gop_start_remove (GstRTSPStream * stream, GstRTSPStreamTransport * trans)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  GList *walk;
+
+  for (walk = priv->gop_starts; walk; walk = walk->next) {
+    GopStart *start = walk->data;
+
+    if (start->trans == trans) {
+      gop_start_free (start);
+      priv->gop_starts = g_list_delete_link (priv->gop_starts, walk);
+      return;
+    }
+  }
+}
+
+/* Get the RTP-Info of the first cached packet that was sent to @trans.
+ * Returns %FALSE when @trans did not get the cached GOP */
+gboolean
+gst_rtsp_stream_get_gop_rtpinfo (GstRTSPStream * stream,
+    GstRTSPStreamTransport * trans, guint * rtptime, guint * seq,
+    guint * clock_rate, GstClockTime * running_time)
+{
+  GstRTSPStreamPrivate *priv;
+  GopStart *start = NULL;
+  GList *walk;
+
+  g_return_val_if_fail (GST_IS_RTSP_STREAM (stream), FALSE);
+
+  priv = stream->priv;
+
+  g_mutex_lock (&priv->lock);
+  for (walk = priv->gop_starts; walk; walk = walk->next) {
+    start = walk->data;
+    if (start->trans == trans)
+      break;
+    start = NULL;
+  }
+  if (start) {
+    if (rtptime)
+      *rtptime = start->rtptime;
+    if (seq)
+      *seq = start->seq;
+    if (clock_rate)
+      *clock_rate = start->clock_rate;
+    if (running_time)
+      *running_time = start->running_time;
+  }
+  g_mutex_unlock (&priv->lock);
+
+  return start != NULL;
+}
+
+/* Get the cached packets to send to the new unicast transport @trans.
+ * Must be called with lock */
+static GstBufferList *
+gop_cache_get_packets (GstRTSPStream * stream, GstRTSPStreamTransport * trans)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  const GstRTSPTransport *tr = gst_rtsp_stream_transport_get_transport (trans);
+  GstBufferList *list = NULL;
+  gboolean timeshifted;
+  GList *walk;
+
+  if (priv->gop_probe == 0 || priv->client_side ||
+      tr->lower_transport == GST_RTSP_LOWER_TRANS_UDP_MCAST)
+    return NULL;
+
+  /* time-shifted transports start at a keyframe of the ring buffer */
+  g_mutex_lock (&priv->timeshift_lock);
+  timeshifted = timeshift_find_reader (stream, trans) != NULL;
+  g_mutex_unlock (&priv->timeshift_lock);
+  if (timeshifted)
+    return NULL;
+
+  g_mutex_lock (&priv->gop_lock);
+  if (priv->gop_valid && !g_queue_is_empty (&priv->gop_cache)) {
+    list = gst_buffer_list_new_sized (priv->gop_cache.length);
+    for (walk = priv->gop_cache.head; walk; walk = walk->next)
+      gst_buffer_list_add (list, gst_buffer_ref (walk->data));
+  }
+  g_mutex_unlock (&priv->gop_lock);
+
+  return list;
+}
+
+/* Send @buffer when it comes after the last sent packet @last_seq.
+ * Returns: %TRUE when @buffer was sent */
+static gboolean
+gop_send_packet (GSocket * socket, GSocketAddress * addr, GstBuffer * buffer,
+    gboolean * have_seq, guint16 * last_seq)
+{
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  GstMapInfo map;
+  guint16 seq;
+
+  if (!gst_rtp_buffer_map (buffer, GST_MAP_READ, &rtp))
+    return FALSE;
+  seq = gst_rtp_buffer_get_seq (&rtp);
+  gst_rtp_buffer_unmap (&rtp);
+
+  if (*have_seq && (gint16) (seq - *last_seq) <= 0)
+    return FALSE;
+
+  if (!gst_buffer_map (buffer, &map, GST_MAP_READ))
+    return FALSE;
+  g_socket_send_to (socket, addr, (const gchar *) map.data, map.size, NULL,
+      NULL);
+  gst_buffer_unmap (buffer, &map);
+
+  *have_seq = TRUE;
+  *last_seq = seq;
+
+  return TRUE;
+}
+
+/* Send the packets of @list that come after @last_seq, pausing after each
+ * burst when @pace. Must be called without lock when @pace */
+static void
+gop_send_packets (GSocket * socket, GSocketAddress * addr,
+    GstBufferList * list, gboolean pace, gboolean * have_seq,
+    guint16 * last_seq)
+{
+  guint i, len, sent = 0;
+
+  len = gst_buffer_list_length (list);
+  for (i = 0; i < len; i++) {
+    if (!gop_send_packet (socket, addr, gst_buffer_list_get (list, i),
+            have_seq, last_seq))
+      continue;
+    if (pace && ++sent % GOP_BURST_PACKETS == 0 && i + 1 < len)
+      g_usleep (GOP_BURST_INTERVAL);
+  }
+}
+
+/* Get the cached packets that come after @last_seq.
+ * Must be called with gop_lock */
+static GstBufferList *
+gop_cache_get_since (GstRTSPStream * stream, guint16 last_seq)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  GstBufferList *list;
+  GList *walk, *first = NULL;
+
+  if (!priv->gop_valid)
+    return NULL;
+
+  /* the new packets are at the tail */
+  for (walk = priv->gop_cache.tail; walk; walk = walk->prev) {
+    GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+    guint16 seq;
+
+    if (!gst_rtp_buffer_map (walk->data, GST_MAP_READ, &rtp))
+      continue;
+    seq = gst_rtp_buffer_get_seq (&rtp);
+    gst_rtp_buffer_unmap (&rtp);
+
+    if ((gint16) (seq - last_seq) <= 0)
+      break;
+    first = walk;
+  }
+  if (first == NULL)
+    return NULL;
+
+  list = gst_buffer_list_new ();
+  for (walk = first; walk; walk = walk->next)
+    gst_buffer_list_add (list, gst_buffer_ref (walk->data));
+
+  return list;
+}
+
+/* Send the cached packets in @list to the held UDP transport @trans, then
+ * the packets that were cached meanwhile, and add @trans to the udpsink.
+ * The packets are paced and sent without lock, except the last few.
+ * Must be called without lock */
+static void
+gop_cache_send_udp (GstRTSPStream * stream, GstRTSPStreamTransport * trans,
+    GstBufferList * list)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  const GstRTSPTransport *tr = gst_rtsp_stream_transport_get_transport (trans);
+  GSocketAddress *addr;
+  GSocket *socket = NULL;
+  GstBufferList *newer = NULL;
+  gboolean have_seq = FALSE, more;
+  guint16 last_seq = 0;
+  guint round;
+
+  addr = g_inet_socket_address_new_from_string (tr->destination,
+      tr->client_port.min);
+
+  if (addr) {
+    g_mutex_lock (&priv->lock);
+    if (g_socket_address_get_family (addr) == G_SOCKET_FAMILY_IPV6)
+      socket = priv->socket_v6[0];
+    else
+      socket = priv->socket_v4[0];
+    if (socket)
+      g_object_ref (socket);
+    g_mutex_unlock (&priv->lock);
+  }
+
+  if (socket)
+    gop_send_packets (socket, addr, list, TRUE, &have_seq, &last_seq);
+
+  /* catch up with the packets that were cached during the replay until
+   * only a burst of them is left */
+  for (round = 0; have_seq && round < GOP_CATCHUP_ROUNDS; round++) {
+    g_mutex_lock (&priv->gop_lock);
+    newer = gop_cache_get_since (stream, last_seq);
+    g_mutex_unlock (&priv->gop_lock);
+
+    if (newer == NULL)
+      break;
+
+    more = gst_buffer_list_length (newer) > GOP_BURST_PACKETS;
+    gop_send_packets (socket, addr, newer, TRUE, &have_seq, &last_seq);
+    gst_buffer_list_unref (newer);
+    newer = NULL;
+    if (!more)
+      break;
+  }
+
+  g_mutex_lock (&priv->lock);
+  g_mutex_lock (&priv->gop_lock);
+  if (g_list_find (priv->gop_held, trans)) {
+    if (have_seq)
+      newer = gop_cache_get_since (stream, last_seq);
+    gop_release_held (stream, trans);
+  }
+  g_mutex_unlock (&priv->lock);
+
+  /* the streaming thread waits in the probe until the last packets are sent
+   * so that they are sent before the live ones */
+  if (newer) {
+    gop_send_packets (socket, addr, newer, FALSE, &have_seq, &last_seq);
+    gst_buffer_list_unref (newer);
+  }
+  g_mutex_unlock (&priv->gop_lock);
+
+  if (socket)
+    g_object_unref (socket);
+  if (addr)
+    g_object_unref (addr);
+}
+
+static void
+dump_structure (const GstStructure * s)
+{
+  gchar *sstr;
+
+  sstr = gst_structure_to_string (s);
+  GST_INFO ("structure: %s", sstr);
+  g_free (sstr);
+}
+
+static GstRTSPStreamTransport *
+find_transport (GstRTSPStream * stream, const gchar * rtcp_from)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  GList *walk;
+  GstRTSPStreamTransport *result = NULL;
+  const gchar *tmp;
+  gchar *dest;
+  guint port;
+
+  if (rtcp_from == NULL)
+    return NULL;
+
+  tmp = g_strrstr (rtcp_from, ":");
+  if (tmp == NULL)
+    return NULL;
+
+  port = atoi (tmp + 1);
+  dest = g_strndup (rtcp_from, tmp - rtcp_from);
+
+  g_mutex_lock (&priv->lock);
+  GST_INFO ("finding %s:%d in %d transports", dest, port,
+      g_list_length (priv->transports));
+
+  for (walk = priv->transports; walk; walk = g_list_next (walk)) {
+    GstRTSPStreamTransport *trans = walk->data;
+    const GstRTSPTransport *tr;
+    gint min, max;
+
+    tr = gst_rtsp_stream_transport_get_transport (trans);
+
+    if (priv->client_side) {
+      /* In client side mode the 'destination' is the RTSP server, so send
+       * to those ports */
+      min = tr->server_port.min;
+      max = tr->server_port.max;
+    } else {
+      min = tr->client_port.min;
+      max = tr->client_port.max;
+    }
+
+    if ((g_ascii_strcasecmp (tr->destination, dest) == 0) &&
+        (min == port || max == port)) {
+      result = trans;
+      break;
+    }
+  }
+  if (result)
+    g_object_ref (result);
+  g_mutex_unlock (&priv->lock);
+
+  g_free (dest);
+
+  return result;
+}
+
+static GstRTSPStreamTransport *
+check_transport (GObject * source, GstRTSPStream * stream)
+{
+  GstStructure *stats;
+  GstRTSPStreamTransport *trans;
+
+  /* see if we have a stream to match with the origin of the RTCP packet */
+  trans = g_object_get_qdata (source, ssrc_stream_map_key);
+  if (trans == NULL) {
+    g_object_get (source, "stats", &stats, NULL);
+    if (stats) {
+      const gchar *rtcp_from;
 
       dump_structure (stats);
 
@@ -2600,62 +3501,691 @@ push_data (GstRTSPStream * stream, GstRTSPStreamTransport * trans,
 static void
 ensure_cached_transports (GstRTSPStream * stream)
 {
-  GstRTSPStreamPrivate *priv = stream->priv;
-  GList *walk;
+  GstRTSPStreamPrivate *priv = stream->priv;
+  GList *walk;
+
+  if (priv->tr_cache_cookie != priv->transports_cookie) {
+    clear_tr_cache (priv);
+    priv->tr_cache =
+        g_ptr_array_new_full (priv->n_tcp_transports, g_object_unref);
+
+    g_mutex_lock (&priv->timeshift_lock);
+    for (walk = priv->transports; walk; walk = g_list_next (walk)) {
+      GstRTSPStreamTransport *tr = (GstRTSPStreamTransport *) walk->data;
+      const GstRTSPTransport *t = gst_rtsp_stream_transport_get_transport (tr);
+
+      if (t->lower_transport != GST_RTSP_LOWER_TRANS_TCP)
+        continue;
+
+      /* time-shifted transports get their packets from the ring buffer */
+      if (timeshift_find_reader (stream, tr))
+        continue;
+
+      g_ptr_array_add (priv->tr_cache, g_object_ref (tr));
+    }
+    g_mutex_unlock (&priv->timeshift_lock);
+    priv->tr_cache_cookie = priv->transports_cookie;
+  }
+}
+
+/* Must be called *without* priv->lock */
+static void
+check_transport_backlog (GstRTSPStream * stream, GstRTSPStreamTransport * trans)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  gboolean send_ret = TRUE;
+
+  gst_rtsp_stream_transport_lock_backlog (trans);
+
+  if (!gst_rtsp_stream_transport_backlog_is_empty (trans)) {
+    GstBuffer *buffer;
+    GstBufferList *buffer_list;
+    gboolean is_rtp;
+    gboolean popped;
+
+    popped =
+        gst_rtsp_stream_transport_backlog_pop (trans, &buffer, &buffer_list,
+        &is_rtp);
+
+    g_assert (popped == TRUE);
+
+    send_ret = push_data (stream, trans, buffer, buffer_list, is_rtp);
+
+    gst_clear_buffer (&buffer);
+    gst_clear_buffer_list (&buffer_list);
+  }
+
+  gst_rtsp_stream_transport_unlock_backlog (trans);
+
+  if (!send_ret) {
+    /* remove transport on send error */
+    g_mutex_lock (&priv->lock);
+    update_transport (stream, trans, FALSE);
+    g_mutex_unlock (&priv->lock);
+  }
+}
+
+/* Create the file of the time-shift ring buffer.
+ * Must be called with timeshift_lock */
+static gboolean
+timeshift_open (GstRTSPStream * stream)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  GError *error = NULL;
+
+  priv->timeshift_file = g_file_new_tmp ("gst-rtsp-timeshift-XXXXXX",
+      &priv->timeshift_io, &error);
+  if (priv->timeshift_file == NULL)
+    goto open_failed;
+
+  /* the data stays reachable from timeshift_io where the platform allows to
+   * delete open files, otherwise it is deleted when closing */
+  g_file_delete (priv->timeshift_file, NULL, NULL);
+
+  priv->timeshift_index =
+      gst_queue_array_new_for_struct (sizeof (TimeshiftEntry), 1024);
+  priv->timeshift_first = 0;
+  priv->timeshift_offset = 0;
+  priv->timeshift_last = GST_CLOCK_TIME_NONE;
+  priv->timeshift_have_rtptime = FALSE;
+
+  return TRUE;
+
+  /* ERRORS */
+open_failed:
+  {
+    GST_WARNING_OBJECT (stream, "failed to create time-shift file: %s",
+        error->message);
+    g_clear_error (&error);
+    return FALSE;
+  }
+}
+
+static void
+timeshift_packet_free (TimeshiftPacket * packet)
+{
+  gst_buffer_unref (packet->buffer);
+  g_slice_free (TimeshiftPacket, packet);
+}
+
+/* must be called with timeshift_lock, after timeshift_stop() */
+static void
+timeshift_close (GstRTSPStream * stream)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  TimeshiftPacket *packet;
+
+  while ((packet = g_queue_pop_head (&priv->timeshift_queue)))
+    timeshift_packet_free (packet);
+
+  g_list_free_full (priv->timeshift_readers,
+      (GDestroyNotify) timeshift_reader_free);
+  priv->timeshift_readers = NULL;
+
+  if (priv->timeshift_io) {
+    g_io_stream_close (G_IO_STREAM (priv->timeshift_io), NULL, NULL);
+    g_clear_object (&priv->timeshift_io);
+  }
+  if (priv->timeshift_file) {
+    g_file_delete (priv->timeshift_file, NULL, NULL);
+    g_clear_object (&priv->timeshift_file);
+  }
+  if (priv->timeshift_index) {
+    gst_queue_array_free (priv->timeshift_index);
+    priv->timeshift_index = NULL;
+  }
+}
+
+/* Write @packet to the ring buffer.
+ * Called from the time-shift thread without timeshift_lock */
+static void
+timeshift_add (GstRTSPStream * stream, TimeshiftPacket * packet)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  GOutputStream *out;
+  TimeshiftEntry entry, *head;
+  GstMapInfo map;
+  guint pt;
+  gboolean res;
+
+  if (!gst_rtp_buffer_map (packet->buffer, GST_MAP_READ, &rtp))
+    return;
+  pt = gst_rtp_buffer_get_payload_type (&rtp);
+  entry.seq = gst_rtp_buffer_get_seq (&rtp);
+  entry.rtptime = gst_rtp_buffer_get_timestamp (&rtp);
+  gst_rtp_buffer_unmap (&rtp);
+
+  /* retransmission and FEC packets have their own payload type */
+  if (pt != priv->timeshift_pt)
+    return;
+
+  entry.size = gst_buffer_get_size (packet->buffer);
+  entry.time = packet->time;
+
+  g_mutex_lock (&priv->timeshift_lock);
+  if (entry.size > priv->timeshift_size)
+    goto drop;
+  if (!GST_CLOCK_TIME_IS_VALID (entry.time))
+    entry.time = priv->timeshift_last;
+  if (!GST_CLOCK_TIME_IS_VALID (entry.time))
+    goto drop;
+
+  entry.keyframe =
+      !GST_BUFFER_FLAG_IS_SET (packet->buffer, GST_BUFFER_FLAG_DELTA_UNIT) &&
+      (!priv->timeshift_have_rtptime ||
+      entry.rtptime != priv->timeshift_last_rtptime);
+  priv->timeshift_last_rtptime = entry.rtptime;
+  priv->timeshift_have_rtptime = TRUE;
+
+  if (priv->timeshift_offset + entry.size > priv->timeshift_size)
+    priv->timeshift_offset = 0;
+  entry.offset = priv->timeshift_offset;
+
+  /* forget the packets that are overwritten or too old */
+  while ((head = gst_queue_array_peek_head_struct (priv->timeshift_index))) {
+    if ((head->offset >= entry.offset + entry.size ||
+            head->offset + head->size <= entry.offset) &&
+        head->time + priv->timeshift_duration >= entry.time)
+      break;
+
+    gst_queue_array_pop_head_struct (priv->timeshift_index);
+    priv->timeshift_first++;
+  }
+  g_mutex_unlock (&priv->timeshift_lock);
+
+  if (!gst_buffer_map (packet->buffer, &map, GST_MAP_READ))
+    return;
+  out = g_io_stream_get_output_stream (G_IO_STREAM (priv->timeshift_io));
+  res = g_seekable_seek (G_SEEKABLE (priv->timeshift_io), entry.offset,
+      G_SEEK_SET, NULL, NULL) &&
+      g_output_stream_write_all (out, map.data, map.size, NULL, NULL, NULL);
+  gst_buffer_unmap (packet->buffer, &map);
+
+  if (!res) {
+    GST_WARNING_OBJECT (stream, "failed to write to the time-shift file");
+    return;
+  }
+
+  g_mutex_lock (&priv->timeshift_lock);
+  gst_queue_array_push_tail_struct (priv->timeshift_index, &entry);
+  priv->timeshift_offset += entry.size;
+  priv->timeshift_last = entry.time;
+  g_mutex_unlock (&priv->timeshift_lock);
+
+  return;
+
+drop:
+  g_mutex_unlock (&priv->timeshift_lock);
+}
+
+/* Read the packet of @entry from the ring buffer.
+ * Called from the time-shift thread without timeshift_lock */
+static GstBuffer *
+timeshift_read (GstRTSPStream * stream, const TimeshiftEntry * entry)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  GInputStream *in;
+  GstBuffer *buffer;
+  GstMapInfo map;
+  gboolean res;
+
+  buffer = gst_buffer_new_allocate (NULL, entry->size, NULL);
+  gst_buffer_map (buffer, &map, GST_MAP_WRITE);
+  in = g_io_stream_get_input_stream (G_IO_STREAM (priv->timeshift_io));
+  res = g_seekable_seek (G_SEEKABLE (priv->timeshift_io), entry->offset,
+      G_SEEK_SET, NULL, NULL) &&
+      g_input_stream_read_all (in, map.data, map.size, NULL, NULL, NULL);
+  gst_buffer_unmap (buffer, &map);
+
+  if (!res) {
+    GST_WARNING_OBJECT (stream, "failed to read from the time-shift file");
+    gst_buffer_unref (buffer);
+    return NULL;
+  }
+
+  return buffer;
+}
+
+/* Get the entries of the packets that @reader has to send now, they are as
+ * late as they were sent live.
+ * Must be called with timeshift_lock */
+static GArray *
+timeshift_get_entries (GstRTSPStream * stream, TimeshiftReader * reader)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  GArray *entries = NULL;
+  guint64 end;
+
+  end = priv->timeshift_first +
+      gst_queue_array_get_length (priv->timeshift_index);
+
+  if (reader->serial < priv->timeshift_first) {
+    GST_DEBUG_OBJECT (stream, "packets of %" GST_PTR_FORMAT " overwritten",
+        reader->trans);
+    reader->serial = priv->timeshift_first;
+  }
+
+  while (reader->serial < end) {
+    TimeshiftEntry *entry;
+
+    entry = gst_queue_array_peek_nth_struct (priv->timeshift_index,
+        reader->serial - priv->timeshift_first);
+    if (entry->time + reader->delay > priv->timeshift_last)
+      break;
+
+    if (entries == NULL)
+      entries = g_array_new (FALSE, FALSE, sizeof (TimeshiftEntry));
+    g_array_append_val (entries, *entry);
+    reader->serial++;
+  }
+
+  return entries;
+}
+
+/* Send the packets from the past to the time-shifted transports.
+ * Called from the time-shift thread without timeshift_lock */
+static void
+timeshift_serve_readers (GstRTSPStream * stream)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  GPtrArray *transports, *ready, *failed;
+  GList *walk;
+  guint i, j;
+
+  transports = g_ptr_array_new_with_free_func (g_object_unref);
+  ready = g_ptr_array_new_with_free_func (g_object_unref);
+  failed = g_ptr_array_new_with_free_func (g_object_unref);
+
+  g_mutex_lock (&priv->timeshift_lock);
+  for (walk = priv->timeshift_readers; walk; walk = walk->next) {
+    TimeshiftReader *reader = walk->data;
+
+    if (reader->active)
+      g_ptr_array_add (transports, g_object_ref (reader->trans));
+  }
+  g_mutex_unlock (&priv->timeshift_lock);
+
+  for (i = 0; i < transports->len; i++) {
+    GstRTSPStreamTransport *trans = g_ptr_array_index (transports, i);
+    TimeshiftReader *reader;
+    GstBufferList *list = NULL;
+    GArray *entries = NULL;
+
+    g_mutex_lock (&priv->timeshift_lock);
+    if ((reader = timeshift_find_reader (stream, trans)) && reader->active)
+      entries = timeshift_get_entries (stream, reader);
+    g_mutex_unlock (&priv->timeshift_lock);
+
+    if (entries == NULL)
+      continue;
+
+    /* only this thread overwrites the file, the entries stay valid */
+    for (j = 0; j < entries->len; j++) {
+      GstBuffer *buffer;
+
+      buffer = timeshift_read (stream,
+          &g_array_index (entries, TimeshiftEntry, j));
+      if (buffer == NULL)
+        continue;
+      if (list == NULL)
+        list = gst_buffer_list_new_sized (entries->len);
+      gst_buffer_list_add (list, buffer);
+    }
+    g_array_unref (entries);
+
+    if (list == NULL)
+      continue;
+
+    gst_rtsp_stream_transport_lock_backlog (trans);
+    if (gst_rtsp_stream_transport_backlog_push (trans, NULL, list, TRUE))
+      g_ptr_array_add (ready, g_object_ref (trans));
+    else
+      g_ptr_array_add (failed, g_object_ref (trans));
+    gst_rtsp_stream_transport_unlock_backlog (trans);
+  }
+
+  for (i = 0; i < ready->len; i++)
+    check_transport_backlog (stream, g_ptr_array_index (ready, i));
+
+  for (i = 0; i < failed->len; i++) {
+    GstRTSPStreamTransport *trans = g_ptr_array_index (failed, i);
+
+    GST_ERROR_OBJECT (stream, "Dropping slow transport %" GST_PTR_FORMAT,
+        trans);
+    g_mutex_lock (&priv->lock);
+    update_transport (stream, trans, FALSE);
+    g_mutex_unlock (&priv->lock);
+  }
+
+  g_ptr_array_unref (transports);
+  g_ptr_array_unref (ready);
+  g_ptr_array_unref (failed);
+}
+
+/* the time-shift thread, writes the packets of the probe to the file and
+ * sends the packets from the past to the time-shifted transports */
+static gpointer
+timeshift_func (GstRTSPStream * stream)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  TimeshiftPacket *packet;
+  GQueue packets;
+
+  g_mutex_lock (&priv->timeshift_lock);
+  while (priv->timeshift_running) {
+    if (g_queue_is_empty (&priv->timeshift_queue)) {
+      g_cond_wait (&priv->timeshift_cond, &priv->timeshift_lock);
+      continue;
+    }
+
+    packets = priv->timeshift_queue;
+    g_queue_init (&priv->timeshift_queue);
+    g_mutex_unlock (&priv->timeshift_lock);
+
+    while ((packet = g_queue_pop_head (&packets))) {
+      timeshift_add (stream, packet);
+      timeshift_packet_free (packet);
+    }
+    timeshift_serve_readers (stream);
+
+    g_mutex_lock (&priv->timeshift_lock);
+  }
+  g_mutex_unlock (&priv->timeshift_lock);
+
+  return NULL;
+}
+
+/* Stop the time-shift thread.
+ * Must be called without lock */
+static void
+timeshift_stop (GstRTSPStream * stream)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  GThread *thread;
+
+  g_mutex_lock (&priv->timeshift_lock);
+  priv->timeshift_running = FALSE;
+  g_cond_signal (&priv->timeshift_cond);
+  thread = priv->timeshift_thread;
+  priv->timeshift_thread = NULL;
+  g_mutex_unlock (&priv->timeshift_lock);
+
+  if (thread)
+    g_thread_join (thread);
+}
+
+/* must be called with timeshift_lock */
+static void
+timeshift_queue_packet (GstRTSPStream * stream, GstBuffer * buffer,
+    const GstSegment * segment)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  TimeshiftPacket *packet;
+
+  if (priv->timeshift_queue.length >= TIMESHIFT_MAX_QUEUED) {
+    GST_WARNING_OBJECT (stream, "time-shift thread is late, dropping packet");
+    return;
+  }
+
+  packet = g_slice_new (TimeshiftPacket);
+  packet->buffer = gst_buffer_ref (buffer);
+  packet->time = GST_CLOCK_TIME_NONE;
+  if (segment)
+    packet->time = gst_segment_to_running_time (segment, GST_FORMAT_TIME,
+        GST_BUFFER_PTS (buffer));
+  g_queue_push_tail (&priv->timeshift_queue, packet);
+}
+
+/* executed from streaming thread, queues the packets for the time-shift
+ * thread */
+static GstPadProbeReturn
+timeshift_probe (GstPad * pad, GstPadProbeInfo * info, GstRTSPStream * stream)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  const GstSegment *segment = NULL;
+  GstEvent *event;
+  guint i;
+
+  event = gst_pad_get_sticky_event (pad, GST_EVENT_SEGMENT, 0);
+  if (event)
+    gst_event_parse_segment (event, &segment);
+
+  g_mutex_lock (&priv->timeshift_lock);
+  if (!priv->timeshift_running)
+    goto done;
+
+  if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+    timeshift_queue_packet (stream, GST_PAD_PROBE_INFO_BUFFER (info), segment);
+  } else {
+    GstBufferList *list = GST_PAD_PROBE_INFO_BUFFER_LIST (info);
+    guint len = gst_buffer_list_length (list);
+
+    for (i = 0; i < len; i++)
+      timeshift_queue_packet (stream, gst_buffer_list_get (list, i), segment);
+  }
+  g_cond_signal (&priv->timeshift_cond);
+
+done:
+  g_mutex_unlock (&priv->timeshift_lock);
+
+  if (event)
+    gst_event_unref (event);
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* Activate the reader of @trans when it is added to @stream, forget it
+ * when @trans is removed.
+ * Must be called with lock */
+static void
+timeshift_update_reader (GstRTSPStream * stream,
+    GstRTSPStreamTransport * trans, gboolean add)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  TimeshiftReader *reader;
+
+  g_mutex_lock (&priv->timeshift_lock);
+  if ((reader = timeshift_find_reader (stream, trans))) {
+    if (add) {
+      reader->active = TRUE;
+    } else {
+      priv->timeshift_readers =
+          g_list_remove (priv->timeshift_readers, reader);
+      timeshift_reader_free (reader);
+    }
+  }
+  g_mutex_unlock (&priv->timeshift_lock);
+}
+
+/**
+ * gst_rtsp_stream_set_timeshift:
+ * @stream: a #GstRTSPStream
+ * @duration: how long the packets are kept, 0 disables the ring buffer
+ * @max_size: the maximum size of the ring buffer in bytes
+ *
+ * Keep the RTP packets that @stream sent during the last @duration, up to
+ * @max_size bytes, in a ring buffer in a temporary file. Transports can
+ * then receive the packets from the past with
+ * gst_rtsp_stream_timeshift_transport() while the other transports receive
+ * the live packets. This is meant for the streams of live media.
+ *
+ * Needs to be set before the stream is joined to a bin.
+ *
+ * Since: 1.20
+ */
+void
+gst_rtsp_stream_set_timeshift (GstRTSPStream * stream, GstClockTime duration,
+    guint64 max_size)
+{
+  GstRTSPStreamPrivate *priv;
+
+  g_return_if_fail (GST_IS_RTSP_STREAM (stream));
+  g_return_if_fail (GST_CLOCK_TIME_IS_VALID (duration));
+
+  priv = stream->priv;
+
+  g_mutex_lock (&priv->timeshift_lock);
+  priv->timeshift_duration = duration;
+  priv->timeshift_size = max_size;
+  g_mutex_unlock (&priv->timeshift_lock);
+}
+
+/**
+ * gst_rtsp_stream_get_timeshift:
+ * @stream: a #GstRTSPStream
+ * @duration: (out) (allow-none): how long the packets are kept
+ * @max_size: (out) (allow-none): the maximum size of the ring buffer
+ *
+ * Get the limits of the time-shift ring buffer of @stream.
+ *
+ * Since: 1.20
+ */
+void
+gst_rtsp_stream_get_timeshift (GstRTSPStream * stream,
+    GstClockTime * duration, guint64 * max_size)
+{
+  GstRTSPStreamPrivate *priv;
+
+  g_return_if_fail (GST_IS_RTSP_STREAM (stream));
+
+  priv = stream->priv;
+
+  g_mutex_lock (&priv->timeshift_lock);
+  if (duration)
+    *duration = priv->timeshift_duration;
+  if (max_size)
+    *max_size = priv->timeshift_size;
+  g_mutex_unlock (&priv->timeshift_lock);
+}
+
+/**
+ * gst_rtsp_stream_timeshift_transport:
+ * @stream: a #GstRTSPStream
+ * @trans: a #GstRTSPStreamTransport of @stream
+ * @running_time: where to start, #GST_CLOCK_TIME_NONE to return to the
+ *   live packets
+ *
+ * Make @trans receive the packets of @stream from the time-shift ring
+ * buffer, starting at the last keyframe before @running_time. The packets
+ * are sent at the pace they were sent live, @trans then stays behind the
+ * live packets until it is removed from @stream or returned to the live
+ * packets. When the packets of @trans are overwritten in the ring buffer,
+ * it continues with the oldest packets.
+ *
+ * Only transports over TCP can be time-shifted.
+ *
+ * Returns: %TRUE when @trans receives the packets from the ring buffer.
+ *
+ * Since: 1.20
+ */
+gboolean
+gst_rtsp_stream_timeshift_transport (GstRTSPStream * stream,
+    GstRTSPStreamTransport * trans, GstClockTime running_time)
+{
+  GstRTSPStreamPrivate *priv;
+  const GstRTSPTransport *tr;
+  TimeshiftReader *reader;
+  TimeshiftEntry *entry, *start = NULL;
+  gboolean res = FALSE;
+  guint64 serial = 0;
+  guint i, len;
 
-  if (priv->tr_cache_cookie != priv->transports_cookie) {
-    clear_tr_cache (priv);
-    priv->tr_cache =
-        g_ptr_array_new_full (priv->n_tcp_transports, g_object_unref);
+  g_return_val_if_fail (GST_IS_RTSP_STREAM (stream), FALSE);
+  g_return_val_if_fail (GST_IS_RTSP_STREAM_TRANSPORT (trans), FALSE);
 
-    for (walk = priv->transports; walk; walk = g_list_next (walk)) {
-      GstRTSPStreamTransport *tr = (GstRTSPStreamTransport *) walk->data;
-      const GstRTSPTransport *t = gst_rtsp_stream_transport_get_transport (tr);
+  priv = stream->priv;
+  tr = gst_rtsp_stream_transport_get_transport (trans);
 
-      if (t->lower_transport != GST_RTSP_LOWER_TRANS_TCP)
-        continue;
+  g_mutex_lock (&priv->lock);
+  g_mutex_lock (&priv->timeshift_lock);
+  if ((reader = timeshift_find_reader (stream, trans))) {
+    priv->timeshift_readers = g_list_remove (priv->timeshift_readers, reader);
+    timeshift_reader_free (reader);
+    priv->transports_cookie++;
+  }
+
+  if (!GST_CLOCK_TIME_IS_VALID (running_time) ||
+      priv->timeshift_index == NULL ||
+      tr->lower_transport != GST_RTSP_LOWER_TRANS_TCP ||
+      !GST_CLOCK_TIME_IS_VALID (priv->timeshift_last) ||
+      running_time >= priv->timeshift_last)
+    goto done;
 
-      g_ptr_array_add (priv->tr_cache, g_object_ref (tr));
+  /* the last keyframe before running_time, or the first one when the ring
+   * buffer does not go back that far */
+  len = gst_queue_array_get_length (priv->timeshift_index);
+  for (i = 0; i < len; i++) {
+    entry = gst_queue_array_peek_nth_struct (priv->timeshift_index, i);
+    if (start && entry->time > running_time)
+      break;
+    if (entry->keyframe) {
+      start = entry;
+      serial = priv->timeshift_first + i;
     }
-    priv->tr_cache_cookie = priv->transports_cookie;
   }
-}
-
-/* Must be called *without* priv->lock */
-static void
-check_transport_backlog (GstRTSPStream * stream, GstRTSPStreamTransport * trans)
-{
-  GstRTSPStreamPrivate *priv = stream->priv;
-  gboolean send_ret = TRUE;
+  if (start == NULL)
+    goto done;
 
-  gst_rtsp_stream_transport_lock_backlog (trans);
+  reader = g_slice_new0 (TimeshiftReader);
+  reader->trans = g_object_ref (trans);
+  reader->serial = serial;
+  reader->delay = priv->timeshift_last - start->time;
+  reader->active = g_list_find (priv->transports, trans) != NULL;
+  priv->timeshift_readers = g_list_prepend (priv->timeshift_readers, reader);
+  priv->transports_cookie++;
 
-  if (!gst_rtsp_stream_transport_backlog_is_empty (trans)) {
-    GstBuffer *buffer;
-    GstBufferList *buffer_list;
-    gboolean is_rtp;
-    gboolean popped;
+  GST_INFO_OBJECT (stream, "%" GST_PTR_FORMAT " is %" GST_TIME_FORMAT
+      " behind", trans, GST_TIME_ARGS (reader->delay));
+  res = TRUE;
 
-    popped =
-        gst_rtsp_stream_transport_backlog_pop (trans, &buffer, &buffer_list,
-        &is_rtp);
+done:
+  g_mutex_unlock (&priv->timeshift_lock);
+  g_mutex_unlock (&priv->lock);
 
-    g_assert (popped == TRUE);
+  return res;
+}
 
-    send_ret = push_data (stream, trans, buffer, buffer_list, is_rtp);
+/* Get the RTP-Info of the next packet that the time-shifted @trans receives */
+gboolean
+gst_rtsp_stream_get_timeshift_rtpinfo (GstRTSPStream * stream,
+    GstRTSPStreamTransport * trans, guint * rtptime, guint * seq,
+    guint * clock_rate)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  TimeshiftReader *reader;
+  TimeshiftEntry *entry;
+  gboolean found = FALSE;
+  GstCaps *caps;
+  gint rate = 0;
+
+  g_mutex_lock (&priv->timeshift_lock);
+  reader = timeshift_find_reader (stream, trans);
+  if (reader && reader->serial >= priv->timeshift_first &&
+      reader->serial < priv->timeshift_first +
+      gst_queue_array_get_length (priv->timeshift_index)) {
+    entry = gst_queue_array_peek_nth_struct (priv->timeshift_index,
+        reader->serial - priv->timeshift_first);
+    *seq = entry->seq;
+    *rtptime = entry->rtptime;
+    found = TRUE;
+  }
+  g_mutex_unlock (&priv->timeshift_lock);
+
+  if (!found)
+    return FALSE;
 
-    gst_clear_buffer (&buffer);
-    gst_clear_buffer_list (&buffer_list);
+  if ((caps = gst_pad_get_current_caps (priv->send_src[0]))) {
+    gst_structure_get_int (gst_caps_get_structure (caps, 0), "clock-rate",
+        &rate);
+    gst_caps_unref (caps);
   }
+  if (rate == 0)
+    return FALSE;
 
-  gst_rtsp_stream_transport_unlock_backlog (trans);
+  *clock_rate = rate;
 
-  if (!send_ret) {
-    /* remove transport on send error */
-    g_mutex_lock (&priv->lock);
-    update_transport (stream, trans, FALSE);
-    g_mutex_unlock (&priv->lock);
-  }
+  return TRUE;
 }
 
 /* Must be called with priv->lock */
@@ -4048,6 +5578,45 @@ gst_rtsp_stream_join_bin (GstRTSPStream * stream, GstBin * bin,
     priv->caps_sig = g_signal_connect (priv->send_src[0], "notify::caps",
         (GCallback) caps_notify, stream);
     priv->caps = gst_pad_get_current_caps (priv->send_src[0]);
+    /* the bitrate tags go in the SDP */
+    priv->tags_probe = gst_pad_add_probe (priv->srcpad,
+        GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, (GstPadProbeCallback) tags_probe,
+        stream, NULL);
+
+    g_mutex_lock (&priv->gop_lock);
+    if (priv->gop_cache_size > 0) {
+      /* keep the last GOP for new transports */
+      priv->gop_pt = gst_rtsp_stream_get_pt (stream);
+      priv->gop_probe = gst_pad_add_probe (priv->send_src[0],
+          GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST |
+          GST_PAD_PROBE_TYPE_EVENT_FLUSH, (GstPadProbeCallback) gop_cache_probe,
+          stream, NULL);
+    }
+    g_mutex_unlock (&priv->gop_lock);
+
+    /* drop the frames without a keyframe before they are payloaded */
+    if (priv->keyframe_trickmode &&
+        (priv->trickmode_pad =
+            gst_element_get_static_pad (priv->payloader, "sink"))) {
+      priv->trickmode_active = FALSE;
+      priv->trickmode_probe = gst_pad_add_probe (priv->trickmode_pad,
+          GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST |
+          GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM | GST_PAD_PROBE_TYPE_EVENT_FLUSH,
+          (GstPadProbeCallback) trickmode_probe, stream, NULL);
+    }
+
+    g_mutex_lock (&priv->timeshift_lock);
+    if (priv->timeshift_duration > 0 && priv->timeshift_size > 0 &&
+        timeshift_open (stream)) {
+      priv->timeshift_pt = gst_rtsp_stream_get_pt (stream);
+      priv->timeshift_running = TRUE;
+      priv->timeshift_thread = g_thread_new ("rtsp-timeshift",
+          (GThreadFunc) timeshift_func, stream);
+      priv->timeshift_probe = gst_pad_add_probe (priv->send_src[0],
+          GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+          (GstPadProbeCallback) timeshift_probe, stream, NULL);
+    }
+    g_mutex_unlock (&priv->timeshift_lock);
   }
 
   priv->joined_bin = bin;
@@ -4119,6 +5688,8 @@ gst_rtsp_stream_leave_bin (GstRTSPStream * stream, GstBin * bin,
     g_thread_join (priv->send_thread);
   }
 
+  timeshift_stop (stream);
+
   g_mutex_lock (&priv->lock);
   if (priv->joined_bin == NULL)
     goto was_not_joined;
@@ -4149,6 +5720,31 @@ gst_rtsp_stream_leave_bin (GstRTSPStream * stream, GstBin * bin,
     gst_pad_unlink (priv->srcpad, priv->send_rtp_sink);
 
     g_signal_handler_disconnect (priv->send_src[0], priv->caps_sig);
+    gst_pad_remove_probe (priv->srcpad, priv->tags_probe);
+    priv->tags_probe = 0;
+    if (priv->gop_probe) {
+      gst_pad_remove_probe (priv->send_src[0], priv->gop_probe);
+      priv->gop_probe = 0;
+    }
+    if (priv->timeshift_probe) {
+      gst_pad_remove_probe (priv->send_src[0], priv->timeshift_probe);
+      priv->timeshift_probe = 0;
+    }
+    if (priv->trickmode_probe) {
+      gst_pad_remove_probe (priv->trickmode_pad, priv->trickmode_probe);
+      priv->trickmode_probe = 0;
+    }
+    gst_clear_object (&priv->trickmode_pad);
+    g_mutex_lock (&priv->timeshift_lock);
+    timeshift_close (stream);
+    g_mutex_unlock (&priv->timeshift_lock);
+    clear_idle (stream);
+    g_mutex_lock (&priv->gop_lock);
+    gop_cache_clear (stream);
+    priv->gop_valid = FALSE;
+    priv->gop_have_rtptime = FALSE;
+    priv->gop_at_start = FALSE;
+    g_mutex_unlock (&priv->gop_lock);
     gst_element_release_request_pad (rtpbin, priv->send_rtp_sink);
     gst_object_unref (priv->send_rtp_sink);
     priv->send_rtp_sink = NULL;
@@ -4536,6 +6132,25 @@ gst_rtsp_stream_get_caps (GstRTSPStream * stream)
   return result;
 }
 
+/* Get the cookie of the last change of the caps, the control url, the
+ * transport or the addresses of @stream, which all end up in the SDP. */
+guint
+gst_rtsp_stream_get_sdp_cookie (GstRTSPStream * stream)
+{
+  GstRTSPStreamPrivate *priv;
+  guint result;
+
+  g_return_val_if_fail (GST_IS_RTSP_STREAM (stream), 0);
+
+  priv = stream->priv;
+
+  g_mutex_lock (&priv->lock);
+  result = priv->sdp_cookie;
+  g_mutex_unlock (&priv->lock);
+
+  return result;
+}
+
 /**
  * gst_rtsp_stream_recv_rtp:
  * @stream: a #GstRTSPStream
@@ -4692,10 +6307,11 @@ remove_client (GstElement * rtp_sink, GstElement * rtcp_sink,
     g_signal_emit_by_name (rtcp_sink, "remove", host, rtcp_port, NULL);
 }
 
-/* must be called with lock */
+/* must be called with lock. A UDP transport that is added with @hold is
+ * kept out of the udpsink until gop_release_held() */
 static gboolean
-update_transport (GstRTSPStream * stream, GstRTSPStreamTransport * trans,
-    gboolean add)
+update_transport_full (GstRTSPStream * stream, GstRTSPStreamTransport * trans,
+    gboolean add, gboolean hold)
 {
   GstRTSPStreamPrivate *priv = stream->priv;
   const GstRTSPTransport *tr;
@@ -4708,11 +6324,16 @@ update_transport (GstRTSPStream * stream, GstRTSPStreamTransport * trans,
 
   tr_element = g_list_find (priv->transports, trans);
 
+  timeshift_update_reader (stream, trans, add);
+
   if (add && tr_element)
     return TRUE;
   else if (!add && !tr_element)
     return FALSE;
 
+  if (!add)
+    gop_start_remove (stream, trans);
+
   switch (tr->lower_transport) {
     case GST_RTSP_LOWER_TRANS_UDP_MCAST:
     {
@@ -4759,14 +6380,23 @@ update_transport (GstRTSPStream * stream, GstRTSPStreamTransport * trans,
         max = tr->client_port.max;
       }
 
-      if (add) {
+      if (add && hold) {
+        GST_INFO ("holding %s:%d-%d", dest, min, max);
+        priv->gop_held = g_list_prepend (priv->gop_held, trans);
+        priv->transports = g_list_prepend (priv->transports, trans);
+      } else if (add) {
         GST_INFO ("adding %s:%d-%d", dest, min, max);
         add_client (priv->udpsink[0], priv->udpsink[1], dest, min, max);
         priv->transports = g_list_prepend (priv->transports, trans);
       } else {
+        GList *held = g_list_find (priv->gop_held, trans);
+
         GST_INFO ("removing %s:%d-%d", dest, min, max);
         priv->transports = g_list_delete_link (priv->transports, tr_element);
-        remove_client (priv->udpsink[0], priv->udpsink[1], dest, min, max);
+        if (held)
+          priv->gop_held = g_list_delete_link (priv->gop_held, held);
+        else
+          remove_client (priv->udpsink[0], priv->udpsink[1], dest, min, max);
       }
       priv->transports_cookie++;
       break;
@@ -4791,6 +6421,8 @@ update_transport (GstRTSPStream * stream, GstRTSPStreamTransport * trans,
     default:
       goto unknown_transport;
   }
+  update_idle (stream);
+
   return TRUE;
 
   /* ERRORS */
@@ -4805,6 +6437,34 @@ mcast_error:
   }
 }
 
+/* must be called with lock */
+static gboolean
+update_transport (GstRTSPStream * stream, GstRTSPStreamTransport * trans,
+    gboolean add)
+{
+  return update_transport_full (stream, trans, add, FALSE);
+}
+
+/* Add the held UDP transport @trans to the udpsink.
+ * Must be called with lock */
+static void
+gop_release_held (GstRTSPStream * stream, GstRTSPStreamTransport * trans)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  const GstRTSPTransport *tr = gst_rtsp_stream_transport_get_transport (trans);
+  GList *held;
+
+  /* removed while the cached GOP was sent */
+  if (!(held = g_list_find (priv->gop_held, trans)))
+    return;
+
+  priv->gop_held = g_list_delete_link (priv->gop_held, held);
+  GST_INFO ("adding %s:%d-%d", tr->destination, tr->client_port.min,
+      tr->client_port.max);
+  add_client (priv->udpsink[0], priv->udpsink[1], tr->destination,
+      tr->client_port.min, tr->client_port.max);
+}
+
 static void
 on_message_sent (GstRTSPStreamTransport * trans, gpointer user_data)
 {
@@ -4821,6 +6481,246 @@ on_message_sent (GstRTSPStreamTransport * trans, gpointer user_data)
   g_mutex_unlock (&priv->send_lock);
 }
 
+/* Set the minimum @interval between the keyframes that are requested when a
+ * transport is added, GST_CLOCK_TIME_NONE to not request keyframes */
+void
+gst_rtsp_stream_set_force_keyunit_interval (GstRTSPStream * stream,
+    GstClockTime interval)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+
+  g_mutex_lock (&priv->lock);
+  priv->keyunit_interval = interval;
+  g_mutex_unlock (&priv->lock);
+}
+
+void
+gst_rtsp_stream_get_force_keyunit_stats (GstRTSPStream * stream,
+    guint64 * honored, guint64 * suppressed)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+
+  g_mutex_lock (&priv->lock);
+  *honored = priv->keyunit_honored;
+  *suppressed = priv->keyunit_suppressed;
+  g_mutex_unlock (&priv->lock);
+}
+
+/* Check if a keyframe can be requested for a new transport now.
+ * Must be called with lock */
+static gboolean
+check_force_keyunit (GstRTSPStream * stream)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  gint64 now;
+
+  if (!GST_CLOCK_TIME_IS_VALID (priv->keyunit_interval) ||
+      priv->srcpad == NULL)
+    return FALSE;
+
+  now = g_get_monotonic_time ();
+  if (priv->keyunit_last != 0 &&
+      (now - priv->keyunit_last) * GST_USECOND < priv->keyunit_interval) {
+    priv->keyunit_suppressed++;
+    return FALSE;
+  }
+
+  priv->keyunit_last = now;
+  priv->keyunit_honored++;
+
+  return TRUE;
+}
+
+/* executed from streaming thread */
+static GstPadProbeReturn
+idle_probe (GstPad * pad, GstPadProbeInfo * info, GstRTSPStream * stream)
+{
+  return GST_PAD_PROBE_DROP;
+}
+
+/* executed from streaming thread, drops the packets of the payloader until
+ * the first keyframe after the stream resumed */
+static GstPadProbeReturn
+resume_probe (GstPad * pad, GstPadProbeInfo * info, GstRTSPStream * stream)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  GstBuffer *buffer;
+
+  if (info->type & GST_PAD_PROBE_TYPE_BUFFER_LIST)
+    buffer = gst_buffer_list_get (GST_PAD_PROBE_INFO_BUFFER_LIST (info), 0);
+  else
+    buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+
+  if (buffer && GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT))
+    return GST_PAD_PROBE_DROP;
+
+  GST_DEBUG_OBJECT (stream, "resumed at keyframe");
+  g_mutex_lock (&priv->lock);
+  if (priv->resume_probe == info->id)
+    priv->resume_probe = 0;
+  g_mutex_unlock (&priv->lock);
+
+  return GST_PAD_PROBE_REMOVE;
+}
+
+/* Find the pad where the input of the encoder of @stream can be dropped.
+ * Elements with several pads, like tees and demuxers, are not passed
+ * because they also feed other streams. */
+static GstPad *
+find_idle_pad (GstRTSPStream * stream)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  GstElement *element = gst_object_ref (priv->payloader);
+  GstPad *pad = NULL;
+
+  while (element) {
+    GstPad *peer;
+    GstElement *upstream = NULL;
+    const gchar *klass;
+
+    if (element->numsinkpads != 1 ||
+        (element != priv->payloader && element->numsrcpads != 1)) {
+      gst_object_unref (element);
+      break;
+    }
+
+    gst_clear_object (&pad);
+    GST_OBJECT_LOCK (element);
+    pad = gst_object_ref (element->sinkpads->data);
+    GST_OBJECT_UNLOCK (element);
+
+    klass = gst_element_get_metadata (element, GST_ELEMENT_METADATA_KLASS);
+    gst_object_unref (element);
+    if (klass && strstr (klass, "Encoder"))
+      break;
+
+    /* continue through parsers, queues and converters */
+    if ((peer = gst_pad_get_peer (pad))) {
+      upstream = gst_pad_get_parent_element (peer);
+      gst_object_unref (peer);
+    }
+    element = upstream;
+  }
+
+  return pad;
+}
+
+/* Drop the input of the encoder when @stream is gated, or when it has no
+ * transports and is not blocked. When the gate opens or a transport is
+ * added, the data flows again from the next keyframe.
+ * Must be called with priv->lock */
+static void
+update_idle (GstRTSPStream * stream)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  gboolean idle;
+
+  idle = priv->joined_bin != NULL && priv->srcpad != NULL && (priv->gated ||
+      (priv->idle_unused && priv->transports == NULL &&
+          priv->blocked_id[0] == 0));
+
+  if (idle && priv->idle_probe == 0) {
+    if (priv->idle_pad == NULL)
+      priv->idle_pad = find_idle_pad (stream);
+    if (priv->idle_pad == NULL)
+      return;
+
+    GST_DEBUG_OBJECT (stream, "no transports, dropping data at %"
+        GST_PTR_FORMAT, priv->idle_pad);
+    priv->idle_probe = gst_pad_add_probe (priv->idle_pad,
+        GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+        (GstPadProbeCallback) idle_probe, stream, NULL);
+    if (priv->resume_probe) {
+      gst_pad_remove_probe (priv->srcpad, priv->resume_probe);
+      priv->resume_probe = 0;
+    }
+  } else if (!idle && priv->idle_probe != 0) {
+    GST_DEBUG_OBJECT (stream, "resuming data at %" GST_PTR_FORMAT,
+        priv->idle_pad);
+    gst_pad_remove_probe (priv->idle_pad, priv->idle_probe);
+    priv->idle_probe = 0;
+    priv->resume_probe = gst_pad_add_probe (priv->srcpad,
+        GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+        (GstPadProbeCallback) resume_probe, stream, NULL);
+    priv->keyunit_resume = TRUE;
+  }
+}
+
+/* Remove the probes of update_idle().
+ * Must be called with priv->lock */
+static void
+clear_idle (GstRTSPStream * stream)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+
+  if (priv->idle_probe) {
+    gst_pad_remove_probe (priv->idle_pad, priv->idle_probe);
+    priv->idle_probe = 0;
+  }
+  if (priv->resume_probe) {
+    gst_pad_remove_probe (priv->srcpad, priv->resume_probe);
+    priv->resume_probe = 0;
+  }
+  gst_clear_object (&priv->idle_pad);
+  priv->keyunit_resume = FALSE;
+  priv->gated = FALSE;
+}
+
+/* Drop the input of the encoder of @stream while it has no transports.
+ * Only for live pipelines, the data is needed to preroll otherwise. */
+void
+gst_rtsp_stream_set_idle_unused (GstRTSPStream * stream, gboolean idle)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  gboolean keyunit;
+
+  g_mutex_lock (&priv->lock);
+  priv->idle_unused = idle;
+  update_idle (stream);
+  keyunit = priv->keyunit_resume;
+  priv->keyunit_resume = FALSE;
+  g_mutex_unlock (&priv->lock);
+
+  if (keyunit)
+    send_force_keyunit (stream);
+}
+
+/* Drop the input of the encoder of @stream while @gated, for the gate
+ * suspend mode */
+void
+gst_rtsp_stream_set_gated (GstRTSPStream * stream, gboolean gated)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  gboolean keyunit;
+
+  g_mutex_lock (&priv->lock);
+  priv->gated = gated;
+  update_idle (stream);
+  keyunit = priv->keyunit_resume;
+  priv->keyunit_resume = FALSE;
+  g_mutex_unlock (&priv->lock);
+
+  if (keyunit)
+    send_force_keyunit (stream);
+}
+
+/* Must be called *without* priv->lock */
+static void
+send_force_keyunit (GstRTSPStream * stream)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  GstStructure *s;
+
+  s = gst_structure_new ("GstForceKeyUnit",
+      "running-time", GST_TYPE_CLOCK_TIME, GST_CLOCK_TIME_NONE,
+      "all-headers", G_TYPE_BOOLEAN, TRUE,
+      "count", G_TYPE_UINT, 0, NULL);
+
+  GST_DEBUG_OBJECT (stream, "requesting keyframe for new transport");
+  gst_pad_send_event (priv->srcpad,
+      gst_event_new_custom (GST_EVENT_CUSTOM_UPSTREAM, s));
+}
+
 /**
  * gst_rtsp_stream_add_transport:
  * @stream: a #GstRTSPStream
@@ -4841,20 +6741,64 @@ gst_rtsp_stream_add_transport (GstRTSPStream * stream,
     GstRTSPStreamTransport * trans)
 {
   GstRTSPStreamPrivate *priv;
-  gboolean res;
+  const GstRTSPTransport *tr;
+  GstBufferList *gop = NULL;
+  gboolean res, added, hold, keyunit = FALSE, check_backlog = FALSE;
 
   g_return_val_if_fail (GST_IS_RTSP_STREAM (stream), FALSE);
   priv = stream->priv;
   g_return_val_if_fail (GST_IS_RTSP_STREAM_TRANSPORT (trans), FALSE);
   g_return_val_if_fail (priv->joined_bin != NULL, FALSE);
 
+  tr = gst_rtsp_stream_transport_get_transport (trans);
+
   g_mutex_lock (&priv->lock);
-  res = update_transport (stream, trans, TRUE);
+  added = g_list_find (priv->transports, trans) == NULL;
+  /* a new UDP transport only goes to the udpsink after it was sent the
+   * cached GOP, so that no live packets arrive before the cached ones */
+  hold = added && !priv->client_side &&
+      tr->lower_transport == GST_RTSP_LOWER_TRANS_UDP;
+  res = update_transport_full (stream, trans, TRUE, hold);
   if (res)
     gst_rtsp_stream_transport_set_message_sent_full (trans, on_message_sent,
         stream, NULL);
+  /* take the cached GOP after the transport was added, so that the packets
+   * that are not in it are sent live */
+  if (res && added) {
+    gop = gop_cache_get_packets (stream, trans);
+    if (gop)
+      gop_start_add (stream, trans, gst_buffer_list_get (gop, 0));
+    else if (hold)
+      gop_release_held (stream, trans);
+    keyunit = check_force_keyunit (stream);
+  }
+  if (priv->keyunit_resume) {
+    /* the encoder was idle */
+    keyunit = TRUE;
+    priv->keyunit_resume = FALSE;
+  }
+  if (gop && tr->lower_transport == GST_RTSP_LOWER_TRANS_TCP) {
+    /* queue before the live packets that the send thread will add */
+    gst_rtsp_stream_transport_lock_backlog (trans);
+    gst_rtsp_stream_transport_backlog_push (trans, NULL, gop, TRUE);
+    gst_rtsp_stream_transport_unlock_backlog (trans);
+    gop = NULL;
+    check_backlog = TRUE;
+  }
   g_mutex_unlock (&priv->lock);
 
+  if (keyunit)
+    send_force_keyunit (stream);
+
+  if (check_backlog) {
+    check_transport_backlog (stream, trans);
+  } else if (gop) {
+    GST_DEBUG_OBJECT (stream, "sending %u cached packets",
+        gst_buffer_list_length (gop));
+    gop_cache_send_udp (stream, trans, gop);
+    gst_buffer_list_unref (gop);
+  }
+
   return res;
 }
 
@@ -4923,6 +6867,7 @@ gst_rtsp_stream_update_crypto (GstRTSPStream * stream,
         gst_caps_ref (crypto));
   else
     g_hash_table_remove (priv->keys, GINT_TO_POINTER (ssrc));
+  priv->sdp_cookie = gst_rtsp_sdp_next_cookie ();
   g_mutex_unlock (&priv->lock);
 
   return TRUE;
@@ -5302,6 +7247,7 @@ pad_blocking (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
   GstBuffer *buffer = NULL;
   GstPadProbeReturn ret = GST_PAD_PROBE_OK;
   GstEvent *event;
+  gboolean was_blocking;
 
   stream = user_data;
   priv = stream->priv;
@@ -5317,6 +7263,9 @@ pad_blocking (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
       priv->blocked_seqnum = gst_rtp_buffer_get_seq (&rtp);
       priv->blocked_rtptime = gst_rtp_buffer_get_timestamp (&rtp);
       gst_rtp_buffer_unmap (&rtp);
+      /* a dropped packet is not sent, the next one is */
+      if (priv->drop_blocked)
+        priv->blocked_seqnum++;
     }
     priv->position = GST_BUFFER_TIMESTAMP (buffer);
   } else if ((info->type & GST_PAD_PROBE_TYPE_BUFFER_LIST)) {
@@ -5329,6 +7278,8 @@ pad_blocking (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
       priv->blocked_seqnum = gst_rtp_buffer_get_seq (&rtp);
       priv->blocked_rtptime = gst_rtp_buffer_get_timestamp (&rtp);
       gst_rtp_buffer_unmap (&rtp);
+      if (priv->drop_blocked)
+        priv->blocked_seqnum += gst_buffer_list_length (list);
     }
     priv->position = GST_BUFFER_TIMESTAMP (buffer);
   } else if ((info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM)) {
@@ -5364,6 +7315,7 @@ pad_blocking (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
     gst_event_unref (event);
   }
 
+  was_blocking = priv->blocking;
   priv->blocking = TRUE;
 
   GST_DEBUG_OBJECT (pad, "Now blocking");
@@ -5371,6 +7323,15 @@ pad_blocking (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
   GST_DEBUG_OBJECT (stream, "position: %" GST_TIME_FORMAT,
       GST_TIME_ARGS (priv->position));
 
+  if (priv->drop_blocked) {
+    /* the probe does not hold the data, it is called for all of it */
+    ret = GST_PAD_PROBE_DROP;
+    if (was_blocking) {
+      g_mutex_unlock (&priv->lock);
+      goto done;
+    }
+  }
+
   g_mutex_unlock (&priv->lock);
 
   gst_element_post_message (priv->payloader,
@@ -5407,8 +7368,8 @@ set_blocked (GstRTSPStream * stream, gboolean blocked)
         priv->blocked_running_time = GST_CLOCK_TIME_NONE;
         priv->blocked_clock_rate = 0;
         priv->blocked_id[i] = gst_pad_add_probe (priv->send_src[i],
-            GST_PAD_PROBE_TYPE_BLOCK | GST_PAD_PROBE_TYPE_BUFFER |
-            GST_PAD_PROBE_TYPE_BUFFER_LIST |
+            (priv->drop_blocked ? 0 : GST_PAD_PROBE_TYPE_BLOCK) |
+            GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST |
             GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, pad_blocking,
             g_object_ref (stream), g_object_unref);
       }
@@ -5422,6 +7383,7 @@ set_blocked (GstRTSPStream * stream, gboolean blocked)
     }
     priv->blocking = FALSE;
   }
+  update_idle (stream);
 }
 
 /**
@@ -5437,14 +7399,20 @@ gboolean
 gst_rtsp_stream_set_blocked (GstRTSPStream * stream, gboolean blocked)
 {
   GstRTSPStreamPrivate *priv;
+  gboolean keyunit;
 
   g_return_val_if_fail (GST_IS_RTSP_STREAM (stream), FALSE);
 
   priv = stream->priv;
   g_mutex_lock (&priv->lock);
   set_blocked (stream, blocked);
+  keyunit = priv->keyunit_resume;
+  priv->keyunit_resume = FALSE;
   g_mutex_unlock (&priv->lock);
 
+  if (keyunit)
+    send_force_keyunit (stream);
+
   return TRUE;
 }
 
@@ -5462,6 +7430,7 @@ gboolean
 gst_rtsp_stream_unblock_linked (GstRTSPStream * stream)
 {
   GstRTSPStreamPrivate *priv;
+  gboolean keyunit;
 
   g_return_val_if_fail (GST_IS_RTSP_STREAM (stream), FALSE);
 
@@ -5469,8 +7438,13 @@ gst_rtsp_stream_unblock_linked (GstRTSPStream * stream)
   g_mutex_lock (&priv->lock);
   if (priv->send_src[0] && gst_pad_is_linked (priv->send_src[0]))
     set_blocked (stream, FALSE);
+  keyunit = priv->keyunit_resume;
+  priv->keyunit_resume = FALSE;
   g_mutex_unlock (&priv->lock);
 
+  if (keyunit)
+    send_force_keyunit (stream);
+
   return TRUE;
 }
 
@@ -5499,6 +7473,19 @@ gst_rtsp_stream_is_blocking (GstRTSPStream * stream)
   return result;
 }
 
+/* Drop the data that arrives while @stream is blocked instead of holding it,
+ * for sources that must never wait for the media. Must be set before the
+ * stream is blocked. */
+void
+gst_rtsp_stream_set_drop_blocked (GstRTSPStream * stream, gboolean drop)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+
+  g_mutex_lock (&priv->lock);
+  priv->drop_blocked = drop;
+  g_mutex_unlock (&priv->lock);
+}
+
 /**
  * gst_rtsp_stream_query_position:
  * @stream: a #GstRTSPStream
@@ -288,6 +288,34 @@ void              gst_rtsp_stream_set_buffer_size  (GstRTSPStream *stream, guint
 GST_RTSP_SERVER_API
 guint             gst_rtsp_stream_get_buffer_size  (GstRTSPStream *stream);
 
+GST_RTSP_SERVER_API
+void              gst_rtsp_stream_set_gop_cache_size (GstRTSPStream *stream, guint size);
+
+GST_RTSP_SERVER_API
+guint             gst_rtsp_stream_get_gop_cache_size (GstRTSPStream *stream);
+
+GST_RTSP_SERVER_API
+void              gst_rtsp_stream_set_keyframe_trickmode (GstRTSPStream *stream,
+                                                          gboolean keyframes);
+
+GST_RTSP_SERVER_API
+gboolean          gst_rtsp_stream_is_keyframe_trickmode (GstRTSPStream *stream);
+
+GST_RTSP_SERVER_API
+void              gst_rtsp_stream_set_timeshift (GstRTSPStream *stream,
+                                                 GstClockTime duration,
+                                                 guint64 max_size);
+
+GST_RTSP_SERVER_API
+void              gst_rtsp_stream_get_timeshift (GstRTSPStream *stream,
+                                                 GstClockTime *duration,
+                                                 guint64 *max_size);
+
+GST_RTSP_SERVER_API
+gboolean          gst_rtsp_stream_timeshift_transport (GstRTSPStream *stream,
+                                                       GstRTSPStreamTransport *trans,
+                                                       GstClockTime running_time);
+
 GST_RTSP_SERVER_API
 void              gst_rtsp_stream_set_pt_map                 (GstRTSPStream * stream, guint pt, GstCaps * caps);
 
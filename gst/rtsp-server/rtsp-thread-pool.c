@@ -54,6 +54,33 @@
 
 #include "rtsp-thread-pool.h"
 
+/* upper bounds, in microseconds, of the latency histogram buckets. The last
+ * bucket collects everything above the last limit */
+static const gint64 latency_bucket_limits[] = {
+  100, 1000, 10000, 100000, 1000000
+};
+
+#define N_LATENCY_BUCKETS (G_N_ELEMENTS (latency_bucket_limits) + 1)
+
+typedef struct _GstRTSPThreadStats
+{
+  GMutex lock;
+
+  gint64 start_time;
+  guint64 iterations;
+  guint n_fds;
+  guint max_n_fds;
+
+  guint64 dispatches;
+  gint64 dispatch_total;
+  gint64 dispatch_max;
+  guint64 dispatch_histogram[N_LATENCY_BUCKETS];
+
+  gint64 lag_total;
+  gint64 lag_max;
+  guint64 lag_histogram[N_LATENCY_BUCKETS];
+} GstRTSPThreadStats;
+
 typedef struct _GstRTSPThreadImpl
 {
   GstRTSPThread thread;
@@ -62,6 +89,9 @@ typedef struct _GstRTSPThreadImpl
   GSource *source;
   /* FIXME, the source has to be part of GstRTSPThreadImpl, due to a bug in GLib:
    * https://bugzilla.gnome.org/show_bug.cgi?id=720186 */
+
+  /* updated by the thread running the mainloop */
+  GstRTSPThreadStats stats;
 } GstRTSPThreadImpl;
 
 GST_DEFINE_MINI_OBJECT_TYPE (GstRTSPThread, gst_rtsp_thread);
@@ -74,6 +104,7 @@ _gst_rtsp_thread_free (GstRTSPThreadImpl * impl)
   GST_DEBUG ("free thread %p", impl);
 
   g_source_unref (impl->source);
+  g_mutex_clear (&impl->stats.lock);
   g_main_loop_unref (impl->thread.loop);
   g_main_context_unref (impl->thread.context);
   g_slice_free1 (sizeof (GstRTSPThreadImpl), impl);
@@ -103,6 +134,7 @@ gst_rtsp_thread_init (GstRTSPThreadImpl * impl)
       (GstMiniObjectFreeFunction) _gst_rtsp_thread_free);
 
   g_atomic_int_set (&impl->reused, 1);
+  g_mutex_init (&impl->stats.lock);
 }
 
 /**
@@ -187,6 +219,128 @@ gst_rtsp_thread_stop (GstRTSPThread * thread)
     gst_rtsp_thread_unref (thread);
 }
 
+static guint
+latency_bucket (gint64 value)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (latency_bucket_limits); i++) {
+    if (value < latency_bucket_limits[i])
+      break;
+  }
+  return i;
+}
+
+static void
+stats_add_iteration (GstRTSPThreadStats * stats, guint n_fds,
+    gboolean dispatched, gint64 lag, gint64 duration)
+{
+  g_mutex_lock (&stats->lock);
+  stats->iterations++;
+  stats->n_fds = n_fds;
+  stats->max_n_fds = MAX (stats->max_n_fds, n_fds);
+  if (dispatched) {
+    stats->dispatches++;
+    stats->dispatch_total += duration;
+    stats->dispatch_max = MAX (stats->dispatch_max, duration);
+    stats->dispatch_histogram[latency_bucket (duration)]++;
+    stats->lag_total += lag;
+    stats->lag_max = MAX (stats->lag_max, lag);
+    stats->lag_histogram[latency_bucket (lag)]++;
+  }
+  g_mutex_unlock (&stats->lock);
+}
+
+static void
+set_histogram (GstStructure * s, const gchar * fieldname,
+    const guint64 * histogram)
+{
+  GValue array = G_VALUE_INIT;
+  GValue val = G_VALUE_INIT;
+  guint i;
+
+  g_value_init (&array, GST_TYPE_ARRAY);
+  g_value_init (&val, G_TYPE_UINT64);
+  for (i = 0; i < N_LATENCY_BUCKETS; i++) {
+    g_value_set_uint64 (&val, histogram[i]);
+    gst_value_array_append_value (&array, &val);
+  }
+  g_value_unset (&val);
+  gst_structure_take_value (s, fieldname, &array);
+}
+
+/**
+ * gst_rtsp_thread_get_stats:
+ * @thread: a #GstRTSPThread
+ *
+ * Get a snapshot of the statistics collected by the mainloop of @thread.
+ *
+ * The returned structure contains the following fields:
+ *
+ *  * "type" G_TYPE_STRING: "client" or "media"
+ *  * "running-time" G_TYPE_UINT64: time since the mainloop was started
+ *  * "iterations" G_TYPE_UINT64: number of mainloop iterations
+ *  * "n-fds" G_TYPE_UINT: number of file descriptors polled in the last
+ *    iteration, which is a measure of the sources attached to the context
+ *  * "max-n-fds" G_TYPE_UINT: maximum number of file descriptors polled
+ *  * "dispatches" G_TYPE_UINT64: number of iterations that dispatched sources
+ *  * "dispatch-time" G_TYPE_UINT64: total time spent dispatching sources
+ *  * "dispatch-max" G_TYPE_UINT64: longest dispatch
+ *  * "dispatch-histogram" GST_TYPE_ARRAY: number of dispatches that took less
+ *    than 100us, 1ms, 10ms, 100ms, 1s and more than 1s respectively
+ *  * "lag-time" G_TYPE_UINT64: total time between wakeup and dispatch
+ *  * "lag-max" G_TYPE_UINT64: largest time between wakeup and dispatch
+ *  * "lag-histogram" GST_TYPE_ARRAY: wakeup to dispatch times, with the same
+ *    buckets as "dispatch-histogram"
+ *
+ * All times are in nanoseconds. When sources were already ready before the
+ * mainloop could poll, they became ready while the previous iteration was
+ * dispatching and the lag is measured from the previous wakeup, which makes
+ * it an upper bound.
+ *
+ * Returns: (transfer full): a #GstStructure with the statistics of @thread.
+ *
+ * Since: 1.20
+ */
+GstStructure *
+gst_rtsp_thread_get_stats (GstRTSPThread * thread)
+{
+  GstRTSPThreadImpl *impl = (GstRTSPThreadImpl *) thread;
+  GstRTSPThreadStats *stats;
+  GstStructure *s;
+  gint64 running_time;
+
+  g_return_val_if_fail (GST_IS_RTSP_THREAD (thread), NULL);
+
+  stats = &impl->stats;
+
+  g_mutex_lock (&stats->lock);
+  if (stats->start_time != 0)
+    running_time = g_get_monotonic_time () - stats->start_time;
+  else
+    running_time = 0;
+
+  s = gst_structure_new ("application/x-rtsp-thread-stats",
+      "type", G_TYPE_STRING,
+      thread->type == GST_RTSP_THREAD_TYPE_CLIENT ? "client" : "media",
+      "running-time", G_TYPE_UINT64, (guint64) running_time * GST_USECOND,
+      "iterations", G_TYPE_UINT64, stats->iterations,
+      "n-fds", G_TYPE_UINT, stats->n_fds,
+      "max-n-fds", G_TYPE_UINT, stats->max_n_fds,
+      "dispatches", G_TYPE_UINT64, stats->dispatches,
+      "dispatch-time", G_TYPE_UINT64,
+      (guint64) stats->dispatch_total * GST_USECOND,
+      "dispatch-max", G_TYPE_UINT64,
+      (guint64) stats->dispatch_max * GST_USECOND,
+      "lag-time", G_TYPE_UINT64, (guint64) stats->lag_total * GST_USECOND,
+      "lag-max", G_TYPE_UINT64, (guint64) stats->lag_max * GST_USECOND, NULL);
+  set_histogram (s, "dispatch-histogram", stats->dispatch_histogram);
+  set_histogram (s, "lag-histogram", stats->lag_histogram);
+  g_mutex_unlock (&stats->lock);
+
+  return s;
+}
+
 struct _GstRTSPThreadPoolPrivate
 {
   GMutex lock;
@@ -194,6 +348,8 @@ struct _GstRTSPThreadPoolPrivate
   gint max_threads;
   /* currently used mainloops */
   GQueue threads;
+  /* all threads running a mainloop */
+  GQueue running;
 };
 
 #define DEFAULT_MAX_THREADS 1
@@ -265,6 +421,7 @@ gst_rtsp_thread_pool_init (GstRTSPThreadPool * pool)
   g_mutex_init (&priv->lock);
   priv->max_threads = DEFAULT_MAX_THREADS;
   g_queue_init (&priv->threads);
+  g_queue_init (&priv->running);
 }
 
 static void
@@ -276,6 +433,7 @@ gst_rtsp_thread_pool_finalize (GObject * obj)
   GST_INFO ("finalize pool %p", pool);
 
   g_queue_clear (&priv->threads);
+  g_queue_clear (&priv->running);
   g_mutex_clear (&priv->lock);
 
   G_OBJECT_CLASS (gst_rtsp_thread_pool_parent_class)->finalize (obj);
@@ -311,6 +469,71 @@ gst_rtsp_thread_pool_set_property (GObject * object, guint propid,
   }
 }
 
+/* runs the mainloop of @impl like g_main_loop_run() but measures the time
+ * spent in each step of the iterations */
+static void
+run_loop (GstRTSPThreadImpl * impl)
+{
+  GstRTSPThread *thread = GST_RTSP_THREAD_CAST (impl);
+  GMainContext *context = thread->context;
+  GPollFunc poll_func;
+  GPollFD *fds = NULL;
+  gint allocated_fds = 0, n_fds;
+  gint max_priority, timeout;
+  gint64 poll_start, poll_end, wakeup, last_wakeup;
+  gint64 dispatch_start, dispatch_end;
+  gboolean dispatched;
+
+  if (!g_main_context_acquire (context)) {
+    GST_WARNING ("context of thread %p is owned, not collecting stats",
+        thread);
+    g_main_loop_run (thread->loop);
+    return;
+  }
+
+  poll_func = g_main_context_get_poll_func (context);
+
+  g_mutex_lock (&impl->stats.lock);
+  impl->stats.start_time = last_wakeup = g_get_monotonic_time ();
+  g_mutex_unlock (&impl->stats.lock);
+
+  while (g_main_loop_is_running (thread->loop)) {
+    g_main_context_prepare (context, &max_priority);
+
+    while ((n_fds = g_main_context_query (context, max_priority, &timeout,
+                fds, allocated_fds)) > allocated_fds) {
+      g_free (fds);
+      allocated_fds = n_fds;
+      fds = g_new (GPollFD, n_fds);
+    }
+
+    poll_start = g_get_monotonic_time ();
+    if (n_fds || timeout != 0)
+      poll_func (fds, n_fds, timeout);
+    poll_end = g_get_monotonic_time ();
+
+    /* when we did not have to wait, the sources became ready while the
+     * previous iteration was running, measure from its wakeup */
+    if (timeout == 0 || poll_end == poll_start)
+      wakeup = last_wakeup;
+    else
+      wakeup = poll_end;
+
+    dispatched = g_main_context_check (context, max_priority, fds, n_fds);
+    dispatch_start = g_get_monotonic_time ();
+    g_main_context_dispatch (context);
+    dispatch_end = g_get_monotonic_time ();
+
+    stats_add_iteration (&impl->stats, n_fds, dispatched,
+        dispatch_start - wakeup, dispatch_end - dispatch_start);
+
+    last_wakeup = poll_end;
+  }
+
+  g_main_context_release (context);
+  g_free (fds);
+}
+
 static gpointer
 do_loop (GstRTSPThread * thread)
 {
@@ -326,8 +549,12 @@ do_loop (GstRTSPThread * thread)
   if (klass->thread_enter)
     klass->thread_enter (pool, thread);
 
+  g_mutex_lock (&priv->lock);
+  g_queue_push_tail (&priv->running, thread);
+  g_mutex_unlock (&priv->lock);
+
   GST_INFO ("enter mainloop of thread %p", thread);
-  g_main_loop_run (thread->loop);
+  run_loop ((GstRTSPThreadImpl *) thread);
   GST_INFO ("exit mainloop of thread %p", thread);
 
   if (klass->thread_leave)
@@ -335,6 +562,7 @@ do_loop (GstRTSPThread * thread)
 
   g_mutex_lock (&priv->lock);
   g_queue_remove (&priv->threads, thread);
+  g_queue_remove (&priv->running, thread);
   g_mutex_unlock (&priv->lock);
 
   gst_rtsp_thread_unref (thread);
@@ -542,6 +770,51 @@ gst_rtsp_thread_pool_get_thread (GstRTSPThreadPool * pool,
   return result;
 }
 
+/**
+ * gst_rtsp_thread_pool_get_stats:
+ * @pool: a #GstRTSPThreadPool
+ *
+ * Get a snapshot of the statistics of all the mainloops that are currently
+ * running in threads of @pool. The "threads" field of the returned structure
+ * is a #GST_TYPE_ARRAY with the structures returned by
+ * gst_rtsp_thread_get_stats() for each of the threads.
+ *
+ * Returns: (transfer full): a #GstStructure with the statistics of @pool.
+ *
+ * Since: 1.20
+ */
+GstStructure *
+gst_rtsp_thread_pool_get_stats (GstRTSPThreadPool * pool)
+{
+  GstRTSPThreadPoolPrivate *priv;
+  GstStructure *s;
+  GValue array = G_VALUE_INIT;
+  GList *walk;
+
+  g_return_val_if_fail (GST_IS_RTSP_THREAD_POOL (pool), NULL);
+
+  priv = pool->priv;
+
+  g_value_init (&array, GST_TYPE_ARRAY);
+
+  g_mutex_lock (&priv->lock);
+  for (walk = priv->running.head; walk; walk = walk->next) {
+    GstRTSPThread *thread = walk->data;
+    GValue val = G_VALUE_INIT;
+
+    g_value_init (&val, GST_TYPE_STRUCTURE);
+    g_value_take_boxed (&val, gst_rtsp_thread_get_stats (thread));
+    gst_value_array_append_and_take_value (&array, &val);
+  }
+  s = gst_structure_new ("application/x-rtsp-thread-pool-stats",
+      "n-threads", G_TYPE_UINT, g_queue_get_length (&priv->running), NULL);
+  g_mutex_unlock (&priv->lock);
+
+  gst_structure_take_value (s, "threads", &array);
+
+  return s;
+}
+
 /**
  * gst_rtsp_thread_pool_cleanup:
  *
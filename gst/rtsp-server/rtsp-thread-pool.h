@@ -87,6 +87,9 @@ gboolean          gst_rtsp_thread_reuse    (GstRTSPThread * thread);
 GST_RTSP_SERVER_API
 void              gst_rtsp_thread_stop     (GstRTSPThread * thread);
 
+GST_RTSP_SERVER_API
+GstStructure *    gst_rtsp_thread_get_stats (GstRTSPThread * thread);
+
 /**
  * gst_rtsp_thread_ref:
  * @thread: The thread to refcount
@@ -176,6 +179,9 @@ GstRTSPThread *     gst_rtsp_thread_pool_get_thread      (GstRTSPThreadPool *poo
                                                           GstRTSPThreadType type,
                                                           GstRTSPContext *ctx);
 
+GST_RTSP_SERVER_API
+GstStructure *      gst_rtsp_thread_pool_get_stats       (GstRTSPThreadPool *pool);
+
 GST_RTSP_SERVER_API
 void                gst_rtsp_thread_pool_cleanup         (void);
 #ifdef G_DEFINE_AUTOPTR_CLEANUP_FUNC
@@ -0,0 +1,313 @@
+/* GStreamer
+ * Copyright (C) 2021 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+/* A coarse timer wheel with a resolution of one second, shared by everything
+ * that needs a timeout in the same GMainContext. The wheel has one GSource
+ * that ticks every second, adding and removing timers is O(1) and does not
+ * touch the GMainContext.
+ *
+ * Timers are kept in the slot of the tick at which they expire, modulo the
+ * number of slots. Timers that expire further in the future than the number
+ * of slots are skipped until the wheel comes around to their tick.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/gst.h>
+
+#include "rtsp-timer-wheel.h"
+
+GST_DEBUG_CATEGORY_STATIC (rtsp_timer_wheel_debug);
+#define GST_CAT_DEFAULT rtsp_timer_wheel_debug
+
+#define N_SLOTS 64
+
+typedef struct
+{
+  GList link;                   /* in the slot, data points to the timer */
+  guint id;
+  guint64 tick;
+  GstRTSPTimerFunc func;
+  gpointer user_data;
+  GDestroyNotify notify;
+} GstRTSPTimer;
+
+struct _GstRTSPTimerWheel
+{
+  gint ref_count;               /* one for each user and one for the source */
+  gint users;                   /* protected by wheels_lock */
+  GMainContext *context;
+  GSource *source;
+
+  GMutex lock;                  /* protects everything below */
+  gint64 start_time;
+  guint64 tick;
+  GQueue slots[N_SLOTS];
+  GHashTable *timers;           /* id -> GstRTSPTimer */
+  guint next_id;
+};
+
+static GMutex wheels_lock;
+static GHashTable *wheels;      /* GMainContext -> GstRTSPTimerWheel */
+
+static void
+timer_free (GstRTSPTimer * timer)
+{
+  if (timer->notify)
+    timer->notify (timer->user_data);
+  g_slice_free (GstRTSPTimer, timer);
+}
+
+static GstRTSPTimerWheel *
+wheel_ref (GstRTSPTimerWheel * wheel)
+{
+  g_atomic_int_inc (&wheel->ref_count);
+  return wheel;
+}
+
+static void
+wheel_unref (GstRTSPTimerWheel * wheel)
+{
+  GHashTableIter iter;
+  gpointer value;
+
+  if (!g_atomic_int_dec_and_test (&wheel->ref_count))
+    return;
+
+  GST_DEBUG ("free timer wheel %p", wheel);
+
+  g_hash_table_iter_init (&iter, wheel->timers);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    timer_free (value);
+  g_hash_table_unref (wheel->timers);
+  g_mutex_clear (&wheel->lock);
+  g_main_context_unref (wheel->context);
+  g_slice_free (GstRTSPTimerWheel, wheel);
+}
+
+static gboolean
+wheel_tick (GstRTSPTimerWheel * wheel)
+{
+  GList *expired = NULL, *walk;
+  guint64 target;
+
+  g_mutex_lock (&wheel->lock);
+  /* catch up with the ticks we missed when the mainloop was busy */
+  target = (g_get_monotonic_time () - wheel->start_time) / G_USEC_PER_SEC;
+  while (wheel->tick < target) {
+    GQueue *slot;
+    GList *l, *next;
+
+    wheel->tick++;
+    slot = &wheel->slots[wheel->tick % N_SLOTS];
+
+    for (l = slot->head; l; l = next) {
+      GstRTSPTimer *timer = l->data;
+
+      next = l->next;
+      if (timer->tick > wheel->tick)
+        continue;
+
+      g_queue_unlink (slot, l);
+      g_hash_table_remove (wheel->timers, GUINT_TO_POINTER (timer->id));
+      expired = g_list_prepend (expired, timer);
+    }
+  }
+  g_mutex_unlock (&wheel->lock);
+
+  /* in the order in which they expired */
+  expired = g_list_reverse (expired);
+  for (walk = expired; walk; walk = walk->next) {
+    GstRTSPTimer *timer = walk->data;
+
+    GST_LOG ("timer %u expired", timer->id);
+    timer->func (timer->user_data);
+    timer_free (timer);
+  }
+  g_list_free (expired);
+
+  return G_SOURCE_CONTINUE;
+}
+
+/**
+ * gst_rtsp_timer_wheel_get:
+ * @context: (allow-none): a #GMainContext
+ *
+ * Get the timer wheel of @context, creating it when it does not exist
+ * yet. When @context is %NULL, the default context is used.
+ *
+ * Returns: (transfer full): the #GstRTSPTimerWheel of @context, release with
+ * gst_rtsp_timer_wheel_unref().
+ */
+GstRTSPTimerWheel *
+gst_rtsp_timer_wheel_get (GMainContext * context)
+{
+  GstRTSPTimerWheel *wheel;
+  guint i;
+
+  if (context == NULL)
+    context = g_main_context_default ();
+
+  g_mutex_lock (&wheels_lock);
+  if (G_UNLIKELY (wheels == NULL)) {
+    GST_DEBUG_CATEGORY_INIT (rtsp_timer_wheel_debug, "rtsptimerwheel", 0,
+        "GstRTSPTimerWheel");
+    wheels = g_hash_table_new (NULL, NULL);
+  }
+
+  wheel = g_hash_table_lookup (wheels, context);
+  if (wheel) {
+    wheel->users++;
+    wheel_ref (wheel);
+    g_mutex_unlock (&wheels_lock);
+    return wheel;
+  }
+
+  wheel = g_slice_new0 (GstRTSPTimerWheel);
+  /* one ref for the caller and one for the source */
+  wheel->ref_count = 2;
+  wheel->users = 1;
+  wheel->context = g_main_context_ref (context);
+  g_mutex_init (&wheel->lock);
+  wheel->start_time = g_get_monotonic_time ();
+  for (i = 0; i < N_SLOTS; i++)
+    g_queue_init (&wheel->slots[i]);
+  wheel->timers = g_hash_table_new (NULL, NULL);
+
+  wheel->source = g_timeout_source_new_seconds (1);
+  g_source_set_callback (wheel->source, (GSourceFunc) wheel_tick, wheel,
+      (GDestroyNotify) wheel_unref);
+  g_source_attach (wheel->source, context);
+
+  g_hash_table_insert (wheels, context, wheel);
+  g_mutex_unlock (&wheels_lock);
+
+  GST_DEBUG ("new timer wheel %p for context %p", wheel, context);
+
+  return wheel;
+}
+
+/**
+ * gst_rtsp_timer_wheel_unref:
+ * @wheel: (transfer full): a #GstRTSPTimerWheel
+ *
+ * Release a wheel obtained with gst_rtsp_timer_wheel_get(). When the last
+ * user releases the wheel, its source is removed from the context and the
+ * pending timers are released without being called.
+ */
+void
+gst_rtsp_timer_wheel_unref (GstRTSPTimerWheel * wheel)
+{
+  gboolean last;
+
+  g_return_if_fail (wheel != NULL);
+
+  g_mutex_lock (&wheels_lock);
+  last = (--wheel->users == 0);
+  if (last)
+    g_hash_table_remove (wheels, wheel->context);
+  g_mutex_unlock (&wheels_lock);
+
+  if (last) {
+    /* releases the ref of the source after a pending dispatch */
+    g_source_destroy (wheel->source);
+    g_source_unref (wheel->source);
+  }
+  wheel_unref (wheel);
+}
+
+/**
+ * gst_rtsp_timer_wheel_add:
+ * @wheel: a #GstRTSPTimerWheel
+ * @seconds: the timeout in seconds
+ * @func: the function to call when the timer expires
+ * @user_data: data passed to @func
+ * @notify: (allow-none): called with @user_data when the timer is released
+ *
+ * Call @func once, from the context of @wheel, after @seconds. Because the
+ * wheel has a resolution of one second, @func is called between @seconds
+ * and @seconds + 1 seconds from now.
+ *
+ * Returns: the id of the timer, to be used with gst_rtsp_timer_wheel_remove()
+ */
+guint
+gst_rtsp_timer_wheel_add (GstRTSPTimerWheel * wheel, guint seconds,
+    GstRTSPTimerFunc func, gpointer user_data, GDestroyNotify notify)
+{
+  GstRTSPTimer *timer;
+  guint id;
+
+  g_return_val_if_fail (wheel != NULL, 0);
+  g_return_val_if_fail (func != NULL, 0);
+
+  timer = g_slice_new0 (GstRTSPTimer);
+  timer->link.data = timer;
+  timer->func = func;
+  timer->user_data = user_data;
+  timer->notify = notify;
+
+  g_mutex_lock (&wheel->lock);
+  do {
+    timer->id = ++wheel->next_id;
+  } while (timer->id == 0 ||
+      g_hash_table_contains (wheel->timers, GUINT_TO_POINTER (timer->id)));
+  timer->tick = wheel->tick + MAX (seconds, 1);
+  g_queue_push_tail_link (&wheel->slots[timer->tick % N_SLOTS], &timer->link);
+  g_hash_table_insert (wheel->timers, GUINT_TO_POINTER (timer->id), timer);
+  id = timer->id;
+  g_mutex_unlock (&wheel->lock);
+
+  GST_LOG ("added timer %u in %u seconds", id, seconds);
+
+  return id;
+}
+
+/**
+ * gst_rtsp_timer_wheel_remove:
+ * @wheel: a #GstRTSPTimerWheel
+ * @id: the id of a timer
+ *
+ * Remove the timer with @id from @wheel. Nothing happens when the timer
+ * already expired.
+ *
+ * Returns: %TRUE when the timer was removed before it expired.
+ */
+gboolean
+gst_rtsp_timer_wheel_remove (GstRTSPTimerWheel * wheel, guint id)
+{
+  GstRTSPTimer *timer;
+
+  g_return_val_if_fail (wheel != NULL, FALSE);
+
+  g_mutex_lock (&wheel->lock);
+  timer = g_hash_table_lookup (wheel->timers, GUINT_TO_POINTER (id));
+  if (timer) {
+    g_queue_unlink (&wheel->slots[timer->tick % N_SLOTS], &timer->link);
+    g_hash_table_remove (wheel->timers, GUINT_TO_POINTER (id));
+  }
+  g_mutex_unlock (&wheel->lock);
+
+  if (timer == NULL)
+    return FALSE;
+
+  GST_LOG ("removed timer %u", id);
+  timer_free (timer);
+
+  return TRUE;
+}
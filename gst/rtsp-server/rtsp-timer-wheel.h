@@ -0,0 +1,52 @@
+/* GStreamer
+ * Copyright (C) 2021 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_RTSP_TIMER_WHEEL_H__
+#define __GST_RTSP_TIMER_WHEEL_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstRTSPTimerWheel GstRTSPTimerWheel;
+
+/**
+ * GstRTSPTimerFunc:
+ * @user_data: user data passed to gst_rtsp_timer_wheel_add()
+ *
+ * Called from the #GMainContext of the wheel when a timer expires.
+ */
+typedef void (*GstRTSPTimerFunc) (gpointer user_data);
+
+GstRTSPTimerWheel * gst_rtsp_timer_wheel_get    (GMainContext *context);
+
+void                gst_rtsp_timer_wheel_unref  (GstRTSPTimerWheel *wheel);
+
+guint               gst_rtsp_timer_wheel_add    (GstRTSPTimerWheel *wheel,
+                                                 guint seconds,
+                                                 GstRTSPTimerFunc func,
+                                                 gpointer user_data,
+                                                 GDestroyNotify notify);
+
+gboolean            gst_rtsp_timer_wheel_remove (GstRTSPTimerWheel *wheel,
+                                                 guint id);
+
+G_END_DECLS
+
+#endif /* __GST_RTSP_TIMER_WHEEL_H__ */
@@ -1206,6 +1206,307 @@ GST_START_TEST (test_client_sdp_with_no_bitrate_tags)
 
 GST_END_TEST;
 
+static gboolean
+test_response_sdp_body (GstRTSPClient * client, GstRTSPMessage * response,
+    gboolean close, gpointer user_data)
+{
+  gchar **body = user_data;
+  guint8 *data;
+  guint size;
+
+  fail_unless (gst_rtsp_message_get_body (response, &data, &size)
+      == GST_RTSP_OK);
+  g_free (*body);
+  *body = g_strndup ((const gchar *) data, size);
+
+  return TRUE;
+}
+
+static void
+send_describe (GstRTSPClient * client, gchar ** body)
+{
+  GstRTSPMessage request = { 0, };
+  gchar *str;
+
+  fail_unless (gst_rtsp_message_init_request (&request, GST_RTSP_DESCRIBE,
+          "rtsp://localhost/test") == GST_RTSP_OK);
+  str = g_strdup_printf ("%d", cseq);
+  gst_rtsp_message_add_header (&request, GST_RTSP_HDR_CSEQ, str);
+  g_free (str);
+
+  gst_rtsp_client_set_send_func (client, test_response_sdp_body, body, NULL);
+  fail_unless (gst_rtsp_client_handle_message (client,
+          &request) == GST_RTSP_OK);
+  gst_rtsp_message_unset (&request);
+}
+
+static void
+media_constructed_cb (GstRTSPMediaFactory * factory, GstRTSPMedia * media,
+    GstRTSPMedia ** p_media)
+{
+  *p_media = g_object_ref (media);
+}
+
+GST_START_TEST (test_client_sdp_cache)
+{
+  GstRTSPClient *client;
+  GstRTSPMountPoints *mount_points;
+  GstRTSPMediaFactory *factory;
+  GstRTSPMedia *media = NULL;
+  GstStructure *stats;
+  gchar *body1 = NULL, *body2 = NULL;
+  guint64 hits, misses;
+
+  client = setup_client ("videotestsrc "
+      "! video/x-raw,width=352,height=288 ! rtpgstpay name=pay0 pt=96",
+      "/test", TRUE);
+  mount_points = gst_rtsp_client_get_mount_points (client);
+  factory = gst_rtsp_mount_points_match (mount_points, "/test", NULL);
+  g_signal_connect (factory, "media-constructed",
+      G_CALLBACK (media_constructed_cb), &media);
+
+  /* the client keeps the media of the last url, the second DESCRIBE is
+   * answered from the SDP that was serialized for the first one */
+  send_describe (client, &body1);
+  fail_unless (media != NULL);
+  send_describe (client, &body2);
+  fail_unless (body1 != NULL && body2 != NULL);
+  fail_unless_equals_string (body1, body2);
+
+  stats = gst_rtsp_media_get_sdp_cache_stats (media);
+  fail_unless (gst_structure_get_uint64 (stats, "hits", &hits));
+  fail_unless (gst_structure_get_uint64 (stats, "misses", &misses));
+  fail_unless_equals_uint64 (hits, 1);
+  fail_unless_equals_uint64 (misses, 1);
+  gst_structure_free (stats);
+
+  g_free (body1);
+  g_free (body2);
+  g_object_unref (media);
+  g_object_unref (factory);
+  g_object_unref (mount_points);
+  teardown_client (client);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_client_sdp_cache_range)
+{
+  GstRTSPClient *client;
+  GstRTSPMountPoints *mount_points;
+  GstRTSPMediaFactory *factory;
+  GstRTSPMedia *media = NULL;
+  GstRTSPStream *stream;
+  GstRTSPTransport *transport;
+  GstRTSPTimeRange *range;
+  GstStructure *stats;
+  gchar *body1 = NULL, *body2 = NULL, *body3 = NULL;
+  guint64 hits, misses;
+
+  client = setup_client ("videotestsrc "
+      "! video/x-raw,width=352,height=288 ! rtpgstpay name=pay0 pt=96",
+      "/test", TRUE);
+  mount_points = gst_rtsp_client_get_mount_points (client);
+  factory = gst_rtsp_mount_points_match (mount_points, "/test", NULL);
+  g_signal_connect (factory, "media-constructed",
+      G_CALLBACK (media_constructed_cb), &media);
+
+  send_describe (client, &body1);
+  fail_unless (media != NULL);
+  fail_unless (strstr (body1, "a=range:npt=0-") != NULL);
+
+  /* moving the position of the paused media changes the range of the SDP,
+   * the cached SDP is not used anymore */
+  stream = gst_rtsp_media_get_stream (media, 0);
+  fail_unless (gst_rtsp_transport_new (&transport) == GST_RTSP_OK);
+  transport->lower_transport = GST_RTSP_LOWER_TRANS_TCP;
+  fail_unless (gst_rtsp_stream_complete_stream (stream, transport));
+  gst_rtsp_transport_free (transport);
+  fail_unless (gst_rtsp_range_parse ("npt=5.0-", &range) == GST_RTSP_OK);
+  fail_unless (gst_rtsp_media_seek (media, range));
+  gst_rtsp_range_free (range);
+
+  send_describe (client, &body2);
+  fail_unless (strstr (body2, "a=range:npt=5-") != NULL);
+
+  /* and the new one is cached for the new range */
+  send_describe (client, &body3);
+  fail_unless_equals_string (body2, body3);
+
+  stats = gst_rtsp_media_get_sdp_cache_stats (media);
+  fail_unless (gst_structure_get_uint64 (stats, "hits", &hits));
+  fail_unless (gst_structure_get_uint64 (stats, "misses", &misses));
+  fail_unless_equals_uint64 (hits, 1);
+  fail_unless_equals_uint64 (misses, 2);
+  gst_structure_free (stats);
+
+  g_free (body1);
+  g_free (body2);
+  g_free (body3);
+  g_object_unref (media);
+  g_object_unref (factory);
+  g_object_unref (mount_points);
+  teardown_client (client);
+}
+
+GST_END_TEST;
+
+static gboolean
+test_response_503 (GstRTSPClient * client, GstRTSPMessage * response,
+    gboolean close, gpointer user_data)
+{
+  GstRTSPStatusCode code;
+  const gchar *reason;
+  GstRTSPVersion version;
+
+  fail_unless (gst_rtsp_message_get_type (response) ==
+      GST_RTSP_MESSAGE_RESPONSE);
+
+  fail_unless (gst_rtsp_message_parse_response (response, &code, &reason,
+          &version)
+      == GST_RTSP_OK);
+  fail_unless (code == GST_RTSP_STS_SERVICE_UNAVAILABLE);
+  fail_unless (version == GST_RTSP_VERSION_1_0);
+
+  return TRUE;
+}
+
+/* a thread pool that never has a thread for the client */
+typedef GstRTSPThreadPool NoThreadPool;
+typedef GstRTSPThreadPoolClass NoThreadPoolClass;
+
+G_DEFINE_TYPE (NoThreadPool, no_thread_pool, GST_TYPE_RTSP_THREAD_POOL);
+
+static GstRTSPThread *
+no_thread_pool_get_thread (GstRTSPThreadPool * pool, GstRTSPThreadType type,
+    GstRTSPContext * ctx)
+{
+  return NULL;
+}
+
+static void
+no_thread_pool_class_init (NoThreadPoolClass * klass)
+{
+  klass->get_thread = no_thread_pool_get_thread;
+}
+
+static void
+no_thread_pool_init (NoThreadPool * pool)
+{
+}
+
+static void
+media_constructed_collect (GstRTSPMediaFactory * factory,
+    GstRTSPMedia * media, GPtrArray * medias)
+{
+  g_mutex_lock (&check_mutex);
+  g_ptr_array_add (medias, g_object_ref (media));
+  g_mutex_unlock (&check_mutex);
+}
+
+static guint
+get_prewarm_stat (GstRTSPMediaFactory * factory, const gchar * field)
+{
+  GstStructure *stats;
+  guint64 val64;
+  guint val;
+
+  stats = gst_rtsp_media_factory_get_prewarm_stats (factory);
+  fail_unless (stats != NULL);
+  if (!gst_structure_get_uint (stats, field, &val)) {
+    fail_unless (gst_structure_get_uint64 (stats, field, &val64));
+    val = val64;
+  }
+  gst_structure_free (stats);
+
+  return val;
+}
+
+static void
+wait_prewarm_stat (GstRTSPMediaFactory * factory, const gchar * field,
+    guint val)
+{
+  gint i;
+
+  for (i = 0; i < 100; i++) {
+    if (get_prewarm_stat (factory, field) == val)
+      break;
+    g_usleep (50 * G_TIME_SPAN_MILLISECOND);
+  }
+  fail_unless_equals_int (get_prewarm_stat (factory, field), val);
+}
+
+GST_START_TEST (test_client_prewarm_no_thread)
+{
+  GstRTSPClient *client;
+  GstRTSPMountPoints *mount_points;
+  GstRTSPMediaFactory *factory;
+  GstRTSPThreadPool *thread_pool;
+  GstRTSPMessage request = { 0, };
+  GstRTSPMedia *prewarmed = NULL;
+  GPtrArray *medias;
+  gchar *str;
+  guint i;
+
+  client = setup_client ("videotestsrc "
+      "! video/x-raw,width=352,height=288 ! rtpgstpay name=pay0 pt=96",
+      "/test", TRUE);
+  mount_points = gst_rtsp_client_get_mount_points (client);
+  factory = gst_rtsp_mount_points_match (mount_points, "/test", NULL);
+  gst_rtsp_media_factory_set_prewarm_size (factory, 1);
+  medias = g_ptr_array_new_with_free_func (g_object_unref);
+  g_signal_connect (factory, "media-constructed",
+      G_CALLBACK (media_constructed_collect), medias);
+
+  thread_pool = g_object_new (no_thread_pool_get_type (), NULL);
+  gst_rtsp_client_set_thread_pool (client, thread_pool);
+  g_object_unref (thread_pool);
+
+  fail_unless (gst_rtsp_message_init_request (&request, GST_RTSP_DESCRIBE,
+          "rtsp://localhost/test") == GST_RTSP_OK);
+  str = g_strdup_printf ("%d", cseq);
+  gst_rtsp_message_take_header (&request, GST_RTSP_HDR_CSEQ, str);
+  gst_rtsp_client_set_send_func (client, test_response_503, NULL, NULL);
+
+  /* the first request misses the pool and starts filling it */
+  fail_unless (gst_rtsp_client_handle_message (client,
+          &request) == GST_RTSP_OK);
+  wait_prewarm_stat (factory, "available", 1);
+
+  g_mutex_lock (&check_mutex);
+  for (i = 0; i < medias->len; i++) {
+    GstRTSPMedia *media = g_ptr_array_index (medias, i);
+
+    if (gst_rtsp_media_get_status (media) == GST_RTSP_MEDIA_STATUS_PREPARED)
+      prewarmed = g_object_ref (media);
+  }
+  g_mutex_unlock (&check_mutex);
+  fail_unless (prewarmed != NULL);
+
+  /* the second one takes the pre-warmed media, which is unprepared when
+   * the client can't use it */
+  fail_unless (gst_rtsp_client_handle_message (client,
+          &request) == GST_RTSP_OK);
+  fail_unless_equals_int (get_prewarm_stat (factory, "hits"), 1);
+  fail_unless (gst_rtsp_media_get_status (prewarmed) ==
+      GST_RTSP_MEDIA_STATUS_UNPREPARED);
+  gst_rtsp_message_unset (&request);
+
+  wait_prewarm_stat (factory, "pending", 0);
+  gst_rtsp_media_factory_set_prewarm_size (factory, 0);
+
+  g_object_unref (prewarmed);
+  g_signal_handlers_disconnect_by_func (factory, media_constructed_collect,
+      medias);
+  g_ptr_array_unref (medias);
+  g_object_unref (factory);
+  g_object_unref (mount_points);
+  teardown_client (client);
+  gst_rtsp_thread_pool_cleanup ();
+}
+
+GST_END_TEST;
+
 static void
 mcast_transport_two_clients (gboolean shared, const gchar * transport1,
     const gchar * expected_transport1, const gchar * addr1,
@@ -2128,6 +2429,163 @@ GST_START_TEST (test_client_play_root_mount_point)
   test_client_play_sub ("/", "rtsp://localhost/stream=0", "rtsp://localhost");
 }
 
+GST_END_TEST;
+
+static gboolean
+test_response_code (GstRTSPClient * client, GstRTSPMessage * response,
+    gboolean close, gpointer user_data)
+{
+  GstRTSPStatusCode code;
+  const gchar *reason;
+  GstRTSPVersion version;
+
+  fail_unless_equals_int (gst_rtsp_message_get_type (response),
+      GST_RTSP_MESSAGE_RESPONSE);
+
+  fail_unless (gst_rtsp_message_parse_response (response, &code, &reason,
+          &version)
+      == GST_RTSP_OK);
+  fail_unless_equals_int (code, GPOINTER_TO_INT (user_data));
+
+  return TRUE;
+}
+
+static void
+count_media_cb (GstRTSPMediaFactory * factory, GstRTSPMedia * media,
+    guint * n_medias)
+{
+  (*n_medias)++;
+}
+
+/* SETUP of a UDP client on @client_ports, returns its session id */
+static gchar *
+setup_merge_client (GstRTSPClient * client, const gchar * client_ports)
+{
+  GstRTSPConnection *conn;
+  GstRTSPMessage request = { 0, };
+  gchar *str, *pattern, *session;
+
+  create_connection (&conn);
+  fail_unless (gst_rtsp_client_set_connection (client, conn));
+
+  fail_unless (gst_rtsp_message_init_request (&request, GST_RTSP_SETUP,
+          "rtsp://localhost/test/stream=0") == GST_RTSP_OK);
+  str = g_strdup_printf ("%d", cseq);
+  gst_rtsp_message_take_header (&request, GST_RTSP_HDR_CSEQ, str);
+  str = g_strdup_printf ("RTP/AVP;unicast;client_port=%s", client_ports);
+  gst_rtsp_message_take_header (&request, GST_RTSP_HDR_TRANSPORT, str);
+
+  pattern = g_strdup_printf ("RTP/AVP;unicast;client_port=%s;"
+      "server_port=[0-9]+-[0-9]+;ssrc=.*;mode=\"PLAY\"", client_ports);
+  expected_transport = pattern;
+  gst_rtsp_client_set_send_func (client, test_setup_response_200, NULL, NULL);
+  fail_unless (gst_rtsp_client_handle_message (client,
+          &request) == GST_RTSP_OK);
+  gst_rtsp_message_unset (&request);
+  expected_transport = NULL;
+  g_free (pattern);
+
+  session = session_id;
+  session_id = NULL;
+
+  return session;
+}
+
+static void
+send_merge_request (GstRTSPClient * client, GstRTSPMethod method,
+    const gchar * session, const gchar * range, const gchar * scale,
+    GstRTSPStatusCode expected)
+{
+  GstRTSPMessage request = { 0, };
+  gchar *str;
+
+  fail_unless (gst_rtsp_message_init_request (&request, method,
+          "rtsp://localhost/test") == GST_RTSP_OK);
+  str = g_strdup_printf ("%d", cseq);
+  gst_rtsp_message_take_header (&request, GST_RTSP_HDR_CSEQ, str);
+  gst_rtsp_message_add_header (&request, GST_RTSP_HDR_SESSION, session);
+  if (range != NULL)
+    gst_rtsp_message_add_header (&request, GST_RTSP_HDR_RANGE, range);
+  if (scale != NULL)
+    gst_rtsp_message_add_header (&request, GST_RTSP_HDR_SCALE, scale);
+
+  gst_rtsp_client_set_send_func (client, test_response_code,
+      GINT_TO_POINTER (expected), NULL);
+  fail_unless (gst_rtsp_client_handle_message (client,
+          &request) == GST_RTSP_OK);
+  gst_rtsp_message_unset (&request);
+}
+
+/* a second client joins the media of the first one and can't move it, also
+ * when the first client paused it */
+GST_START_TEST (test_client_merge_window)
+{
+  GstRTSPClient *client1, *client2;
+  GstRTSPSessionPool *session_pool;
+  GstRTSPMountPoints *mount_points;
+  GstRTSPMediaFactory *factory;
+  GstRTSPThreadPool *thread_pool;
+  gchar *session1, *session2;
+  guint n_medias = 0;
+
+  mount_points = gst_rtsp_mount_points_new ();
+  factory = gst_rtsp_media_factory_new ();
+  gst_rtsp_media_factory_set_launch (factory,
+      "( videotestsrc ! video/x-raw,width=64,height=48,framerate=25/1 ! "
+      "rtpvrawpay pt=96 name=pay0 )");
+  gst_rtsp_media_factory_set_gop_cache_size (factory, 4 * 1024 * 1024);
+  gst_rtsp_media_factory_set_merge_window (factory, 10 * GST_SECOND);
+  g_signal_connect (factory, "media-constructed", G_CALLBACK (count_media_cb),
+      &n_medias);
+  gst_rtsp_mount_points_add_factory (mount_points, "/test", factory);
+  session_pool = gst_rtsp_session_pool_new ();
+  thread_pool = gst_rtsp_thread_pool_new ();
+
+  client1 = gst_rtsp_client_new ();
+  gst_rtsp_client_set_session_pool (client1, session_pool);
+  gst_rtsp_client_set_mount_points (client1, mount_points);
+  gst_rtsp_client_set_thread_pool (client1, thread_pool);
+  client2 = gst_rtsp_client_new ();
+  gst_rtsp_client_set_session_pool (client2, session_pool);
+  gst_rtsp_client_set_mount_points (client2, mount_points);
+  gst_rtsp_client_set_thread_pool (client2, thread_pool);
+
+  /* the first client plays from the start and fills the GOP cache */
+  session1 = setup_merge_client (client1, "5000-5001");
+  send_merge_request (client1, GST_RTSP_PLAY, session1, "npt=0-", NULL,
+      GST_RTSP_STS_OK);
+  g_usleep (300 * G_TIME_SPAN_MILLISECOND);
+
+  /* the second client gets the same media */
+  session2 = setup_merge_client (client2, "5002-5003");
+  fail_unless_equals_int (n_medias, 1);
+
+  /* the paused first client still counts, the media is not seeked or
+   * played with another rate for the second one */
+  send_merge_request (client1, GST_RTSP_PAUSE, session1, NULL, NULL,
+      GST_RTSP_STS_OK);
+  send_merge_request (client2, GST_RTSP_PLAY, session2, "npt=30-", NULL,
+      GST_RTSP_STS_INVALID_RANGE);
+  send_merge_request (client2, GST_RTSP_PLAY, session2, NULL, "2.0",
+      GST_RTSP_STS_METHOD_NOT_VALID_IN_THIS_STATE);
+
+  /* the GOP cache holds the packets from the start */
+  send_merge_request (client2, GST_RTSP_PLAY, session2, "npt=0-", NULL,
+      GST_RTSP_STS_OK);
+  fail_unless_equals_int (n_medias, 1);
+
+  session_id = session2;
+  send_teardown (client2, "rtsp://localhost/test");
+  session_id = session1;
+  send_teardown (client1, "rtsp://localhost/test");
+
+  teardown_client (client1);
+  teardown_client (client2);
+  g_object_unref (mount_points);
+  g_object_unref (session_pool);
+  g_object_unref (thread_pool);
+}
+
 GST_END_TEST static Suite *
 rtspclient_suite (void)
 {
@@ -2155,6 +2613,9 @@ rtspclient_suite (void)
   tcase_add_test (tc, test_client_sdp_with_bitrate_tag);
   tcase_add_test (tc, test_client_sdp_with_max_bitrate_and_bitrate_tags);
   tcase_add_test (tc, test_client_sdp_with_no_bitrate_tags);
+  tcase_add_test (tc, test_client_sdp_cache);
+  tcase_add_test (tc, test_client_sdp_cache_range);
+  tcase_add_test (tc, test_client_prewarm_no_thread);
   tcase_add_test (tc,
       test_client_multicast_transport_specific_two_clients_shared_media);
   tcase_add_test (tc, test_client_multicast_transport_specific_two_clients);
@@ -2188,6 +2649,7 @@ rtspclient_suite (void)
   tcase_add_test (tc, test_scale_and_speed);
   tcase_add_test (tc, test_client_play);
   tcase_add_test (tc, test_client_play_root_mount_point);
+  tcase_add_test (tc, test_client_merge_window);
 
   return s;
 }
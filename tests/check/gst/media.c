@@ -18,6 +18,7 @@
  */
 
 #include <gst/check/gstcheck.h>
+#include <glib/gstdio.h>
 
 #include <rtsp-media-factory.h>
 
@@ -449,6 +450,755 @@ GST_START_TEST (test_media_prepare)
 
 GST_END_TEST;
 
+static void
+media_prepared_cb (GstRTSPMedia * media, gboolean success, gpointer user_data)
+{
+  gint *result = user_data;
+
+  *result = success ? 1 : 0;
+}
+
+GST_START_TEST (test_media_prepare_async)
+{
+  GstRTSPMediaFactory *factory;
+  GstRTSPMedia *media;
+  GstRTSPUrl *url;
+  GstRTSPThreadPool *pool;
+  GstRTSPThread *thread;
+  GMainContext *context;
+  gint result = -1;
+
+  pool = gst_rtsp_thread_pool_new ();
+  context = g_main_context_new ();
+
+  factory = gst_rtsp_media_factory_new ();
+  fail_unless (gst_rtsp_url_parse ("rtsp://localhost:8554/test",
+          &url) == GST_RTSP_OK);
+
+  gst_rtsp_media_factory_set_launch (factory,
+      "( videotestsrc ! rtpvrawpay pt=96 name=pay0 )");
+
+  media = gst_rtsp_media_factory_construct (factory, url);
+  fail_unless (GST_IS_RTSP_MEDIA (media));
+
+  thread = gst_rtsp_thread_pool_get_thread (pool,
+      GST_RTSP_THREAD_TYPE_MEDIA, NULL);
+  fail_unless (gst_rtsp_media_prepare_async (media, thread, context,
+          media_prepared_cb, &result, NULL));
+  /* the callback is only called from the context */
+  fail_unless_equals_int (result, -1);
+
+  while (result == -1)
+    g_main_context_iteration (context, TRUE);
+  fail_unless_equals_int (result, 1);
+  fail_unless (gst_rtsp_media_get_status (media) ==
+      GST_RTSP_MEDIA_STATUS_PREPARED);
+  fail_unless (media_has_sdp (media));
+
+  /* preparing a prepared media calls the callback in the next iteration */
+  result = -1;
+  fail_unless (gst_rtsp_media_prepare_async (media, NULL, context,
+          media_prepared_cb, &result, NULL));
+  fail_unless_equals_int (result, -1);
+  while (result == -1)
+    g_main_context_iteration (context, TRUE);
+  fail_unless_equals_int (result, 1);
+
+  fail_unless (gst_rtsp_media_unprepare (media));
+  fail_unless (gst_rtsp_media_unprepare (media));
+
+  g_object_unref (media);
+  gst_rtsp_url_free (url);
+  g_object_unref (factory);
+  g_main_context_unref (context);
+
+  g_object_unref (pool);
+  gst_rtsp_thread_pool_cleanup ();
+}
+
+GST_END_TEST;
+
+static guint
+media_sdp_medias_len (GstRTSPMedia * media)
+{
+  GstSDPInfo info;
+  GstSDPMessage *sdp;
+  guint len = 0;
+
+  info.is_ipv6 = FALSE;
+  info.server_ip = "0.0.0.0";
+
+  gst_sdp_message_new (&sdp);
+  if (gst_rtsp_media_setup_sdp (media, sdp, &info))
+    len = gst_sdp_message_medias_len (sdp);
+  gst_sdp_message_free (sdp);
+
+  return len;
+}
+
+static void
+wait_for_status (GstRTSPMedia * media, GstRTSPMediaStatus status)
+{
+  gint64 end_time = g_get_monotonic_time () + 10 * G_TIME_SPAN_SECOND;
+
+  while (gst_rtsp_media_get_status (media) != status &&
+      g_get_monotonic_time () < end_time)
+    g_usleep (10 * G_TIME_SPAN_MILLISECOND);
+  fail_unless (gst_rtsp_media_get_status (media) == status);
+}
+
+GST_START_TEST (test_media_idle_timeout)
+{
+  GstRTSPMediaFactory *factory;
+  GstRTSPMedia *media;
+  GstRTSPUrl *url;
+  GstRTSPThreadPool *pool;
+  GstRTSPThread *thread;
+
+  pool = gst_rtsp_thread_pool_new ();
+
+  factory = gst_rtsp_media_factory_new ();
+  gst_rtsp_media_factory_set_shared (factory, TRUE);
+  gst_rtsp_media_factory_set_idle_timeout (factory, 1);
+  fail_unless_equals_int (gst_rtsp_media_factory_get_idle_timeout (factory),
+      1);
+  fail_unless (gst_rtsp_url_parse ("rtsp://localhost:8554/test",
+          &url) == GST_RTSP_OK);
+
+  gst_rtsp_media_factory_set_launch (factory,
+      "( videotestsrc ! rtpvrawpay pt=96 name=pay0 )");
+
+  media = gst_rtsp_media_factory_construct (factory, url);
+  fail_unless (GST_IS_RTSP_MEDIA (media));
+  fail_unless (gst_rtsp_media_is_reusable (media));
+  fail_unless_equals_int (gst_rtsp_media_get_idle_timeout (media), 1);
+
+  thread = gst_rtsp_thread_pool_get_thread (pool,
+      GST_RTSP_THREAD_TYPE_MEDIA, NULL);
+  fail_unless (gst_rtsp_media_prepare (media, thread));
+  fail_unless_equals_int (media_sdp_medias_len (media), 1);
+
+  /* the media stays prepared after the last user left */
+  fail_unless (gst_rtsp_media_unprepare (media));
+  fail_unless (gst_rtsp_media_get_status (media) ==
+      GST_RTSP_MEDIA_STATUS_PREPARED);
+
+  /* and is used again without preparing it */
+  thread = gst_rtsp_thread_pool_get_thread (pool,
+      GST_RTSP_THREAD_TYPE_MEDIA, NULL);
+  fail_unless (gst_rtsp_media_prepare (media, thread));
+  fail_unless (gst_rtsp_media_unprepare (media));
+
+  /* until it was idle for the timeout */
+  wait_for_status (media, GST_RTSP_MEDIA_STATUS_UNPREPARED);
+
+  /* it is still described from the SDP it had */
+  fail_unless_equals_int (media_sdp_medias_len (media), 1);
+
+  thread = gst_rtsp_thread_pool_get_thread (pool,
+      GST_RTSP_THREAD_TYPE_MEDIA, NULL);
+  fail_unless (gst_rtsp_media_prepare (media, thread));
+  fail_unless (media_has_sdp (media));
+  fail_unless (gst_rtsp_media_unprepare (media));
+  fail_unless (gst_rtsp_media_get_status (media) ==
+      GST_RTSP_MEDIA_STATUS_PREPARED);
+
+  /* unpreparing an idle media unprepares it immediately */
+  fail_unless (gst_rtsp_media_unprepare (media));
+  fail_unless (gst_rtsp_media_get_status (media) ==
+      GST_RTSP_MEDIA_STATUS_UNPREPARED);
+  fail_unless_equals_int (media_sdp_medias_len (media), 0);
+
+  /* the extra unprepare did not release a user of the next preparation */
+  thread = gst_rtsp_thread_pool_get_thread (pool,
+      GST_RTSP_THREAD_TYPE_MEDIA, NULL);
+  fail_unless (gst_rtsp_media_prepare (media, thread));
+  thread = gst_rtsp_thread_pool_get_thread (pool,
+      GST_RTSP_THREAD_TYPE_MEDIA, NULL);
+  fail_unless (gst_rtsp_media_prepare (media, thread));
+  fail_unless (gst_rtsp_media_unprepare (media));
+  g_usleep (2 * G_USEC_PER_SEC);
+  fail_unless (gst_rtsp_media_get_status (media) ==
+      GST_RTSP_MEDIA_STATUS_PREPARED);
+
+  fail_unless (gst_rtsp_media_unprepare (media));
+  wait_for_status (media, GST_RTSP_MEDIA_STATUS_UNPREPARED);
+
+  g_object_unref (media);
+  gst_rtsp_url_free (url);
+  g_object_unref (factory);
+
+  g_object_unref (pool);
+  gst_rtsp_thread_pool_cleanup ();
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_media_keep_live_sdp)
+{
+  GstRTSPMediaFactory *factory;
+  GstRTSPMedia *media, *media2;
+  GstRTSPUrl *url;
+  GstRTSPThreadPool *pool;
+  GstRTSPThread *thread;
+
+  pool = gst_rtsp_thread_pool_new ();
+
+  factory = gst_rtsp_media_factory_new ();
+  gst_rtsp_media_factory_set_shared (factory, TRUE);
+  gst_rtsp_media_factory_set_keep_live_sdp (factory, TRUE);
+  fail_unless (gst_rtsp_media_factory_is_keep_live_sdp (factory));
+  fail_unless (gst_rtsp_url_parse ("rtsp://localhost:8554/test",
+          &url) == GST_RTSP_OK);
+
+  gst_rtsp_media_factory_set_launch (factory,
+      "( videotestsrc is-live=true ! rtpvrawpay pt=96 name=pay0 )");
+
+  /* a new media can't be described before it is prepared */
+  media = gst_rtsp_media_factory_construct (factory, url);
+  fail_unless (GST_IS_RTSP_MEDIA (media));
+  fail_if (gst_rtsp_media_is_reusable (media));
+  fail_unless_equals_int (media_sdp_medias_len (media), 0);
+
+  thread = gst_rtsp_thread_pool_get_thread (pool,
+      GST_RTSP_THREAD_TYPE_MEDIA, NULL);
+  fail_unless (gst_rtsp_media_prepare (media, thread));
+  fail_unless_equals_int (media_sdp_medias_len (media), 1);
+  fail_unless (gst_rtsp_media_unprepare (media));
+  wait_for_status (media, GST_RTSP_MEDIA_STATUS_UNPREPARED);
+
+  /* the next media for the url is described like the last one */
+  media2 = gst_rtsp_media_factory_construct (factory, url);
+  fail_unless (GST_IS_RTSP_MEDIA (media2));
+  fail_unless (media2 != media);
+  fail_unless (gst_rtsp_media_get_status (media2) ==
+      GST_RTSP_MEDIA_STATUS_UNPREPARED);
+  fail_unless_equals_int (media_sdp_medias_len (media2), 1);
+
+  thread = gst_rtsp_thread_pool_get_thread (pool,
+      GST_RTSP_THREAD_TYPE_MEDIA, NULL);
+  fail_unless (gst_rtsp_media_prepare (media2, thread));
+  fail_unless_equals_int (media_sdp_medias_len (media2), 1);
+  fail_unless (gst_rtsp_media_unprepare (media2));
+
+  g_object_unref (media2);
+  g_object_unref (media);
+  gst_rtsp_url_free (url);
+  g_object_unref (factory);
+
+  g_object_unref (pool);
+  gst_rtsp_thread_pool_cleanup ();
+}
+
+GST_END_TEST;
+
+static GstRTSPStreamTransport *
+new_tcp_stream_transport (GstRTSPStream * stream)
+{
+  GstRTSPTransport *transport;
+
+  fail_unless (gst_rtsp_transport_new (&transport) == GST_RTSP_OK);
+  transport->lower_transport = GST_RTSP_LOWER_TRANS_TCP;
+  fail_unless (gst_rtsp_stream_complete_stream (stream, transport));
+
+  return gst_rtsp_stream_transport_new (stream, transport);
+}
+
+GST_START_TEST (test_media_force_keyunit_on_join)
+{
+  GstRTSPMediaFactory *factory;
+  GstRTSPMedia *media;
+  GstRTSPUrl *url;
+  GstRTSPStream *stream;
+  GstRTSPThreadPool *pool;
+  GstRTSPThread *thread;
+  GstRTSPStreamTransport *trans1, *trans2;
+  GstStructure *stats;
+  guint64 honored, suppressed;
+
+  factory = gst_rtsp_media_factory_new ();
+  gst_rtsp_media_factory_set_shared (factory, TRUE);
+  gst_rtsp_media_factory_set_force_keyunit_on_join (factory, TRUE);
+  gst_rtsp_media_factory_set_force_keyunit_interval (factory,
+      60 * GST_SECOND);
+  fail_unless (gst_rtsp_url_parse ("rtsp://localhost:8554/test",
+          &url) == GST_RTSP_OK);
+  gst_rtsp_media_factory_set_launch (factory,
+      "( videotestsrc is-live=true ! rtpvrawpay pt=96 name=pay0 )");
+
+  media = gst_rtsp_media_factory_construct (factory, url);
+  fail_unless (GST_IS_RTSP_MEDIA (media));
+  fail_unless (gst_rtsp_media_is_force_keyunit_on_join (media));
+  fail_unless_equals_uint64 (gst_rtsp_media_get_force_keyunit_interval
+      (media), 60 * GST_SECOND);
+
+  pool = gst_rtsp_thread_pool_new ();
+  thread = gst_rtsp_thread_pool_get_thread (pool,
+      GST_RTSP_THREAD_TYPE_MEDIA, NULL);
+  fail_unless (gst_rtsp_media_prepare (media, thread));
+
+  stream = gst_rtsp_media_get_stream (media, 0);
+  fail_unless (stream != NULL);
+
+  /* the first client gets a keyframe, the second one joins within the
+   * interval and has to wait for it */
+  trans1 = new_tcp_stream_transport (stream);
+  fail_unless (gst_rtsp_stream_transport_set_active (trans1, TRUE));
+  trans2 = new_tcp_stream_transport (stream);
+  fail_unless (gst_rtsp_stream_transport_set_active (trans2, TRUE));
+
+  stats = gst_rtsp_media_get_force_keyunit_stats (media);
+  fail_unless (gst_structure_get_uint64 (stats, "honored", &honored));
+  fail_unless (gst_structure_get_uint64 (stats, "suppressed", &suppressed));
+  fail_unless_equals_uint64 (honored, 1);
+  fail_unless_equals_uint64 (suppressed, 1);
+  gst_structure_free (stats);
+
+  fail_unless (gst_rtsp_stream_transport_set_active (trans1, FALSE));
+  fail_unless (gst_rtsp_stream_transport_set_active (trans2, FALSE));
+  g_object_unref (trans1);
+  g_object_unref (trans2);
+
+  fail_unless (gst_rtsp_media_unprepare (media));
+  g_object_unref (media);
+
+  gst_rtsp_url_free (url);
+  g_object_unref (factory);
+
+  g_object_unref (pool);
+
+  gst_rtsp_thread_pool_cleanup ();
+}
+
+GST_END_TEST;
+
+static GstPadProbeReturn
+count_buffers (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  g_atomic_int_inc ((gint *) user_data);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+add_count_probe (GstElement * bin, const gchar * name, const gchar * padname,
+    gint * count)
+{
+  GstElement *element;
+  GstPad *pad;
+
+  element = gst_bin_get_by_name (GST_BIN (bin), name);
+  fail_unless (element != NULL);
+  pad = gst_element_get_static_pad (element, padname);
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, count_buffers, count,
+      NULL);
+  gst_object_unref (pad);
+  gst_object_unref (element);
+}
+
+/* the streams that are not set up are measured by the number of buffers
+ * that their payloader produces */
+GST_START_TEST (test_media_deactivate_unused_streams)
+{
+  GstRTSPMediaFactory *factory;
+  GstRTSPMedia *media;
+  GstRTSPUrl *url;
+  GstRTSPStream *video, *audio;
+  GstRTSPThreadPool *pool;
+  GstRTSPThread *thread;
+  GstRTSPStreamTransport *trans, *audio_trans;
+  GstElement *bin;
+  gint video_packets = 0, audio_packets = 0;
+  gint last_video, last_audio;
+
+  factory = gst_rtsp_media_factory_new ();
+  gst_rtsp_media_factory_set_deactivate_unused_streams (factory, TRUE);
+  fail_unless (gst_rtsp_url_parse ("rtsp://localhost:8554/test",
+          &url) == GST_RTSP_OK);
+  gst_rtsp_media_factory_set_launch (factory,
+      "( videotestsrc is-live=true ! rtpvrawpay pt=96 name=pay0 "
+      "audiotestsrc is-live=true ! rtpL16pay pt=97 name=pay1 )");
+
+  media = gst_rtsp_media_factory_construct (factory, url);
+  fail_unless (GST_IS_RTSP_MEDIA (media));
+  fail_unless (gst_rtsp_media_is_deactivate_unused_streams (media));
+  fail_unless (gst_rtsp_media_n_streams (media) == 2);
+
+  bin = gst_rtsp_media_get_element (media);
+  add_count_probe (bin, "pay0", "src", &video_packets);
+  add_count_probe (bin, "pay1", "src", &audio_packets);
+
+  pool = gst_rtsp_thread_pool_new ();
+  thread = gst_rtsp_thread_pool_get_thread (pool,
+      GST_RTSP_THREAD_TYPE_MEDIA, NULL);
+  fail_unless (gst_rtsp_media_prepare (media, thread));
+
+  /* only receive the video, the audio stream is not payloaded while its
+   * data is dropped */
+  video = gst_rtsp_media_get_stream (media, 0);
+  audio = gst_rtsp_media_get_stream (media, 1);
+  trans = new_tcp_stream_transport (video);
+  fail_unless (gst_rtsp_stream_transport_set_active (trans, TRUE));
+  fail_unless (gst_rtsp_stream_set_blocked (video, FALSE));
+  fail_unless (gst_rtsp_stream_set_blocked (audio, FALSE));
+
+  /* let the buffers in flight drain */
+  g_usleep (200 * G_TIME_SPAN_MILLISECOND);
+  last_video = g_atomic_int_get (&video_packets);
+  last_audio = g_atomic_int_get (&audio_packets);
+  g_usleep (500 * G_TIME_SPAN_MILLISECOND);
+  fail_unless (g_atomic_int_get (&video_packets) > last_video);
+  fail_unless_equals_int (g_atomic_int_get (&audio_packets), last_audio);
+
+  /* the audio resumes when a client sets it up */
+  audio_trans = new_tcp_stream_transport (audio);
+  fail_unless (gst_rtsp_stream_transport_set_active (audio_trans, TRUE));
+  g_usleep (500 * G_TIME_SPAN_MILLISECOND);
+  fail_unless (g_atomic_int_get (&audio_packets) > last_audio);
+
+  /* and stops again without it */
+  fail_unless (gst_rtsp_stream_transport_set_active (audio_trans, FALSE));
+  g_object_unref (audio_trans);
+  g_usleep (200 * G_TIME_SPAN_MILLISECOND);
+  last_audio = g_atomic_int_get (&audio_packets);
+  g_usleep (500 * G_TIME_SPAN_MILLISECOND);
+  fail_unless_equals_int (g_atomic_int_get (&audio_packets), last_audio);
+
+  /* turning it off resumes the streams */
+  gst_rtsp_media_set_deactivate_unused_streams (media, FALSE);
+  fail_if (gst_rtsp_media_is_deactivate_unused_streams (media));
+  g_usleep (500 * G_TIME_SPAN_MILLISECOND);
+  fail_unless (g_atomic_int_get (&audio_packets) > last_audio);
+
+  fail_unless (gst_rtsp_stream_transport_set_active (trans, FALSE));
+  g_object_unref (trans);
+
+  fail_unless (gst_rtsp_media_unprepare (media));
+  gst_object_unref (bin);
+  g_object_unref (media);
+
+  gst_rtsp_url_free (url);
+  g_object_unref (factory);
+
+  g_object_unref (pool);
+
+  gst_rtsp_thread_pool_cleanup ();
+}
+
+GST_END_TEST;
+
+/* the work that is saved while suspended is measured by the number of
+ * buffers that reach the payloader, the capture keeps running */
+GST_START_TEST (test_media_suspend_gate)
+{
+  GstRTSPMediaFactory *factory;
+  GstRTSPMedia *media;
+  GstRTSPUrl *url;
+  GstRTSPStream *stream;
+  GstRTSPThreadPool *pool;
+  GstRTSPThread *thread;
+  GstRTSPStreamTransport *trans;
+  GstElement *bin;
+  gint captured = 0, payloaded = 0;
+  gint last_captured, last_payloaded;
+
+  factory = gst_rtsp_media_factory_new ();
+  gst_rtsp_media_factory_set_suspend_mode (factory,
+      GST_RTSP_SUSPEND_MODE_GATE);
+  fail_unless (gst_rtsp_url_parse ("rtsp://localhost:8554/test",
+          &url) == GST_RTSP_OK);
+  gst_rtsp_media_factory_set_launch (factory,
+      "( videotestsrc is-live=true name=src ! rtpvrawpay pt=96 name=pay0 )");
+
+  media = gst_rtsp_media_factory_construct (factory, url);
+  fail_unless (GST_IS_RTSP_MEDIA (media));
+  fail_unless (gst_rtsp_media_get_suspend_mode (media) ==
+      GST_RTSP_SUSPEND_MODE_GATE);
+
+  bin = gst_rtsp_media_get_element (media);
+  add_count_probe (bin, "src", "src", &captured);
+  add_count_probe (bin, "pay0", "src", &payloaded);
+
+  pool = gst_rtsp_thread_pool_new ();
+  thread = gst_rtsp_thread_pool_get_thread (pool,
+      GST_RTSP_THREAD_TYPE_MEDIA, NULL);
+  fail_unless (gst_rtsp_media_prepare (media, thread));
+
+  stream = gst_rtsp_media_get_stream (media, 0);
+  trans = new_tcp_stream_transport (stream);
+  fail_unless (gst_rtsp_stream_transport_set_active (trans, TRUE));
+  fail_unless (gst_rtsp_stream_set_blocked (stream, FALSE));
+
+  fail_unless (gst_rtsp_media_suspend (media));
+  fail_unless (gst_rtsp_media_get_status (media) ==
+      GST_RTSP_MEDIA_STATUS_SUSPENDED);
+
+  /* let the buffers in flight drain */
+  g_usleep (200 * G_TIME_SPAN_MILLISECOND);
+  last_captured = g_atomic_int_get (&captured);
+  last_payloaded = g_atomic_int_get (&payloaded);
+  g_usleep (500 * G_TIME_SPAN_MILLISECOND);
+  fail_unless (g_atomic_int_get (&captured) > last_captured);
+  fail_unless_equals_int (g_atomic_int_get (&payloaded), last_payloaded);
+
+  /* the data flows again when unsuspended */
+  fail_unless (gst_rtsp_media_unsuspend (media));
+  fail_unless (gst_rtsp_media_get_status (media) ==
+      GST_RTSP_MEDIA_STATUS_PREPARED);
+  g_usleep (500 * G_TIME_SPAN_MILLISECOND);
+  fail_unless (g_atomic_int_get (&payloaded) > last_payloaded);
+
+  fail_unless (gst_rtsp_stream_transport_set_active (trans, FALSE));
+  g_object_unref (trans);
+
+  fail_unless (gst_rtsp_media_unprepare (media));
+  gst_object_unref (bin);
+  g_object_unref (media);
+
+  gst_rtsp_url_free (url);
+  g_object_unref (factory);
+
+  g_object_unref (pool);
+
+  gst_rtsp_thread_pool_cleanup ();
+}
+
+GST_END_TEST;
+
+static gint timeshift_packets;
+
+static gboolean
+timeshift_send (GstBuffer * buffer, guint8 channel, gpointer user_data)
+{
+  g_atomic_int_inc (&timeshift_packets);
+  gst_rtsp_stream_transport_message_sent (user_data);
+
+  return TRUE;
+}
+
+GST_START_TEST (test_media_timeshift)
+{
+  GstRTSPMediaFactory *factory;
+  GstRTSPMedia *media;
+  GstRTSPUrl *url;
+  GstRTSPStream *stream;
+  GstRTSPThreadPool *pool;
+  GstRTSPThread *thread;
+  GstRTSPStreamTransport *trans;
+  GstRTSPTimeRange *range;
+  GPtrArray *transports;
+  GstClockTime duration;
+  guint64 size;
+  gchar *rtpinfo;
+  gint packets;
+
+  factory = gst_rtsp_media_factory_new ();
+  gst_rtsp_media_factory_set_shared (factory, TRUE);
+  gst_rtsp_media_factory_set_timeshift (factory, 10 * GST_SECOND,
+      16 * 1024 * 1024);
+  fail_unless (gst_rtsp_url_parse ("rtsp://localhost:8554/test",
+          &url) == GST_RTSP_OK);
+  gst_rtsp_media_factory_set_launch (factory,
+      "( videotestsrc is-live=true ! video/x-raw,width=64,height=48 ! "
+      "rtpvrawpay pt=96 name=pay0 )");
+
+  media = gst_rtsp_media_factory_construct (factory, url);
+  fail_unless (GST_IS_RTSP_MEDIA (media));
+  gst_rtsp_media_get_timeshift (media, &duration, &size);
+  fail_unless_equals_uint64 (duration, 10 * GST_SECOND);
+  fail_unless_equals_uint64 (size, 16 * 1024 * 1024);
+
+  pool = gst_rtsp_thread_pool_new ();
+  thread = gst_rtsp_thread_pool_get_thread (pool,
+      GST_RTSP_THREAD_TYPE_MEDIA, NULL);
+  fail_unless (gst_rtsp_media_prepare (media, thread));
+
+  stream = gst_rtsp_media_get_stream (media, 0);
+  trans = new_tcp_stream_transport (stream);
+  gst_rtsp_stream_transport_set_url (trans, url);
+  gst_rtsp_stream_transport_set_callbacks (trans, timeshift_send,
+      timeshift_send, trans, NULL);
+  fail_unless (gst_rtsp_stream_transport_set_active (trans, TRUE));
+  fail_unless (gst_rtsp_stream_set_blocked (stream, FALSE));
+
+  /* fill the ring buffer */
+  g_usleep (500 * G_TIME_SPAN_MILLISECOND);
+
+  transports = g_ptr_array_new ();
+  g_ptr_array_add (transports, trans);
+
+  /* clients that play from the start of a live media get the live
+   * packets */
+  fail_unless (gst_rtsp_range_parse ("npt=0-", &range) == GST_RTSP_OK);
+  fail_if (gst_rtsp_media_seek_timeshift (media, transports, range));
+  gst_rtsp_range_free (range);
+
+  /* a position in the past starts at the oldest keyframe, the packets keep
+   * coming from the past */
+  fail_unless (gst_rtsp_range_parse ("npt=0.1-", &range) == GST_RTSP_OK);
+  fail_unless (gst_rtsp_media_seek_timeshift (media, transports, range));
+  gst_rtsp_range_free (range);
+  rtpinfo = gst_rtsp_stream_transport_get_rtpinfo (trans, GST_CLOCK_TIME_NONE);
+  fail_unless (rtpinfo != NULL);
+  g_free (rtpinfo);
+
+  packets = g_atomic_int_get (&timeshift_packets);
+  g_usleep (300 * G_TIME_SPAN_MILLISECOND);
+  fail_unless (g_atomic_int_get (&timeshift_packets) > packets);
+
+  /* back to the live packets */
+  fail_unless (gst_rtsp_range_parse ("npt=now-", &range) == GST_RTSP_OK);
+  fail_if (gst_rtsp_media_seek_timeshift (media, transports, range));
+  gst_rtsp_range_free (range);
+  g_ptr_array_unref (transports);
+
+  fail_unless (gst_rtsp_stream_transport_set_active (trans, FALSE));
+  g_object_unref (trans);
+
+  fail_unless (gst_rtsp_media_unprepare (media));
+  g_object_unref (media);
+
+  gst_rtsp_url_free (url);
+  g_object_unref (factory);
+
+  g_object_unref (pool);
+
+  gst_rtsp_thread_pool_cleanup ();
+}
+
+GST_END_TEST;
+
+static gboolean
+discard_send (GstBuffer * buffer, guint8 channel, gpointer user_data)
+{
+  gst_rtsp_stream_transport_message_sent (user_data);
+
+  return TRUE;
+}
+
+/* a UDP client that joins a playing media receives the cached GOP first,
+ * starting at the seq of its RTP-Info, and then the live packets in order */
+GST_START_TEST (test_media_gop_cache_replay)
+{
+  GstRTSPMediaFactory *factory;
+  GstRTSPMedia *media;
+  GstRTSPUrl *url;
+  GstRTSPStream *stream;
+  GstRTSPThreadPool *pool;
+  GstRTSPThread *thread;
+  GstRTSPStreamTransport *trans1, *trans2;
+  GstRTSPTransport *transport;
+  GSocket *socket;
+  GSocketAddress *addr;
+  GHashTable *received;
+  gchar *rtpinfo, *seqstr;
+  guint8 data[2048];
+  guint seq, max_seq = 0;
+  gint i;
+
+  factory = gst_rtsp_media_factory_new ();
+  gst_rtsp_media_factory_set_shared (factory, TRUE);
+  gst_rtsp_media_factory_set_gop_cache_size (factory, 1024 * 1024);
+  fail_unless (gst_rtsp_url_parse ("rtsp://localhost:8554/test",
+          &url) == GST_RTSP_OK);
+  gst_rtsp_media_factory_set_launch (factory,
+      "( videotestsrc is-live=true ! "
+      "video/x-raw,width=64,height=48,framerate=10/1 ! "
+      "rtpvrawpay pt=96 mtu=1000 name=pay0 )");
+
+  media = gst_rtsp_media_factory_construct (factory, url);
+  fail_unless (GST_IS_RTSP_MEDIA (media));
+
+  pool = gst_rtsp_thread_pool_new ();
+  thread = gst_rtsp_thread_pool_get_thread (pool,
+      GST_RTSP_THREAD_TYPE_MEDIA, NULL);
+  fail_unless (gst_rtsp_media_prepare (media, thread));
+
+  /* the first client keeps the media playing and fills the cache */
+  stream = gst_rtsp_media_get_stream (media, 0);
+  trans1 = new_tcp_stream_transport (stream);
+  gst_rtsp_stream_transport_set_callbacks (trans1, discard_send,
+      discard_send, trans1, NULL);
+  fail_unless (gst_rtsp_stream_transport_set_active (trans1, TRUE));
+  fail_unless (gst_rtsp_stream_set_blocked (stream, FALSE));
+  g_usleep (500 * G_TIME_SPAN_MILLISECOND);
+
+  socket = g_socket_new (G_SOCKET_FAMILY_IPV4, G_SOCKET_TYPE_DATAGRAM,
+      G_SOCKET_PROTOCOL_UDP, NULL);
+  fail_unless (socket != NULL);
+  addr = g_inet_socket_address_new_from_string ("127.0.0.1", 0);
+  fail_unless (g_socket_bind (socket, addr, FALSE, NULL));
+  g_object_unref (addr);
+  addr = g_socket_get_local_address (socket, NULL);
+  g_socket_set_timeout (socket, 5);
+
+  fail_unless (gst_rtsp_transport_new (&transport) == GST_RTSP_OK);
+  transport->lower_transport = GST_RTSP_LOWER_TRANS_UDP;
+  transport->destination = g_strdup ("127.0.0.1");
+  transport->client_port.min =
+      g_inet_socket_address_get_port (G_INET_SOCKET_ADDRESS (addr));
+  transport->client_port.max = transport->client_port.min + 1;
+  g_object_unref (addr);
+  fail_unless (gst_rtsp_stream_allocate_udp_sockets (stream,
+          G_SOCKET_FAMILY_IPV4, transport, FALSE));
+  fail_unless (gst_rtsp_stream_complete_stream (stream, transport));
+  trans2 = gst_rtsp_stream_transport_new (stream, transport);
+  gst_rtsp_stream_transport_set_url (trans2, url);
+  fail_unless (gst_rtsp_stream_transport_set_active (trans2, TRUE));
+
+  rtpinfo = gst_rtsp_stream_transport_get_rtpinfo (trans2,
+      GST_CLOCK_TIME_NONE);
+  fail_unless (rtpinfo != NULL);
+  seqstr = g_strstr_len (rtpinfo, -1, ";seq=");
+  fail_unless (seqstr != NULL);
+  seq = g_ascii_strtoull (seqstr + 5, NULL, 10);
+  g_free (rtpinfo);
+
+  /* the packets that were in flight when the client was added can arrive
+   * twice, but no packet arrives after a later one */
+  received = g_hash_table_new (NULL, NULL);
+  for (i = 0; i < 50; i++) {
+    gssize len;
+    guint16 rtp_seq;
+
+    len = g_socket_receive (socket, (gchar *) data, sizeof (data), NULL,
+        NULL);
+    fail_unless (len >= 12);
+    rtp_seq = GST_READ_UINT16_BE (data + 2);
+
+    if (i == 0) {
+      fail_unless_equals_int (rtp_seq, seq);
+    } else if ((gint16) (rtp_seq - max_seq) <= 0) {
+      fail_unless (g_hash_table_contains (received,
+              GUINT_TO_POINTER (rtp_seq)));
+      continue;
+    } else {
+      fail_unless_equals_int (rtp_seq, (guint16) (max_seq + 1));
+    }
+    g_hash_table_add (received, GUINT_TO_POINTER (rtp_seq));
+    max_seq = rtp_seq;
+  }
+  g_hash_table_unref (received);
+
+  fail_unless (gst_rtsp_stream_transport_set_active (trans2, FALSE));
+  g_object_unref (trans2);
+  g_object_unref (socket);
+  fail_unless (gst_rtsp_stream_transport_set_active (trans1, FALSE));
+  g_object_unref (trans1);
+
+  fail_unless (gst_rtsp_media_unprepare (media));
+  g_object_unref (media);
+
+  gst_rtsp_url_free (url);
+  g_object_unref (factory);
+
+  g_object_unref (pool);
+
+  gst_rtsp_thread_pool_cleanup ();
+}
+
+GST_END_TEST;
+
 enum _SyncState
 {
   SYNC_STATE_INIT,
@@ -863,19 +1613,219 @@ GST_START_TEST (test_media_multidyn_prepare)
 
 GST_END_TEST;
 
+GST_START_TEST (test_media_keyframe_index)
+{
+  GstRTSPMediaFactory *factory;
+  GstRTSPMedia *media;
+  GstRTSPUrl *url;
+  GstRTSPStream *stream;
+  GstRTSPTimeRange *range;
+  GstRTSPThreadPool *pool;
+  GstRTSPThread *thread;
+  GstRTSPTransport *transport;
+  gchar *location, *str;
+  gint fd;
+
+  /* an index with a keyframe every second */
+  fd = g_file_open_tmp ("rtsp-keyframe-index-XXXXXX", &location, NULL);
+  fail_unless (fd >= 0);
+  g_close (fd, NULL);
+  fail_unless (g_file_set_contents (location,
+          "gst-rtsp-keyframe-index 1\n" "duration -1\n" "0 -1\n"
+          "1000000000 -1\n" "2000000000 -1\n", -1, NULL));
+
+  factory = gst_rtsp_media_factory_new ();
+  fail_unless (gst_rtsp_url_parse ("rtsp://localhost:8554/test",
+          &url) == GST_RTSP_OK);
+  gst_rtsp_media_factory_set_launch (factory,
+      "( videotestsrc ! rtpvrawpay pt=96 name=pay0 )");
+
+  media = gst_rtsp_media_factory_construct (factory, url);
+  fail_unless (GST_IS_RTSP_MEDIA (media));
+  gst_rtsp_media_set_keyframe_index_location (media, location);
+
+  str = gst_rtsp_media_get_keyframe_index_location (media);
+  fail_unless_equals_string (str, location);
+  g_free (str);
+
+  stream = gst_rtsp_media_get_stream (media, 0);
+  fail_unless (stream != NULL);
+
+  pool = gst_rtsp_thread_pool_new ();
+  thread = gst_rtsp_thread_pool_get_thread (pool,
+      GST_RTSP_THREAD_TYPE_MEDIA, NULL);
+
+  fail_unless (gst_rtsp_media_prepare (media, thread));
+
+  fail_unless (gst_rtsp_transport_new (&transport) == GST_RTSP_OK);
+  transport->lower_transport = GST_RTSP_LOWER_TRANS_TCP;
+  fail_unless (gst_rtsp_stream_complete_stream (stream, transport));
+  fail_unless (gst_rtsp_transport_free (transport) == GST_RTSP_OK);
+
+  /* a key unit seek starts at the keyframe before from the index */
+  fail_unless (gst_rtsp_range_parse ("npt=1.5-", &range) == GST_RTSP_OK);
+  fail_unless (gst_rtsp_media_seek_full (media, range,
+          GST_SEEK_FLAG_KEY_UNIT));
+  str = gst_rtsp_media_get_range_string (media, FALSE, GST_RTSP_RANGE_NPT);
+  fail_unless_equals_string (str, "npt=1-");
+  g_free (str);
+
+  /* and after it when asked */
+  fail_unless (gst_rtsp_media_seek_full (media, range,
+          GST_SEEK_FLAG_KEY_UNIT | GST_SEEK_FLAG_SNAP_AFTER));
+  str = gst_rtsp_media_get_range_string (media, FALSE, GST_RTSP_RANGE_NPT);
+  fail_unless_equals_string (str, "npt=2-");
+  g_free (str);
+
+  /* an accurate seek does not use the index */
+  fail_unless (gst_rtsp_media_seek_full (media, range, GST_SEEK_FLAG_ACCURATE));
+  str = gst_rtsp_media_get_range_string (media, FALSE, GST_RTSP_RANGE_NPT);
+  fail_unless_equals_string (str, "npt=1.5-");
+  g_free (str);
+  gst_rtsp_range_free (range);
+
+  fail_unless (gst_rtsp_media_unprepare (media));
+  g_object_unref (media);
+
+  gst_rtsp_url_free (url);
+  g_object_unref (factory);
+  g_object_unref (pool);
+
+  g_unlink (location);
+  g_free (location);
+
+  gst_rtsp_thread_pool_cleanup ();
+}
+
+GST_END_TEST;
+static gchar *
+keyframe_index_seek (const gchar * location, const gchar * index_location)
+{
+  GstRTSPMediaFactory *factory;
+  GstRTSPMedia *media;
+  GstRTSPUrl *url;
+  GstRTSPStream *stream;
+  GstRTSPTimeRange *range;
+  GstRTSPThreadPool *pool;
+  GstRTSPThread *thread;
+  GstRTSPTransport *transport;
+  gchar *launch, *str;
+
+  factory = gst_rtsp_media_factory_new ();
+  fail_unless (gst_rtsp_url_parse ("rtsp://localhost:8554/test",
+          &url) == GST_RTSP_OK);
+  launch = g_strdup_printf ("( filesrc location=\"%s\" ! wavparse ! "
+      "audioconvert ! rtpL16pay pt=96 name=pay0 )", location);
+  gst_rtsp_media_factory_set_launch (factory, launch);
+  g_free (launch);
+
+  media = gst_rtsp_media_factory_construct (factory, url);
+  fail_unless (GST_IS_RTSP_MEDIA (media));
+  gst_rtsp_media_set_keyframe_index_location (media, index_location);
+  stream = gst_rtsp_media_get_stream (media, 0);
+  fail_unless (stream != NULL);
+
+  pool = gst_rtsp_thread_pool_new ();
+  thread = gst_rtsp_thread_pool_get_thread (pool,
+      GST_RTSP_THREAD_TYPE_MEDIA, NULL);
+  fail_unless (gst_rtsp_media_prepare (media, thread));
+
+  fail_unless (gst_rtsp_transport_new (&transport) == GST_RTSP_OK);
+  transport->lower_transport = GST_RTSP_LOWER_TRANS_TCP;
+  fail_unless (gst_rtsp_stream_complete_stream (stream, transport));
+  fail_unless (gst_rtsp_transport_free (transport) == GST_RTSP_OK);
+
+  fail_unless (gst_rtsp_range_parse ("npt=1.5-", &range) == GST_RTSP_OK);
+  fail_unless (gst_rtsp_media_seek_full (media, range,
+          GST_SEEK_FLAG_KEY_UNIT));
+  gst_rtsp_range_free (range);
+  str = gst_rtsp_media_get_range_string (media, FALSE, GST_RTSP_RANGE_NPT);
+
+  fail_unless (gst_rtsp_media_unprepare (media));
+  g_object_unref (media);
+  gst_rtsp_url_free (url);
+  g_object_unref (factory);
+  g_object_unref (pool);
+  gst_rtsp_thread_pool_cleanup ();
+
+  return str;
+}
+
+/* an index is only used for the file that was indexed */
+GST_START_TEST (test_media_keyframe_index_source)
+{
+  GstElement *pipeline;
+  GstMessage *msg;
+  GStatBuf st;
+  gchar *dir, *location, *index_location, *desc, *contents, *str;
+
+  dir = g_dir_make_tmp ("rtsp-keyframe-index-XXXXXX", NULL);
+  fail_unless (dir != NULL);
+  location = g_build_filename (dir, "test.wav", NULL);
+  index_location = g_build_filename (dir, "test.idx", NULL);
+
+  desc = g_strdup_printf ("audiotestsrc num-buffers=200 ! wavenc ! "
+      "filesink location=\"%s\"", location);
+  pipeline = gst_parse_launch (desc, NULL);
+  g_free (desc);
+  fail_unless (pipeline != NULL);
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  msg = gst_bus_timed_pop_filtered (GST_ELEMENT_BUS (pipeline),
+      GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+  fail_unless (g_stat (location, &st) == 0);
+
+  /* an index of the file snaps the seek to its keyframes */
+  contents = g_strdup_printf ("gst-rtsp-keyframe-index 1\n"
+      "duration -1\n" "source %" G_GUINT64_FORMAT " %" G_GINT64_FORMAT "\n"
+      "0 -1\n" "1000000000 -1\n" "2000000000 -1\n", (guint64) st.st_size,
+      (gint64) st.st_mtime);
+  fail_unless (g_file_set_contents (index_location, contents, -1, NULL));
+  g_free (contents);
+  str = keyframe_index_seek (location, index_location);
+  fail_unless_equals_string (str, "npt=1-");
+  g_free (str);
+
+  /* an index of another version of the file is not used */
+  contents = g_strdup_printf ("gst-rtsp-keyframe-index 1\n"
+      "duration -1\n" "source %" G_GUINT64_FORMAT " %" G_GINT64_FORMAT "\n"
+      "0 -1\n" "1000000000 -1\n" "2000000000 -1\n",
+      (guint64) st.st_size + 1, (gint64) st.st_mtime);
+  fail_unless (g_file_set_contents (index_location, contents, -1, NULL));
+  g_free (contents);
+  str = keyframe_index_seek (location, index_location);
+  fail_if (g_strcmp0 (str, "npt=1-") == 0);
+  g_free (str);
+
+  g_unlink (index_location);
+  g_unlink (location);
+  g_rmdir (dir);
+  g_free (index_location);
+  g_free (location);
+  g_free (dir);
+}
+
+GST_END_TEST;
 
 static Suite *
 rtspmedia_suite (void)
 {
   Suite *s = suite_create ("rtspmedia");
   TCase *tc = tcase_create ("general");
-  gboolean has_avidemux;
+  gboolean has_avidemux, has_wav;
 
   suite_add_tcase (s, tc);
   tcase_set_timeout (tc, 20);
 
   has_avidemux = gst_registry_check_feature_version (gst_registry_get (),
       "avidemux", GST_VERSION_MAJOR, GST_VERSION_MINOR, 0);
+  has_wav = gst_registry_check_feature_version (gst_registry_get (),
+      "wavenc", GST_VERSION_MAJOR, GST_VERSION_MINOR, 0) &&
+      gst_registry_check_feature_version (gst_registry_get (),
+      "wavparse", GST_VERSION_MAJOR, GST_VERSION_MINOR, 0);
 
   tcase_add_test (tc, test_media_seek);
   tcase_add_test (tc, test_media_seek_no_sinks);
@@ -887,6 +1837,17 @@ rtspmedia_suite (void)
   }
   tcase_add_test (tc, test_media);
   tcase_add_test (tc, test_media_prepare);
+  tcase_add_test (tc, test_media_prepare_async);
+  tcase_add_test (tc, test_media_idle_timeout);
+  tcase_add_test (tc, test_media_keep_live_sdp);
+  tcase_add_test (tc, test_media_force_keyunit_on_join);
+  tcase_add_test (tc, test_media_deactivate_unused_streams);
+  tcase_add_test (tc, test_media_suspend_gate);
+  tcase_add_test (tc, test_media_timeshift);
+  tcase_add_test (tc, test_media_gop_cache_replay);
+  tcase_add_test (tc, test_media_keyframe_index);
+  if (has_wav)
+    tcase_add_test (tc, test_media_keyframe_index_source);
   tcase_add_test (tc, test_media_shared_race_test_unsuspend_vs_set_state_null);
   tcase_add_test (tc, test_media_reusable);
   tcase_add_test (tc, test_media_dyn_prepare);
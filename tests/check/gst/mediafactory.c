@@ -18,8 +18,13 @@
  */
 
 #include <gst/check/gstcheck.h>
+#include <glib/gstdio.h>
 
 #include <rtsp-media-factory.h>
+#include <rtsp-media-factory-uri.h>
+#include <rtsp-media-factory-relay.h>
+#include <rtsp-media-factory-push.h>
+#include <rtsp-server.h>
 
 GST_START_TEST (test_parse_error)
 {
@@ -95,6 +100,241 @@ GST_START_TEST (test_launch_construct)
 
 GST_END_TEST;
 
+#define BENCH_CONSTRUCTS 200
+
+static gint64
+bench_construct (GstRTSPMediaFactory * factory, const GstRTSPUrl * url)
+{
+  gint64 start;
+  guint i;
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < BENCH_CONSTRUCTS; i++) {
+    GstRTSPMedia *media = gst_rtsp_media_factory_construct (factory, url);
+
+    fail_unless (GST_IS_RTSP_MEDIA (media));
+    g_object_unref (media);
+  }
+  return g_get_monotonic_time () - start;
+}
+
+GST_START_TEST (test_launch_template)
+{
+  const gchar *launch = "( videotestsrc pattern=ball num-buffers=5 ! "
+      "video/x-raw,width=320 ! tee name=t ! queue ! "
+      "rtpvrawpay pt=97 name=pay0 t. ! queue ! fakesink )";
+  GstRTSPMediaFactory *factory;
+  GstElement *element, *element2, *src, *pay;
+  GstRTSPMedia *media;
+  GstRTSPUrl *url;
+  gint pattern, num_buffers;
+  guint pt;
+
+  factory = gst_rtsp_media_factory_new ();
+  fail_unless (gst_rtsp_url_parse ("rtsp://localhost:8554/test",
+          &url) == GST_RTSP_OK);
+  gst_rtsp_media_factory_set_launch (factory, launch);
+
+  /* every element is a new clone of the template with the same properties */
+  element = gst_rtsp_media_factory_create_element (factory, url);
+  element2 = gst_rtsp_media_factory_create_element (factory, url);
+  fail_unless (GST_IS_BIN (element));
+  fail_unless (GST_IS_BIN (element2));
+  fail_if (element == element2);
+  fail_if (GST_OBJECT_PARENT (element) != NULL);
+
+  src = gst_bin_get_by_name (GST_BIN (element2), "videotestsrc0");
+  fail_unless (src != NULL);
+  g_object_get (src, "pattern", &pattern, "num-buffers", &num_buffers, NULL);
+  fail_unless_equals_int (pattern, 18);
+  fail_unless_equals_int (num_buffers, 5);
+  gst_object_unref (src);
+
+  pay = gst_bin_get_by_name (GST_BIN (element2), "pay0");
+  fail_unless (pay != NULL);
+  g_object_get (pay, "pt", &pt, NULL);
+  fail_unless_equals_int (pt, 97);
+  fail_unless (gst_pad_is_linked (GST_ELEMENT_CAST (pay)->sinkpads->data));
+  gst_object_unref (pay);
+
+  gst_object_unref (gst_object_ref_sink (element));
+  gst_object_unref (gst_object_ref_sink (element2));
+
+  media = gst_rtsp_media_factory_construct (factory, url);
+  fail_unless (GST_IS_RTSP_MEDIA (media));
+  fail_unless_equals_int (gst_rtsp_media_n_streams (media), 1);
+  g_object_unref (media);
+
+  gst_rtsp_url_free (url);
+  g_object_unref (factory);
+}
+
+GST_END_TEST;
+
+/* compare with parsing the launch line for each media like before */
+GST_START_TEST (test_launch_template_benchmark)
+{
+  const gchar *launch = "( videotestsrc pattern=ball num-buffers=5 ! "
+      "video/x-raw,width=320 ! tee name=t ! queue ! "
+      "rtpvrawpay pt=97 name=pay0 t. ! queue ! fakesink )";
+  GstRTSPMediaFactory *factory;
+  GstElement *element;
+  GstRTSPUrl *url;
+  gint64 parse_time, clone_time, start;
+  guint i;
+
+  factory = gst_rtsp_media_factory_new ();
+  fail_unless (gst_rtsp_url_parse ("rtsp://localhost:8554/test",
+          &url) == GST_RTSP_OK);
+  gst_rtsp_media_factory_set_launch (factory, launch);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < BENCH_CONSTRUCTS; i++) {
+    element = gst_parse_launch_full (launch, NULL,
+        GST_PARSE_FLAG_PLACE_IN_BIN, NULL);
+    fail_unless (element != NULL);
+    gst_object_unref (gst_object_ref_sink (element));
+  }
+  parse_time = g_get_monotonic_time () - start;
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < BENCH_CONSTRUCTS; i++) {
+    element = gst_rtsp_media_factory_create_element (factory, url);
+    fail_unless (element != NULL);
+    gst_object_unref (gst_object_ref_sink (element));
+  }
+  clone_time = g_get_monotonic_time () - start;
+
+  g_print ("%u elements: parsed in %" G_GINT64_FORMAT " us, cloned in %"
+      G_GINT64_FORMAT " us\n", BENCH_CONSTRUCTS, parse_time, clone_time);
+  g_print ("%u media constructed in %" G_GINT64_FORMAT " us\n",
+      BENCH_CONSTRUCTS, bench_construct (factory, url));
+  fail_unless (clone_time < parse_time);
+
+  gst_rtsp_url_free (url);
+  g_object_unref (factory);
+}
+
+GST_END_TEST;
+
+/* an element with a property that can only be set, like some elements have */
+typedef struct
+{
+  GstElement element;
+  gint secret;
+} TestWriteOnly;
+
+typedef struct
+{
+  GstElementClass element_class;
+} TestWriteOnlyClass;
+
+GType test_write_only_get_type (void);
+
+G_DEFINE_TYPE (TestWriteOnly, test_write_only, GST_TYPE_ELEMENT);
+
+static void
+test_write_only_set_property (GObject * object, guint propid,
+    const GValue * value, GParamSpec * pspec)
+{
+  ((TestWriteOnly *) object)->secret = g_value_get_int (value);
+}
+
+static void
+test_write_only_class_init (TestWriteOnlyClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->set_property = test_write_only_set_property;
+  g_object_class_install_property (gobject_class, 1,
+      g_param_spec_int ("secret", "Secret", "Secret", 0, G_MAXINT, 0,
+          G_PARAM_WRITABLE | G_PARAM_STATIC_STRINGS));
+  gst_element_class_set_static_metadata (GST_ELEMENT_CLASS (klass),
+      "Test write only", "Testing", "Test write only", "GStreamer");
+}
+
+static void
+test_write_only_init (TestWriteOnly * self)
+{
+}
+
+GST_START_TEST (test_launch_template_unreadable)
+{
+  GstRTSPMediaFactory *factory;
+  GstElement *element, *element2, *test, *test2;
+  GstRTSPUrl *url;
+
+  fail_unless (gst_element_register (NULL, "testwriteonly", GST_RANK_NONE,
+          test_write_only_get_type ()));
+
+  factory = gst_rtsp_media_factory_new ();
+  fail_unless (gst_rtsp_url_parse ("rtsp://localhost:8554/test",
+          &url) == GST_RTSP_OK);
+
+  /* a clone would lose the property, the launch line is parsed for every
+   * element and the elements get new names */
+  gst_rtsp_media_factory_set_launch (factory,
+      "( videotestsrc ! rtpvrawpay pt=96 name=pay0 testwriteonly secret=5 )");
+
+  element = gst_rtsp_media_factory_create_element (factory, url);
+  element2 = gst_rtsp_media_factory_create_element (factory, url);
+  fail_unless (GST_IS_BIN (element));
+  fail_unless (GST_IS_BIN (element2));
+
+  test = gst_bin_get_by_name (GST_BIN (element), "testwriteonly0");
+  fail_unless (test != NULL);
+  test2 = gst_bin_get_by_name (GST_BIN (element2), "testwriteonly0");
+  fail_unless (test2 == NULL);
+  gst_object_unref (test);
+
+  test2 = gst_bin_get_by_name (GST_BIN (element2), "testwriteonly1");
+  fail_unless (test2 != NULL);
+  fail_unless_equals_int (((TestWriteOnly *) test2)->secret, 5);
+  gst_object_unref (test2);
+
+  gst_object_unref (gst_object_ref_sink (element));
+  gst_object_unref (gst_object_ref_sink (element2));
+
+  gst_rtsp_url_free (url);
+  g_object_unref (factory);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_launch_template_delayed)
+{
+  GstRTSPMediaFactory *factory;
+  GstElement *element, *element2, *pay;
+  GstRTSPUrl *url;
+
+  factory = gst_rtsp_media_factory_new ();
+  fail_unless (gst_rtsp_url_parse ("rtsp://localhost:8554/test",
+          &url) == GST_RTSP_OK);
+
+  /* the link from decodebin is only made when its pad is added, this can't
+   * be cloned and the launch line is parsed for every element */
+  gst_rtsp_media_factory_set_launch (factory,
+      "( videotestsrc ! decodebin ! rtpvrawpay name=pay0 )");
+
+  element = gst_rtsp_media_factory_create_element (factory, url);
+  element2 = gst_rtsp_media_factory_create_element (factory, url);
+  fail_unless (GST_IS_BIN (element));
+  fail_unless (GST_IS_BIN (element2));
+  fail_if (element == element2);
+
+  pay = gst_bin_get_by_name (GST_BIN (element2), "pay0");
+  fail_unless (pay != NULL);
+  gst_object_unref (pay);
+
+  gst_object_unref (gst_object_ref_sink (element));
+  gst_object_unref (gst_object_ref_sink (element2));
+
+  gst_rtsp_url_free (url);
+  g_object_unref (factory);
+}
+
+GST_END_TEST;
+
 GST_START_TEST (test_shared)
 {
   GstRTSPMediaFactory *factory;
@@ -133,6 +373,74 @@ GST_START_TEST (test_shared)
 
 GST_END_TEST;
 
+#define N_CONSTRUCT_THREADS 8
+
+typedef struct
+{
+  GstRTSPMediaFactory *factory;
+  GstRTSPUrl *url;
+  GstRTSPMedia *media;
+} ConstructData;
+
+static gpointer
+construct_thread (ConstructData * data)
+{
+  data->media = gst_rtsp_media_factory_construct (data->factory, data->url);
+  return NULL;
+}
+
+static void
+media_constructed_cb (GstRTSPMediaFactory * factory, GstRTSPMedia * media,
+    gint * n_constructed)
+{
+  g_atomic_int_inc (n_constructed);
+}
+
+GST_START_TEST (test_shared_concurrent_construct)
+{
+  GstRTSPMediaFactory *factory;
+  GstRTSPUrl *url;
+  ConstructData data[N_CONSTRUCT_THREADS];
+  GThread *threads[N_CONSTRUCT_THREADS];
+  gint n_constructed = 0;
+  gint i;
+
+  factory = gst_rtsp_media_factory_new ();
+  gst_rtsp_media_factory_set_shared (factory, TRUE);
+  g_signal_connect (factory, "media-constructed",
+      G_CALLBACK (media_constructed_cb), &n_constructed);
+
+  fail_unless (gst_rtsp_url_parse ("rtsp://localhost:8554/test",
+          &url) == GST_RTSP_OK);
+
+  gst_rtsp_media_factory_set_launch (factory,
+      "( videotestsrc ! rtpvrawpay pt=96 name=pay0 )");
+
+  for (i = 0; i < N_CONSTRUCT_THREADS; i++) {
+    data[i].factory = factory;
+    data[i].url = url;
+    data[i].media = NULL;
+    threads[i] = g_thread_new ("construct", (GThreadFunc) construct_thread,
+        &data[i]);
+  }
+  for (i = 0; i < N_CONSTRUCT_THREADS; i++)
+    g_thread_join (threads[i]);
+
+  /* only one media was constructed and everybody got it */
+  fail_unless_equals_int (n_constructed, 1);
+  for (i = 0; i < N_CONSTRUCT_THREADS; i++) {
+    fail_unless (GST_IS_RTSP_MEDIA (data[i].media));
+    fail_unless (data[i].media == data[0].media);
+  }
+  for (i = 0; i < N_CONSTRUCT_THREADS; i++)
+    g_object_unref (data[i].media);
+
+  gst_rtsp_url_free (url);
+  g_object_unref (factory);
+}
+
+GST_END_TEST;
+
 GST_START_TEST (test_addresspool)
 {
   GstRTSPMediaFactory *factory;
@@ -280,6 +588,196 @@ GST_START_TEST (test_permissions)
 
 GST_END_TEST;
 
+static guint
+get_prewarm_stat (GstRTSPMediaFactory * factory, const gchar * field)
+{
+  GstStructure *stats;
+  guint64 val64;
+  guint val;
+
+  stats = gst_rtsp_media_factory_get_prewarm_stats (factory);
+  fail_unless (stats != NULL);
+  if (!gst_structure_get_uint (stats, field, &val)) {
+    fail_unless (gst_structure_get_uint64 (stats, field, &val64));
+    val = val64;
+  }
+  gst_structure_free (stats);
+
+  return val;
+}
+
+GST_START_TEST (test_prewarm)
+{
+  GstRTSPMediaFactory *factory;
+  GstRTSPMedia *media, *media2;
+  GstRTSPUrl *url;
+  gint i;
+
+  factory = gst_rtsp_media_factory_new ();
+  fail_if (gst_rtsp_media_factory_is_shared (factory));
+  g_object_set (factory, "prewarm-size", 2, NULL);
+  fail_unless_equals_int (gst_rtsp_media_factory_get_prewarm_size (factory),
+      2);
+
+  fail_unless (gst_rtsp_url_parse ("rtsp://localhost:8554/test",
+          &url) == GST_RTSP_OK);
+
+  gst_rtsp_media_factory_set_launch (factory,
+      "( videotestsrc ! rtpvrawpay pt=96 name=pay0 )");
+
+  /* the first request misses and starts filling the pool */
+  media = gst_rtsp_media_factory_construct (factory, url);
+  fail_unless (GST_IS_RTSP_MEDIA (media));
+  fail_unless_equals_int (get_prewarm_stat (factory, "misses"), 1);
+
+  for (i = 0; i < 100; i++) {
+    if (get_prewarm_stat (factory, "available") == 2)
+      break;
+    g_usleep (50 * G_TIME_SPAN_MILLISECOND);
+  }
+  fail_unless_equals_int (get_prewarm_stat (factory, "available"), 2);
+
+  /* the next request gets a prepared media */
+  media2 = gst_rtsp_media_factory_construct (factory, url);
+  fail_unless (GST_IS_RTSP_MEDIA (media2));
+  fail_unless (media2 != media);
+  fail_unless_equals_int (get_prewarm_stat (factory, "hits"), 1);
+  fail_unless (gst_rtsp_media_get_status (media2) ==
+      GST_RTSP_MEDIA_STATUS_PREPARED);
+
+  fail_unless (gst_rtsp_media_prepare (media2, NULL));
+  fail_unless (gst_rtsp_media_unprepare (media2));
+  fail_unless (gst_rtsp_media_get_status (media2) ==
+      GST_RTSP_MEDIA_STATUS_UNPREPARED);
+  g_object_unref (media2);
+  g_object_unref (media);
+
+  /* wait for the refill before releasing the pool */
+  for (i = 0; i < 100; i++) {
+    if (get_prewarm_stat (factory, "pending") == 0)
+      break;
+    g_usleep (50 * G_TIME_SPAN_MILLISECOND);
+  }
+  gst_rtsp_media_factory_set_prewarm_size (factory, 0);
+  fail_unless_equals_int (get_prewarm_stat (factory, "available"), 0);
+
+  gst_rtsp_url_free (url);
+  g_object_unref (factory);
+
+  gst_rtsp_thread_pool_cleanup ();
+}
+
+GST_END_TEST;
+
+static gboolean
+discard_send (GstBuffer * buffer, guint8 channel, gpointer user_data)
+{
+  gst_rtsp_stream_transport_message_sent (user_data);
+
+  return TRUE;
+}
+
+GST_START_TEST (test_merge_window)
+{
+  GstRTSPMediaFactory *factory;
+  GstRTSPMedia *media, *media2, *media3;
+  GstRTSPUrl *url;
+  GstRTSPStream *stream;
+  GstRTSPTransport *transport;
+  GstRTSPStreamTransport *trans;
+  GPtrArray *transports;
+
+  factory = gst_rtsp_media_factory_new ();
+  fail_if (gst_rtsp_media_factory_is_shared (factory));
+  gst_rtsp_media_factory_set_gop_cache_size (factory, 4 * 1024 * 1024);
+  g_object_set (factory, "merge-window", 10 * GST_SECOND, NULL);
+  fail_unless (gst_rtsp_media_factory_get_merge_window (factory) ==
+      10 * GST_SECOND);
+
+  fail_unless (gst_rtsp_url_parse ("rtsp://localhost:8554/test",
+          &url) == GST_RTSP_OK);
+
+  gst_rtsp_media_factory_set_launch (factory,
+      "( videotestsrc ! video/x-raw,width=64,height=48,framerate=25/1 ! "
+      "rtpvrawpay pt=96 name=pay0 )");
+
+  media = gst_rtsp_media_factory_construct (factory, url);
+  fail_unless (GST_IS_RTSP_MEDIA (media));
+  fail_if (gst_rtsp_media_is_shared (media));
+  fail_unless (gst_rtsp_media_get_merge_window (media) == 10 * GST_SECOND);
+
+  /* an unprepared media can't be joined */
+  media2 = gst_rtsp_media_factory_construct (factory, url);
+  fail_unless (GST_IS_RTSP_MEDIA (media2));
+  fail_unless (media2 != media);
+  g_object_unref (media2);
+
+  /* nor can a prepared media that did not send packets yet, the GOP cache
+   * doesn't hold its start */
+  fail_unless (gst_rtsp_media_prepare (media, NULL));
+  media2 = gst_rtsp_media_factory_construct (factory, url);
+  fail_unless (media2 != media);
+  g_object_unref (media2);
+
+  stream = gst_rtsp_media_get_stream (media, 0);
+  fail_unless (gst_rtsp_transport_new (&transport) == GST_RTSP_OK);
+  transport->lower_transport = GST_RTSP_LOWER_TRANS_TCP;
+  transport->interleaved.min = 0;
+  transport->interleaved.max = 1;
+  fail_unless (gst_rtsp_stream_complete_stream (stream, transport));
+  trans = gst_rtsp_stream_transport_new (stream, transport);
+  gst_rtsp_stream_transport_set_callbacks (trans, discard_send, discard_send,
+      trans, NULL);
+  transports = g_ptr_array_new ();
+  g_ptr_array_add (transports, trans);
+  fail_unless (gst_rtsp_media_set_state (media, GST_STATE_PLAYING,
+          transports));
+  g_usleep (300 * G_TIME_SPAN_MILLISECOND);
+
+  /* the next client joins the playing media at its start */
+  media2 = gst_rtsp_media_factory_construct (factory, url);
+  fail_unless (media2 == media);
+  fail_unless (gst_rtsp_media_is_shared (media2));
+  fail_unless (gst_rtsp_media_prepare (media2, NULL));
+
+  /* without a window every client gets its own media */
+  gst_rtsp_media_factory_set_merge_window (factory, 0);
+  media3 = gst_rtsp_media_factory_construct (factory, url);
+  fail_unless (media3 != media);
+  g_object_unref (media3);
+  gst_rtsp_media_factory_set_merge_window (factory, 10 * GST_SECOND);
+
+  /* nor when the GOP cache lost the start */
+  gst_rtsp_media_set_gop_cache_size (media, 0);
+  media3 = gst_rtsp_media_factory_construct (factory, url);
+  fail_unless (media3 != media);
+  g_object_unref (media3);
+
+  fail_unless (gst_rtsp_media_set_state (media, GST_STATE_NULL, transports));
+  g_ptr_array_unref (transports);
+  g_object_unref (trans);
+
+  fail_unless (gst_rtsp_media_unprepare (media2));
+  g_object_unref (media2);
+  fail_unless (gst_rtsp_media_unprepare (media));
+  fail_unless (gst_rtsp_media_get_status (media) ==
+      GST_RTSP_MEDIA_STATUS_UNPREPARED);
+  g_object_unref (media);
+
+  /* the unprepared media is forgotten */
+  media = gst_rtsp_media_factory_construct (factory, url);
+  fail_unless (GST_IS_RTSP_MEDIA (media));
+  fail_if (gst_rtsp_media_is_shared (media));
+  g_object_unref (media);
+
+  gst_rtsp_url_free (url);
+  g_object_unref (factory);
+
+  gst_rtsp_thread_pool_cleanup ();
+}
+
+GST_END_TEST;
+
 GST_START_TEST (test_reset)
 {
   GstRTSPMediaFactory *factory;
@@ -420,6 +918,676 @@ GST_START_TEST (test_allow_bind_mcast)
 
 GST_END_TEST;
 
+static void
+add_cache_record (GByteArray * array, guint8 type, guint8 flags,
+    GstClockTime time, const guint8 * data, guint size)
+{
+  guint8 header[16] = { 0, };
+
+  header[0] = type;
+  header[2] = flags;
+  GST_WRITE_UINT32_BE (header + 4, size);
+  GST_WRITE_UINT64_BE (header + 8, time);
+  g_byte_array_append (array, header, sizeof (header));
+  g_byte_array_append (array, data, size);
+}
+
+GST_START_TEST (test_uri_rtp_cache)
+{
+  GstRTSPMediaFactoryURI *factory;
+  GstRTSPMedia *media;
+  GstRTSPUrl *url;
+  GstRTSPStream *stream;
+  GstRTSPThreadPool *pool;
+  GstRTSPThread *thread;
+  GstStructure *s;
+  GstCaps *caps;
+  GByteArray *array;
+  const gchar *uri = "file:///tmp/rtp-cache-test.mp4";
+  const gchar *caps_str = "application/x-rtp, media=(string)application, "
+      "payload=(int)96, clock-rate=(int)90000, encoding-name=(string)X-GST, "
+      "ssrc=(uint)1234";
+  guint8 packet[14] = { 0x80, 0x60, 0x00, 0x01, 0, 0, 0, 0, 0, 0, 0x04, 0xd2,
+    0xaa, 0xbb
+  };
+  gchar *dir, *key, *checksum, *name, *path, *str;
+  guint64 size;
+
+  /* the cache file of the uri, with two packets */
+  dir = g_dir_make_tmp ("rtsp-rtp-cache-XXXXXX", NULL);
+  fail_unless (dir != NULL);
+  key = g_strdup_printf ("%s use-gstpay=0", uri);
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, key, -1);
+  g_free (key);
+  name = g_strconcat (checksum, ".rtp", NULL);
+  path = g_build_filename (dir, name, NULL);
+  g_free (name);
+  g_free (checksum);
+
+  array = g_byte_array_new ();
+  g_byte_array_append (array, (const guint8 *) "GSTRTPC1", 8);
+  add_cache_record (array, 'C', 0, GST_CLOCK_TIME_NONE,
+      (const guint8 *) caps_str, strlen (caps_str));
+  add_cache_record (array, 'P', 1, 0, packet, sizeof (packet));
+  packet[3] = 0x02;
+  add_cache_record (array, 'P', 0, 40 * GST_MSECOND, packet, sizeof (packet));
+  add_cache_record (array, 'E', 0, GST_CLOCK_TIME_NONE, NULL, 0);
+  fail_unless (g_file_set_contents (path, (const gchar *) array->data,
+          array->len, NULL));
+  g_byte_array_unref (array);
+
+  factory = gst_rtsp_media_factory_uri_new ();
+  gst_rtsp_media_factory_uri_set_uri (factory, uri);
+  gst_rtsp_media_factory_uri_set_rtp_cache (factory, dir, 1024 * 1024);
+
+  gst_rtsp_media_factory_uri_get_rtp_cache (factory, &str, &size);
+  fail_unless_equals_string (str, dir);
+  fail_unless_equals_uint64 (size, 1024 * 1024);
+  g_free (str);
+
+  fail_unless (gst_rtsp_url_parse ("rtsp://localhost:8554/test",
+          &url) == GST_RTSP_OK);
+
+  /* the media replays the cached packets instead of the uri */
+  media =
+      gst_rtsp_media_factory_construct (GST_RTSP_MEDIA_FACTORY (factory), url);
+  fail_unless (GST_IS_RTSP_MEDIA (media));
+  fail_unless (gst_rtsp_media_n_streams (media) == 1);
+
+  pool = gst_rtsp_thread_pool_new ();
+  thread = gst_rtsp_thread_pool_get_thread (pool,
+      GST_RTSP_THREAD_TYPE_MEDIA, NULL);
+  fail_unless (gst_rtsp_media_prepare (media, thread));
+
+  stream = gst_rtsp_media_get_stream (media, 0);
+  caps = gst_rtsp_stream_get_caps (stream);
+  fail_unless (caps != NULL);
+  s = gst_caps_get_structure (caps, 0);
+  fail_unless_equals_string (gst_structure_get_string (s, "encoding-name"),
+      "X-GST");
+  gst_caps_unref (caps);
+
+  fail_unless (gst_rtsp_media_unprepare (media));
+  g_object_unref (media);
+
+  /* the file is evicted when the cache gets too small */
+  gst_rtsp_media_factory_uri_set_rtp_cache (factory, dir, 0);
+  fail_if (g_file_test (path, G_FILE_TEST_EXISTS));
+
+  gst_rtsp_url_free (url);
+  g_object_unref (factory);
+  g_object_unref (pool);
+  gst_rtsp_thread_pool_cleanup ();
+
+  g_rmdir (dir);
+  g_free (path);
+  g_free (dir);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_replay)
+{
+  GstRTSPMediaFactoryReplay *factory;
+  GstRTSPMedia *media;
+  GstRTSPUrl *url;
+  GstRTSPThreadPool *pool;
+  GstRTSPThread *thread;
+  GByteArray *array;
+  const gchar *uri = "file:///tmp/rtp-replay-test.mp4";
+  const gchar *caps_str = "application/x-rtp, media=(string)application, "
+      "payload=(int)96, clock-rate=(int)90000, encoding-name=(string)X-GST, "
+      "ssrc=(uint)1234";
+  guint8 packet[14] = { 0x80, 0x60, 0x00, 0x01, 0, 0, 0, 0, 0, 0, 0x04, 0xd2,
+    0xaa, 0xbb
+  };
+  gchar *dir, *key, *checksum, *name, *path;
+  gint64 num_loops;
+
+  factory = gst_rtsp_media_factory_replay_new ();
+  fail_unless (GST_IS_RTSP_MEDIA_FACTORY_URI (factory));
+  fail_unless (gst_rtsp_media_factory_is_shared (GST_RTSP_MEDIA_FACTORY
+          (factory)));
+  fail_unless_equals_int64 (gst_rtsp_media_factory_replay_get_num_loops
+      (factory), -1);
+  g_object_set (factory, "num-loops", (gint64) 3, NULL);
+  g_object_get (factory, "num-loops", &num_loops, NULL);
+  fail_unless_equals_int64 (num_loops, 3);
+  gst_rtsp_media_factory_replay_set_num_loops (factory, -1);
+
+  /* the cache file of the uri, with two packets */
+  dir = g_dir_make_tmp ("rtsp-rtp-replay-XXXXXX", NULL);
+  fail_unless (dir != NULL);
+  key = g_strdup_printf ("%s use-gstpay=0", uri);
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, key, -1);
+  g_free (key);
+  name = g_strconcat (checksum, ".rtp", NULL);
+  path = g_build_filename (dir, name, NULL);
+  g_free (name);
+  g_free (checksum);
+
+  array = g_byte_array_new ();
+  g_byte_array_append (array, (const guint8 *) "GSTRTPC1", 8);
+  add_cache_record (array, 'C', 0, GST_CLOCK_TIME_NONE,
+      (const guint8 *) caps_str, strlen (caps_str));
+  add_cache_record (array, 'P', 1, 0, packet, sizeof (packet));
+  packet[3] = 0x02;
+  add_cache_record (array, 'P', 0, 40 * GST_MSECOND, packet, sizeof (packet));
+  add_cache_record (array, 'E', 0, GST_CLOCK_TIME_NONE, NULL, 0);
+  fail_unless (g_file_set_contents (path, (const gchar *) array->data,
+          array->len, NULL));
+  g_byte_array_unref (array);
+
+  gst_rtsp_media_factory_uri_set_uri (GST_RTSP_MEDIA_FACTORY_URI (factory),
+      uri);
+  gst_rtsp_media_factory_uri_set_rtp_cache (GST_RTSP_MEDIA_FACTORY_URI
+      (factory), dir, 1024 * 1024);
+
+  fail_unless (gst_rtsp_url_parse ("rtsp://localhost:8554/test",
+          &url) == GST_RTSP_OK);
+
+  /* the media loops over the cached packets forever and can't seek */
+  media =
+      gst_rtsp_media_factory_construct (GST_RTSP_MEDIA_FACTORY (factory), url);
+  fail_unless (GST_IS_RTSP_MEDIA (media));
+  fail_unless (gst_rtsp_media_n_streams (media) == 1);
+
+  pool = gst_rtsp_thread_pool_new ();
+  thread = gst_rtsp_thread_pool_get_thread (pool,
+      GST_RTSP_THREAD_TYPE_MEDIA, NULL);
+  fail_unless (gst_rtsp_media_prepare (media, thread));
+  fail_unless_equals_int64 (gst_rtsp_media_seekable (media), -1);
+
+  fail_unless (gst_rtsp_media_unprepare (media));
+  g_object_unref (media);
+
+  gst_rtsp_media_factory_uri_set_rtp_cache (GST_RTSP_MEDIA_FACTORY_URI
+      (factory), dir, 0);
+  fail_if (g_file_test (path, G_FILE_TEST_EXISTS));
+
+  gst_rtsp_url_free (url);
+  g_object_unref (factory);
+  g_object_unref (pool);
+  gst_rtsp_thread_pool_cleanup ();
+
+  g_rmdir (dir);
+  g_free (path);
+  g_free (dir);
+}
+
+GST_END_TEST;
+
+static gboolean
+has_element (GstRTSPMedia * media, const gchar * name)
+{
+  GstElement *bin, *element;
+
+  bin = gst_rtsp_media_get_element (media);
+  element = gst_bin_get_by_name (GST_BIN (bin), name);
+  gst_object_unref (bin);
+  if (element == NULL)
+    return FALSE;
+  gst_object_unref (element);
+
+  return TRUE;
+}
+
+static void
+write_wav (const gchar * location, gint num_buffers)
+{
+  GstElement *pipeline;
+  GstMessage *msg;
+  gchar *desc;
+
+  desc = g_strdup_printf ("audiotestsrc num-buffers=%d ! wavenc ! "
+      "filesink location=\"%s\"", num_buffers, location);
+  pipeline = gst_parse_launch (desc, NULL);
+  g_free (desc);
+  fail_unless (pipeline != NULL);
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  msg = gst_bus_timed_pop_filtered (GST_ELEMENT_BUS (pipeline),
+      GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+}
+
+/* a media that plays the uri to the end records it in the cache, the next
+ * media replays the recording */
+GST_START_TEST (test_uri_rtp_cache_record)
+{
+  GstRTSPMediaFactoryURI *factory;
+  GstRTSPMedia *media;
+  GstRTSPUrl *url;
+  GstRTSPStream *stream;
+  GstRTSPThreadPool *pool;
+  GstRTSPThread *thread;
+  GstRTSPTransport *transport;
+  GstRTSPStreamTransport *trans;
+  GPtrArray *transports;
+  gchar *dir, *location, *uri, *key, *checksum, *name, *path;
+  gint i;
+
+  dir = g_dir_make_tmp ("rtsp-rtp-cache-XXXXXX", NULL);
+  fail_unless (dir != NULL);
+
+  /* a short file to play */
+  location = g_build_filename (dir, "test.wav", NULL);
+  write_wav (location, 10);
+
+  uri = gst_filename_to_uri (location, NULL);
+  fail_unless (uri != NULL);
+  key = g_strdup_printf ("%s use-gstpay=0", uri);
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, key, -1);
+  name = g_strconcat (checksum, ".rtp", NULL);
+  path = g_build_filename (dir, name, NULL);
+  g_free (name);
+  g_free (checksum);
+  g_free (key);
+
+  factory = gst_rtsp_media_factory_uri_new ();
+  gst_rtsp_media_factory_uri_set_uri (factory, uri);
+  gst_rtsp_media_factory_uri_set_rtp_cache (factory, dir, 1024 * 1024);
+
+  fail_unless (gst_rtsp_url_parse ("rtsp://localhost:8554/test",
+          &url) == GST_RTSP_OK);
+
+  pool = gst_rtsp_thread_pool_new ();
+
+  /* the first media decodes the uri and plays it to the end */
+  media =
+      gst_rtsp_media_factory_construct (GST_RTSP_MEDIA_FACTORY (factory), url);
+  fail_unless (GST_IS_RTSP_MEDIA (media));
+  fail_unless (has_element (media, "uribin"));
+  thread = gst_rtsp_thread_pool_get_thread (pool,
+      GST_RTSP_THREAD_TYPE_MEDIA, NULL);
+  fail_unless (gst_rtsp_media_prepare (media, thread));
+  fail_unless (gst_rtsp_media_n_streams (media) == 1);
+
+  stream = gst_rtsp_media_get_stream (media, 0);
+  fail_unless (gst_rtsp_transport_new (&transport) == GST_RTSP_OK);
+  transport->lower_transport = GST_RTSP_LOWER_TRANS_TCP;
+  transport->interleaved.min = 0;
+  transport->interleaved.max = 1;
+  fail_unless (gst_rtsp_stream_complete_stream (stream, transport));
+  trans = gst_rtsp_stream_transport_new (stream, transport);
+  gst_rtsp_stream_transport_set_callbacks (trans, discard_send, discard_send,
+      trans, NULL);
+  transports = g_ptr_array_new ();
+  g_ptr_array_add (transports, trans);
+  fail_unless (gst_rtsp_media_set_state (media, GST_STATE_PLAYING,
+          transports));
+
+  for (i = 0; i < 100 && !g_file_test (path, G_FILE_TEST_EXISTS); i++)
+    g_usleep (100 * G_TIME_SPAN_MILLISECOND);
+  fail_unless (g_file_test (path, G_FILE_TEST_EXISTS));
+
+  fail_unless (gst_rtsp_media_set_state (media, GST_STATE_NULL, transports));
+  g_ptr_array_unref (transports);
+  g_object_unref (trans);
+  fail_unless (gst_rtsp_media_unprepare (media));
+  g_object_unref (media);
+
+  /* the next media replays the recorded packets */
+  media =
+      gst_rtsp_media_factory_construct (GST_RTSP_MEDIA_FACTORY (factory), url);
+  fail_unless (GST_IS_RTSP_MEDIA (media));
+  fail_if (has_element (media, "uribin"));
+  thread = gst_rtsp_thread_pool_get_thread (pool,
+      GST_RTSP_THREAD_TYPE_MEDIA, NULL);
+  fail_unless (gst_rtsp_media_prepare (media, thread));
+  fail_unless (gst_rtsp_media_n_streams (media) == 1);
+  fail_unless (gst_rtsp_media_unprepare (media));
+  g_object_unref (media);
+
+  /* the packets of a replaced file are dropped */
+  write_wav (location, 20);
+  media =
+      gst_rtsp_media_factory_construct (GST_RTSP_MEDIA_FACTORY (factory), url);
+  fail_unless (GST_IS_RTSP_MEDIA (media));
+  fail_unless (has_element (media, "uribin"));
+  fail_if (g_file_test (path, G_FILE_TEST_EXISTS));
+  g_object_unref (media);
+
+  /* the packets of another payloader are not in the cache */
+  g_object_set (factory, "use-gstpay", TRUE, NULL);
+  media =
+      gst_rtsp_media_factory_construct (GST_RTSP_MEDIA_FACTORY (factory), url);
+  fail_unless (GST_IS_RTSP_MEDIA (media));
+  fail_unless (has_element (media, "uribin"));
+  g_object_unref (media);
+
+  gst_rtsp_media_factory_uri_set_rtp_cache (factory, dir, 0);
+  fail_if (g_file_test (path, G_FILE_TEST_EXISTS));
+
+  gst_rtsp_url_free (url);
+  g_object_unref (factory);
+  g_object_unref (pool);
+  gst_rtsp_thread_pool_cleanup ();
+
+  g_unlink (location);
+  g_rmdir (dir);
+  g_free (location);
+  g_free (uri);
+  g_free (path);
+  g_free (dir);
+}
+
+GST_END_TEST;
+
+static gpointer
+camera_thread (GMainLoop * loop)
+{
+  g_main_loop_run (loop);
+  return NULL;
+}
+
+GST_START_TEST (test_relay)
+{
+  GstRTSPServer *server;
+  GstRTSPMountPoints *mounts;
+  GstRTSPMediaFactory *camera;
+  GstRTSPMediaFactoryRelay *factory1, *factory2;
+  GstRTSPMedia *media1, *media2;
+  GstRTSPStream *stream;
+  GstRTSPThreadPool *pool;
+  GstRTSPThread *thread;
+  GstRTSPUrl *url1, *url2;
+  GstElementFactory *rtspsrc;
+  GMainContext *context;
+  GMainLoop *loop;
+  GThread *camera_loop;
+  GstStructure *s;
+  GstCaps *caps;
+  gchar *service, *location, *str;
+  guint id;
+
+  rtspsrc = gst_element_factory_find ("rtspsrc");
+  if (rtspsrc == NULL) {
+    GST_INFO ("no rtspsrc, skipping test");
+    return;
+  }
+  gst_object_unref (rtspsrc);
+
+  /* a local server plays the camera */
+  context = g_main_context_new ();
+  loop = g_main_loop_new (context, FALSE);
+  server = gst_rtsp_server_new ();
+  gst_rtsp_server_set_service (server, "0");
+  camera = gst_rtsp_media_factory_new ();
+  gst_rtsp_media_factory_set_launch (camera,
+      "( videotestsrc is-live=true ! video/x-raw,width=64,height=48 ! "
+      "rtpvrawpay pt=96 name=pay0 )");
+  gst_rtsp_media_factory_set_shared (camera, TRUE);
+  mounts = gst_rtsp_server_get_mount_points (server);
+  gst_rtsp_mount_points_add_factory (mounts, "/camera", camera);
+  g_object_unref (mounts);
+  id = gst_rtsp_server_attach (server, context);
+  fail_if (id == 0);
+  service = gst_rtsp_server_get_service (server);
+  location = g_strdup_printf ("rtsp://127.0.0.1:%s/camera", service);
+  g_free (service);
+  camera_loop = g_thread_new ("camera", (GThreadFunc) camera_thread, loop);
+
+  /* two mount points for the same camera */
+  factory1 = gst_rtsp_media_factory_relay_new ();
+  fail_unless (gst_rtsp_media_factory_is_shared (GST_RTSP_MEDIA_FACTORY
+          (factory1)));
+  fail_unless (gst_rtsp_media_factory_relay_get_location (factory1) == NULL);
+  gst_rtsp_media_factory_relay_set_location (factory1, location);
+  str = gst_rtsp_media_factory_relay_get_location (factory1);
+  fail_unless_equals_string (str, location);
+  g_free (str);
+  fail_unless_equals_int
+      (gst_rtsp_media_factory_relay_get_reconnect_interval (factory1), 5);
+  gst_rtsp_media_factory_relay_set_reconnect_interval (factory1, 1);
+  fail_unless_equals_int
+      (gst_rtsp_media_factory_relay_get_reconnect_interval (factory1), 1);
+
+  factory2 = gst_rtsp_media_factory_relay_new ();
+  gst_rtsp_media_factory_relay_set_location (factory2, location);
+  gst_rtsp_media_factory_set_latency (GST_RTSP_MEDIA_FACTORY (factory2), 500);
+
+  fail_unless (gst_rtsp_url_parse ("rtsp://localhost:8554/cam1",
+          &url1) == GST_RTSP_OK);
+  fail_unless (gst_rtsp_url_parse ("rtsp://localhost:8554/cam2",
+          &url2) == GST_RTSP_OK);
+
+  /* the factories share the connection to the camera */
+  media1 =
+      gst_rtsp_media_factory_construct (GST_RTSP_MEDIA_FACTORY (factory1),
+      url1);
+  fail_unless (GST_IS_RTSP_MEDIA (media1));
+  media2 =
+      gst_rtsp_media_factory_construct (GST_RTSP_MEDIA_FACTORY (factory2),
+      url2);
+  fail_unless (media1 == media2);
+  g_object_unref (media2);
+
+  /* with the settings of the factory that constructed the media */
+  fail_unless_equals_int (gst_rtsp_media_get_latency (media1),
+      gst_rtsp_media_factory_get_latency (GST_RTSP_MEDIA_FACTORY (factory1)));
+
+  pool = gst_rtsp_thread_pool_new ();
+  thread = gst_rtsp_thread_pool_get_thread (pool,
+      GST_RTSP_THREAD_TYPE_MEDIA, NULL);
+  fail_unless (gst_rtsp_media_prepare (media1, thread));
+  fail_unless (gst_rtsp_media_n_streams (media1) == 1);
+
+  /* the packets of the camera are relayed without depayloading */
+  stream = gst_rtsp_media_get_stream (media1, 0);
+  caps = gst_rtsp_stream_get_caps (stream);
+  fail_unless (caps != NULL);
+  s = gst_caps_get_structure (caps, 0);
+  fail_unless_equals_string (gst_structure_get_string (s, "encoding-name"),
+      "RAW");
+  fail_if (gst_structure_has_field (s, "npt-start"));
+  gst_caps_unref (caps);
+
+  fail_unless (gst_rtsp_media_unprepare (media1));
+  g_object_unref (media1);
+
+  /* an unprepared media is not shared anymore */
+  media2 =
+      gst_rtsp_media_factory_construct (GST_RTSP_MEDIA_FACTORY (factory2),
+      url2);
+  fail_unless (GST_IS_RTSP_MEDIA (media2));
+  g_object_unref (media2);
+
+  gst_rtsp_url_free (url1);
+  gst_rtsp_url_free (url2);
+  g_object_unref (factory1);
+  g_object_unref (factory2);
+  g_object_unref (pool);
+  gst_rtsp_thread_pool_cleanup ();
+
+  g_main_loop_quit (loop);
+  g_thread_join (camera_loop);
+  g_source_destroy (g_main_context_find_source_by_id (context, id));
+  g_object_unref (server);
+  g_main_loop_unref (loop);
+  g_main_context_unref (context);
+  g_free (location);
+}
+
+GST_END_TEST;
+
+typedef struct
+{
+  GstRTSPMediaFactoryPush *factory;
+  gint stop;
+} PushData;
+
+static gpointer
+push_thread (PushData * data)
+{
+  GstClockTime pts = 0;
+
+  while (!g_atomic_int_get (&data->stop)) {
+    GstBuffer *frame;
+
+    frame = gst_buffer_new_allocate (NULL, 8 * 8 * 3, NULL);
+    gst_buffer_memset (frame, 0, 0x80, 8 * 8 * 3);
+    GST_BUFFER_PTS (frame) = pts;
+    pts += 40 * GST_MSECOND;
+    gst_rtsp_media_factory_push_frame (data->factory, 0, frame);
+    g_usleep (40 * G_TIME_SPAN_MILLISECOND);
+  }
+  return NULL;
+}
+
+GST_START_TEST (test_push)
+{
+  GstRTSPMediaFactoryPush *factory;
+  GstRTSPMedia *media;
+  GstRTSPStream *stream;
+  GstRTSPThreadPool *pool;
+  GstRTSPThread *thread;
+  GstRTSPUrl *url;
+  GstStructure *s;
+  GstCaps *caps;
+  GThread *pusher;
+  PushData data;
+
+  factory = gst_rtsp_media_factory_push_new ();
+  fail_unless (gst_rtsp_media_factory_is_shared (GST_RTSP_MEDIA_FACTORY
+          (factory)));
+  caps = gst_caps_from_string ("video/x-raw, format=RGB, width=8, height=8, "
+      "framerate=25/1");
+  fail_unless_equals_int (gst_rtsp_media_factory_push_add_stream (factory,
+          caps), 0);
+  gst_caps_unref (caps);
+  fail_unless_equals_int (gst_rtsp_media_factory_push_n_streams (factory), 1);
+
+  /* nothing plays the frames yet */
+  fail_unless_equals_int (gst_rtsp_media_factory_push_frame (factory, 0,
+          gst_buffer_new_allocate (NULL, 8 * 8 * 3, NULL)), GST_FLOW_FLUSHING);
+
+  fail_unless (gst_rtsp_url_parse ("rtsp://localhost:8554/test",
+          &url) == GST_RTSP_OK);
+  media =
+      gst_rtsp_media_factory_construct (GST_RTSP_MEDIA_FACTORY (factory), url);
+  fail_unless (GST_IS_RTSP_MEDIA (media));
+  fail_unless (gst_rtsp_media_n_streams (media) == 1);
+
+  /* the media prepares with the first frame, the pusher is never blocked
+   * while the media waits for a client */
+  data.factory = factory;
+  data.stop = 0;
+  pusher = g_thread_new ("push", (GThreadFunc) push_thread, &data);
+
+  pool = gst_rtsp_thread_pool_new ();
+  thread = gst_rtsp_thread_pool_get_thread (pool,
+      GST_RTSP_THREAD_TYPE_MEDIA, NULL);
+  fail_unless (gst_rtsp_media_prepare (media, thread));
+  fail_unless (gst_rtsp_media_is_live (media));
+
+  stream = gst_rtsp_media_get_stream (media, 0);
+  caps = gst_rtsp_stream_get_caps (stream);
+  fail_unless (caps != NULL);
+  s = gst_caps_get_structure (caps, 0);
+  fail_unless_equals_string (gst_structure_get_string (s, "encoding-name"),
+      "RAW");
+  gst_caps_unref (caps);
+
+  fail_unless_equals_int (gst_rtsp_media_factory_push_frame (factory, 0,
+          gst_buffer_new_allocate (NULL, 8 * 8 * 3, NULL)), GST_FLOW_OK);
+
+  fail_unless (gst_rtsp_media_unprepare (media));
+  g_atomic_int_set (&data.stop, 1);
+  g_thread_join (pusher);
+  g_object_unref (media);
+
+  fail_unless_equals_int (gst_rtsp_media_factory_push_frame (factory, 0,
+          gst_buffer_new_allocate (NULL, 8 * 8 * 3, NULL)), GST_FLOW_FLUSHING);
+
+  gst_rtsp_url_free (url);
+  g_object_unref (factory);
+  g_object_unref (pool);
+  gst_rtsp_thread_pool_cleanup ();
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_source_hub)
+{
+  GstRTSPSourceHub *hub, *found;
+  GstRTSPMediaFactory *full, *sub;
+  GstRTSPMedia *media1, *media2;
+  GstRTSPThreadPool *pool;
+  GstRTSPThread *thread;
+  GstRTSPUrl *url;
+  GstStructure *s;
+  GstCaps *caps;
+  gchar *str;
+
+  hub = gst_rtsp_source_hub_new ("camera");
+  gst_rtsp_source_hub_set_launch (hub, "videotestsrc is-live=true ! "
+      "video/x-raw, format=RGB, width=8, height=8, framerate=25/1 ! "
+      "identity name=video");
+  str = gst_rtsp_source_hub_get_name (hub);
+  fail_unless_equals_string (str, "camera");
+  g_free (str);
+
+  found = gst_rtsp_source_hub_find ("camera");
+  fail_unless (found == hub);
+  g_object_unref (found);
+  fail_unless (gst_rtsp_source_hub_find ("microphone") == NULL);
+
+  /* two mounts of the same capture */
+  full = gst_rtsp_media_factory_new ();
+  gst_rtsp_media_factory_set_launch (full, "( rtsphubsrc hub=camera "
+      "output=video ! rtpvrawpay name=pay0 pt=96 )");
+  sub = gst_rtsp_media_factory_new ();
+  gst_rtsp_media_factory_set_launch (sub, "( rtsphubsrc hub=camera "
+      "output=video max-time=0 ! videoscale ! video/x-raw, width=4, height=4 "
+      "! rtpvrawpay name=pay0 pt=96 )");
+
+  fail_unless (gst_rtsp_url_parse ("rtsp://localhost:8554/test",
+          &url) == GST_RTSP_OK);
+  media1 = gst_rtsp_media_factory_construct (full, url);
+  fail_unless (GST_IS_RTSP_MEDIA (media1));
+  media2 = gst_rtsp_media_factory_construct (sub, url);
+  fail_unless (GST_IS_RTSP_MEDIA (media2));
+
+  pool = gst_rtsp_thread_pool_new ();
+  thread = gst_rtsp_thread_pool_get_thread (pool,
+      GST_RTSP_THREAD_TYPE_MEDIA, NULL);
+  fail_unless (gst_rtsp_media_prepare (media1, thread));
+  thread = gst_rtsp_thread_pool_get_thread (pool,
+      GST_RTSP_THREAD_TYPE_MEDIA, NULL);
+  fail_unless (gst_rtsp_media_prepare (media2, thread));
+  fail_unless (gst_rtsp_media_is_live (media1));
+  fail_unless (gst_rtsp_media_is_live (media2));
+  fail_unless_equals_int (gst_rtsp_source_hub_n_consumers (hub), 2);
+
+  caps = gst_rtsp_stream_get_caps (gst_rtsp_media_get_stream (media2, 0));
+  fail_unless (caps != NULL);
+  s = gst_caps_get_structure (caps, 0);
+  fail_unless_equals_string (gst_structure_get_string (s, "width"), "4");
+  gst_caps_unref (caps);
+
+  /* the capture stops with the last consumer */
+  fail_unless (gst_rtsp_media_unprepare (media1));
+  fail_unless_equals_int (gst_rtsp_source_hub_n_consumers (hub), 1);
+  fail_unless (gst_rtsp_media_unprepare (media2));
+  fail_unless_equals_int (gst_rtsp_source_hub_n_consumers (hub), 0);
+  g_object_unref (media1);
+  g_object_unref (media2);
+
+  g_object_unref (hub);
+  fail_unless (gst_rtsp_source_hub_find ("camera") == NULL);
+
+  gst_rtsp_url_free (url);
+  g_object_unref (full);
+  g_object_unref (sub);
+  g_object_unref (pool);
+  gst_rtsp_thread_pool_cleanup ();
+}
+
+GST_END_TEST;
+
 static Suite *
 rtspmediafactory_suite (void)
 {
@@ -431,13 +1599,36 @@ rtspmediafactory_suite (void)
   tcase_add_test (tc, test_parse_error);
   tcase_add_test (tc, test_launch);
   tcase_add_test (tc, test_launch_construct);
+  tcase_add_test (tc, test_launch_template);
+  tcase_add_test (tc, test_launch_template_unreadable);
+  tcase_add_test (tc, test_launch_template_delayed);
   tcase_add_test (tc, test_shared);
+  tcase_add_test (tc, test_shared_concurrent_construct);
   tcase_add_test (tc, test_addresspool);
   tcase_add_test (tc, test_permissions);
   tcase_add_test (tc, test_reset);
+  tcase_add_test (tc, test_prewarm);
+  tcase_add_test (tc, test_merge_window);
+  tcase_add_test (tc, test_uri_rtp_cache);
+  if (gst_registry_check_feature_version (gst_registry_get (), "wavenc",
+          GST_VERSION_MAJOR, GST_VERSION_MINOR, 0) &&
+      gst_registry_check_feature_version (gst_registry_get (), "wavparse",
+          GST_VERSION_MAJOR, GST_VERSION_MINOR, 0)) {
+    tcase_add_test (tc, test_uri_rtp_cache_record);
+  } else {
+    GST_INFO ("Skipping test, missing plugins: wavenc, wavparse");
+  }
+  tcase_add_test (tc, test_replay);
+  tcase_add_test (tc, test_relay);
+  tcase_add_test (tc, test_push);
+  tcase_add_test (tc, test_source_hub);
   tcase_add_test (tc, test_mcast_ttl);
   tcase_add_test (tc, test_allow_bind_mcast);
 
+  /* the benchmarks take long and only run when asked for */
+  if (g_getenv ("GST_RTSP_SERVER_BENCHMARKS"))
+    tcase_add_test (tc, test_launch_template_benchmark);
+
   return s;
 }
 
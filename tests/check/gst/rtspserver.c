@@ -2702,6 +2702,195 @@ GST_START_TEST (test_double_play)
 
 GST_END_TEST;
 
+/* as in rtsp-client.c */
+#define MAX_PENDING_REQUESTS 16
+
+typedef struct
+{
+  GstPad *pad;
+  gulong probe_id;
+} PrepareBlock;
+
+static GstPadProbeReturn
+block_prepare_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  return GST_PAD_PROBE_OK;
+}
+
+/* keep the media from prerolling until unblock_prepare() is called */
+static void
+media_configure_block_prepare (GstRTSPMediaFactory * factory,
+    GstRTSPMedia * media, PrepareBlock * block)
+{
+  GstElement *bin, *pay;
+
+  bin = gst_rtsp_media_get_element (media);
+  pay = gst_bin_get_by_name (GST_BIN (bin), "pay0");
+  fail_unless (pay != NULL);
+
+  g_mutex_lock (&check_mutex);
+  block->pad = gst_element_get_static_pad (pay, "sink");
+  block->probe_id = gst_pad_add_probe (block->pad,
+      GST_PAD_PROBE_TYPE_BLOCK | GST_PAD_PROBE_TYPE_BUFFER,
+      block_prepare_probe, NULL, NULL);
+  g_mutex_unlock (&check_mutex);
+
+  gst_object_unref (pay);
+  gst_object_unref (bin);
+}
+
+static void
+unblock_prepare (PrepareBlock * block)
+{
+  g_mutex_lock (&check_mutex);
+  fail_unless (block->pad != NULL);
+  gst_pad_remove_probe (block->pad, block->probe_id);
+  gst_object_unref (block->pad);
+  block->pad = NULL;
+  g_mutex_unlock (&check_mutex);
+}
+
+static void
+add_blocked_factory (PrepareBlock * block)
+{
+  GstRTSPMountPoints *mounts;
+  GstRTSPMediaFactory *factory;
+
+  mounts = gst_rtsp_server_get_mount_points (server);
+  factory = gst_rtsp_media_factory_new ();
+  gst_rtsp_media_factory_set_launch (factory, "( " VIDEO_PIPELINE " )");
+  g_signal_connect (factory, "media-configure",
+      G_CALLBACK (media_configure_block_prepare), block);
+  gst_rtsp_mount_points_add_factory (mounts, TEST_MOUNT_POINT "2", factory);
+  g_object_unref (mounts);
+}
+
+static void
+send_request_cseq (GstRTSPConnection * conn, GstRTSPMethod method, gint cseq)
+{
+  GstRTSPMessage *request;
+  gchar *str;
+
+  request = create_request (conn, method, NULL);
+  str = g_strdup_printf ("%d", cseq);
+  gst_rtsp_message_take_header (request, GST_RTSP_HDR_CSEQ, str);
+  fail_unless (send_request (conn, request));
+  gst_rtsp_message_free (request);
+}
+
+static void
+read_response_cseq (GstRTSPConnection * conn, gint cseq,
+    GstRTSPStatusCode expected)
+{
+  GstRTSPMessage *response;
+  GstRTSPStatusCode code;
+  gchar *str;
+
+  response = read_response (conn);
+  fail_unless (response != NULL);
+  gst_rtsp_message_parse_response (response, &code, NULL, NULL);
+  fail_unless_equals_int (code, expected);
+  fail_unless (gst_rtsp_message_get_header (response, GST_RTSP_HDR_CSEQ,
+          &str, 0) == GST_RTSP_OK);
+  fail_unless_equals_int (atoi (str), cseq);
+  gst_rtsp_message_free (response);
+}
+
+GST_START_TEST (test_pipelined_requests_during_prepare)
+{
+  GstRTSPConnection *conn;
+  PrepareBlock block = { NULL, 0 };
+  gint cseq, last_queued;
+
+  add_blocked_factory (&block);
+  start_server (FALSE);
+
+  conn = connect_to_server (test_port, TEST_MOUNT_POINT "2");
+  iterate ();
+
+  /* the DESCRIBE waits for the media to prepare, the OPTIONS behind it are
+   * queued up to the limit and the others are refused right away */
+  send_request_cseq (conn, GST_RTSP_DESCRIBE, 1);
+  last_queued = 1 + MAX_PENDING_REQUESTS;
+  for (cseq = 2; cseq <= last_queued + 2; cseq++)
+    send_request_cseq (conn, GST_RTSP_OPTIONS, cseq);
+
+  read_response_cseq (conn, last_queued + 1, GST_RTSP_STS_SERVICE_UNAVAILABLE);
+  read_response_cseq (conn, last_queued + 2, GST_RTSP_STS_SERVICE_UNAVAILABLE);
+
+  /* once prepared, the DESCRIBE and the queued requests are answered in
+   * order */
+  unblock_prepare (&block);
+  for (cseq = 1; cseq <= last_queued; cseq++)
+    read_response_cseq (conn, cseq, GST_RTSP_STS_OK);
+
+  gst_rtsp_connection_free (conn);
+  stop_server ();
+  iterate ();
+}
+
+GST_END_TEST;
+
+static void
+client_finalized (gpointer data, GObject * where_the_object_was)
+{
+  gboolean *finalized = data;
+
+  g_mutex_lock (&check_mutex);
+  *finalized = TRUE;
+  g_cond_broadcast (&check_cond);
+  g_mutex_unlock (&check_mutex);
+}
+
+static void
+client_connected_weak_ref (GstRTSPServer * server, GstRTSPClient * client,
+    gboolean * finalized)
+{
+  g_object_weak_ref (G_OBJECT (client), client_finalized, finalized);
+}
+
+GST_START_TEST (test_close_during_prepare)
+{
+  GstRTSPConnection *conn;
+  PrepareBlock block = { NULL, 0 };
+  gboolean finalized = FALSE;
+  gint64 end_time;
+  gint cseq, last_queued;
+
+  add_blocked_factory (&block);
+  g_signal_connect (server, "client-connected",
+      G_CALLBACK (client_connected_weak_ref), &finalized);
+  start_server (FALSE);
+
+  conn = connect_to_server (test_port, TEST_MOUNT_POINT "2");
+  iterate ();
+
+  /* fill the queue of the client, the refused request tells us that all
+   * the others were queued */
+  send_request_cseq (conn, GST_RTSP_DESCRIBE, 1);
+  last_queued = 1 + MAX_PENDING_REQUESTS;
+  for (cseq = 2; cseq <= last_queued + 1; cseq++)
+    send_request_cseq (conn, GST_RTSP_OPTIONS, cseq);
+  read_response_cseq (conn, last_queued + 1, GST_RTSP_STS_SERVICE_UNAVAILABLE);
+
+  /* closing the connection drops the queued requests, nothing is answered
+   * and the client goes away when the media finished preparing */
+  gst_rtsp_connection_free (conn);
+  unblock_prepare (&block);
+
+  end_time = g_get_monotonic_time () + 10 * G_TIME_SPAN_SECOND;
+  g_mutex_lock (&check_mutex);
+  while (!finalized)
+    fail_unless (g_cond_wait_until (&check_cond, &check_mutex, end_time),
+        "client was not finalized");
+  g_mutex_unlock (&check_mutex);
+
+  stop_server ();
+  iterate ();
+}
+
+GST_END_TEST;
+
 
 static Suite *
 rtspserver_suite (void)
@@ -2744,6 +2933,8 @@ rtspserver_suite (void)
   tcase_add_test (tc, test_multiple_transports);
   tcase_add_test (tc, test_suspend_mode_reset_only_audio);
   tcase_add_test (tc, test_double_play);
+  tcase_add_test (tc, test_pipelined_requests_during_prepare);
+  tcase_add_test (tc, test_close_during_prepare);
 
   return s;
 }
@@ -187,6 +187,259 @@ GST_START_TEST (test_pool)
 
 GST_END_TEST;
 
+GST_START_TEST (test_pool_expiry)
+{
+  GstRTSPSessionPool *pool;
+  GstRTSPSession *session1, *session2, *session3;
+
+  pool = gst_rtsp_session_pool_new ();
+
+  session1 = gst_rtsp_session_pool_create (pool);
+  session2 = gst_rtsp_session_pool_create (pool);
+  session3 = gst_rtsp_session_pool_create (pool);
+  fail_unless_equals_int (gst_rtsp_session_pool_get_n_sessions (pool), 3);
+
+  g_object_set (session1, "timeout", 1, "extra-timeout", 0, NULL);
+  g_object_set (session2, "timeout", 1, "extra-timeout", 0, NULL);
+  /* never expires */
+  g_object_set (session3, "timeout", 0, "extra-timeout", 0, NULL);
+
+  /* g_usleep() only guarantees a lower bound, so the checks below only rely
+   * on the sessions having been idle for at least their timeout, or on
+   * session2 having been touched right before the cleanup */
+  g_usleep (1200 * G_TIME_SPAN_MILLISECOND);
+
+  /* touching session2 after its deadline passed, but before the pool noticed,
+   * keeps it alive */
+  gst_rtsp_session_touch (session2);
+  fail_unless_equals_int (gst_rtsp_session_pool_cleanup (pool), 1);
+  fail_unless_equals_int (gst_rtsp_session_pool_get_n_sessions (pool), 2);
+  fail_unless (gst_rtsp_session_pool_find (pool,
+          gst_rtsp_session_get_sessionid (session1)) == NULL);
+  fail_unless (gst_rtsp_session_is_expired_usec (session1,
+          g_get_monotonic_time ()));
+
+  /* lowering the timeout of a session that never expired reschedules it */
+  gst_rtsp_session_set_timeout (session3, 1);
+  g_usleep (1200 * G_TIME_SPAN_MILLISECOND);
+
+  fail_unless_equals_int (gst_rtsp_session_pool_cleanup (pool), 2);
+  fail_unless_equals_int (gst_rtsp_session_pool_get_n_sessions (pool), 0);
+
+  g_object_unref (session1);
+  g_object_unref (session2);
+  g_object_unref (session3);
+  g_object_unref (pool);
+}
+
+GST_END_TEST;
+
+#define N_THREADS 8
+#define N_THREAD_SESSIONS 200
+#define N_LOOKUPS 20000
+
+typedef struct
+{
+  GstRTSPSessionPool *pool;
+  GstRTSPSession **shared;
+  guint n_shared;
+  guint seed;
+  guint found;
+  guint wrong;
+} ThreadData;
+
+/* every thread creates and removes its own sessions while looking up the
+ * shared ones, so that all the shards are modified and read concurrently */
+static gpointer
+pool_thread (ThreadData * data)
+{
+  GstRTSPSession *own[N_THREAD_SESSIONS];
+  GRand *rand = g_rand_new_with_seed (data->seed);
+  guint i;
+
+  for (i = 0; i < N_THREAD_SESSIONS; i++)
+    own[i] = gst_rtsp_session_pool_create (data->pool);
+
+  for (i = 0; i < N_LOOKUPS; i++) {
+    GstRTSPSession *expected, *session;
+    guint idx = g_rand_int_range (rand, 0, data->n_shared + N_THREAD_SESSIONS);
+
+    if (idx < data->n_shared)
+      expected = data->shared[idx];
+    else
+      expected = own[idx - data->n_shared];
+
+    session = gst_rtsp_session_pool_find (data->pool,
+        gst_rtsp_session_get_sessionid (expected));
+    if (session == expected)
+      data->found++;
+    else
+      data->wrong++;
+    if (session)
+      g_object_unref (session);
+  }
+
+  /* remove every other session of this thread and check that the others
+   * can still be found */
+  for (i = 0; i < N_THREAD_SESSIONS; i += 2) {
+    if (!gst_rtsp_session_pool_remove (data->pool, own[i]))
+      data->wrong++;
+    g_object_unref (own[i]);
+  }
+  for (i = 1; i < N_THREAD_SESSIONS; i += 2) {
+    GstRTSPSession *session;
+
+    session = gst_rtsp_session_pool_find (data->pool,
+        gst_rtsp_session_get_sessionid (own[i]));
+    if (session != own[i])
+      data->wrong++;
+    if (session)
+      g_object_unref (session);
+    g_object_unref (own[i]);
+  }
+  g_rand_free (rand);
+
+  return NULL;
+}
+
+GST_START_TEST (test_pool_concurrent)
+{
+  GstRTSPSessionPool *pool;
+  GstRTSPSession *shared[N_THREAD_SESSIONS];
+  GThread *threads[N_THREADS];
+  ThreadData data[N_THREADS];
+  GList *sessions, *walk;
+  guint i;
+
+  pool = gst_rtsp_session_pool_new ();
+
+  for (i = 0; i < N_THREAD_SESSIONS; i++) {
+    shared[i] = gst_rtsp_session_pool_create (pool);
+    fail_unless (GST_IS_RTSP_SESSION (shared[i]));
+  }
+
+  for (i = 0; i < N_THREADS; i++) {
+    data[i].pool = pool;
+    data[i].shared = shared;
+    data[i].n_shared = N_THREAD_SESSIONS;
+    data[i].seed = i;
+    data[i].found = 0;
+    data[i].wrong = 0;
+    threads[i] = g_thread_new ("pool", (GThreadFunc) pool_thread, &data[i]);
+  }
+  for (i = 0; i < N_THREADS; i++) {
+    g_thread_join (threads[i]);
+    fail_unless_equals_int (data[i].wrong, 0);
+    fail_unless (data[i].found > 0);
+  }
+
+  /* the shared sessions and half of the sessions of each thread are left */
+  fail_unless_equals_int (gst_rtsp_session_pool_get_n_sessions (pool),
+      N_THREAD_SESSIONS + N_THREADS * N_THREAD_SESSIONS / 2);
+
+  sessions = gst_rtsp_session_pool_filter (pool, NULL, NULL);
+  fail_unless_equals_int (g_list_length (sessions),
+      N_THREAD_SESSIONS + N_THREADS * N_THREAD_SESSIONS / 2);
+  for (walk = sessions; walk; walk = walk->next)
+    fail_unless (gst_rtsp_session_pool_remove (pool, walk->data));
+  g_list_free_full (sessions, g_object_unref);
+  fail_unless_equals_int (gst_rtsp_session_pool_get_n_sessions (pool), 0);
+
+  for (i = 0; i < N_THREAD_SESSIONS; i++) {
+    fail_if (gst_rtsp_session_pool_remove (pool, shared[i]));
+    g_object_unref (shared[i]);
+  }
+
+  g_object_unref (pool);
+}
+
+GST_END_TEST;
+
+#define BENCH_SESSIONS 1000
+#define BENCH_LOOKUPS 200000
+#define BENCH_MAX_THREADS 8
+
+typedef struct
+{
+  GstRTSPSessionPool *pool;
+  gchar **ids;
+  guint seed;
+  guint found;
+} BenchData;
+
+static gpointer
+find_thread (BenchData * data)
+{
+  GRand *rand = g_rand_new_with_seed (data->seed);
+  guint i;
+
+  for (i = 0; i < BENCH_LOOKUPS; i++) {
+    GstRTSPSession *session;
+
+    session = gst_rtsp_session_pool_find (data->pool,
+        data->ids[g_rand_int_range (rand, 0, BENCH_SESSIONS)]);
+    if (session) {
+      data->found++;
+      g_object_unref (session);
+    }
+  }
+  g_rand_free (rand);
+
+  return NULL;
+}
+
+/* every thread does the same amount of lookups, with perfect scaling the
+ * lookups/s grow with the number of threads */
+GST_START_TEST (test_pool_find_benchmark)
+{
+  GstRTSPSessionPool *pool;
+  GstRTSPSession *sessions[BENCH_SESSIONS];
+  gchar *ids[BENCH_SESSIONS];
+  guint i, n_threads;
+
+  pool = gst_rtsp_session_pool_new ();
+
+  for (i = 0; i < BENCH_SESSIONS; i++) {
+    sessions[i] = gst_rtsp_session_pool_create (pool);
+    fail_unless (GST_IS_RTSP_SESSION (sessions[i]));
+    ids[i] = g_strdup (gst_rtsp_session_get_sessionid (sessions[i]));
+  }
+
+  for (n_threads = 1; n_threads <= BENCH_MAX_THREADS; n_threads++) {
+    GThread *threads[BENCH_MAX_THREADS];
+    BenchData data[BENCH_MAX_THREADS];
+    gint64 start, elapsed;
+
+    start = g_get_monotonic_time ();
+    for (i = 0; i < n_threads; i++) {
+      data[i].pool = pool;
+      data[i].ids = ids;
+      data[i].seed = i;
+      data[i].found = 0;
+      threads[i] = g_thread_new ("find", (GThreadFunc) find_thread, &data[i]);
+    }
+    for (i = 0; i < n_threads; i++) {
+      g_thread_join (threads[i]);
+      fail_unless_equals_int (data[i].found, BENCH_LOOKUPS);
+    }
+    elapsed = g_get_monotonic_time () - start;
+
+    g_print ("%u threads: %u lookups in %" G_GINT64_FORMAT " us, %.0f "
+        "lookups/s\n", n_threads, n_threads * BENCH_LOOKUPS, elapsed,
+        (gdouble) n_threads * BENCH_LOOKUPS * G_USEC_PER_SEC / MAX (elapsed,
+            1));
+  }
+
+  for (i = 0; i < BENCH_SESSIONS; i++) {
+    fail_unless (gst_rtsp_session_pool_remove (pool, sessions[i]));
+    g_object_unref (sessions[i]);
+    g_free (ids[i]);
+  }
+  g_object_unref (pool);
+}
+
+GST_END_TEST;
+
 static Suite *
 rtspsessionpool_suite (void)
 {
@@ -196,6 +449,12 @@ rtspsessionpool_suite (void)
   suite_add_tcase (s, tc);
   tcase_set_timeout (tc, 15);
   tcase_add_test (tc, test_pool);
+  tcase_add_test (tc, test_pool_expiry);
+  tcase_add_test (tc, test_pool_concurrent);
+
+  /* the benchmarks take long and only run when asked for */
+  if (g_getenv ("GST_RTSP_SERVER_BENCHMARKS"))
+    tcase_add_test (tc, test_pool_find_benchmark);
 
   return s;
 }
@@ -653,6 +653,166 @@ GST_START_TEST (test_remove_transport_twice)
 
 GST_END_TEST;
 
+GST_START_TEST (test_gop_cache_size)
+{
+  GstRTSPTransport *transport;
+  GstRTSPStream *stream;
+  GstRTSPStreamTransport *tr;
+  GstPad *srcpad;
+  GstElement *pay;
+  GstBin *bin;
+  GstElement *rtpbin;
+
+  srcpad = gst_pad_new ("testsrcpad", GST_PAD_SRC);
+  fail_unless (srcpad != NULL);
+  pay = gst_element_factory_make ("rtpgstpay", "testpayloader");
+  fail_unless (pay != NULL);
+  stream = gst_rtsp_stream_new (0, pay, srcpad);
+  fail_unless (stream != NULL);
+  gst_object_unref (pay);
+  gst_object_unref (srcpad);
+
+  /* disabled by default */
+  fail_unless_equals_int (gst_rtsp_stream_get_gop_cache_size (stream), 0);
+  gst_rtsp_stream_set_gop_cache_size (stream, 1024 * 1024);
+  fail_unless_equals_int (gst_rtsp_stream_get_gop_cache_size (stream),
+      1024 * 1024);
+
+  rtpbin = gst_element_factory_make ("rtpbin", "testrtpbin");
+  fail_unless (rtpbin != NULL);
+  bin = GST_BIN (gst_bin_new ("testbin"));
+  fail_unless (bin != NULL);
+  fail_unless (gst_bin_add (bin, rtpbin));
+
+  gst_rtsp_stream_set_protocols (stream, GST_RTSP_LOWER_TRANS_TCP);
+  fail_unless (gst_rtsp_stream_join_bin (stream, bin, rtpbin, GST_STATE_NULL));
+
+  /* nothing was cached yet, the transport is added as usual */
+  fail_unless (gst_rtsp_transport_new (&transport) == GST_RTSP_OK);
+  transport->lower_transport = GST_RTSP_LOWER_TRANS_TCP;
+  transport->destination = g_strdup ("127.0.0.1");
+  tr = gst_rtsp_stream_transport_new (stream, transport);
+  fail_unless (tr);
+  fail_unless (gst_rtsp_stream_add_transport (stream, tr));
+  fail_unless (gst_rtsp_stream_remove_transport (stream, tr));
+  g_object_unref (tr);
+
+  gst_rtsp_stream_set_gop_cache_size (stream, 0);
+  fail_unless_equals_int (gst_rtsp_stream_get_gop_cache_size (stream), 0);
+
+  fail_unless (gst_rtsp_stream_leave_bin (stream, bin, rtpbin));
+  gst_object_unref (bin);
+  gst_object_unref (stream);
+}
+
+GST_END_TEST;
+
+static GstPadProbeReturn
+trickmode_output_probe (GstPad * pad, GstPadProbeInfo * info, GList ** output)
+{
+  *output = g_list_append (*output, gst_mini_object_ref (info->data));
+
+  return GST_PAD_PROBE_DROP;
+}
+
+GST_START_TEST (test_keyframe_trickmode)
+{
+  GstRTSPStream *stream;
+  GstPad *srcpad, *upstream, *paysink;
+  GstElement *pay;
+  GstBin *bin;
+  GstElement *rtpbin;
+  GstSegment segment;
+  GstBuffer *buffer;
+  GstEvent *event;
+  const GstSegment *applied;
+  GList *output = NULL, *walk;
+  guint n_buffers = 0;
+
+  srcpad = gst_pad_new ("testsrcpad", GST_PAD_SRC);
+  fail_unless (srcpad != NULL);
+  pay = gst_element_factory_make ("rtpgstpay", "testpayloader");
+  fail_unless (pay != NULL);
+  stream = gst_rtsp_stream_new (0, pay, srcpad);
+  fail_unless (stream != NULL);
+  gst_object_unref (srcpad);
+
+  fail_if (gst_rtsp_stream_is_keyframe_trickmode (stream));
+  gst_rtsp_stream_set_keyframe_trickmode (stream, TRUE);
+  fail_unless (gst_rtsp_stream_is_keyframe_trickmode (stream));
+
+  rtpbin = gst_element_factory_make ("rtpbin", "testrtpbin");
+  fail_unless (rtpbin != NULL);
+  bin = GST_BIN (gst_bin_new ("testbin"));
+  fail_unless (bin != NULL);
+  fail_unless (gst_bin_add (bin, rtpbin));
+
+  gst_rtsp_stream_set_protocols (stream, GST_RTSP_LOWER_TRANS_TCP);
+  fail_unless (gst_rtsp_stream_join_bin (stream, bin, rtpbin, GST_STATE_NULL));
+
+  /* look at what reaches the payloader after the stream handled it */
+  paysink = gst_element_get_static_pad (pay, "sink");
+  gst_pad_add_probe (paysink, GST_PAD_PROBE_TYPE_BUFFER |
+      GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+      (GstPadProbeCallback) trickmode_output_probe, &output, NULL);
+  upstream = gst_pad_new ("upstream", GST_PAD_SRC);
+  fail_unless (gst_pad_link (upstream, paysink) == GST_PAD_LINK_OK);
+  gst_pad_set_active (upstream, TRUE);
+  gst_pad_set_active (paysink, TRUE);
+
+  /* 8x fast-forward that the demuxer did not apply */
+  gst_pad_push_event (upstream, gst_event_new_stream_start ("test"));
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  segment.rate = 8.0;
+  segment.flags = GST_SEGMENT_FLAG_TRICKMODE;
+  gst_pad_push_event (upstream, gst_event_new_segment (&segment));
+
+  buffer = gst_buffer_new ();
+  GST_BUFFER_PTS (buffer) = 0;
+  fail_unless (gst_pad_push (upstream, buffer) == GST_FLOW_OK);
+  buffer = gst_buffer_new ();
+  GST_BUFFER_PTS (buffer) = 40 * GST_MSECOND;
+  GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+  fail_unless (gst_pad_push (upstream, buffer) == GST_FLOW_OK);
+  buffer = gst_buffer_new ();
+  GST_BUFFER_PTS (buffer) = 8 * GST_SECOND;
+  fail_unless (gst_pad_push (upstream, buffer) == GST_FLOW_OK);
+
+  /* the keyframes come at the normal rate, the rate is applied */
+  for (walk = output; walk; walk = walk->next) {
+    if (GST_IS_EVENT (walk->data)) {
+      event = walk->data;
+      if (GST_EVENT_TYPE (event) != GST_EVENT_SEGMENT)
+        continue;
+      gst_event_parse_segment (event, &applied);
+      fail_unless (applied->rate == 1.0);
+      fail_unless (applied->applied_rate == 8.0);
+      fail_unless (applied->flags & GST_SEGMENT_FLAG_TRICKMODE);
+    } else {
+      buffer = walk->data;
+      fail_if (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT));
+      fail_unless_equals_uint64 (GST_BUFFER_PTS (buffer),
+          n_buffers * GST_SECOND);
+      n_buffers++;
+    }
+  }
+  fail_unless_equals_int (n_buffers, 2);
+  g_list_free_full (output, (GDestroyNotify) gst_mini_object_unref);
+
+  gst_pad_set_active (upstream, FALSE);
+  gst_pad_set_active (paysink, FALSE);
+  gst_pad_unlink (upstream, paysink);
+  gst_object_unref (upstream);
+  gst_object_unref (paysink);
+  gst_object_unref (pay);
+
+  fail_unless (gst_rtsp_stream_leave_bin (stream, bin, rtpbin));
+  gst_object_unref (bin);
+  gst_object_unref (stream);
+}
+
+GST_END_TEST;
+
 static gboolean
 is_ipv6_supported (void)
 {
@@ -699,6 +859,8 @@ rtspstream_suite (void)
   tcase_add_test (tc, test_multicast_client_address_invalid);
   tcase_add_test (tc, test_add_transport_twice);
   tcase_add_test (tc, test_remove_transport_twice);
+  tcase_add_test (tc, test_gop_cache_size);
+  tcase_add_test (tc, test_keyframe_trickmode);
 
   return s;
 }
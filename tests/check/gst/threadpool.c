@@ -215,6 +215,92 @@ GST_START_TEST (test_pool_thread_copy)
 
 GST_END_TEST;
 
+static gboolean
+busy_dispatch (gpointer user_data)
+{
+  g_usleep (2000);
+
+  return G_SOURCE_REMOVE;
+}
+
+static guint64
+histogram_sum (const GstStructure * s, const gchar * fieldname)
+{
+  const GValue *array;
+  guint64 sum = 0;
+  guint i;
+
+  array = gst_structure_get_value (s, fieldname);
+  fail_unless (array != NULL);
+  fail_unless (GST_VALUE_HOLDS_ARRAY (array));
+
+  for (i = 0; i < gst_value_array_get_size (array); i++)
+    sum += g_value_get_uint64 (gst_value_array_get_value (array, i));
+
+  return sum;
+}
+
+GST_START_TEST (test_pool_thread_stats)
+{
+  GstRTSPThreadPool *pool;
+  GstRTSPThread *thread;
+  GstStructure *s;
+  const GstStructure *ts;
+  const GValue *threads;
+  GSource *source;
+  guint64 dispatches, dispatch_max;
+  guint n_threads;
+
+  pool = gst_rtsp_thread_pool_new ();
+  fail_unless (GST_IS_RTSP_THREAD_POOL (pool));
+
+  thread = gst_rtsp_thread_pool_get_thread (pool, GST_RTSP_THREAD_TYPE_CLIENT,
+      NULL);
+  fail_unless (GST_IS_RTSP_THREAD (thread));
+
+  /* dispatch a slow source in the mainloop and wait until it shows up in
+   * the stats */
+  source = g_idle_source_new ();
+  g_source_set_callback (source, busy_dispatch, NULL, NULL);
+  g_source_attach (source, thread->context);
+  g_source_unref (source);
+
+  do {
+    s = gst_rtsp_thread_get_stats (thread);
+    fail_unless (s != NULL);
+    fail_unless (gst_structure_get_uint64 (s, "dispatches", &dispatches));
+    if (dispatches == 0) {
+      gst_structure_free (s);
+      g_usleep (1000);
+    }
+  } while (dispatches == 0);
+
+  fail_unless_equals_string (gst_structure_get_string (s, "type"), "client");
+  fail_unless (gst_structure_get_uint64 (s, "dispatch-max", &dispatch_max));
+  fail_unless (dispatch_max >= 2 * GST_MSECOND);
+  fail_unless_equals_uint64 (histogram_sum (s, "dispatch-histogram"),
+      dispatches);
+  fail_unless_equals_uint64 (histogram_sum (s, "lag-histogram"), dispatches);
+  gst_structure_free (s);
+
+  s = gst_rtsp_thread_pool_get_stats (pool);
+  fail_unless (s != NULL);
+  fail_unless (gst_structure_get_uint (s, "n-threads", &n_threads));
+  fail_unless_equals_int (n_threads, 1);
+  threads = gst_structure_get_value (s, "threads");
+  fail_unless (GST_VALUE_HOLDS_ARRAY (threads));
+  fail_unless_equals_int (gst_value_array_get_size (threads), 1);
+  ts = gst_value_get_structure (gst_value_array_get_value (threads, 0));
+  fail_unless (gst_structure_has_name (ts, "application/x-rtsp-thread-stats"));
+  gst_structure_free (s);
+
+  gst_rtsp_thread_stop (thread);
+  g_object_unref (pool);
+  gst_rtsp_thread_pool_cleanup ();
+}
+
+GST_END_TEST;
+
 static Suite *
 rtspthreadpool_suite (void)
 {
@@ -229,6 +315,7 @@ rtspthreadpool_suite (void)
   tcase_add_test (tc, test_pool_max_threads);
   tcase_add_test (tc, test_pool_max_threads_property);
   tcase_add_test (tc, test_pool_thread_copy);
+  tcase_add_test (tc, test_pool_thread_stats);
 
   return s;
 }
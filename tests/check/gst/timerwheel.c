@@ -0,0 +1,135 @@
+/* GStreamer
+ * unit tests for GstRTSPTimerWheel
+ * Copyright (C) 2021 GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+
+/* the timer wheel is not exported by the library, build it in so that the
+ * test can move the wheel forward without waiting */
+#include "rtsp-timer-wheel.c"
+
+static GString *fired;
+static gint released;
+
+static void
+timer_fired (gpointer user_data)
+{
+  g_string_append_c (fired, GPOINTER_TO_INT (user_data));
+}
+
+static void
+timer_released (gpointer user_data)
+{
+  released++;
+}
+
+/* run the ticks of @wheel up to @tick, as if the time passed */
+static void
+wheel_run_to (GstRTSPTimerWheel * wheel, guint64 tick)
+{
+  wheel->start_time = g_get_monotonic_time () - tick * G_USEC_PER_SEC -
+      G_USEC_PER_SEC / 2;
+  wheel_tick (wheel);
+  fail_unless (wheel->tick == tick);
+}
+
+static guint
+add_timer (GstRTSPTimerWheel * wheel, guint seconds, gchar name)
+{
+  guint id;
+
+  id = gst_rtsp_timer_wheel_add (wheel, seconds, timer_fired,
+      GINT_TO_POINTER (name), timer_released);
+  fail_unless (id != 0);
+
+  return id;
+}
+
+GST_START_TEST (test_timer_wheel_order)
+{
+  GMainContext *context;
+  GstRTSPTimerWheel *wheel;
+  guint id;
+
+  fired = g_string_new (NULL);
+  released = 0;
+
+  /* the context is not iterated, only the test moves the wheel */
+  context = g_main_context_new ();
+  wheel = gst_rtsp_timer_wheel_get (context);
+
+  /* B, A and F share a slot in different turns of the wheel */
+  add_timer (wheel, 100, 'A');
+  add_timer (wheel, 36, 'B');
+  add_timer (wheel, 10, 'C');
+  id = add_timer (wheel, 70, 'D');
+  add_timer (wheel, 130, 'E');
+  add_timer (wheel, 164, 'F');
+  /* timers of the same tick fire in the order they were added */
+  add_timer (wheel, 200, 'G');
+  add_timer (wheel, 200, 'H');
+  add_timer (wheel, 300, 'I');
+
+  wheel_run_to (wheel, 9);
+  fail_unless_equals_string (fired->str, "");
+  wheel_run_to (wheel, 10);
+  fail_unless_equals_string (fired->str, "C");
+  wheel_run_to (wheel, 36);
+  fail_unless_equals_string (fired->str, "CB");
+
+  /* a removed timer is released without firing */
+  fail_unless (gst_rtsp_timer_wheel_remove (wheel, id));
+  fail_unless_equals_int (released, 3);
+  fail_if (gst_rtsp_timer_wheel_remove (wheel, id));
+
+  wheel_run_to (wheel, 99);
+  fail_unless_equals_string (fired->str, "CB");
+  wheel_run_to (wheel, 100);
+  fail_unless_equals_string (fired->str, "CBA");
+
+  /* the ticks that were missed fire in order */
+  wheel_run_to (wheel, 250);
+  fail_unless_equals_string (fired->str, "CBAEFGH");
+  fail_unless_equals_int (released, 8);
+
+  /* the pending timers are released without firing */
+  gst_rtsp_timer_wheel_unref (wheel);
+  fail_unless_equals_string (fired->str, "CBAEFGH");
+  fail_unless_equals_int (released, 9);
+
+  g_main_context_unref (context);
+  g_string_free (fired, TRUE);
+}
+
+GST_END_TEST;
+
+static Suite *
+rtsptimerwheel_suite (void)
+{
+  Suite *s = suite_create ("rtsptimerwheel");
+  TCase *tc = tcase_create ("general");
+
+  suite_add_tcase (s, tc);
+  tcase_set_timeout (tc, 20);
+  tcase_add_test (tc, test_timer_wheel_order);
+
+  return s;
+}
+
+GST_CHECK_MAIN (rtsptimerwheel);